@@ -11,6 +11,7 @@
 #include "core.h"
 #include "wp.h"
 #include "private/registry.h"
+#include "private/timer-wheel.h"
 
 #include <pipewire/pipewire.h>
 
@@ -34,12 +35,16 @@ static gboolean
 wp_loop_source_dispatch (GSource * s, GSourceFunc callback, gpointer user_data)
 {
   int result;
+  gboolean watched;
 
   wp_trace_boxed (G_TYPE_SOURCE, s, "entering pw main loop");
 
+  watched = wp_watchdog_push ("pipewire events", G_TYPE_NONE, NULL, NULL);
   pw_loop_enter (WP_LOOP_SOURCE(s)->loop);
   result = pw_loop_iterate (WP_LOOP_SOURCE(s)->loop, 0);
   pw_loop_leave (WP_LOOP_SOURCE(s)->loop);
+  if (watched)
+    wp_watchdog_pop ();
 
   wp_trace_boxed (G_TYPE_SOURCE, s, "leaving pw main loop");
 
@@ -68,6 +73,7 @@ wp_loop_source_new (void)
 {
   GSource *s = g_source_new (&source_funcs, sizeof (WpLoopSource));
   WP_LOOP_SOURCE(s)->loop = pw_loop_new (NULL);
+  g_source_set_name (s, "wp-pw-loop");
 
   g_source_add_unix_fd (s,
       pw_loop_get_fd (WP_LOOP_SOURCE(s)->loop),
@@ -151,6 +157,9 @@ struct _WpCore
 
   WpRegistry registry;
   GHashTable *async_tasks; // <int seq, GTask*>
+
+  /* created on demand, see timer.c */
+  WpTimerWheel *timer_wheel;
 };
 
 enum {
@@ -314,6 +323,7 @@ wp_core_dispose (GObject * obj)
   WpCore *self = WP_CORE (obj);
 
   wp_registry_clear (&self->registry);
+  g_clear_pointer (&self->timer_wheel, wp_timer_wheel_free);
 
   G_OBJECT_CLASS (wp_core_parent_class)->dispose (obj);
 }
@@ -736,6 +746,117 @@ wp_core_update_properties (WpCore * self, WpProperties * updates)
     pw_core_update_properties (self->pw_core, wp_properties_peek_dict (upd));
 }
 
+/* the callbacks of the sources that are added with wp_core_idle_add() and
+   wp_core_timeout_add() are wrapped, so that the watchdog times them */
+typedef struct _WpWatchedSourceFunc WpWatchedSourceFunc;
+struct _WpWatchedSourceFunc
+{
+  const gchar *what;
+  GSourceFunc function;
+  gpointer data;
+  GDestroyNotify destroy;
+};
+
+static gchar *
+watched_source_func_describe (gconstpointer instance)
+{
+  const WpWatchedSourceFunc *w = instance;
+  return g_strdup_printf ("function %p", (gpointer) w->function);
+}
+
+static gboolean
+watched_source_func_dispatch (gpointer data)
+{
+  WpWatchedSourceFunc *w = data;
+  gboolean watched, ret;
+
+  watched = wp_watchdog_push (w->what, G_TYPE_NONE, w,
+      watched_source_func_describe);
+  ret = w->function (w->data);
+  if (watched)
+    wp_watchdog_pop ();
+  return ret;
+}
+
+static void
+watched_source_func_free (gpointer data)
+{
+  WpWatchedSourceFunc *w = data;
+  if (w->destroy)
+    w->destroy (w->data);
+  g_slice_free (WpWatchedSourceFunc, w);
+}
+
+static void
+source_set_watched_callback (GSource * s, const gchar * what,
+    GSourceFunc function, gpointer data, GDestroyNotify destroy)
+{
+  WpWatchedSourceFunc *w = g_slice_new (WpWatchedSourceFunc);
+  w->what = what;
+  w->function = function;
+  w->data = data;
+  w->destroy = destroy;
+  g_source_set_callback (s, watched_source_func_dispatch, w,
+      watched_source_func_free);
+}
+
+/* the same for closures, with marshal guards; a closure may be invoked
+   recursively, so remember which invocations are being watched */
+typedef struct _WpWatchedClosure WpWatchedClosure;
+struct _WpWatchedClosure
+{
+  const gchar *what;
+  guint depth;
+  guint64 watched;
+};
+
+static void
+watched_closure_pre (gpointer data, GClosure * closure)
+{
+  WpWatchedClosure *w = data;
+
+  if (w->depth < 64 &&
+      wp_watchdog_push (w->what, G_TYPE_CLOSURE, closure, NULL))
+    w->watched |= G_GUINT64_CONSTANT (1) << w->depth;
+  w->depth++;
+}
+
+static void
+watched_closure_post (gpointer data, GClosure * closure)
+{
+  WpWatchedClosure *w = data;
+  guint64 bit;
+
+  w->depth--;
+  bit = (w->depth < 64) ? G_GUINT64_CONSTANT (1) << w->depth : 0;
+  if (w->watched & bit) {
+    w->watched &= ~bit;
+    wp_watchdog_pop ();
+  }
+}
+
+static void
+watched_closure_free (gpointer data, GClosure * closure)
+{
+  g_slice_free (WpWatchedClosure, data);
+}
+
+static void
+source_set_watched_closure (GSource * s, const gchar * what,
+    GClosure * closure)
+{
+  /* a closure can only have one pair of marshal guards; if it already has
+     them (e.g. it was added on a source before), it is not watched */
+  if (closure->n_guards == 0) {
+    WpWatchedClosure *w = g_slice_new0 (WpWatchedClosure);
+    w->what = what;
+    g_closure_add_marshal_guards (closure, w, watched_closure_pre,
+        w, watched_closure_post);
+    g_closure_add_finalize_notifier (closure, w, watched_closure_free);
+  }
+  g_source_set_closure (s, closure);
+}
+
 /*!
  * \brief Adds an idle callback to be called in the same GMainContext as the
  * one used by this core.
@@ -759,7 +880,7 @@ wp_core_idle_add (WpCore * self, GSource **source, GSourceFunc function,
   g_return_if_fail (WP_IS_CORE (self));
 
   s = g_idle_source_new ();
-  g_source_set_callback (s, function, data, destroy);
+  source_set_watched_callback (s, "idle callback", function, data, destroy);
   g_source_attach (s, self->g_main_context);
 
   if (source)
@@ -787,7 +908,7 @@ wp_core_idle_add_closure (WpCore * self, GSource **source, GClosure * closure)
   g_return_if_fail (closure != NULL);
 
   s = g_idle_source_new ();
-  g_source_set_closure (s, closure);
+  source_set_watched_closure (s, "idle callback", closure);
   g_source_attach (s, self->g_main_context);
 
   if (source)
@@ -824,7 +945,8 @@ wp_core_timeout_add (WpCore * self, GSource **source, guint timeout_ms,
   g_return_if_fail (WP_IS_CORE (self));
 
   s = g_timeout_source_new (timeout_ms);
-  g_source_set_callback (s, function, data, destroy);
+  source_set_watched_callback (s, "timeout callback", function, data,
+      destroy);
   g_source_attach (s, self->g_main_context);
 
   if (source)
@@ -854,7 +976,7 @@ wp_core_timeout_add_closure (WpCore * self, GSource **source, guint timeout_ms,
   g_return_if_fail (closure != NULL);
 
   s = g_timeout_source_new (timeout_ms);
-  g_source_set_closure (s, closure);
+  source_set_watched_closure (s, "timeout callback", closure);
   g_source_attach (s, self->g_main_context);
 
   if (source)
@@ -988,6 +1110,14 @@ wp_core_get_registry (WpCore * self)
   return &self->registry;
 }
 
+WpTimerWheel *
+wp_core_get_timer_wheel (WpCore * self)
+{
+  if (!self->timer_wheel)
+    self->timer_wheel = wp_timer_wheel_new (self->g_main_context);
+  return self->timer_wheel;
+}
+
 WpCore *
 wp_registry_get_core (WpRegistry * self)
 {
@@ -13,6 +13,7 @@
 #include "log.h"
 #include "error.h"
 #include "wpenums.h"
+#include "private/string-pool.h"
 
 #include <pipewire/impl.h>
 #include <pipewire/pipewire.h>
@@ -61,12 +62,13 @@ static guint32 signals[N_SIGNALS] = {0};
 
 /* data structure */
 
+/* the strings come from the string pool */
 struct item
 {
   uint32_t subject;
-  gchar *key;
-  gchar *type;
-  gchar *value;
+  const gchar *key;
+  const gchar *type;
+  const gchar *value;
 };
 
 static void
@@ -74,17 +76,17 @@ set_item (struct item * item, uint32_t subject, const char * key,
     const char * type, const char * value)
 {
   item->subject = subject;
-  item->key = g_strdup (key);
-  item->type = g_strdup (type);
-  item->value = g_strdup (value);
+  item->key = wp_string_pool_intern (key);
+  item->type = wp_string_pool_intern (type);
+  item->value = wp_string_pool_intern_value (value);
 }
 
 static void
 clear_item (struct item * item)
 {
-  g_free (item->key);
-  g_free (item->type);
-  g_free (item->value);
+  wp_string_pool_release (item->key);
+  wp_string_pool_release (item->type);
+  wp_string_pool_release (item->value);
   spa_zero (*item);
 }
 
@@ -94,7 +96,8 @@ find_item (struct pw_array * metadata, uint32_t subject, const char * key)
   struct item *item;
 
   pw_array_for_each (item, metadata) {
-    if (item->subject == subject && (key == NULL || !strcmp (item->key, key))) {
+    if (item->subject == subject && (key == NULL || item->key == key ||
+            !strcmp (item->key, key))) {
       return item;
     }
   }
@@ -14,6 +14,7 @@
 #include "log.h"
 #include "wpenums.h"
 #include "private/pipewire-object-mixin.h"
+#include "private/port-index.h"
 
 #include <pipewire/impl.h>
 
@@ -99,7 +100,10 @@ static guint32 signals[N_SIGNALS] = {0};
 struct _WpNode
 {
   WpGlobalProxy parent;
-  WpObjectManager *ports_om;
+
+  /* the id under which this node is registered on the port index,
+     while WP_NODE_FEATURE_PORTS is enabled or being enabled */
+  guint32 ports_node_id;
 };
 
 static void wp_node_pw_object_mixin_priv_interface_init (
@@ -114,6 +118,7 @@ G_DEFINE_TYPE_WITH_CODE (WpNode, wp_node, WP_TYPE_GLOBAL_PROXY,
 static void
 wp_node_init (WpNode * self)
 {
+  self->ports_node_id = SPA_ID_INVALID;
 }
 
 static void
@@ -150,15 +155,50 @@ wp_node_get_property (GObject * object, guint property_id,
 }
 
 static void
-wp_node_on_ports_om_installed (WpObjectManager *ports_om, WpNode * self)
+wp_node_disable_feature_ports (WpNode * self)
 {
-  wp_object_update_features (WP_OBJECT (self), WP_NODE_FEATURE_PORTS, 0);
+  g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (self));
+  WpPortIndex *index = core ? wp_port_index_peek (core) : NULL;
+
+  if (index && self->ports_node_id != SPA_ID_INVALID)
+    wp_port_index_remove_node (index, self, self->ports_node_id);
+  self->ports_node_id = SPA_ID_INVALID;
 }
 
 static void
-wp_node_emit_ports_changed (WpObjectManager *ports_om, WpNode * self)
+wp_node_ports_sync_done (WpCore * core, GAsyncResult * res, WpNode * self)
 {
-  g_signal_emit (self, signals[SIGNAL_PORTS_CHANGED], 0);
+  g_autoptr (WpNode) node = self;
+  g_autoptr (GError) error = NULL;
+  WpPortIndex *index;
+
+  if (!wp_core_sync_finish (core, res, &error)) {
+    wp_warning_object (self, "core sync error: %s", error->message);
+    return;
+  }
+
+  /* the feature was disabled in the meantime */
+  index = wp_port_index_peek (core);
+  if (!index || self->ports_node_id == SPA_ID_INVALID ||
+      !wp_port_index_has_node (index, self, self->ports_node_id))
+    return;
+
+  /* the ports of this node have been exposed by now, since they appeared
+     on the registry before the sync; wait until they are also prepared */
+  if (!wp_port_index_is_node_ready (index, self->ports_node_id)) {
+    wp_core_sync (core, NULL, (GAsyncReadyCallback) wp_node_ports_sync_done,
+        g_steal_pointer (&node));
+    return;
+  }
+
+  wp_object_update_features (WP_OBJECT (self), WP_NODE_FEATURE_PORTS, 0);
+
+  /* like the ports object manager used to, announce the initial ports
+     right after the feature is enabled */
+  if (wp_port_index_get_n_ports (index, self->ports_node_id) > 0) {
+    wp_port_index_clear_changed (index, self->ports_node_id);
+    g_signal_emit (self, signals[SIGNAL_PORTS_CHANGED], 0);
+  }
 }
 
 static void
@@ -170,20 +210,12 @@ wp_node_enable_feature_ports (WpNode * self)
   wp_debug_object (self, "enabling WP_NODE_FEATURE_PORTS, bound_id:%u",
       bound_id);
 
-  self->ports_om = wp_object_manager_new ();
-  wp_object_manager_add_interest (self->ports_om,
-      WP_TYPE_PORT,
-      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_NODE_ID, "=u", bound_id,
-      NULL);
-  wp_object_manager_request_object_features (self->ports_om,
-      WP_TYPE_PORT, WP_OBJECT_FEATURES_ALL);
-
-  g_signal_connect_object (self->ports_om, "installed",
-      G_CALLBACK (wp_node_on_ports_om_installed), self, 0);
-  g_signal_connect_object (self->ports_om, "objects-changed",
-      G_CALLBACK (wp_node_emit_ports_changed), self, 0);
+  wp_node_disable_feature_ports (self);
+  self->ports_node_id = bound_id;
+  wp_port_index_add_node (wp_port_index_get (core), self, bound_id);
 
-  wp_core_install_object_manager (core, self->ports_om);
+  wp_core_sync (core, NULL, (GAsyncReadyCallback) wp_node_ports_sync_done,
+      g_object_ref (self));
 }
 
 static WpObjectFeatures
@@ -229,8 +261,7 @@ wp_node_deactivate (WpObject * object, WpObjectFeatures features)
   wp_pw_object_mixin_deactivate (object, features);
 
   if (features & WP_NODE_FEATURE_PORTS) {
-    WpNode *self = WP_NODE (object);
-    g_clear_object (&self->ports_om);
+    wp_node_disable_feature_ports (WP_NODE (object));
     wp_object_update_features (object, 0, WP_NODE_FEATURE_PORTS);
   }
 
@@ -257,7 +288,7 @@ wp_node_pw_proxy_destroyed (WpProxy * proxy)
 
   wp_pw_object_mixin_handle_pw_proxy_destroyed (proxy);
 
-  g_clear_object (&self->ports_om);
+  wp_node_disable_feature_ports (self);
   wp_object_update_features (WP_OBJECT (self), 0, WP_NODE_FEATURE_PORTS);
 
   WP_PROXY_CLASS (wp_node_parent_class)->pw_proxy_destroyed (proxy);
@@ -468,6 +499,13 @@ wp_node_get_n_output_ports (WpNode * self, guint * max)
   return info->n_output_ports;
 }
 
+static WpPortIndex *
+wp_node_get_port_index (WpNode * self)
+{
+  g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (self));
+  return wp_port_index_get (core);
+}
+
 /*!
  * \brief Gets the number of ports of this node
  *
@@ -490,7 +528,8 @@ wp_node_get_n_ports (WpNode * self)
   g_return_val_if_fail (wp_object_get_active_features (WP_OBJECT (self)) &
           WP_NODE_FEATURE_PORTS, 0);
 
-  return wp_object_manager_get_n_objects (self->ports_om);
+  return wp_port_index_get_n_ports (wp_node_get_port_index (self),
+      self->ports_node_id);
 }
 
 /*!
@@ -510,7 +549,10 @@ wp_node_new_ports_iterator (WpNode * self)
   g_return_val_if_fail (wp_object_get_active_features (WP_OBJECT (self)) &
           WP_NODE_FEATURE_PORTS, NULL);
 
-  return wp_object_manager_new_iterator (self->ports_om);
+  return wp_iterator_new_ptr_array (
+      wp_port_index_dup_ports (wp_node_get_port_index (self),
+          self->ports_node_id, NULL),
+      WP_TYPE_PORT);
 }
 
 /*!
@@ -557,8 +599,10 @@ wp_node_new_ports_filtered_iterator_full (WpNode * self,
   g_return_val_if_fail (wp_object_get_active_features (WP_OBJECT (self)) &
           WP_NODE_FEATURE_PORTS, NULL);
 
-  return wp_object_manager_new_filtered_iterator_full (self->ports_om,
-      interest);
+  return wp_iterator_new_ptr_array (
+      wp_port_index_dup_ports (wp_node_get_port_index (self),
+          self->ports_node_id, interest),
+      WP_TYPE_PORT);
 }
 
 /*!
@@ -604,8 +648,8 @@ wp_node_lookup_port_full (WpNode * self, WpObjectInterest * interest)
   g_return_val_if_fail (wp_object_get_active_features (WP_OBJECT (self)) &
           WP_NODE_FEATURE_PORTS, NULL);
 
-  return (WpPort *)
-      wp_object_manager_lookup_full (self->ports_om, interest);
+  return wp_port_index_lookup_port (wp_node_get_port_index (self),
+      self->ports_node_id, interest);
 }
 
 /*!
@@ -14,6 +14,8 @@
 #include "proxy-interfaces.h"
 #include "log.h"
 #include "error.h"
+#include "private/registry.h"
+#include "private/string-pool.h"
 
 #include <pipewire/pipewire.h>
 
@@ -35,7 +37,7 @@ struct constraint
   WpConstraintType type;
   WpConstraintVerb verb;
   gchar subject_type; /* a basic GVariantType as a single char */
-  gchar *subject;
+  const gchar *subject; /* from the string pool */
   GVariant *value;
 };
 
@@ -237,7 +239,7 @@ wp_object_interest_add_constraint (WpObjectInterest * self,
   c->verb = verb;
   /* subject_type is filled in by _validate() */
   c->subject_type = '\0';
-  c->subject = g_strdup (subject);
+  c->subject = wp_string_pool_intern (subject);
   c->value = value ? g_variant_ref_sink (value) : NULL;
 
   /* mark as invalid to force validation */
@@ -265,7 +267,7 @@ wp_object_interest_free (WpObjectInterest * self)
   g_return_if_fail (self != NULL);
 
   pw_array_for_each (c, &self->constraints) {
-    g_clear_pointer (&c->subject, g_free);
+    wp_string_pool_release (c->subject);
     g_clear_pointer (&c->value, g_variant_unref);
   }
   pw_array_clear (&self->constraints);
@@ -873,3 +875,65 @@ wp_object_interest_matches_full (WpObjectInterest * self,
   }
   return result;
 }
+
+/* private API, used by the registry to index object managers */
+
+GType
+wp_object_interest_get_object_type (WpObjectInterest * self)
+{
+  return self->gtype;
+}
+
+/*
+ * Returns the value that a pipewire global property named \a subject must
+ * have in order for an object to match this interest, as a string, or NULL
+ * if \a self does not constrain this property to a single value
+ */
+gchar *
+wp_object_interest_dup_global_property_value (WpObjectInterest * self,
+    const gchar * subject)
+{
+  struct constraint *c;
+
+  if (!wp_object_interest_validate (self, NULL))
+    return NULL;
+
+  pw_array_for_each (c, &self->constraints) {
+    if (c->type != WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY ||
+        c->verb != WP_CONSTRAINT_VERB_EQUALS ||
+        g_strcmp0 (c->subject, subject) != 0)
+      continue;
+
+    switch (c->subject_type) {
+      case 's':
+        return g_variant_dup_string (c->value, NULL);
+      case 'i':
+        return g_strdup_printf ("%d", g_variant_get_int32 (c->value));
+      case 'u':
+        return g_strdup_printf ("%u", g_variant_get_uint32 (c->value));
+      default:
+        break;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Returns (transfer container): the subjects of the constraints of type
+ * \a type, as strings that are owned by \a self
+ */
+GPtrArray *
+wp_object_interest_get_subjects (WpObjectInterest * self,
+    WpConstraintType type)
+{
+  GPtrArray *subjects = g_ptr_array_new ();
+  struct constraint *c;
+
+  pw_array_for_each (c, &self->constraints) {
+    if (c->type == type &&
+        !g_ptr_array_find_with_equal_func (subjects, c->subject, g_str_equal,
+            NULL))
+      g_ptr_array_add (subjects, (gpointer) c->subject);
+  }
+  return subjects;
+}
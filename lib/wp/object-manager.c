@@ -12,6 +12,7 @@
 #include "log.h"
 #include "proxy-interfaces.h"
 #include "private/registry.h"
+#include "private/port-index.h"
 
 #include <pipewire/pipewire.h>
 
@@ -52,6 +53,13 @@
  * \c installed signal has been emitted. That signal is emitted asynchronously
  * after all the initial objects have been prepared.
  *
+ * Normally, whether an object matches the interests is decided once, when the
+ * object is offered to the object manager. In live mode (see
+ * wp_object_manager_set_live()), objects whose PipeWire properties or GObject
+ * properties change later are re-checked against the constraints that
+ * concern the changed keys; \c object-added and \c object-removed are then
+ * emitted as they start or stop matching.
+ *
  * \gproperties
  *
  * \gproperty{core, WpCore *, G_PARAM_READABLE, The core}
@@ -144,6 +152,19 @@ struct _WpObjectManager
   gboolean changed;
   guint pending_objects;
   GSource *idle_source;
+
+  /* live mode; element-type: <GObject*, guint> (weak ref on the object), the
+     set of candidate objects and the mask of interests that each one
+     currently matches */
+  gboolean live;
+  GHashTable *live_objects;
+  /* element-type: <const gchar*, guint>, the mask of interests that have
+     constraints on each PipeWire / GObject property */
+  GHashTable *live_pw_keys;
+  GHashTable *live_g_props;
+
+  /* used by the registry to avoid notifying this object manager twice */
+  guint index_stamp;
 };
 
 enum {
@@ -163,6 +184,14 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE (WpObjectManager, wp_object_manager, G_TYPE_OBJECT)
 
+static void wp_registry_index_add_interest (WpRegistry *self,
+    WpObjectManager *om, WpObjectInterest *interest);
+static void live_update_subjects (WpObjectManager * self);
+static void live_disable (WpObjectManager * self);
+
+/* the interests of a live object manager are tracked in 32-bit masks */
+#define LIVE_MAX_INTERESTS 32
+
 static void
 wp_object_manager_init (WpObjectManager * self)
 {
@@ -185,6 +214,7 @@ wp_object_manager_finalize (GObject * object)
     g_source_destroy (self->idle_source);
     g_clear_pointer (&self->idle_source, g_source_unref);
   }
+  live_disable (self);
   g_clear_pointer (&self->objects, g_ptr_array_unref);
   g_clear_pointer (&self->features, g_hash_table_unref);
   g_clear_pointer (&self->interests, g_ptr_array_unref);
@@ -320,6 +350,85 @@ wp_object_manager_add_interest_full (WpObjectManager *self,
     return;
   }
   g_ptr_array_add (self->interests, interest);
+
+  if (self->live && self->interests->len > LIVE_MAX_INTERESTS) {
+    wp_warning_object (self, "more than %u interests, disabling live mode",
+        LIVE_MAX_INTERESTS);
+    live_disable (self);
+  } else if (self->live) {
+    live_update_subjects (self);
+  }
+
+  /* if we are already installed, make sure the registry knows about it */
+  {
+    g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
+    if (core)
+      wp_registry_index_add_interest (wp_core_get_registry (core), self,
+          interest);
+  }
+}
+
+/*!
+ * \brief Enables or disables the live mode of the object manager.
+ *
+ * In live mode, the object manager keeps watching the objects that match
+ * the type and the PipeWire global properties of its interests, whether
+ * they match the rest of the constraints or not. When one of the PipeWire
+ * properties or GObject properties that the constraints refer to changes,
+ * only the interests that have constraints on it are checked again and the
+ * object is added or removed accordingly.
+ *
+ * This must be called before the object manager is installed. Interests
+ * that are added later only take effect for the objects that are offered
+ * to the object manager after they have been added. The live mode supports
+ * up to 32 interests; it is disabled, with a warning, if there are more.
+ *
+ * \ingroup wpobjectmanager
+ * \param self the object manager
+ * \param live whether to enable the live mode
+ * \since 0.4.10
+ */
+void
+wp_object_manager_set_live (WpObjectManager * self, gboolean live)
+{
+  g_autoptr (WpCore) core = NULL;
+
+  g_return_if_fail (WP_IS_OBJECT_MANAGER (self));
+  core = g_weak_ref_get (&self->core);
+  g_return_if_fail (core == NULL);
+
+  if (live && self->interests->len > LIVE_MAX_INTERESTS) {
+    wp_warning_object (self, "more than %u interests, not enabling live mode",
+        LIVE_MAX_INTERESTS);
+    return;
+  }
+
+  if (!live) {
+    live_disable (self);
+    return;
+  }
+
+  self->live = live;
+  if (!self->live_objects) {
+    self->live_objects = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->live_pw_keys = g_hash_table_new (g_str_hash, g_str_equal);
+    self->live_g_props = g_hash_table_new (g_str_hash, g_str_equal);
+    live_update_subjects (self);
+  }
+}
+
+/*!
+ * \brief Checks whether the object manager is in live mode.
+ * \ingroup wpobjectmanager
+ * \param self the object manager
+ * \returns TRUE if the live mode is enabled, FALSE otherwise
+ * \since 0.4.10
+ */
+gboolean
+wp_object_manager_is_live (WpObjectManager * self)
+{
+  g_return_val_if_fail (WP_IS_OBJECT_MANAGER (self), FALSE);
+  return self->live;
 }
 
 static void
@@ -635,8 +744,8 @@ wp_object_manager_is_interested_in_global (WpObjectManager * self,
     /* and consider the manager interested if the type and the globals match...
        if pw_properties / g_properties fail, that's ok because they are not
        known yet (the proxy is likely NULL and properties not yet retrieved) */
-    if (match & (WP_INTEREST_MATCH_GTYPE |
-                 WP_INTEREST_MATCH_PW_GLOBAL_PROPERTIES)) {
+    if (SPA_FLAG_IS_SET (match, WP_INTEREST_MATCH_GTYPE |
+                                WP_INTEREST_MATCH_PW_GLOBAL_PROPERTIES)) {
       gpointer ft = g_hash_table_lookup (self->features,
           GSIZE_TO_POINTER (global->type));
       *wanted_features = (WpObjectFeatures) GPOINTER_TO_UINT (ft);
@@ -721,11 +830,214 @@ wp_object_manager_maybe_objects_changed (WpObjectManager * self)
   }
 }
 
+static inline guint
+interest_bit (guint index)
+{
+  g_assert (index < LIVE_MAX_INTERESTS);
+  return 1u << index;
+}
+
+static void
+add_subjects (GHashTable * table, WpObjectInterest * interest, guint bit,
+    WpConstraintType type)
+{
+  g_autoptr (GPtrArray) subjects = wp_object_interest_get_subjects (interest,
+      type);
+
+  for (guint i = 0; i < subjects->len; i++) {
+    const gchar *subject = g_ptr_array_index (subjects, i);
+    guint mask = GPOINTER_TO_UINT (g_hash_table_lookup (table, subject));
+    g_hash_table_insert (table, (gpointer) subject,
+        GUINT_TO_POINTER (mask | bit));
+  }
+}
+
+static void
+live_update_subjects (WpObjectManager * self)
+{
+  g_hash_table_remove_all (self->live_pw_keys);
+  g_hash_table_remove_all (self->live_g_props);
+
+  for (guint i = 0; i < self->interests->len; i++) {
+    WpObjectInterest *interest = g_ptr_array_index (self->interests, i);
+    add_subjects (self->live_pw_keys, interest, interest_bit (i),
+        WP_CONSTRAINT_TYPE_PW_PROPERTY);
+    add_subjects (self->live_g_props, interest, interest_bit (i),
+        WP_CONSTRAINT_TYPE_G_PROPERTY);
+  }
+}
+
+/* re-checks the interests in the @which mask and returns the updated mask of
+   the interests that @object matches; if @candidate is not NULL, it is set
+   to TRUE when the type and the global properties of @object match at least
+   one of the checked interests */
+static guint
+live_check_interests (WpObjectManager * self, GObject * object, guint which,
+    guint matches, gboolean * candidate)
+{
+  WpInterestMatchFlags flags = candidate ?
+      WP_INTEREST_MATCH_FLAGS_CHECK_ALL : WP_INTEREST_MATCH_FLAGS_NONE;
+
+  matches &= ~which;
+
+  for (guint i = 0; i < self->interests->len; i++) {
+    WpObjectInterest *interest = g_ptr_array_index (self->interests, i);
+    WpInterestMatch match;
+
+    if (!(which & interest_bit (i)))
+      continue;
+
+    match = wp_object_interest_matches_full (interest, flags,
+        G_OBJECT_TYPE (object), object, NULL, NULL);
+    if (match == WP_INTEREST_MATCH_ALL)
+      matches |= interest_bit (i);
+    if (candidate && SPA_FLAG_IS_SET (match,
+            WP_INTEREST_MATCH_GTYPE | WP_INTEREST_MATCH_PW_GLOBAL_PROPERTIES))
+      *candidate = TRUE;
+  }
+  return matches;
+}
+
+static void
+live_recheck_object (WpObjectManager * self, GObject * object, guint which)
+{
+  g_autoptr (WpObjectManager) self_ref = g_object_ref (self);
+  gpointer value;
+  guint old_matches, matches;
+
+  if (!which ||
+      !g_hash_table_lookup_extended (self->live_objects, object, NULL, &value))
+    return;
+
+  old_matches = GPOINTER_TO_UINT (value);
+  matches = live_check_interests (self, object, which, old_matches, NULL);
+  g_hash_table_insert (self->live_objects, object, GUINT_TO_POINTER (matches));
+
+  if (!old_matches && matches) {
+    wp_trace_object (self, "now matching: " WP_OBJECT_FORMAT,
+        WP_OBJECT_ARGS (object));
+    g_ptr_array_add (self->objects, object);
+    g_signal_emit (self, signals[SIGNAL_OBJECT_ADDED], 0, object);
+    self->changed = TRUE;
+  }
+  else if (old_matches && !matches) {
+    wp_trace_object (self, "no longer matching: " WP_OBJECT_FORMAT,
+        WP_OBJECT_ARGS (object));
+    g_ptr_array_remove_fast (self->objects, object);
+    g_signal_emit (self, signals[SIGNAL_OBJECT_REMOVED], 0, object);
+    self->changed = TRUE;
+  }
+
+  wp_object_manager_maybe_objects_changed (self);
+}
+
+static void
+on_live_pw_property_changed (GObject * object, const gchar * key,
+    const gchar * value, WpObjectManager * self)
+{
+  live_recheck_object (self, object,
+      GPOINTER_TO_UINT (g_hash_table_lookup (self->live_pw_keys, key)));
+}
+
+static void
+on_live_g_property_changed (GObject * object, GParamSpec * pspec,
+    WpObjectManager * self)
+{
+  live_recheck_object (self, object,
+      GPOINTER_TO_UINT (g_hash_table_lookup (self->live_g_props, pspec->name)));
+}
+
+static void
+live_object_destroyed (gpointer data, GObject * object)
+{
+  WpObjectManager *self = WP_OBJECT_MANAGER (data);
+
+  /* the object was finalized without going through the registry's removal
+     path; its address may be reused, so forget it entirely */
+  g_hash_table_remove (self->live_objects, object);
+  g_ptr_array_remove_fast (self->objects, object);
+}
+
+static void
+live_track_object (WpObjectManager * self, GObject * object, guint matches)
+{
+  GHashTableIter iter;
+  gpointer subject;
+
+  if (!g_hash_table_insert (self->live_objects, object,
+          GUINT_TO_POINTER (matches)))
+    return;
+
+  g_object_weak_ref (object, live_object_destroyed, self);
+
+  /* the handlers are disconnected when either side is destroyed */
+  if (WP_IS_PIPEWIRE_OBJECT (object)) {
+    g_hash_table_iter_init (&iter, self->live_pw_keys);
+    while (g_hash_table_iter_next (&iter, &subject, NULL)) {
+      g_autofree gchar *signal =
+          g_strconcat ("properties-changed::", subject, NULL);
+      g_signal_connect_object (object, signal,
+          G_CALLBACK (on_live_pw_property_changed), self, 0);
+    }
+  }
+
+  g_hash_table_iter_init (&iter, self->live_g_props);
+  while (g_hash_table_iter_next (&iter, &subject, NULL)) {
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (object), subject)) {
+      g_autofree gchar *signal = g_strconcat ("notify::", subject, NULL);
+      g_signal_connect_object (object, signal,
+          G_CALLBACK (on_live_g_property_changed), self, 0);
+    }
+  }
+}
+
+static void
+live_untrack_object (WpObjectManager * self, GObject * object)
+{
+  if (g_hash_table_remove (self->live_objects, object)) {
+    g_object_weak_unref (object, live_object_destroyed, self);
+    g_signal_handlers_disconnect_by_data (object, self);
+  }
+}
+
+static void
+live_disable (WpObjectManager * self)
+{
+  if (self->live_objects) {
+    GHashTableIter iter;
+    gpointer object;
+
+    g_hash_table_iter_init (&iter, self->live_objects);
+    while (g_hash_table_iter_next (&iter, &object, NULL)) {
+      g_object_weak_unref (object, live_object_destroyed, self);
+      g_signal_handlers_disconnect_by_data (object, self);
+    }
+  }
+
+  self->live = FALSE;
+  g_clear_pointer (&self->live_objects, g_hash_table_unref);
+  g_clear_pointer (&self->live_pw_keys, g_hash_table_unref);
+  g_clear_pointer (&self->live_g_props, g_hash_table_unref);
+}
+
 /* caller must also call wp_object_manager_maybe_objects_changed() after */
 static void
 wp_object_manager_add_object (WpObjectManager * self, gpointer object)
 {
-  if (wp_object_manager_is_interested_in_object (self, object)) {
+  gboolean interested;
+
+  if (self->live) {
+    gboolean candidate = FALSE;
+    guint matches =
+        live_check_interests (self, object, G_MAXUINT, 0, &candidate);
+    if (candidate)
+      live_track_object (self, object, matches);
+    interested = (matches != 0);
+  } else {
+    interested = wp_object_manager_is_interested_in_object (self, object);
+  }
+
+  if (interested) {
     wp_trace_object (self, "added: " WP_OBJECT_FORMAT, WP_OBJECT_ARGS (object));
     g_ptr_array_add (self->objects, object);
     g_signal_emit (self, signals[SIGNAL_OBJECT_ADDED], 0, object);
@@ -738,6 +1050,10 @@ static void
 wp_object_manager_rm_object (WpObjectManager * self, gpointer object)
 {
   guint index;
+
+  if (self->live)
+    live_untrack_object (self, object);
+
   if (g_ptr_array_find (self->objects, object, &index)) {
     g_ptr_array_remove_index_fast (self->objects, index);
     g_signal_emit (self, signals[SIGNAL_OBJECT_REMOVED], 0, object);
@@ -846,11 +1162,172 @@ wp_object_manager_add_global (WpObjectManager * self, WpGlobal * global)
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "wp-registry"
 
+/*
+ * Object managers are indexed by the GType of each one of their interests,
+ * so that a new object is only offered to the object managers that have
+ * at least one interest on its type (or one of its parent types).
+ * Interests that additionally require a specific value for the OM_INDEX_KEY
+ * global property (ex. the ports object manager of every WpNode) are further
+ * indexed by that value, so that a new global is only offered to the object
+ * managers that require the value that this global actually has.
+ */
+#define OM_INDEX_KEY PW_KEY_NODE_ID
+
+typedef struct _WpObjectManagerIndex WpObjectManagerIndex;
+struct _WpObjectManagerIndex
+{
+  /* element-type: WpObjectManager* (no ref) */
+  GPtrArray *any;
+  /* element-type: <gchar*, GPtrArray<WpObjectManager*>> */
+  GHashTable *by_key;
+};
+
+static WpObjectManagerIndex *
+wp_object_manager_index_new (void)
+{
+  WpObjectManagerIndex *self = g_slice_new0 (WpObjectManagerIndex);
+  self->any = g_ptr_array_new ();
+  self->by_key = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_ptr_array_unref);
+  return self;
+}
+
+static void
+wp_object_manager_index_free (WpObjectManagerIndex * self)
+{
+  g_clear_pointer (&self->any, g_ptr_array_unref);
+  g_clear_pointer (&self->by_key, g_hash_table_unref);
+  g_slice_free (WpObjectManagerIndex, self);
+}
+
+static void
+wp_registry_index_add_interest (WpRegistry *self, WpObjectManager *om,
+    WpObjectInterest *interest)
+{
+  GType gtype = wp_object_interest_get_object_type (interest);
+  g_autofree gchar *key = NULL;
+  WpObjectManagerIndex *index;
+  GPtrArray *oms;
+
+  /* prevent bad things when called from within wp_registry_clear() */
+  if (G_UNLIKELY (!self->om_index))
+    return;
+
+  index = g_hash_table_lookup (self->om_index, GSIZE_TO_POINTER (gtype));
+  if (!index) {
+    index = wp_object_manager_index_new ();
+    g_hash_table_insert (self->om_index, GSIZE_TO_POINTER (gtype), index);
+  }
+
+  key = wp_object_interest_dup_global_property_value (interest, OM_INDEX_KEY);
+  if (key) {
+    oms = g_hash_table_lookup (index->by_key, key);
+    if (!oms) {
+      oms = g_ptr_array_new ();
+      g_hash_table_insert (index->by_key, g_steal_pointer (&key), oms);
+    }
+  } else {
+    oms = index->any;
+  }
+  g_ptr_array_add (oms, om);
+}
+
+static void
+wp_registry_index_remove_interest (WpRegistry *self, WpObjectManager *om,
+    WpObjectInterest *interest)
+{
+  GType gtype = wp_object_interest_get_object_type (interest);
+  g_autofree gchar *key = NULL;
+  WpObjectManagerIndex *index;
+
+  if (G_UNLIKELY (!self->om_index))
+    return;
+
+  index = g_hash_table_lookup (self->om_index, GSIZE_TO_POINTER (gtype));
+  if (!index)
+    return;
+
+  key = wp_object_interest_dup_global_property_value (interest, OM_INDEX_KEY);
+  if (key) {
+    GPtrArray *oms = g_hash_table_lookup (index->by_key, key);
+    if (oms) {
+      g_ptr_array_remove_fast (oms, om);
+      if (oms->len == 0)
+        g_hash_table_remove (index->by_key, key);
+    }
+  } else {
+    g_ptr_array_remove_fast (index->any, om);
+  }
+}
+
+static inline void
+collect_object_managers (WpRegistry *self, GPtrArray *oms, GPtrArray *result)
+{
+  for (guint i = 0; i < oms->len; i++) {
+    WpObjectManager *om = g_ptr_array_index (oms, i);
+    if (om->index_stamp != self->om_index_stamp) {
+      om->index_stamp = self->om_index_stamp;
+      g_ptr_array_add (result, g_object_ref (om));
+    }
+  }
+}
+
+/*
+ * Returns (transfer full): the object managers that may be interested in an
+ * object of the given \a type, which has the given pipewire global properties;
+ * if \a props is NULL, the global properties are assumed to be unknown
+ */
+static GPtrArray *
+wp_registry_find_object_managers (WpRegistry *self, GType type,
+    WpProperties *props)
+{
+  GPtrArray *result = g_ptr_array_new_with_free_func (g_object_unref);
+  const gchar *key = props ? wp_properties_get (props, OM_INDEX_KEY) : NULL;
+  GHashTableIter iter;
+  gpointer itype, value;
+
+  if (G_UNLIKELY (!self->om_index))
+    return result;
+
+  self->om_index_stamp++;
+
+  /* the number of distinct interest types is small and does not depend
+     on the number of objects, so just check all of them */
+  g_hash_table_iter_init (&iter, self->om_index);
+  while (g_hash_table_iter_next (&iter, &itype, &value)) {
+    WpObjectManagerIndex *index = value;
+
+    if (!g_type_is_a (type, GPOINTER_TO_SIZE (itype)))
+      continue;
+
+    collect_object_managers (self, index->any, result);
+
+    if (key) {
+      GPtrArray *oms = g_hash_table_lookup (index->by_key, key);
+      if (oms)
+        collect_object_managers (self, oms, result);
+    }
+    /* properties are unknown; anything may match */
+    else if (!props) {
+      GHashTableIter kiter;
+      gpointer oms;
+
+      g_hash_table_iter_init (&kiter, index->by_key);
+      while (g_hash_table_iter_next (&kiter, NULL, &oms))
+        collect_object_managers (self, oms, result);
+    }
+  }
+  return result;
+}
+
 static void
 wp_registry_notify_add_object (WpRegistry *self, gpointer object)
 {
-  for (guint i = 0; i < self->object_managers->len; i++) {
-    WpObjectManager *om = g_ptr_array_index (self->object_managers, i);
+  g_autoptr (GPtrArray) oms =
+      wp_registry_find_object_managers (self, G_OBJECT_TYPE (object), NULL);
+
+  for (guint i = 0; i < oms->len; i++) {
+    WpObjectManager *om = g_ptr_array_index (oms, i);
     wp_object_manager_add_object (om, object);
     wp_object_manager_maybe_objects_changed (om);
   }
@@ -859,17 +1336,35 @@ wp_registry_notify_add_object (WpRegistry *self, gpointer object)
 static void
 wp_registry_notify_rm_object (WpRegistry *self, gpointer object)
 {
-  for (guint i = 0; i < self->object_managers->len; i++) {
-    WpObjectManager *om = g_ptr_array_index (self->object_managers, i);
+  g_autoptr (WpProperties) props = NULL;
+  g_autoptr (GPtrArray) oms = NULL;
+
+  /* global proxies can only have been added on object managers
+     that accept their global properties */
+  if (WP_IS_GLOBAL_PROXY (object))
+    props = wp_global_proxy_get_global_properties (WP_GLOBAL_PROXY (object));
+
+  oms = wp_registry_find_object_managers (self, G_OBJECT_TYPE (object), props);
+
+  for (guint i = 0; i < oms->len; i++) {
+    WpObjectManager *om = g_ptr_array_index (oms, i);
     wp_object_manager_rm_object (om, object);
     wp_object_manager_maybe_objects_changed (om);
   }
+
+  if (self->port_index && WP_IS_PORT (object))
+    wp_port_index_remove_port (self->port_index, WP_PORT (object));
 }
 
 static void
-object_manager_destroyed (gpointer data, GObject * om)
+object_manager_destroyed (gpointer data, GObject * object)
 {
   WpRegistry *self = data;
+  WpObjectManager *om = (WpObjectManager *) object;
+
+  for (guint i = 0; i < om->interests->len; i++)
+    wp_registry_index_remove_interest (self, om,
+        g_ptr_array_index (om->interests, i));
   g_ptr_array_remove_fast (self->object_managers, om);
 }
 
@@ -958,11 +1453,16 @@ wp_registry_init (WpRegistry *self)
       g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
   self->objects = g_ptr_array_new_with_free_func (g_object_unref);
   self->object_managers = g_ptr_array_new ();
+  self->om_index = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) wp_object_manager_index_free);
+  self->om_index_stamp = 0;
+  self->port_index = NULL;
 }
 
 void
 wp_registry_clear (WpRegistry *self)
 {
+  g_clear_pointer (&self->port_index, wp_port_index_free);
   wp_registry_detach (self);
   g_clear_pointer (&self->globals, g_ptr_array_unref);
   g_clear_pointer (&self->tmp_globals, g_ptr_array_unref);
@@ -993,6 +1493,8 @@ wp_registry_clear (WpRegistry *self)
       g_object_weak_unref (om, object_manager_destroyed, self);
     }
   }
+
+  g_clear_pointer (&self->om_index, g_hash_table_unref);
 }
 
 void
@@ -1091,20 +1593,43 @@ expose_tmp_globals (WpCore *core, GAsyncResult *res, WpRegistry *self)
     g_ptr_array_index (self->globals, g->id) = wp_global_ref (g);
   }
 
-  /* notify object managers */
-  for (guint i = 0; i < self->object_managers->len; i++) {
-    WpObjectManager *om = g_ptr_array_index (self->object_managers, i);
+  /* notify the object managers that may be interested in each global */
+  {
+    g_autoptr (GPtrArray) notified =
+        g_ptr_array_new_with_free_func (g_object_unref);
+    g_autoptr (GHashTable) seen = g_hash_table_new (NULL, NULL);
 
     for (guint i = 0; i < tmp_globals->len; i++) {
       WpGlobal *g = g_ptr_array_index (tmp_globals, i);
+      g_autoptr (GPtrArray) oms = NULL;
 
       /* if global was already removed, drop it */
       if (g->flags == 0 || g->id == SPA_ID_INVALID)
         continue;
 
-      wp_object_manager_add_global (om, g);
+      oms = wp_registry_find_object_managers (self, g->type, g->properties);
+      for (guint j = 0; j < oms->len; j++) {
+        WpObjectManager *om = g_ptr_array_index (oms, j);
+        wp_object_manager_add_global (om, g);
+        if (g_hash_table_add (seen, om))
+          g_ptr_array_add (notified, g_object_ref (om));
+      }
+
+      if (self->port_index && g_type_is_a (g->type, WP_TYPE_PORT))
+        wp_port_index_add_global (self->port_index, g);
     }
-    wp_object_manager_maybe_objects_changed (om);
+
+    /* object managers that are not installed yet wait for all the
+       tmp globals to be exposed before emitting 'installed' */
+    for (guint i = 0; i < self->object_managers->len; i++) {
+      WpObjectManager *om = g_ptr_array_index (self->object_managers, i);
+      if (!om->installed && g_hash_table_add (seen, om))
+        g_ptr_array_add (notified, g_object_ref (om));
+    }
+
+    for (guint i = 0; i < notified->len; i++)
+      wp_object_manager_maybe_objects_changed (
+          g_ptr_array_index (notified, i));
   }
 }
 
@@ -1286,6 +1811,9 @@ wp_core_install_object_manager (WpCore * self, WpObjectManager * om)
 
   g_object_weak_ref (G_OBJECT (om), object_manager_destroyed, reg);
   g_ptr_array_add (reg->object_managers, om);
+  for (i = 0; i < om->interests->len; i++)
+    wp_registry_index_add_interest (reg, om,
+        g_ptr_array_index (om->interests, i));
   g_weak_ref_set (&om->core, self);
 
   /* add pre-existing objects to the object manager,
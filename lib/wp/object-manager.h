@@ -42,6 +42,12 @@ WP_API
 void wp_object_manager_add_interest_full (WpObjectManager * self,
     WpObjectInterest * interest);
 
+WP_API
+void wp_object_manager_set_live (WpObjectManager * self, gboolean live);
+
+WP_API
+gboolean wp_object_manager_is_live (WpObjectManager * self);
+
 /* object features */
 
 WP_API
@@ -719,6 +719,52 @@ wp_pw_object_mixin_handle_pw_proxy_destroyed (WpProxy * proxy)
 /***************************/
 /* PIPEWIRE EVENT HANDLERS */
 
+/* returns the keys that are added, changed or removed in @new_props,
+   compared to @old_props */
+static GPtrArray *
+diff_properties (const struct spa_dict * old_props,
+    const struct spa_dict * new_props)
+{
+  GPtrArray *keys = g_ptr_array_new_with_free_func (g_free);
+  const struct spa_dict_item *item;
+
+  if (new_props) {
+    spa_dict_for_each (item, new_props) {
+      const gchar *old_value =
+          old_props ? spa_dict_lookup (old_props, item->key) : NULL;
+      if (g_strcmp0 (old_value, item->value) != 0)
+        g_ptr_array_add (keys, g_strdup (item->key));
+    }
+  }
+  if (old_props) {
+    spa_dict_for_each (item, old_props) {
+      if (!new_props || !spa_dict_lookup_item (new_props, item->key))
+        g_ptr_array_add (keys, g_strdup (item->key));
+    }
+  }
+  return keys;
+}
+
+static void
+emit_properties_changed (gpointer instance, GPtrArray * keys,
+    WpProperties * props)
+{
+  static guint signal_id = 0;
+
+  if (G_UNLIKELY (signal_id == 0))
+    signal_id = g_signal_lookup ("properties-changed",
+        WP_TYPE_PIPEWIRE_OBJECT);
+
+  for (guint i = 0; i < keys->len; i++) {
+    const gchar *key = g_ptr_array_index (keys, i);
+    /* nobody can be connected to the detail of a key that has no quark */
+    GQuark detail = g_quark_try_string (key);
+
+    g_signal_emit (instance, signal_id, detail, key,
+        wp_properties_get (props, key));
+  }
+}
+
 void
 wp_pw_object_mixin_handle_event_info (gpointer instance, gconstpointer update)
 {
@@ -730,6 +776,7 @@ wp_pw_object_mixin_handle_event_info (gpointer instance, gconstpointer update)
   guint64 process_info_change_mask =
       change_mask & ~(iface->CHANGE_MASK_PROPS | iface->CHANGE_MASK_PARAMS);
   gpointer old_info = NULL;
+  g_autoptr (GPtrArray) changed_keys = NULL;
 
   wp_debug_object (instance, "info, change_mask:0x%"G_GINT64_MODIFIER"x [%s%s]",
       change_mask,
@@ -774,6 +821,14 @@ wp_pw_object_mixin_handle_event_info (gpointer instance, gconstpointer update)
     }
   }
 
+  /* find the keys that change; the old dict is freed by update_info() */
+  if (change_mask & iface->CHANGE_MASK_PROPS) {
+    changed_keys = diff_properties (
+        d->info ? G_STRUCT_MEMBER (const struct spa_dict *, d->info,
+            iface->props_offset) : NULL,
+        G_STRUCT_MEMBER (const struct spa_dict *, update, iface->props_offset));
+  }
+
   /* update our info struct */
   d->info = iface->update_info (d->info, update);
 
@@ -785,7 +840,10 @@ wp_pw_object_mixin_handle_event_info (gpointer instance, gconstpointer update)
     g_clear_pointer (&d->properties, wp_properties_unref);
     d->properties = wp_properties_new_wrap_dict (props);
 
-    g_object_notify (G_OBJECT (instance), "properties");
+    if (changed_keys->len > 0) {
+      emit_properties_changed (instance, changed_keys, d->properties);
+      g_object_notify (G_OBJECT (instance), "properties");
+    }
   }
 
   if (change_mask & iface->CHANGE_MASK_PARAMS)
@@ -0,0 +1,459 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define G_LOG_DOMAIN "wp-port-index"
+
+#include "private/port-index.h"
+#include "private/registry.h"
+#include "log.h"
+
+#include <pipewire/pipewire.h>
+
+/*
+ * The port index keeps track of the ports of the nodes that have
+ * WP_NODE_FEATURE_PORTS enabled, grouped by the id of the node that they
+ * belong to. It is used by WpNode to implement WP_NODE_FEATURE_PORTS, so
+ * that nodes don't need to install an object manager each just to find
+ * their own ports.
+ *
+ * The registry offers every new port global and every removed port to the
+ * index, which only binds the ports of the node ids that it tracks, with
+ * all their features, as the object manager that each node used to have
+ * did. The ports of a node are looked up in the existing
+ * globals when the first node with that id registers.
+ *
+ * The index is created on demand, when the first node enables
+ * WP_NODE_FEATURE_PORTS, and it lives until the core's registry is cleared.
+ */
+
+struct node_entry
+{
+  guint32 node_id;
+  /* distinguishes this entry from older entries of the same node id */
+  guint64 serial;
+  /* nodes that have WP_NODE_FEATURE_PORTS enabled, without a ref */
+  GPtrArray *nodes;
+  /* element-type: WpPort*, in the order in which they became ready, which
+     is the order in which the ports object manager used to list them */
+  GPtrArray *ports;
+  /* port activations in progress */
+  guint pending;
+};
+
+struct _WpPortIndex
+{
+  GWeakRef core;
+  guint64 next_serial;
+
+  /* element-type: <guint32 node id, struct node_entry*> */
+  GHashTable *entries;
+  /* ids of nodes whose ports changed since the last 'ports-changed' */
+  GHashTable *changed;
+  GSource *idle_source;
+};
+
+struct activation_data
+{
+  GWeakRef core;
+  guint32 node_id;
+  guint64 serial;
+};
+
+static void node_destroyed (gpointer data, GObject * node);
+
+static struct node_entry *
+node_entry_new (WpPortIndex * self, guint32 node_id)
+{
+  struct node_entry *entry = g_slice_new0 (struct node_entry);
+  entry->node_id = node_id;
+  entry->serial = self->next_serial++;
+  entry->nodes = g_ptr_array_new ();
+  entry->ports = g_ptr_array_new_with_free_func (g_object_unref);
+  return entry;
+}
+
+static void
+node_entry_free (struct node_entry * entry)
+{
+  g_ptr_array_unref (entry->nodes);
+  g_ptr_array_unref (entry->ports);
+  g_slice_free (struct node_entry, entry);
+}
+
+static guint32
+parse_id (const gchar * str)
+{
+  return str ? (guint32) g_ascii_strtoull (str, NULL, 10) : SPA_ID_INVALID;
+}
+
+static guint32
+port_get_node_id (WpPort * port)
+{
+  g_autoptr (WpProperties) props =
+      wp_global_proxy_get_global_properties (WP_GLOBAL_PROXY (port));
+  return parse_id (props ? wp_properties_get (props, PW_KEY_NODE_ID) : NULL);
+}
+
+static guint32
+port_get_port_id (WpPort * port)
+{
+  return parse_id (wp_pipewire_object_get_property (WP_PIPEWIRE_OBJECT (port),
+          PW_KEY_PORT_ID));
+}
+
+static gboolean
+emit_ports_changed (WpPortIndex * self)
+{
+  g_autoptr (GPtrArray) nodes = g_ptr_array_new_with_free_func (g_object_unref);
+  GHashTableIter iter;
+  gpointer key;
+
+  g_clear_pointer (&self->idle_source, g_source_unref);
+
+  /* collect first, as handlers may enable or disable ports on other nodes */
+  g_hash_table_iter_init (&iter, self->changed);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    struct node_entry *entry = g_hash_table_lookup (self->entries, key);
+    for (guint i = 0; entry && i < entry->nodes->len; i++)
+      g_ptr_array_add (nodes, g_object_ref (g_ptr_array_index (entry->nodes, i)));
+  }
+  g_hash_table_remove_all (self->changed);
+
+  for (guint i = 0; i < nodes->len; i++)
+    g_signal_emit_by_name (g_ptr_array_index (nodes, i), "ports-changed");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_ports_changed (WpPortIndex * self, guint32 node_id)
+{
+  g_hash_table_add (self->changed, GUINT_TO_POINTER (node_id));
+
+  if (!self->idle_source) {
+    g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
+    if (core)
+      wp_core_idle_add (core, &self->idle_source,
+          (GSourceFunc) emit_ports_changed, self, NULL);
+  }
+}
+
+static void
+activation_data_free (struct activation_data * data)
+{
+  g_weak_ref_clear (&data->core);
+  g_slice_free (struct activation_data, data);
+}
+
+static void
+on_port_ready (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+  struct activation_data *data = user_data;
+  g_autoptr (WpCore) core = g_weak_ref_get (&data->core);
+  g_autoptr (GError) error = NULL;
+  WpPort *port = WP_PORT (object);
+  WpPortIndex *self = core ? wp_port_index_peek (core) : NULL;
+  struct node_entry *entry = self ? g_hash_table_lookup (self->entries,
+      GUINT_TO_POINTER (data->node_id)) : NULL;
+  gboolean activated = wp_object_activate_finish (WP_OBJECT (port), res, &error);
+
+  /* the node stopped tracking its ports in the meantime */
+  if (!entry || entry->serial != data->serial)
+    goto out;
+
+  entry->pending--;
+
+  if (!activated) {
+    wp_debug_object (port, "port activation failed: %s", error->message);
+    goto out;
+  }
+
+  /* the port was removed while being activated, or it was offered twice */
+  if (!(wp_object_get_active_features (WP_OBJECT (port)) &
+          WP_PROXY_FEATURE_BOUND) ||
+      g_ptr_array_find (entry->ports, port, NULL))
+    goto out;
+
+  g_ptr_array_add (entry->ports, g_object_ref (port));
+  wp_trace_object (port, "indexed on node %u, port.id %u", data->node_id,
+      port_get_port_id (port));
+
+  schedule_ports_changed (self, data->node_id);
+
+out:
+  activation_data_free (data);
+}
+
+static void
+node_entry_bind_global (WpPortIndex * self, struct node_entry * entry,
+    WpGlobal * global)
+{
+  g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
+  struct activation_data *data;
+
+  if (!core)
+    return;
+
+  if (!global->proxy)
+    global->proxy = g_object_new (global->type,
+        "core", core,
+        "global", global,
+        NULL);
+
+  data = g_slice_new0 (struct activation_data);
+  g_weak_ref_init (&data->core, core);
+  data->node_id = entry->node_id;
+  data->serial = entry->serial;
+
+  /* the same features that the ports object manager used to request */
+  entry->pending++;
+  wp_object_activate (WP_OBJECT (global->proxy),
+      WP_OBJECT_FEATURES_ALL, NULL, on_port_ready, data);
+}
+
+static WpPortIndex *
+wp_port_index_new (WpCore * core)
+{
+  WpPortIndex *self = g_slice_new0 (WpPortIndex);
+
+  g_weak_ref_init (&self->core, core);
+  self->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) node_entry_free);
+  self->changed = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  return self;
+}
+
+/*
+ * Returns (transfer none): the port index of the core, creating it if needed
+ */
+WpPortIndex *
+wp_port_index_get (WpCore * core)
+{
+  WpRegistry *reg = wp_core_get_registry (core);
+
+  if (!reg->port_index)
+    reg->port_index = wp_port_index_new (core);
+  return reg->port_index;
+}
+
+/*
+ * Returns (transfer none) (nullable): the port index of the core,
+ * if it has been created
+ */
+WpPortIndex *
+wp_port_index_peek (WpCore * core)
+{
+  return wp_core_get_registry (core)->port_index;
+}
+
+void
+wp_port_index_free (WpPortIndex * self)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, self->entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    struct node_entry *entry = value;
+    for (guint i = 0; i < entry->nodes->len; i++)
+      g_object_weak_unref (g_ptr_array_index (entry->nodes, i),
+          node_destroyed, self);
+  }
+
+  if (self->idle_source) {
+    g_source_destroy (self->idle_source);
+    g_clear_pointer (&self->idle_source, g_source_unref);
+  }
+  g_clear_pointer (&self->changed, g_hash_table_unref);
+  g_clear_pointer (&self->entries, g_hash_table_unref);
+  g_weak_ref_clear (&self->core);
+  g_slice_free (WpPortIndex, self);
+}
+
+/*
+ * Called by the registry when a new port global is exposed
+ */
+void
+wp_port_index_add_global (WpPortIndex * self, WpGlobal * global)
+{
+  guint32 node_id = parse_id (global->properties ?
+      wp_properties_get (global->properties, PW_KEY_NODE_ID) : NULL);
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+
+  if (entry)
+    node_entry_bind_global (self, entry, global);
+}
+
+/*
+ * Called by the registry when a port proxy is removed
+ */
+void
+wp_port_index_remove_port (WpPortIndex * self, WpPort * port)
+{
+  guint32 node_id = port_get_node_id (port);
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+
+  if (!entry)
+    return;
+
+  if (g_ptr_array_remove (entry->ports, port))
+    schedule_ports_changed (self, node_id);
+}
+
+static void
+wp_port_index_remove_node_entry (WpPortIndex * self, guint32 node_id)
+{
+  g_hash_table_remove (self->entries, GUINT_TO_POINTER (node_id));
+  g_hash_table_remove (self->changed, GUINT_TO_POINTER (node_id));
+}
+
+static void
+node_destroyed (gpointer data, GObject * node)
+{
+  WpPortIndex *self = data;
+  GHashTableIter iter;
+  gpointer value;
+
+  /* nodes normally unregister themselves when they lose
+     WP_NODE_FEATURE_PORTS, so this is not a hot path */
+  g_hash_table_iter_init (&iter, self->entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    struct node_entry *entry = value;
+    if (g_ptr_array_remove_fast (entry->nodes, node) &&
+        entry->nodes->len == 0) {
+      g_hash_table_remove (self->changed, GUINT_TO_POINTER (entry->node_id));
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+}
+
+/*
+ * Starts tracking the ports of \a node_id and emitting 'ports-changed'
+ * on \a node when they change; \a node is not referenced
+ */
+void
+wp_port_index_add_node (WpPortIndex * self, WpNode * node, guint32 node_id)
+{
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+
+  if (!entry) {
+    g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
+    WpRegistry *reg = core ? wp_core_get_registry (core) : NULL;
+
+    entry = node_entry_new (self, node_id);
+    g_hash_table_insert (self->entries, GUINT_TO_POINTER (node_id), entry);
+
+    /* bind the ports of this node that are already known */
+    for (guint i = 0; reg && i < reg->globals->len; i++) {
+      WpGlobal *g = g_ptr_array_index (reg->globals, i);
+      if (g && g_type_is_a (g->type, WP_TYPE_PORT) && g->properties &&
+          parse_id (wp_properties_get (g->properties, PW_KEY_NODE_ID))
+              == node_id)
+        node_entry_bind_global (self, entry, g);
+    }
+  }
+
+  g_object_weak_ref (G_OBJECT (node), node_destroyed, self);
+  g_ptr_array_add (entry->nodes, node);
+}
+
+void
+wp_port_index_remove_node (WpPortIndex * self, WpNode * node, guint32 node_id)
+{
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+
+  if (entry && g_ptr_array_remove_fast (entry->nodes, node)) {
+    g_object_weak_unref (G_OBJECT (node), node_destroyed, self);
+    if (entry->nodes->len == 0)
+      wp_port_index_remove_node_entry (self, node_id);
+  }
+}
+
+gboolean
+wp_port_index_has_node (WpPortIndex * self, WpNode * node, guint32 node_id)
+{
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+  return entry && g_ptr_array_find (entry->nodes, node, NULL);
+}
+
+/*
+ * Returns TRUE if none of the ports of \a node_id are being activated
+ */
+gboolean
+wp_port_index_is_node_ready (WpPortIndex * self, guint32 node_id)
+{
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+  return entry && entry->pending == 0;
+}
+
+/*
+ * Forgets any pending 'ports-changed' emission for \a node_id; used when
+ * the nodes emit it themselves
+ */
+void
+wp_port_index_clear_changed (WpPortIndex * self, guint32 node_id)
+{
+  g_hash_table_remove (self->changed, GUINT_TO_POINTER (node_id));
+}
+
+guint
+wp_port_index_get_n_ports (WpPortIndex * self, guint32 node_id)
+{
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+  return entry ? entry->ports->len : 0;
+}
+
+/*
+ * Returns (transfer full): a new array with the ports of \a node_id that
+ * match \a interest, in the order in which they became ready
+ * \param interest (transfer full) (nullable): the interest
+ */
+GPtrArray *
+wp_port_index_dup_ports (WpPortIndex * self, guint32 node_id,
+    WpObjectInterest * interest)
+{
+  g_autoptr (WpObjectInterest) oi = interest;
+  GPtrArray *result = g_ptr_array_new_with_free_func (g_object_unref);
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+
+  for (guint i = 0; entry && i < entry->ports->len; i++) {
+    WpPort *port = g_ptr_array_index (entry->ports, i);
+    if (!oi || wp_object_interest_matches (oi, port))
+      g_ptr_array_add (result, g_object_ref (port));
+  }
+  return result;
+}
+
+/*
+ * Returns (transfer full) (nullable): the first port of \a node_id
+ * that matches \a interest
+ * \param interest (transfer full): the interest
+ */
+WpPort *
+wp_port_index_lookup_port (WpPortIndex * self, guint32 node_id,
+    WpObjectInterest * interest)
+{
+  g_autoptr (WpObjectInterest) oi = interest;
+  struct node_entry *entry =
+      g_hash_table_lookup (self->entries, GUINT_TO_POINTER (node_id));
+
+  for (guint i = 0; entry && i < entry->ports->len; i++) {
+    WpPort *port = g_ptr_array_index (entry->ports, i);
+    if (wp_object_interest_matches (oi, port))
+      return g_object_ref (port);
+  }
+  return NULL;
+}
@@ -0,0 +1,44 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_PORT_INDEX_H__
+#define __WIREPLUMBER_PORT_INDEX_H__
+
+#include "core.h"
+#include "node.h"
+#include "port.h"
+#include "private/registry.h"
+
+G_BEGIN_DECLS
+
+typedef struct _WpPortIndex WpPortIndex;
+
+WpPortIndex * wp_port_index_get (WpCore * core);
+WpPortIndex * wp_port_index_peek (WpCore * core);
+void wp_port_index_free (WpPortIndex * self);
+
+void wp_port_index_add_global (WpPortIndex * self, WpGlobal * global);
+void wp_port_index_remove_port (WpPortIndex * self, WpPort * port);
+
+void wp_port_index_add_node (WpPortIndex * self, WpNode * node,
+    guint32 node_id);
+void wp_port_index_remove_node (WpPortIndex * self, WpNode * node,
+    guint32 node_id);
+gboolean wp_port_index_has_node (WpPortIndex * self, WpNode * node,
+    guint32 node_id);
+gboolean wp_port_index_is_node_ready (WpPortIndex * self, guint32 node_id);
+void wp_port_index_clear_changed (WpPortIndex * self, guint32 node_id);
+
+guint wp_port_index_get_n_ports (WpPortIndex * self, guint32 node_id);
+GPtrArray * wp_port_index_dup_ports (WpPortIndex * self, guint32 node_id,
+    WpObjectInterest * interest);
+WpPort * wp_port_index_lookup_port (WpPortIndex * self, guint32 node_id,
+    WpObjectInterest * interest);
+
+G_END_DECLS
+
+#endif
@@ -11,6 +11,7 @@
 
 #include "core.h"
 #include "global-proxy.h"
+#include "object-interest.h"
 
 #include <pipewire/pipewire.h>
 
@@ -30,6 +31,15 @@ struct _WpRegistry
   GPtrArray *tmp_globals; // elementy-type: WpGlobal*
   GPtrArray *objects; // element-type: GObject*
   GPtrArray *object_managers; // element-type: WpObjectManager*
+
+  /* object managers indexed by the GType of their interests and by the
+     value of the "node.id" global property, if they require one;
+     element-type: <GType, WpObjectManagerIndex*> */
+  GHashTable *om_index;
+  guint om_index_stamp;
+
+  /* created on demand, see private/port-index.c */
+  struct _WpPortIndex *port_index;
 };
 
 void wp_registry_init (WpRegistry *self);
@@ -53,6 +63,14 @@ WpCore * wp_registry_get_core (WpRegistry * self) G_GNUC_CONST;
 
 WpRegistry * wp_core_get_registry (WpCore * self) G_GNUC_CONST;
 
+/* object interest */
+
+GType wp_object_interest_get_object_type (WpObjectInterest * self);
+gchar * wp_object_interest_dup_global_property_value (WpObjectInterest * self,
+    const gchar * subject);
+GPtrArray * wp_object_interest_get_subjects (WpObjectInterest * self,
+    WpConstraintType type);
+
 /* global */
 
 typedef enum {
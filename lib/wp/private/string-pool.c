@@ -0,0 +1,62 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define G_LOG_DOMAIN "wp-string-pool"
+
+#include "private/string-pool.h"
+
+#include <string.h>
+
+/*
+ * The string pool keeps a single, reference-counted copy of the strings that
+ * WirePlumber stores over and over again: property keys (node.name,
+ * media.class, object.id, ...) and short, frequent values ("Audio/Sink",
+ * "FL", "true", ...). Two strings that were interned from equal contents
+ * are the same pointer, so they can also be compared by pointer first.
+ *
+ * Strings are GRefStrings; the interned ones live in the GLib intern table,
+ * which is thread-safe and drops a string when its last reference is
+ * released. Long values are unlikely to repeat, so wp_string_pool_intern_value()
+ * gives them a private GRefString instead, which avoids growing the table
+ * with strings that are never shared. Both kinds are released with
+ * wp_string_pool_release().
+ */
+
+/* returns (transfer full): an interned copy of @str */
+const gchar *
+wp_string_pool_intern (const gchar * str)
+{
+  return str ? g_ref_string_new_intern (str) : NULL;
+}
+
+/* returns (transfer full): an interned copy of @str, if it is short enough,
+   or a private reference-counted copy otherwise */
+const gchar *
+wp_string_pool_intern_value (const gchar * str)
+{
+  if (!str)
+    return NULL;
+
+  return (strnlen (str, WP_STRING_POOL_MAX_VALUE_LEN + 1) <=
+          WP_STRING_POOL_MAX_VALUE_LEN) ?
+      g_ref_string_new_intern (str) : g_ref_string_new (str);
+}
+
+/* @str must come from this pool; returns (transfer full): @str */
+const gchar *
+wp_string_pool_acquire (const gchar * str)
+{
+  return str ? g_ref_string_acquire ((gchar *) str) : NULL;
+}
+
+/* @str must come from this pool */
+void
+wp_string_pool_release (const gchar * str)
+{
+  if (str)
+    g_ref_string_release ((gchar *) str);
+}
@@ -0,0 +1,25 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_STRING_POOL_H__
+#define __WIREPLUMBER_STRING_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* values longer than this are not worth interning */
+#define WP_STRING_POOL_MAX_VALUE_LEN 32
+
+const gchar * wp_string_pool_intern (const gchar * str);
+const gchar * wp_string_pool_intern_value (const gchar * str);
+const gchar * wp_string_pool_acquire (const gchar * str);
+void wp_string_pool_release (const gchar * str);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,26 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_TIMER_WHEEL_H__
+#define __WIREPLUMBER_TIMER_WHEEL_H__
+
+#include "core.h"
+
+G_BEGIN_DECLS
+
+typedef struct _WpTimerWheel WpTimerWheel;
+
+WpTimerWheel * wp_timer_wheel_new (GMainContext * context);
+void wp_timer_wheel_free (WpTimerWheel * self);
+
+/* core */
+
+WpTimerWheel * wp_core_get_timer_wheel (WpCore * self);
+
+G_END_DECLS
+
+#endif
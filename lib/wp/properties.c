@@ -9,8 +9,10 @@
 #define G_LOG_DOMAIN "wp-properties"
 
 #include "properties.h"
+#include "private/string-pool.h"
 
 #include <errno.h>
+#include <string.h>
 #include <pipewire/properties.h>
 
 /*! \defgroup wpproperties WpProperties */
@@ -40,6 +42,24 @@
  * the ownership of the `struct pw_properties` remains outside. This must
  * be used with care, as the `struct pw_properties` may be free'ed externally.
  *
+ * Properties sets that are created empty or as a copy of another set
+ * (wp_properties_new_empty(), wp_properties_new(), wp_properties_new_copy(),
+ * wp_properties_new_copy_dict() and wp_properties_copy()) do not allocate
+ * a `struct pw_properties`. Instead, they store their keys and short values
+ * in a string pool that is shared with the rest of WirePlumber, so that
+ * the keys and values that thousands of objects have in common are stored
+ * only once. This is transparent to the API, with the exception that
+ * wp_properties_unref_and_take_pw_properties() has to make a copy for them.
+ *
+ * Looking up a key in a `spa_dict` is a linear scan, unless the dict is
+ * sorted. Since PipeWire objects such as ALSA or Bluetooth nodes may carry
+ * close to a hundred properties, the sets that are backed by the string pool
+ * keep a hash index of their keys once they have at least 16 items. The index
+ * is built by the functions that create or modify such a set, so that
+ * wp_properties_get() never modifies \a self. Sets that wrap a `spa_dict` or
+ * are backed by a `struct pw_properties` may be modified externally and
+ * always do the linear scan.
+ *
  * WpProperties is reference-counted with wp_properties_ref() and
  * wp_properties_unref().
  */
@@ -47,6 +67,17 @@
 enum {
   FLAG_IS_DICT = (1<<1),
   FLAG_NO_OWNERSHIP = (1<<2),
+  FLAG_INTERNED = (1<<3),
+};
+
+/* the minimum number of items for keeping an index of the keys */
+#define INDEX_MIN_ITEMS 16
+
+/* a dict whose keys and values are strings from the string pool */
+struct interned_dict
+{
+  struct spa_dict dict;
+  guint32 n_allocated;
 };
 
 struct _WpProperties
@@ -56,9 +87,192 @@ struct _WpProperties
   union {
     struct pw_properties *props;
     const struct spa_dict *dict;
+    struct interned_dict *interned;
   };
+  /* key -> position + 1 in the dict; only for FLAG_INTERNED, maintained by
+     all the functions that modify the dict, see index_rebuild() */
+  GHashTable *index;
 };
 
+static struct interned_dict *
+interned_dict_new (guint32 n_allocated)
+{
+  struct interned_dict *d = g_slice_new0 (struct interned_dict);
+  d->n_allocated = MAX (n_allocated, 8);
+  d->dict.items = g_new (struct spa_dict_item, d->n_allocated);
+  return d;
+}
+
+static void
+interned_dict_free (struct interned_dict * d)
+{
+  for (guint32 i = 0; i < d->dict.n_items; i++) {
+    wp_string_pool_release (d->dict.items[i].key);
+    wp_string_pool_release (d->dict.items[i].value);
+  }
+  g_free ((struct spa_dict_item *) d->dict.items);
+  g_slice_free (struct interned_dict, d);
+}
+
+static struct spa_dict_item *
+interned_dict_find (struct interned_dict * d, const gchar * key)
+{
+  struct spa_dict_item *items = (struct spa_dict_item *) d->dict.items;
+
+  /* keys that come from the pool match by pointer, without strcmp() */
+  for (guint32 i = 0; i < d->dict.n_items; i++) {
+    if (items[i].key == key || strcmp (items[i].key, key) == 0)
+      return &items[i];
+  }
+  return NULL;
+}
+
+/* appends an item, taking ownership of the pool strings @key and @value */
+static void
+interned_dict_append (struct interned_dict * d, const gchar * key,
+    const gchar * value)
+{
+  struct spa_dict_item *item;
+
+  if (d->dict.n_items == d->n_allocated) {
+    d->n_allocated *= 2;
+    d->dict.items = g_renew (struct spa_dict_item,
+        (struct spa_dict_item *) d->dict.items, d->n_allocated);
+  }
+  item = (struct spa_dict_item *) &d->dict.items[d->dict.n_items++];
+  item->key = key;
+  item->value = value;
+  d->dict.flags &= ~SPA_DICT_FLAG_SORTED;
+}
+
+/* same semantics as pw_properties_set() */
+static gint
+interned_dict_set (struct interned_dict * d, const gchar * key,
+    const gchar * value)
+{
+  struct spa_dict_item *item = interned_dict_find (d, key);
+
+  if (!item) {
+    if (!value)
+      return 0;
+    interned_dict_append (d, wp_string_pool_intern (key),
+        wp_string_pool_intern_value (value));
+    return 1;
+  }
+
+  if (!value) {
+    struct spa_dict_item *items = (struct spa_dict_item *) d->dict.items;
+    guint32 idx = item - items;
+
+    wp_string_pool_release (item->key);
+    wp_string_pool_release (item->value);
+    /* keep the order of the remaining items */
+    memmove (&items[idx], &items[idx + 1],
+        (d->dict.n_items - idx - 1) * sizeof (struct spa_dict_item));
+    d->dict.n_items--;
+    return 1;
+  }
+
+  if (item->value == value || g_strcmp0 (item->value, value) == 0)
+    return 0;
+
+  wp_string_pool_release (item->value);
+  item->value = wp_string_pool_intern_value (value);
+  return 1;
+}
+
+static WpProperties *
+wp_properties_new_interned (guint32 n_allocated)
+{
+  WpProperties * self = g_slice_new0 (WpProperties);
+  g_ref_count_init (&self->ref);
+  self->flags = FLAG_INTERNED;
+  self->interned = interned_dict_new (n_allocated);
+  return self;
+}
+
+/* builds the index of an interned set from scratch, or drops it if the set
+   is too small for it; to be called whenever items are moved around */
+static void
+index_rebuild (WpProperties * self)
+{
+  const struct spa_dict *dict = &self->interned->dict;
+
+  g_clear_pointer (&self->index, g_hash_table_unref);
+  if (dict->n_items < INDEX_MIN_ITEMS)
+    return;
+
+  self->index = g_hash_table_new (g_str_hash, g_str_equal);
+  for (guint32 i = 0; i < dict->n_items; i++) {
+    /* with duplicate keys, the first one wins, as in spa_dict_lookup() */
+    if (!g_hash_table_contains (self->index, dict->items[i].key))
+      g_hash_table_insert (self->index, (gpointer) dict->items[i].key,
+          GUINT_TO_POINTER (i + 1));
+  }
+}
+
+static const struct spa_dict_item *
+index_lookup (WpProperties * self, const gchar * key)
+{
+  guint pos = GPOINTER_TO_UINT (g_hash_table_lookup (self->index, key));
+  return pos ? &self->interned->dict.items[pos - 1] : NULL;
+}
+
+static gint
+properties_set (WpProperties * self, const gchar * key, const gchar * value)
+{
+  const struct spa_dict *dict;
+  guint32 n_items;
+  gint res;
+
+  if (!(self->flags & FLAG_INTERNED))
+    return pw_properties_set (self->props, key, value);
+
+  dict = &self->interned->dict;
+  n_items = dict->n_items;
+  res = interned_dict_set (self->interned, key, value);
+
+  /* the index stores positions, which change only when an item is removed;
+     an appended item can be added to it */
+  if (dict->n_items < n_items ||
+      (!self->index && dict->n_items == INDEX_MIN_ITEMS))
+    index_rebuild (self);
+  else if (self->index && dict->n_items > n_items)
+    g_hash_table_insert (self->index, (gpointer) dict->items[n_items].key,
+        GUINT_TO_POINTER (dict->n_items));
+  return res;
+}
+
+static gint
+properties_update (WpProperties * self, const struct spa_dict * dict)
+{
+  const struct spa_dict_item *item;
+  gint changed = 0;
+
+  if (!(self->flags & FLAG_INTERNED))
+    return pw_properties_update (self->props, dict);
+
+  spa_dict_for_each (item, dict)
+    changed += properties_set (self, item->key, item->value);
+  return changed;
+}
+
+static gint
+properties_add (WpProperties * self, const struct spa_dict * dict)
+{
+  const struct spa_dict_item *item;
+  gint changed = 0;
+
+  if (!(self->flags & FLAG_INTERNED))
+    return pw_properties_add (self->props, dict);
+
+  spa_dict_for_each (item, dict) {
+    if (!wp_properties_get (self, item->key))
+      changed += properties_set (self, item->key, item->value);
+  }
+  return changed;
+}
+
 G_DEFINE_BOXED_TYPE(WpProperties, wp_properties, wp_properties_ref, wp_properties_unref)
 
 /*!
@@ -69,11 +283,7 @@ G_DEFINE_BOXED_TYPE(WpProperties, wp_properties, wp_properties_ref, wp_propertie
 WpProperties *
 wp_properties_new_empty (void)
 {
-  WpProperties * self = g_slice_new0 (WpProperties);
-  g_ref_count_init (&self->ref);
-  self->flags = 0;
-  self->props = pw_properties_new (NULL, NULL);
-  return self;
+  return wp_properties_new_interned (0);
 }
 
 /*!
@@ -214,15 +424,9 @@ wp_properties_new_take (struct pw_properties * props)
 WpProperties *
 wp_properties_new_copy (const struct pw_properties * props)
 {
-  WpProperties * self;
-
   g_return_val_if_fail (props != NULL, NULL);
 
-  self = g_slice_new0 (WpProperties);
-  g_ref_count_init (&self->ref);
-  self->flags = 0;
-  self->props = pw_properties_copy (props);
-  return self;
+  return wp_properties_new_copy_dict (&props->dict);
 }
 
 /*!
@@ -267,13 +471,18 @@ WpProperties *
 wp_properties_new_copy_dict (const struct spa_dict * dict)
 {
   WpProperties * self;
+  const struct spa_dict_item *item;
 
   g_return_val_if_fail (dict != NULL, NULL);
 
-  self = g_slice_new0 (WpProperties);
-  g_ref_count_init (&self->ref);
-  self->flags = 0;
-  self->props = pw_properties_new_dict (dict);
+  self = wp_properties_new_interned (dict->n_items);
+  spa_dict_for_each (item, dict) {
+    if (item->key)
+      interned_dict_append (self->interned, wp_string_pool_intern (item->key),
+          wp_string_pool_intern_value (item->value));
+  }
+  self->interned->dict.flags = dict->flags;
+  index_rebuild (self);
   return self;
 }
 
@@ -289,14 +498,33 @@ wp_properties_new_copy_dict (const struct spa_dict * dict)
 WpProperties *
 wp_properties_copy (WpProperties * other)
 {
-  return wp_properties_new_copy_dict (wp_properties_peek_dict (other));
+  WpProperties * self;
+  const struct spa_dict_item *item;
+
+  g_return_val_if_fail (other != NULL, NULL);
+
+  if (!(other->flags & FLAG_INTERNED))
+    return wp_properties_new_copy_dict (wp_properties_peek_dict (other));
+
+  /* the strings are already in the pool; share them */
+  self = wp_properties_new_interned (other->interned->dict.n_items);
+  spa_dict_for_each (item, &other->interned->dict) {
+    interned_dict_append (self->interned, wp_string_pool_acquire (item->key),
+        wp_string_pool_acquire (item->value));
+  }
+  self->interned->dict.flags = other->interned->dict.flags;
+  index_rebuild (self);
+  return self;
 }
 
 static void
 wp_properties_free (WpProperties * self)
 {
-  if (!(self->flags & FLAG_NO_OWNERSHIP))
+  if (self->flags & FLAG_INTERNED)
+    interned_dict_free (self->interned);
+  else if (!(self->flags & FLAG_NO_OWNERSHIP))
     pw_properties_free (self->props);
+  g_clear_pointer (&self->index, g_hash_table_unref);
   g_slice_free (WpProperties, self);
 }
 
@@ -372,7 +600,7 @@ wp_properties_update (WpProperties * self, WpProperties * props)
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_update (self->props, wp_properties_peek_dict (props));
+  return properties_update (self, wp_properties_peek_dict (props));
 }
 
 /*!
@@ -394,7 +622,7 @@ wp_properties_update_from_dict (WpProperties * self,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_update (self->props, dict);
+  return properties_update (self, dict);
 }
 
 /*!
@@ -416,7 +644,7 @@ wp_properties_add (WpProperties * self, WpProperties * props)
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_add (self->props, wp_properties_peek_dict (props));
+  return properties_add (self, wp_properties_peek_dict (props));
 }
 
 /*!
@@ -439,7 +667,7 @@ wp_properties_add_from_dict (WpProperties * self,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_add (self->props, dict);
+  return properties_add (self, dict);
 }
 
 /*!
@@ -526,12 +754,18 @@ gint
 wp_properties_update_keys_array (WpProperties * self, WpProperties * props,
     const gchar * keys[])
 {
+  gint changed = 0;
+  const gchar *value;
+
   g_return_val_if_fail (self != NULL, -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_update_keys (self->props,
-      wp_properties_peek_dict (props), keys);
+  for (; *keys; keys++) {
+    if ((value = wp_properties_get (props, *keys)) != NULL)
+      changed += properties_set (self, *keys, value);
+  }
+  return changed;
 }
 
 /*!
@@ -620,12 +854,20 @@ gint
 wp_properties_add_keys_array (WpProperties * self, WpProperties * props,
     const gchar * keys[])
 {
+  gint changed = 0;
+  const gchar *value;
+
   g_return_val_if_fail (self != NULL, -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_add_keys (self->props,
-      wp_properties_peek_dict (props), keys);
+  for (; *keys; keys++) {
+    if ((value = wp_properties_get (props, *keys)) == NULL)
+      continue;
+    if (wp_properties_get (self, *keys) == NULL)
+      changed += properties_set (self, *keys, value);
+  }
+  return changed;
 }
 
 /*!
@@ -640,10 +882,19 @@ wp_properties_add_keys_array (WpProperties * self, WpProperties * props,
 const gchar *
 wp_properties_get (WpProperties * self, const gchar * key)
 {
+  const struct spa_dict_item *item;
+
   g_return_val_if_fail (self != NULL, NULL);
   g_return_val_if_fail (key != NULL, NULL);
 
-  return spa_dict_lookup (wp_properties_peek_dict (self), key);
+  if (self->index)
+    item = index_lookup (self, key);
+  else if (self->flags & FLAG_INTERNED)
+    item = interned_dict_find (self->interned, key);
+  else
+    item = spa_dict_lookup_item (wp_properties_peek_dict (self), key);
+
+  return item ? item->value : NULL;
 }
 
 /*!
@@ -669,7 +920,7 @@ wp_properties_set (WpProperties * self, const gchar * key,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_set (self->props, key, value);
+  return properties_set (self, key, value);
 }
 
 /*!
@@ -719,6 +970,10 @@ wp_properties_setf_valist (WpProperties * self, const gchar * key,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  if (self->flags & FLAG_INTERNED) {
+    g_autofree gchar *value = g_strdup_vprintf (format, args);
+    return properties_set (self, key, value);
+  }
   return pw_properties_setva (self->props, key, format, args);
 }
 
@@ -940,7 +1195,12 @@ wp_properties_sort (WpProperties * self)
   g_return_if_fail (!(self->flags & FLAG_IS_DICT));
   g_return_if_fail (!(self->flags & FLAG_NO_OWNERSHIP));
 
-  return spa_dict_qsort (&self->props->dict);
+  if (self->flags & FLAG_INTERNED) {
+    spa_dict_qsort (&self->interned->dict);
+    index_rebuild (self);
+  } else {
+    spa_dict_qsort (&self->props->dict);
+  }
 }
 
 /*!
@@ -955,6 +1215,8 @@ wp_properties_peek_dict (WpProperties * self)
 {
   g_return_val_if_fail (self != NULL, NULL);
 
+  if (self->flags & FLAG_INTERNED)
+    return &self->interned->dict;
   return (self->flags & FLAG_IS_DICT) ? self->dict : &self->props->dict;
 }
 
@@ -980,7 +1242,8 @@ wp_properties_to_pw_properties (WpProperties * self)
  * stored internally and then freeing the WpProperties wrapper.
  *
  * If \a self is not uniquely owned (see wp_properties_ensure_unique_owner()),
- * then this method does make a copy and is the same as
+ * or if it stores its strings in the shared string pool (see the description
+ * of WpProperties), then this method does make a copy and is the same as
  * wp_properties_to_pw_properties(), performance-wise.
  *
  * \ingroup wpproperties
@@ -990,12 +1253,24 @@ wp_properties_to_pw_properties (WpProperties * self)
 struct pw_properties *
 wp_properties_unref_and_take_pw_properties (WpProperties * self)
 {
+  struct pw_properties *props;
+
   g_return_val_if_fail (self != NULL, NULL);
 
-  g_autoptr (WpProperties) unique = wp_properties_ensure_unique_owner (self);
-  /* set the flag so that unref-ing \a unique will not destroy unique->props */
-  unique->flags = FLAG_NO_OWNERSHIP;
-  return unique->props;
+  /* the pw_properties can only be stolen if \a self owns it and nobody
+     else references \a self; copies are interned, so they never do */
+  if (self->flags & (FLAG_INTERNED | FLAG_IS_DICT | FLAG_NO_OWNERSHIP) ||
+      !g_ref_count_compare (&self->ref, 1)) {
+    props = wp_properties_to_pw_properties (self);
+    wp_properties_unref (self);
+    return props;
+  }
+
+  /* set the flag so that unref-ing \a self will not destroy self->props */
+  props = self->props;
+  self->flags = FLAG_NO_OWNERSHIP;
+  wp_properties_unref (self);
+  return props;
 }
 
 /*!
@@ -54,6 +54,30 @@
  *
  * Flags: G_SIGNAL_RUN_FIRST
  * \endparblock
+ *
+ * \par properties-changed
+ * \parblock
+ * \code
+ * properties_changed_callback (WpPipewireObject * self,
+ *                              const gchar *key,
+ *                              const gchar *value,
+ *                              gpointer user_data)
+ * \endcode
+ *
+ * Emitted when the info of a proxy updates the properties of the remote
+ * object, once for every key that was added, changed or removed, before
+ * the "properties" property is notified. The detail of the emission is the
+ * key, so that it is possible to connect to changes of specific keys only,
+ * as in "properties-changed::media.name". Keys whose value did not change
+ * are not emitted and if no key changed, "properties" is not notified
+ * either.
+ *
+ * Parameters:
+ * - `key` - the key that changed
+ * - `value` - the new value of the key, or NULL if it was removed
+ *
+ * Flags: G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED
+ * \endparblock
  */
 
 G_DEFINE_INTERFACE (WpPipewireObject, wp_pipewire_object, WP_TYPE_PROXY)
@@ -78,6 +102,10 @@ wp_pipewire_object_default_init (WpPipewireObjectInterface * iface)
 
   g_signal_new ("params-changed", G_TYPE_FROM_INTERFACE (iface),
       G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING);
+
+  g_signal_new ("properties-changed", G_TYPE_FROM_INTERFACE (iface),
+      G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, 0, NULL, NULL, NULL,
+      G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_STRING);
 }
 
 /*!
@@ -244,6 +244,49 @@ wp_si_linkable_get_ports (WpSiLinkable * self, const gchar * context)
   return WP_SI_LINKABLE_GET_IFACE (self)->get_ports (self, context);
 }
 
+/*!
+ * \brief Gets the same information as wp_si_linkable_get_ports(), as an
+ * array of WpSiPortInfo structures
+ *
+ * Items may implement this natively and cache the array until their ports
+ * change, in which case this is cheaper than building and parsing the
+ * GVariant form. For items that only implement
+ * WpSiLinkableInterface.get_ports(), the array is built from the variant.
+ *
+ * The returned array must not be modified.
+ *
+ * \ingroup wpsiinterfaces
+ * \param self the session item
+ * \param context (nullable): an optional context for the ports
+ * \returns (transfer full) (element-type WpSiPortInfo) (nullable): the ports
+ *   of this item, in the same order as in wp_si_linkable_get_ports()
+ */
+GArray *
+wp_si_linkable_get_port_set (WpSiLinkable * self, const gchar * context)
+{
+  g_autoptr (GVariant) ports = NULL;
+  GVariantIter iter;
+  WpSiPortInfo info;
+  GArray *arr;
+
+  g_return_val_if_fail (WP_IS_SI_LINKABLE (self), NULL);
+
+  if (WP_SI_LINKABLE_GET_IFACE (self)->get_port_set)
+    return WP_SI_LINKABLE_GET_IFACE (self)->get_port_set (self, context);
+
+  ports = wp_si_linkable_get_ports (self, context);
+  if (!ports || !g_variant_is_of_type (ports, G_VARIANT_TYPE ("a(uuu)")))
+    return NULL;
+
+  arr = g_array_sized_new (FALSE, FALSE, sizeof (WpSiPortInfo),
+      g_variant_n_children (ports));
+  g_variant_iter_init (&iter, ports);
+  while (g_variant_iter_next (&iter, "(uuu)", &info.node_id, &info.port_id,
+              &info.channel))
+    g_array_append_val (arr, info);
+  return arr;
+}
+
 /*!
  * \brief Gets the acquisition interface associated with the item
  *
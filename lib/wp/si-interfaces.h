@@ -16,6 +16,7 @@
 G_BEGIN_DECLS
 
 typedef struct _WpSiAcquisition WpSiAcquisition;
+typedef struct _WpSiPortInfo WpSiPortInfo;
 
 /*!
  * \brief The WpSiEndpoint GType
@@ -93,15 +94,31 @@ struct _WpSiLinkableInterface
 
   GVariant * (*get_ports) (WpSiLinkable * self, const gchar * context);
   WpSiAcquisition * (*get_acquisition) (WpSiLinkable * self);
+  GArray * (*get_port_set) (WpSiLinkable * self, const gchar * context);
 
   /*< private >*/
-  WP_PADDING(6)
+  WP_PADDING(5)
+};
+
+/*!
+ * \brief A port of a WpSiLinkable, as returned by wp_si_linkable_get_port_set()
+ * \ingroup wpsiinterfaces
+ */
+struct _WpSiPortInfo
+{
+  guint32 node_id;
+  guint32 port_id;
+  guint32 channel;
 };
 
 WP_API
 GVariant * wp_si_linkable_get_ports (WpSiLinkable * self,
     const gchar * context);
 
+WP_API
+GArray * wp_si_linkable_get_port_set (WpSiLinkable * self,
+    const gchar * context);
+
 WP_API
 WpSiAcquisition * wp_si_linkable_get_acquisition (WpSiLinkable * self);
 
@@ -115,6 +115,12 @@ compress_string (const gchar *str)
  *
  * The WpState class saves and loads properties from a file
  *
+ * In addition to the flat string properties, a state can also store typed
+ * records, see wp_state_save_records(). Records are kept in a separate file,
+ * next to the properties file, in the binary GVariant serialization format,
+ * so that numbers and arrays do not need to be formatted and parsed as
+ * strings.
+ *
  * \gproperties
  * \gproperty{name, gchar *, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY,
  *   The file name where the state will be stored.}
@@ -133,6 +139,7 @@ struct _WpState
   gchar *name;
 
   gchar *location;
+  gchar *records_location;
   GKeyFile *keyfile;
 };
 
@@ -173,6 +180,8 @@ wp_state_ensure_location (WpState *self)
   if (!self->location)
     self->location = get_new_location (self->name);
   g_return_if_fail (self->location);
+  if (!self->records_location)
+    self->records_location = g_strconcat (self->location, ".records", NULL);
 }
 
 static void
@@ -215,6 +224,7 @@ wp_state_finalize (GObject * object)
 
   g_clear_pointer (&self->name, g_free);
   g_clear_pointer (&self->location, g_free);
+  g_clear_pointer (&self->records_location, g_free);
 
   G_OBJECT_CLASS (wp_state_parent_class)->finalize (object);
 }
@@ -284,7 +294,7 @@ wp_state_get_location (WpState *self)
 }
 
 /*!
- * \brief Clears the state removing its file
+ * \brief Clears the state removing its files
  * \ingroup wpstate
  * \param self the state
  */
@@ -295,6 +305,9 @@ wp_state_clear (WpState *self)
   wp_state_ensure_location (self);
   if (remove (self->location) < 0)
     wp_warning ("failed to remove %s: %s", self->location, g_strerror (errno));
+  if (remove (self->records_location) < 0 && errno != ENOENT)
+    wp_warning ("failed to remove %s: %s", self->records_location,
+        g_strerror (errno));
 }
 
 /*!
@@ -386,3 +399,93 @@ wp_state_load (WpState *self)
 
   return g_steal_pointer (&props);
 }
+
+/*!
+ * \brief Saves typed records in the state, overwriting all previously
+ * saved records.
+ *
+ * \a records is a dictionary (`a{sv}`) that maps subject keys to their
+ * record. A record can be any GVariant, but typically it is a boolean, a
+ * double, an array of doubles (`ad`) or a nested dictionary (`a{sv}`) that
+ * groups several values of the same subject. Records are stored separately
+ * from the properties saved with wp_state_save(), so the two can be used
+ * together on the same state.
+ *
+ * \ingroup wpstate
+ * \param self the state
+ * \param records (transfer floating): the records to save
+ * \param error (out)(optional): return location for a GError, or NULL
+ * \returns TRUE if the records could be saved, FALSE otherwise
+ * \since 0.4.10
+ */
+gboolean
+wp_state_save_records (WpState *self, GVariant *records, GError ** error)
+{
+  g_autoptr (GVariant) data = NULL;
+  GError *err = NULL;
+
+  g_return_val_if_fail (WP_IS_STATE (self), FALSE);
+  g_return_val_if_fail (records, FALSE);
+  g_return_val_if_fail (
+      g_variant_is_of_type (records, G_VARIANT_TYPE_VARDICT), FALSE);
+  wp_state_ensure_location (self);
+
+  wp_info_object (self, "saving records into %s", self->records_location);
+
+  /* the file is always stored in little endian */
+  data = g_variant_ref_sink (records);
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    GVariant *swapped = g_variant_byteswap (data);
+    g_variant_unref (data);
+    data = swapped;
+  }
+
+  if (!g_file_set_contents (self->records_location,
+          g_variant_get_data (data), g_variant_get_size (data), &err)) {
+    g_propagate_prefixed_error (error, err, "could not save records of %s: ",
+        self->name);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*!
+ * \brief Loads the typed records of the state from the file system
+ *
+ * Like wp_state_load(), this function will never fail. If there are no
+ * records stored, or they cannot be loaded for any reason, it returns an
+ * empty dictionary.
+ *
+ * \ingroup wpstate
+ * \param self the state
+ * \returns (transfer full): a dictionary (`a{sv}`) that maps subject keys
+ *   to their record
+ * \since 0.4.10
+ */
+GVariant *
+wp_state_load_records (WpState *self)
+{
+  g_autoptr (GMappedFile) file = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  GVariant *records = NULL;
+
+  g_return_val_if_fail (WP_IS_STATE (self), NULL);
+  wp_state_ensure_location (self);
+
+  file = g_mapped_file_new (self->records_location, FALSE, NULL);
+  if (!file)
+    return g_variant_ref_sink (g_variant_new ("a{sv}", NULL));
+
+  /* the data is not trusted; GVariant validates it lazily on access */
+  bytes = g_mapped_file_get_bytes (file);
+  records = g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE);
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    /* g_variant_byteswap() returns a non-floating reference already */
+    GVariant *swapped = g_variant_byteswap (records);
+    g_variant_unref (g_variant_ref_sink (records));
+    return swapped;
+  }
+
+  return g_variant_ref_sink (records);
+}
@@ -41,6 +41,13 @@ gboolean wp_state_save (WpState *self, WpProperties *props, GError ** error);
 WP_API
 WpProperties * wp_state_load (WpState *self);
 
+WP_API
+gboolean wp_state_save_records (WpState *self, GVariant *records,
+    GError ** error);
+
+WP_API
+GVariant * wp_state_load_records (WpState *self);
+
 G_END_DECLS
 
 #endif
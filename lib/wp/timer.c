@@ -0,0 +1,462 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define G_LOG_DOMAIN "wp-timer"
+
+#include "timer.h"
+#include "log.h"
+#include "watchdog.h"
+#include "private/timer-wheel.h"
+
+/*! \defgroup wptimer WpTimer */
+/*!
+ * \struct WpTimer
+ *
+ * WpTimer is a one-shot timer that can be started, re-started and stopped
+ * any number of times without allocating anything.
+ *
+ * Unlike wp_core_timeout_add(), timers do not create a GSource each. All the
+ * timers of a core are kept in a hierarchical timer wheel, which is driven by
+ * a single GSource that wakes up only when the next timer is due. This makes
+ * it cheap to keep a large number of timers that are frequently re-armed or
+ * cancelled, for example one per node or per stream.
+ *
+ * Timers have a resolution of one millisecond.
+ */
+
+/* 4 levels of 64 slots, with 1ms ticks, cover about 4.6 hours; timers that
+   expire later than that are kept in the last slot of the top level and are
+   moved to their correct place as the wheel turns */
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_RANGE (G_GUINT64_CONSTANT (1) << (WHEEL_BITS * WHEEL_LEVELS))
+
+struct _WpTimer
+{
+  grefcount ref;
+  GWeakRef core;
+  GClosure *closure;
+
+  /* set while the timer is pending */
+  WpTimerWheel *wheel;
+  GQueue *slot;
+  GList link;
+  guint64 expires;
+};
+
+G_DEFINE_BOXED_TYPE (WpTimer, wp_timer, wp_timer_ref, wp_timer_unref)
+
+struct _WpTimerWheel
+{
+  GSource *source;
+  gint64 base_time;
+  guint64 current;
+  guint n_pending;
+  gboolean dispatching;
+
+  /* bitmaps of the non-empty slots of each level */
+  guint64 occupied[WHEEL_LEVELS];
+  GQueue slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+typedef struct _WpTimerWheelSource WpTimerWheelSource;
+struct _WpTimerWheelSource
+{
+  GSource parent;
+  WpTimerWheel *wheel;
+};
+
+static inline guint64
+wheel_now (WpTimerWheel * self, gboolean round_up)
+{
+  gint64 elapsed = g_get_monotonic_time () - self->base_time;
+  return (elapsed + (round_up ? 999 : 0)) / 1000;
+}
+
+static inline guint64
+slots_after (guint64 occupied, guint index)
+{
+  /* mask out the slots up to and including index; 2 << 63 wraps to 0 */
+  return occupied & ~((G_GUINT64_CONSTANT (2) << index) - 1);
+}
+
+/* places the timer in the slot where it has to be when the wheel reaches
+   its expiration time; the timer is placed no earlier than min_expires */
+static void
+wheel_insert (WpTimerWheel * self, WpTimer * t, guint64 min_expires)
+{
+  guint64 expires = MAX (t->expires, min_expires);
+  guint64 delta = expires - self->current;
+  guint level = 0, index;
+
+  if (delta >= WHEEL_RANGE) {
+    expires = self->current + WHEEL_RANGE - 1;
+    delta = WHEEL_RANGE - 1;
+  }
+  while (level < WHEEL_LEVELS - 1 &&
+      delta >= (G_GUINT64_CONSTANT (1) << (WHEEL_BITS * (level + 1))))
+    level++;
+
+  index = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  t->slot = &self->slots[level][index];
+  g_queue_push_tail_link (t->slot, &t->link);
+  self->occupied[level] |= G_GUINT64_CONSTANT (1) << index;
+}
+
+static void
+wheel_remove (WpTimerWheel * self, WpTimer * t)
+{
+  guint pos = t->slot - &self->slots[0][0];
+
+  g_queue_unlink (t->slot, &t->link);
+  if (g_queue_is_empty (t->slot))
+    self->occupied[pos / WHEEL_SLOTS] &=
+        ~(G_GUINT64_CONSTANT (1) << (pos % WHEEL_SLOTS));
+  t->slot = NULL;
+}
+
+/* moves all the timers of the current slot of a level to the lower levels */
+static void
+wheel_cascade (WpTimerWheel * self, guint level)
+{
+  guint index = (self->current >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  GQueue timers = self->slots[level][index];
+  GList *link;
+
+  g_queue_init (&self->slots[level][index]);
+  self->occupied[level] &= ~(G_GUINT64_CONSTANT (1) << index);
+
+  while ((link = g_queue_pop_head_link (&timers)))
+    wheel_insert (self, link->data, self->current);
+}
+
+/* returns the earliest tick at which the wheel has something to do; this is
+   either the expiration of a timer or the time that some slot of the upper
+   levels needs to be cascaded */
+static guint64
+wheel_next_event (WpTimerWheel * self)
+{
+  guint64 next = G_MAXUINT64;
+
+  for (guint level = 0; level < WHEEL_LEVELS; level++) {
+    guint shift = WHEEL_BITS * level;
+    guint64 pos = self->current >> shift;
+    guint index = pos & WHEEL_MASK;
+    guint64 ahead = slots_after (self->occupied[level], index);
+    guint64 tick;
+
+    if (ahead)
+      tick = (pos - index + __builtin_ctzll (ahead)) << shift;
+    else if (self->occupied[level])
+      tick = (pos - index + WHEEL_SLOTS) << shift;
+    else
+      continue;
+
+    next = MIN (next, tick);
+  }
+  return next;
+}
+
+static void
+wheel_fire (WpTimerWheel * self, WpTimer * t)
+{
+  GValue value = G_VALUE_INIT;
+  gboolean watched;
+
+  g_value_init (&value, WP_TYPE_TIMER);
+  g_value_set_boxed (&value, t);
+  watched = wp_watchdog_push ("timer", WP_TYPE_TIMER, t, NULL);
+  g_closure_invoke (t->closure, NULL, 1, &value, NULL);
+  if (watched)
+    wp_watchdog_pop ();
+  g_value_unset (&value);
+}
+
+static void
+wheel_tick (WpTimerWheel * self)
+{
+  GQueue *slot;
+  GList *link;
+  guint index;
+
+  self->current++;
+  index = self->current & WHEEL_MASK;
+
+  /* at the start of a rotation, bring down the timers of the next level */
+  for (guint level = 1; level < WHEEL_LEVELS &&
+      ((self->current >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) == 0;
+      level++)
+    wheel_cascade (self, level);
+
+  /* timers that are started from the callbacks always go to later slots */
+  slot = &self->slots[0][index];
+  while ((link = g_queue_pop_head_link (slot))) {
+    WpTimer *t = link->data;
+
+    t->slot = NULL;
+    t->wheel = NULL;
+    self->n_pending--;
+
+    wheel_fire (self, t);
+    wp_timer_unref (t);
+  }
+  self->occupied[0] &= ~(G_GUINT64_CONSTANT (1) << index);
+}
+
+static void
+wheel_advance (WpTimerWheel * self, guint64 now)
+{
+  while (self->current < now) {
+    guint64 next = wheel_next_event (self);
+
+    /* nothing to do until then; skip ahead */
+    if (next > now) {
+      self->current = now;
+      break;
+    }
+    self->current = next - 1;
+    wheel_tick (self);
+  }
+}
+
+static void
+wheel_update_source (WpTimerWheel * self)
+{
+  guint64 next = wheel_next_event (self);
+
+  g_source_set_ready_time (self->source, (next == G_MAXUINT64) ? -1 :
+      self->base_time + (gint64) next * 1000);
+}
+
+static gboolean
+wheel_source_dispatch (GSource * source, GSourceFunc callback, gpointer data)
+{
+  WpTimerWheel *self = ((WpTimerWheelSource *) source)->wheel;
+
+  self->dispatching = TRUE;
+  wheel_advance (self, wheel_now (self, FALSE));
+  self->dispatching = FALSE;
+
+  wheel_update_source (self);
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs wheel_source_funcs = {
+  .dispatch = wheel_source_dispatch,
+};
+
+WpTimerWheel *
+wp_timer_wheel_new (GMainContext * context)
+{
+  WpTimerWheel *self = g_slice_new0 (WpTimerWheel);
+
+  self->base_time = g_get_monotonic_time ();
+  for (guint level = 0; level < WHEEL_LEVELS; level++)
+    for (guint index = 0; index < WHEEL_SLOTS; index++)
+      g_queue_init (&self->slots[level][index]);
+
+  self->source = g_source_new (&wheel_source_funcs,
+      sizeof (WpTimerWheelSource));
+  ((WpTimerWheelSource *) self->source)->wheel = self;
+  g_source_set_name (self->source, "wp-timer-wheel");
+  g_source_attach (self->source, context);
+  return self;
+}
+
+void
+wp_timer_wheel_free (WpTimerWheel * self)
+{
+  g_source_destroy (self->source);
+  g_clear_pointer (&self->source, g_source_unref);
+
+  for (guint level = 0; level < WHEEL_LEVELS; level++) {
+    for (guint index = 0; index < WHEEL_SLOTS; index++) {
+      GList *link;
+      while ((link = g_queue_pop_head_link (&self->slots[level][index]))) {
+        WpTimer *t = link->data;
+        t->slot = NULL;
+        t->wheel = NULL;
+        wp_timer_unref (t);
+      }
+    }
+  }
+  g_slice_free (WpTimerWheel, self);
+}
+
+/*!
+ * \brief Creates a new timer that calls \a func when it expires
+ *
+ * The timer is not started; use wp_timer_start() to start it.
+ *
+ * \ingroup wptimer
+ * \param core the core
+ * \param func (scope notified): the function to call
+ * \param data (closure): data to pass to \a func
+ * \param destroy (nullable): a function to destroy \a data
+ * \returns (transfer full): the new timer
+ */
+WpTimer *
+wp_timer_new (WpCore * core, WpTimerFunc func, gpointer data,
+    GDestroyNotify destroy)
+{
+  g_return_val_if_fail (func != NULL, NULL);
+
+  return wp_timer_new_closure (core, g_cclosure_new (G_CALLBACK (func), data,
+          (GClosureNotify) destroy));
+}
+
+/*!
+ * \brief Creates a new timer that invokes \a closure when it expires
+ *
+ * This is the same as wp_timer_new(), but it allows you to specify a
+ * GClosure instead of a C callback. The closure is invoked with the
+ * timer as its only parameter.
+ *
+ * \ingroup wptimer
+ * \param core the core
+ * \param closure the closure to invoke
+ * \returns (transfer full): the new timer
+ */
+WpTimer *
+wp_timer_new_closure (WpCore * core, GClosure * closure)
+{
+  WpTimer *self;
+
+  g_return_val_if_fail (WP_IS_CORE (core), NULL);
+  g_return_val_if_fail (closure != NULL, NULL);
+
+  self = g_slice_new0 (WpTimer);
+  g_ref_count_init (&self->ref);
+  g_weak_ref_init (&self->core, core);
+  self->closure = g_closure_ref (closure);
+  g_closure_sink (closure);
+  if (G_CLOSURE_NEEDS_MARSHAL (closure))
+    g_closure_set_marshal (closure, g_cclosure_marshal_VOID__VOID);
+  self->link.data = self;
+  return self;
+}
+
+/*!
+ * \ingroup wptimer
+ * \param self a timer
+ * \returns (transfer full): \a self with an additional reference count on it
+ */
+WpTimer *
+wp_timer_ref (WpTimer * self)
+{
+  g_ref_count_inc (&self->ref);
+  return self;
+}
+
+static void
+wp_timer_free (WpTimer * self)
+{
+  g_weak_ref_clear (&self->core);
+  g_closure_unref (self->closure);
+  g_slice_free (WpTimer, self);
+}
+
+/*!
+ * \brief Decreases the reference count on \a self and frees it when the ref
+ * count reaches zero.
+ *
+ * A pending timer keeps a reference to itself, so it will still fire if all
+ * other references are dropped before it expires.
+ *
+ * \ingroup wptimer
+ * \param self (transfer full): a timer
+ */
+void
+wp_timer_unref (WpTimer * self)
+{
+  if (g_ref_count_dec (&self->ref))
+    wp_timer_free (self);
+}
+
+/*!
+ * \brief Starts the timer, so that it expires after \a timeout_ms milliseconds
+ *
+ * If the timer is already pending, it is re-armed with the new timeout.
+ * The timer fires only once; it can be started again from its own callback
+ * to make it fire periodically.
+ *
+ * \ingroup wptimer
+ * \param self the timer
+ * \param timeout_ms the timeout in milliseconds
+ */
+void
+wp_timer_start (WpTimer * self, guint timeout_ms)
+{
+  g_autoptr (WpCore) core = NULL;
+  WpTimerWheel *wheel;
+  guint64 now;
+
+  g_return_if_fail (self != NULL);
+
+  core = g_weak_ref_get (&self->core);
+  g_return_if_fail (core != NULL);
+
+  wheel = wp_core_get_timer_wheel (core);
+  now = wheel_now (wheel, TRUE);
+
+  if (self->wheel) {
+    wheel_remove (self->wheel, self);
+  } else {
+    /* while the wheel was empty, there was no need to keep turning it */
+    if (wheel->n_pending == 0 && !wheel->dispatching)
+      wheel->current = MAX (wheel->current, now);
+    self->wheel = wheel;
+    wheel->n_pending++;
+    wp_timer_ref (self);
+  }
+
+  self->expires = now + timeout_ms;
+  wheel_insert (wheel, self, wheel->current + 1);
+
+  if (!wheel->dispatching)
+    wheel_update_source (wheel);
+}
+
+/*!
+ * \brief Stops the timer, if it is pending
+ *
+ * \ingroup wptimer
+ * \param self the timer
+ */
+void
+wp_timer_stop (WpTimer * self)
+{
+  WpTimerWheel *wheel;
+
+  g_return_if_fail (self != NULL);
+
+  if (!(wheel = self->wheel))
+    return;
+
+  wheel_remove (wheel, self);
+  self->wheel = NULL;
+  wheel->n_pending--;
+
+  /* the source will only wake up once without anything to do, so there is
+     no need to update it here */
+  wp_timer_unref (self);
+}
+
+/*!
+ * \ingroup wptimer
+ * \param self the timer
+ * \returns TRUE if the timer has been started and has not expired
+ *   or been stopped since
+ */
+gboolean
+wp_timer_is_pending (WpTimer * self)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  return self->wheel != NULL;
+}
@@ -0,0 +1,59 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_TIMER_H__
+#define __WIREPLUMBER_TIMER_H__
+
+#include "core.h"
+
+G_BEGIN_DECLS
+
+/*!
+ * \brief The WpTimer GType
+ * \ingroup wptimer
+ */
+#define WP_TYPE_TIMER (wp_timer_get_type ())
+WP_API
+GType wp_timer_get_type (void);
+
+typedef struct _WpTimer WpTimer;
+
+/*!
+ * \brief A function to be called when a WpTimer expires
+ * \ingroup wptimer
+ * \param timer the timer
+ * \param data the user data that was passed to wp_timer_new()
+ */
+typedef void (*WpTimerFunc) (WpTimer * timer, gpointer data);
+
+WP_API
+WpTimer * wp_timer_new (WpCore * core, WpTimerFunc func, gpointer data,
+    GDestroyNotify destroy);
+
+WP_API
+WpTimer * wp_timer_new_closure (WpCore * core, GClosure * closure);
+
+WP_API
+WpTimer * wp_timer_ref (WpTimer * self);
+
+WP_API
+void wp_timer_unref (WpTimer * self);
+
+WP_API
+void wp_timer_start (WpTimer * self, guint timeout_ms);
+
+WP_API
+void wp_timer_stop (WpTimer * self);
+
+WP_API
+gboolean wp_timer_is_pending (WpTimer * self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpTimer, wp_timer_unref)
+
+G_END_DECLS
+
+#endif
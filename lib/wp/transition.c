@@ -10,6 +10,7 @@
 
 #include "transition.h"
 #include "log.h"
+#include "watchdog.h"
 #include "error.h"
 
 /*! \defgroup wptransition Transitions */
@@ -387,6 +388,18 @@ wp_transition_return (WpTransition * self, WpTransitionPrivate *priv)
   g_object_unref (self);
 }
 
+static gchar *
+describe_transition (gconstpointer instance)
+{
+  WpTransition *self = (WpTransition *) instance;
+  WpTransitionPrivate *priv = wp_transition_get_instance_private (self);
+
+  return g_strdup_printf ("%s:%p step %u of %s:%p", G_OBJECT_TYPE_NAME (self),
+      self, priv->step,
+      priv->source_object ? G_OBJECT_TYPE_NAME (priv->source_object) : "none",
+      priv->source_object);
+}
+
 /*!
  * \brief Advances the transition to the next step.
  *
@@ -426,6 +439,7 @@ wp_transition_advance (WpTransition * self)
   WpTransitionPrivate *priv = wp_transition_get_instance_private (self);
   guint next_step;
   GError *error = NULL;
+  gboolean watched;
 
   priv->started = TRUE;
 
@@ -465,7 +479,11 @@ wp_transition_advance (WpTransition * self)
 
   /* execute the next step */
   priv->step = next_step;
+  watched = wp_watchdog_push ("transition", G_OBJECT_TYPE (self), self,
+      describe_transition);
   WP_TRANSITION_GET_CLASS (self)->execute_step (self, priv->step);
+  if (watched)
+    wp_watchdog_pop ();
 }
 
 /*!
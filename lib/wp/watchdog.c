@@ -0,0 +1,405 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define G_LOG_DOMAIN "wp-watchdog"
+
+#include "watchdog.h"
+#include "log.h"
+
+#include <string.h>
+
+/*! \defgroup wpwatchdog Main loop watchdog */
+/*!
+ * The watchdog measures how long each iteration of the main loop keeps the
+ * loop busy, i.e. the time between waking up from poll() and going back to
+ * sleep, and keeps a histogram of these times.
+ *
+ * The parts of WirePlumber that dispatch work on the loop (PipeWire events,
+ * timers, transitions, Lua callbacks) announce what they are running with
+ * wp_watchdog_push() and wp_watchdog_pop(). When one of them runs for longer
+ * than the threshold, it is described in the report that is logged for the
+ * iteration, from the innermost to the outermost, so that a stall can be
+ * traced back to the handler that caused it. The outermost handler is also
+ * attributed to the GSource that dispatched it. The sources that are added
+ * with wp_core_idle_add(), wp_core_timeout_add() and their closure variants
+ * are watched automatically.
+ *
+ * When an iteration stalls, but none of the handlers that ran in it took
+ * longer than the threshold by itself, the slowest one of them is named in
+ * the report instead. If none ran at all, the time was spent in sources that
+ * are not instrumented.
+ *
+ * The watchdog only observes the thread that runs the watched main context;
+ * it must be started and stopped from that thread. Work that is announced
+ * from any other thread, i.e. one that does not own the watched context, is
+ * ignored. While it is not running, wp_watchdog_push() returns immediately.
+ */
+
+#define MAX_DEPTH 32
+#define MAX_NAME_LEN 128
+
+/* upper limits of the histogram buckets, in microseconds */
+static const guint64 bucket_limits[WP_WATCHDOG_N_BUCKETS] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, G_MAXUINT64,
+};
+
+typedef struct _Frame Frame;
+struct _Frame
+{
+  const gchar *what;
+  GType type;
+  gconstpointer instance;
+  WpWatchdogDescribeFunc describe;
+  gint64 start;
+};
+
+typedef struct _WpWatchdog WpWatchdog;
+struct _WpWatchdog
+{
+  GMainContext *context;
+  GPollFunc poll_func;
+  GSource *summary_source;
+  guint64 threshold_us;
+  guint summary_interval_s;
+
+  gint64 wake_time;
+  guint depth;
+  Frame stack[MAX_DEPTH];
+  GString *report;
+
+  /* the slowest outermost handler of the current iteration */
+  guint64 slowest_us;
+  gchar slowest[MAX_NAME_LEN];
+
+  WpWatchdogStats stats;
+  WpWatchdogStats interval;
+};
+
+static WpWatchdog *watchdog = NULL;
+
+static void
+record_iteration (WpWatchdog * self, guint64 busy_us)
+{
+  guint b = 0;
+
+  while (busy_us > bucket_limits[b])
+    b++;
+
+  for (guint i = 0; i < 2; i++) {
+    WpWatchdogStats *s = i ? &self->interval : &self->stats;
+    s->n_iterations++;
+    s->histogram[b]++;
+    s->max_busy_us = MAX (s->max_busy_us, busy_us);
+    if (busy_us >= self->threshold_us)
+      s->n_stalls++;
+  }
+
+  if (busy_us >= self->threshold_us) {
+    if (self->report->len)
+      wp_warning ("main loop stalled for %.1f ms; running: %s",
+          busy_us / 1000.0, self->report->str);
+    else if (self->slowest_us > 0)
+      wp_warning ("main loop stalled for %.1f ms; slowest instrumented "
+          "handler: %s (%.1f ms)", busy_us / 1000.0, self->slowest,
+          self->slowest_us / 1000.0);
+    else
+      wp_warning ("main loop stalled for %.1f ms; no instrumented handler ran",
+          busy_us / 1000.0);
+  }
+  g_string_truncate (self->report, 0);
+  self->slowest_us = 0;
+}
+
+static gint
+watchdog_poll (GPollFD * fds, guint nfds, gint timeout)
+{
+  WpWatchdog *self = watchdog;
+  gint ret;
+
+  /* nested main loops are not accounted separately */
+  if (self->depth == 0 && self->wake_time != 0)
+    record_iteration (self, g_get_monotonic_time () - self->wake_time);
+
+  ret = self->poll_func (fds, nfds, timeout);
+
+  self->wake_time = g_get_monotonic_time ();
+  return ret;
+}
+
+/* formats the range of the smallest bucket under which the given fraction
+   of the iterations of @s fall */
+static gchar *
+percentile (const WpWatchdogStats * s, gdouble fraction)
+{
+  guint64 target = s->n_iterations * fraction;
+  guint64 count = 0;
+  guint i;
+
+  for (i = 0; i < WP_WATCHDOG_N_BUCKETS - 1; i++) {
+    count += s->histogram[i];
+    if (count > target)
+      return g_strdup_printf ("<= %.1f ms", bucket_limits[i] / 1000.0);
+  }
+  return g_strdup_printf ("> %.1f ms", bucket_limits[i - 1] / 1000.0);
+}
+
+static gboolean
+log_summary (gpointer data)
+{
+  WpWatchdog *self = data;
+  WpWatchdogStats *s = &self->interval;
+  g_autoptr (GString) hist = g_string_new (NULL);
+  g_autofree gchar *p50 = percentile (s, 0.5);
+  g_autofree gchar *p99 = percentile (s, 0.99);
+
+  for (guint i = 0; i < WP_WATCHDOG_N_BUCKETS; i++) {
+    if (bucket_limits[i] == G_MAXUINT64)
+      g_string_append_printf (hist, " >%.1fms:%" G_GUINT64_FORMAT,
+          bucket_limits[i - 1] / 1000.0, s->histogram[i]);
+    else
+      g_string_append_printf (hist, " <=%.1fms:%" G_GUINT64_FORMAT,
+          bucket_limits[i] / 1000.0, s->histogram[i]);
+  }
+
+  wp_info ("main loop in the last %u s: %" G_GUINT64_FORMAT " iterations, %"
+      G_GUINT64_FORMAT " stalls, p50 %s, p99 %s, max %.1f ms;%s",
+      self->summary_interval_s, s->n_iterations, s->n_stalls, p50, p99,
+      s->max_busy_us / 1000.0, hist->str);
+
+  memset (s, 0, sizeof (*s));
+  return G_SOURCE_CONTINUE;
+}
+
+/*!
+ * \brief Starts watching the iterations of a main context
+ *
+ * Only one main context can be watched at a time.
+ *
+ * \ingroup wpwatchdog
+ * \param context (nullable): the context to watch, or NULL for the global
+ *   default main context
+ * \param threshold_ms iterations and handlers that take longer than this
+ *   are reported as stalls
+ * \param summary_interval_s if not 0, a summary of the iterations is logged
+ *   with the info level every this many seconds
+ * \since 0.4.10
+ */
+void
+wp_watchdog_start (GMainContext * context, guint threshold_ms,
+    guint summary_interval_s)
+{
+  g_return_if_fail (watchdog == NULL);
+
+  if (!context)
+    context = g_main_context_default ();
+
+  watchdog = g_slice_new0 (WpWatchdog);
+  watchdog->context = g_main_context_ref (context);
+  watchdog->threshold_us = (guint64) MAX (threshold_ms, 1) * 1000;
+  watchdog->summary_interval_s = summary_interval_s;
+  watchdog->report = g_string_new (NULL);
+
+  watchdog->poll_func = g_main_context_get_poll_func (context);
+  g_main_context_set_poll_func (context, watchdog_poll);
+
+  if (summary_interval_s > 0) {
+    watchdog->summary_source = g_timeout_source_new_seconds (summary_interval_s);
+    g_source_set_callback (watchdog->summary_source, log_summary, watchdog,
+        NULL);
+    g_source_attach (watchdog->summary_source, context);
+  }
+
+  wp_info ("main loop watchdog started, threshold: %u ms", threshold_ms);
+}
+
+/*!
+ * \brief Stops the watchdog
+ * \ingroup wpwatchdog
+ * \since 0.4.10
+ */
+void
+wp_watchdog_stop (void)
+{
+  if (!watchdog)
+    return;
+
+  g_main_context_set_poll_func (watchdog->context, watchdog->poll_func);
+  if (watchdog->summary_source) {
+    g_source_destroy (watchdog->summary_source);
+    g_source_unref (watchdog->summary_source);
+  }
+  g_main_context_unref (watchdog->context);
+  g_string_free (watchdog->report, TRUE);
+  g_slice_free (WpWatchdog, watchdog);
+  watchdog = NULL;
+}
+
+/*!
+ * \brief Announces that the calling code starts running something on
+ *   behalf of \a instance
+ *
+ * Every successful call must be matched by a call to wp_watchdog_pop()
+ * when that work is done. Calls from threads that do not own the watched
+ * main context are not successful.
+ *
+ * \ingroup wpwatchdog
+ * \param what a static string that describes the kind of work
+ * \param type the type of \a instance, or G_TYPE_NONE
+ * \param instance (nullable): the object on whose behalf the work runs
+ * \param describe (nullable): a function that describes \a instance; if
+ *   NULL, GObject instances are described by their type and address
+ * \returns TRUE if the work is being watched and wp_watchdog_pop()
+ *   must be called, FALSE otherwise
+ * \since 0.4.10
+ */
+gboolean
+wp_watchdog_push (const gchar * what, GType type, gconstpointer instance,
+    WpWatchdogDescribeFunc describe)
+{
+  Frame *frame;
+
+  if (G_LIKELY (!watchdog))
+    return FALSE;
+
+  /* the stack describes the thread that runs the watched context only */
+  if (!g_main_context_is_owner (watchdog->context))
+    return FALSE;
+
+  if (watchdog->depth < MAX_DEPTH) {
+    frame = &watchdog->stack[watchdog->depth];
+    frame->what = what;
+    frame->type = type;
+    frame->instance = instance;
+    frame->describe = describe;
+    frame->start = g_get_monotonic_time ();
+  }
+  watchdog->depth++;
+  return TRUE;
+}
+
+/* names the GSource that is being dispatched, if any */
+static void
+describe_current_source (GString * str)
+{
+  GSource *source = g_main_current_source ();
+  const gchar *name;
+
+  if (!source)
+    return;
+
+  name = g_source_get_name (source);
+  if (name)
+    g_string_append_printf (str, " from source '%s'", name);
+  else
+    g_string_append_printf (str, " from source %u", g_source_get_id (source));
+}
+
+static void
+describe_frame (Frame * frame, GString * str)
+{
+  g_autofree gchar *desc = NULL;
+
+  if (frame->describe)
+    desc = frame->describe (frame->instance);
+  else if (frame->instance && G_TYPE_IS_OBJECT (frame->type))
+    desc = g_strdup_printf ("%s:%p", G_OBJECT_TYPE_NAME (frame->instance),
+        frame->instance);
+  else if (frame->instance && frame->type != G_TYPE_NONE)
+    desc = g_strdup_printf ("%s:%p", g_type_name (frame->type),
+        frame->instance);
+
+  g_string_append (str, frame->what);
+  if (desc)
+    g_string_append_printf (str, " %s", desc);
+}
+
+/*!
+ * \brief Announces that the work announced by the last successful call to
+ *   wp_watchdog_push() is done
+ * \ingroup wpwatchdog
+ * \since 0.4.10
+ */
+void
+wp_watchdog_pop (void)
+{
+  Frame *frame;
+  guint64 elapsed;
+
+  if (!watchdog || watchdog->depth == 0 ||
+      !g_main_context_is_owner (watchdog->context))
+    return;
+
+  if (--watchdog->depth >= MAX_DEPTH)
+    return;
+
+  frame = &watchdog->stack[watchdog->depth];
+  elapsed = g_get_monotonic_time () - frame->start;
+
+  if (elapsed < watchdog->threshold_us) {
+    /* remember the slowest outermost handler, in case the iteration
+       stalls as a whole; this runs for every handler, so the instance is
+       not described, to avoid allocating */
+    if (watchdog->depth == 0 && elapsed >= watchdog->slowest_us) {
+      GSource *source = g_main_current_source ();
+      const gchar *name = source ? g_source_get_name (source) : NULL;
+
+      if (name)
+        g_snprintf (watchdog->slowest, sizeof (watchdog->slowest),
+            "%s from source '%s'", frame->what, name);
+      else if (source)
+        g_snprintf (watchdog->slowest, sizeof (watchdog->slowest),
+            "%s from source %u", frame->what, g_source_get_id (source));
+      else
+        g_strlcpy (watchdog->slowest, frame->what, sizeof (watchdog->slowest));
+      watchdog->slowest_us = MAX (elapsed, 1);
+    }
+    return;
+  }
+
+  /* inner frames finish first, so the report goes from the innermost
+     handler to the outermost one */
+  if (watchdog->report->len)
+    g_string_append (watchdog->report, " <- ");
+  describe_frame (frame, watchdog->report);
+  g_string_append_printf (watchdog->report, " (%.1f ms)", elapsed / 1000.0);
+
+  /* name the GSource that dispatched the outermost handler */
+  if (watchdog->depth == 0)
+    describe_current_source (watchdog->report);
+}
+
+/*!
+ * \brief Retrieves the statistics collected since the watchdog was started
+ * \ingroup wpwatchdog
+ * \param stats (out): the location to store the statistics
+ * \since 0.4.10
+ */
+void
+wp_watchdog_get_stats (WpWatchdogStats * stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  if (watchdog)
+    *stats = watchdog->stats;
+  else
+    memset (stats, 0, sizeof (*stats));
+}
+
+/*!
+ * \brief Gets the upper limit of a bucket of the latency histogram
+ * \ingroup wpwatchdog
+ * \param bucket the bucket index, smaller than WP_WATCHDOG_N_BUCKETS
+ * \returns the longest iteration time, in microseconds, that falls into
+ *   \a bucket; G_MAXUINT64 for the last bucket
+ * \since 0.4.10
+ */
+guint64
+wp_watchdog_get_bucket_limit (guint bucket)
+{
+  g_return_val_if_fail (bucket < WP_WATCHDOG_N_BUCKETS, G_MAXUINT64);
+  return bucket_limits[bucket];
+}
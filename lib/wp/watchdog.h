@@ -0,0 +1,71 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_WATCHDOG_H__
+#define __WIREPLUMBER_WATCHDOG_H__
+
+#include <glib-object.h>
+#include "defs.h"
+
+G_BEGIN_DECLS
+
+/*!
+ * \brief The number of buckets of the main loop latency histogram
+ * \ingroup wpwatchdog
+ */
+#define WP_WATCHDOG_N_BUCKETS 10
+
+/*!
+ * \brief Statistics of the main loop iterations observed by the watchdog
+ * \ingroup wpwatchdog
+ */
+typedef struct _WpWatchdogStats WpWatchdogStats;
+struct _WpWatchdogStats
+{
+  /*! the number of main loop iterations */
+  guint64 n_iterations;
+  /*! the number of iterations that took longer than the threshold */
+  guint64 n_stalls;
+  /*! the longest iteration, in microseconds */
+  guint64 max_busy_us;
+  /*! the number of iterations in each latency bucket; see
+      wp_watchdog_get_bucket_limit() */
+  guint64 histogram[WP_WATCHDOG_N_BUCKETS];
+};
+
+/*!
+ * \brief A function that describes an instance that is being dispatched,
+ *   for the stall report
+ * \ingroup wpwatchdog
+ * \param instance the instance that was passed to wp_watchdog_push()
+ * \returns (transfer full): a human-readable description of \a instance
+ */
+typedef gchar * (*WpWatchdogDescribeFunc) (gconstpointer instance);
+
+WP_API
+void wp_watchdog_start (GMainContext * context, guint threshold_ms,
+    guint summary_interval_s);
+
+WP_API
+void wp_watchdog_stop (void);
+
+WP_API
+gboolean wp_watchdog_push (const gchar * what, GType type,
+    gconstpointer instance, WpWatchdogDescribeFunc describe);
+
+WP_API
+void wp_watchdog_pop (void);
+
+WP_API
+void wp_watchdog_get_stats (WpWatchdogStats * stats);
+
+WP_API
+guint64 wp_watchdog_get_bucket_limit (guint bucket);
+
+G_END_DECLS
+
+#endif
@@ -37,7 +37,9 @@
 #include "spa-pod.h"
 #include "spa-type.h"
 #include "state.h"
+#include "timer.h"
 #include "transition.h"
+#include "watchdog.h"
 #include "wpenums.h"
 #include "wpversion.h"
 #include "factory.h"
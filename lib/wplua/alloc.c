@@ -0,0 +1,394 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "wplua.h"
+#include "private.h"
+#include <wp/wp.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Memory allocator of a lua_State.
+ *
+ * Small blocks are served from per-size-class pools. Sizes are rounded up
+ * to a multiple of POOL_GRANULE and each class carves its blocks out of
+ * slabs of slab_size bytes. Slabs are aligned to their size, so the slab
+ * of a block, and thus its class, is found by masking its address. Each
+ * slab keeps its own free list; a slab that has no blocks in use anymore is
+ * given back to the system, unless it is the last one of its class that has
+ * free blocks. Larger blocks go to malloc().
+ *
+ * Lua always passes the original size of a block when it reallocates or
+ * frees it, so whether a block is pooled is derived from that and no header
+ * is needed. The only exception are the malloc()ed blocks that could not be
+ * moved to a pool while shrinking, which are remembered in a set.
+ */
+
+#define POOL_GRANULE 16
+#define MAX_CLASSES (WPLUA_ALLOC_MAX_POOLED_SIZE / POOL_GRANULE)
+#define MIN_SLAB_SIZE 4096
+
+typedef struct _PoolClass PoolClass;
+typedef struct _Slab Slab;
+
+struct _Slab
+{
+  Slab *prev;
+  Slab *next;
+  PoolClass *cls;
+  gpointer free_list;
+  guint8 *bump;
+  guint n_used;
+  guint n_blocks;
+};
+
+#define SLAB_HEADER_SIZE \
+  ((sizeof (Slab) + POOL_GRANULE - 1) / POOL_GRANULE * POOL_GRANULE)
+
+struct _PoolClass
+{
+  gsize block_size;
+  Slab *partial;    /* slabs with free blocks */
+  Slab *full;       /* slabs without free blocks */
+  gsize n_used;
+  gsize n_reserved;
+  guint64 n_allocs;
+};
+
+typedef struct _WpLuaPool WpLuaPool;
+struct _WpLuaPool
+{
+  gsize max_pooled_size;
+  gsize slab_size;
+  guint n_classes;
+  PoolClass classes[MAX_CLASSES];
+  GHashTable *strays;   /* malloc()ed blocks with a pooled size */
+  WpLuaAllocStats stats;
+};
+
+static inline guint
+size_class (gsize size)
+{
+  return (size - 1) / POOL_GRANULE;
+}
+
+static inline gboolean
+is_pooled (WpLuaPool *pool, gsize size)
+{
+  return size > 0 && size <= pool->max_pooled_size;
+}
+
+static inline Slab *
+slab_of (WpLuaPool *pool, gpointer block)
+{
+  return (Slab *) ((guintptr) block & ~((guintptr) pool->slab_size - 1));
+}
+
+static inline gboolean
+is_stray (WpLuaPool *pool, gpointer block)
+{
+  return G_UNLIKELY (pool->strays != NULL) &&
+      g_hash_table_contains (pool->strays, block);
+}
+
+static void
+slab_link (Slab **list, Slab *s)
+{
+  s->prev = NULL;
+  s->next = *list;
+  if (*list)
+    (*list)->prev = s;
+  *list = s;
+}
+
+static void
+slab_unlink (Slab **list, Slab *s)
+{
+  if (s->prev)
+    s->prev->next = s->next;
+  else
+    *list = s->next;
+  if (s->next)
+    s->next->prev = s->prev;
+  s->prev = s->next = NULL;
+}
+
+static Slab *
+slab_new (WpLuaPool *pool, PoolClass *c)
+{
+  gpointer mem = NULL;
+  Slab *s;
+
+  if (posix_memalign (&mem, pool->slab_size, pool->slab_size) != 0)
+    return NULL;
+
+  s = mem;
+  s->prev = s->next = NULL;
+  s->cls = c;
+  s->free_list = NULL;
+  s->bump = (guint8 *) mem + SLAB_HEADER_SIZE;
+  s->n_used = 0;
+  s->n_blocks = (pool->slab_size - SLAB_HEADER_SIZE) / c->block_size;
+
+  c->n_reserved += s->n_blocks;
+  pool->stats.pool_bytes += pool->slab_size;
+  return s;
+}
+
+static void
+slab_free (WpLuaPool *pool, Slab *s)
+{
+  s->cls->n_reserved -= s->n_blocks;
+  pool->stats.pool_bytes -= pool->slab_size;
+  free (s);
+}
+
+static gpointer
+pool_get (WpLuaPool *pool, gsize size)
+{
+  PoolClass *c;
+  Slab *s;
+  gpointer block;
+
+  if (!is_pooled (pool, size))
+    return malloc (size);
+
+  c = &pool->classes[size_class (size)];
+
+  if (!(s = c->partial)) {
+    if (!(s = slab_new (pool, c)))
+      return NULL;
+    slab_link (&c->partial, s);
+  }
+
+  if (s->free_list) {
+    block = s->free_list;
+    s->free_list = *(gpointer *) block;
+  } else {
+    block = s->bump;
+    s->bump += c->block_size;
+  }
+
+  if (++s->n_used == s->n_blocks) {
+    slab_unlink (&c->partial, s);
+    slab_link (&c->full, s);
+  }
+
+  c->n_used++;
+  c->n_allocs++;
+  return block;
+}
+
+static void
+pool_put (WpLuaPool *pool, gpointer block, gsize size)
+{
+  PoolClass *c;
+  Slab *s;
+
+  if (!is_pooled (pool, size) ||
+      (G_UNLIKELY (pool->strays) &&
+          g_hash_table_remove (pool->strays, block))) {
+    free (block);
+    return;
+  }
+
+  s = slab_of (pool, block);
+  c = s->cls;
+
+  if (s->n_used-- == s->n_blocks) {
+    slab_unlink (&c->full, s);
+    slab_link (&c->partial, s);
+  }
+  *(gpointer *) block = s->free_list;
+  s->free_list = block;
+  c->n_used--;
+
+  /* keep one slab with free blocks per class, to avoid thrashing when a
+     single block is allocated and freed repeatedly */
+  if (s->n_used == 0 && (c->partial != s || s->next)) {
+    slab_unlink (&c->partial, s);
+    slab_free (pool, s);
+  }
+}
+
+static void
+account (WpLuaPool *pool, gsize osize, gsize nsize)
+{
+  pool->stats.live_bytes += nsize;
+  pool->stats.live_bytes -= osize;
+  pool->stats.peak_live_bytes =
+      MAX (pool->stats.peak_live_bytes, pool->stats.live_bytes);
+}
+
+void *
+_wplua_pool_alloc (void *ud, void *ptr, size_t osize, size_t nsize)
+{
+  WpLuaPool *pool = ud;
+  gpointer block;
+  gboolean omalloced = FALSE;
+
+  /* when ptr is NULL, osize encodes the type of the object instead */
+  if (!ptr)
+    osize = 0;
+
+  if (nsize == 0) {
+    if (ptr) {
+      pool_put (pool, ptr, osize);
+      account (pool, osize, 0);
+      pool->stats.n_frees++;
+    }
+    return NULL;
+  }
+
+  if (ptr) {
+    gboolean npooled = is_pooled (pool, nsize);
+
+    omalloced = !is_pooled (pool, osize) || is_stray (pool, ptr);
+
+    /* the block stays in the same place */
+    if (!omalloced && npooled &&
+        slab_of (pool, ptr)->cls == &pool->classes[size_class (nsize)]) {
+      account (pool, osize, nsize);
+      return ptr;
+    }
+    else if (omalloced && !npooled) {
+      /* with a size above the pooled ones, it is no stray anymore */
+      gboolean stray = G_UNLIKELY (pool->strays != NULL) &&
+          g_hash_table_remove (pool->strays, ptr);
+
+      block = realloc (ptr, nsize);
+      if (!block && nsize <= osize)
+        block = ptr;
+      if (block)
+        account (pool, osize, nsize);
+      else if (stray)
+        g_hash_table_add (pool->strays, ptr);
+      return block;
+    }
+  }
+
+  block = pool_get (pool, nsize);
+  if (!block) {
+    /* Lua assumes that shrinking a block never fails; keep the old one,
+       which is still large enough */
+    if (ptr && nsize <= osize) {
+      if (omalloced) {
+        if (!pool->strays)
+          pool->strays = g_hash_table_new (g_direct_hash, g_direct_equal);
+        g_hash_table_add (pool->strays, ptr);
+      }
+      account (pool, osize, nsize);
+      return ptr;
+    }
+    return NULL;
+  }
+
+  if (ptr) {
+    memcpy (block, ptr, MIN (osize, nsize));
+    pool_put (pool, ptr, osize);
+  } else {
+    pool->stats.n_allocs++;
+  }
+  account (pool, osize, nsize);
+  return block;
+}
+
+gpointer
+_wplua_pool_new (gsize max_pooled_size, gsize slab_size)
+{
+  WpLuaPool *pool = g_slice_new0 (WpLuaPool);
+
+  max_pooled_size = MIN (max_pooled_size, WPLUA_ALLOC_MAX_POOLED_SIZE);
+  pool->max_pooled_size = max_pooled_size / POOL_GRANULE * POOL_GRANULE;
+  /* slabs are aligned to their size, which must be a power of two */
+  slab_size = MAX (slab_size, MIN_SLAB_SIZE);
+  pool->slab_size = (gsize) 1 << g_bit_storage (slab_size - 1);
+  pool->n_classes = pool->max_pooled_size / POOL_GRANULE;
+  for (guint i = 0; i < pool->n_classes; i++)
+    pool->classes[i].block_size = (i + 1) * POOL_GRANULE;
+  return pool;
+}
+
+void
+_wplua_pool_free (gpointer data)
+{
+  WpLuaPool *pool = data;
+
+  for (guint i = 0; i < pool->n_classes; i++) {
+    PoolClass *c = &pool->classes[i];
+    Slab *s;
+
+    while ((s = c->partial)) {
+      slab_unlink (&c->partial, s);
+      slab_free (pool, s);
+    }
+    while ((s = c->full)) {
+      slab_unlink (&c->full, s);
+      slab_free (pool, s);
+    }
+  }
+  g_clear_pointer (&pool->strays, g_hash_table_unref);
+  g_slice_free (WpLuaPool, pool);
+}
+
+static WpLuaPool *
+get_pool (lua_State *L)
+{
+  gpointer ud = NULL;
+  lua_Alloc f = lua_getallocf (L, &ud);
+
+  g_return_val_if_fail (f == _wplua_pool_alloc, NULL);
+  return ud;
+}
+
+/**
+ * wplua_get_alloc_stats:
+ * @L: the lua_State
+ * @stats: (out): the location to store the statistics
+ *
+ * @brief Retrieves the memory usage counters of @L
+ */
+void
+wplua_get_alloc_stats (lua_State *L, WpLuaAllocStats *stats)
+{
+  WpLuaPool *pool = get_pool (L);
+
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (stats != NULL);
+
+  *stats = pool->stats;
+}
+
+/**
+ * wplua_get_alloc_class_stats:
+ * @L: the lua_State
+ * @stats: (out) (array length=n_stats): an array to store the statistics of
+ *   each size class
+ * @n_stats: the number of elements in @stats
+ *
+ * @brief Retrieves the usage counters of the small block pools of @L,
+ * one per size class, from the smallest to the largest
+ *
+ * @returns the number of size classes, which may be larger than @n_stats
+ */
+guint
+wplua_get_alloc_class_stats (lua_State *L, WpLuaAllocClassStats *stats,
+    guint n_stats)
+{
+  WpLuaPool *pool = get_pool (L);
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  for (guint i = 0; i < MIN (n_stats, pool->n_classes); i++) {
+    PoolClass *c = &pool->classes[i];
+    stats[i].block_size = c->block_size;
+    stats[i].n_used = c->n_used;
+    stats[i].n_free = c->n_reserved - c->n_used;
+    stats[i].n_allocs = c->n_allocs;
+  }
+  return pool->n_classes;
+}
@@ -75,12 +75,21 @@ wplua_pushboxed (lua_State * L, GType type, gpointer object)
 {
   g_return_if_fail (G_TYPE_FUNDAMENTAL (type) == G_TYPE_BOXED);
 
+  /* already in Lua; drop the reference that was passed to us */
+  if (object && _wplua_push_interned (L, object, type)) {
+    g_boxed_free (type, object);
+    return;
+  }
+
   GValue *v = _wplua_pushgvalue_userdata (L, type);
   wp_trace_boxed (type, object, "pushing to Lua, v=%p", v);
   g_value_take_boxed (v, object);
 
   luaL_getmetatable (L, "GBoxed");
   lua_setmetatable (L, -2);
+
+  if (object)
+    _wplua_intern (L, -1, object);
 }
 
 gpointer
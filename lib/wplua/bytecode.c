@@ -0,0 +1,268 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "wplua.h"
+#include "private.h"
+#include <wp/wp.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * On-disk cache of compiled chunks.
+ *
+ * Each script has one entry, stored in $XDG_CACHE_HOME/wireplumber/lua/
+ * <id>.luac, where <id> is the SHA-256 of the Lua release, the number sizes
+ * the interpreter was built with and the URI of the script. Editing a script
+ * therefore replaces its entry instead of adding a new one. Entries of
+ * scripts that are not loaded anymore are removed once they have not been
+ * used for CACHE_MAX_AGE_DAYS.
+ *
+ * The file starts with a magic string, the key of the source text that was
+ * compiled (see _wplua_bytecode_cache_key()) and the SHA-256 of the bytecode
+ * that follows. The key detects an outdated entry and the checksum detects
+ * a truncated or otherwise damaged one, before the bytecode is given to the
+ * (unverifying) undump code.
+ *
+ * The checksum does not protect against an entry that was written on
+ * purpose, so the cache is only used while its directory is owned by the
+ * user and cannot be written by anyone else, and only entries that are
+ * owned by the user and not writable by anyone else are loaded.
+ */
+
+#define CACHE_MAGIC "WPLUAC\x02"
+#define CACHE_MAGIC_SIZE (sizeof (CACHE_MAGIC))
+#define CACHE_KEY_SIZE 64
+#define CACHE_CHECKSUM_SIZE 32
+#define CACHE_HEADER_SIZE \
+    (CACHE_MAGIC_SIZE + CACHE_KEY_SIZE + CACHE_CHECKSUM_SIZE)
+#define CACHE_MAX_AGE_DAYS 30
+
+static gchar *
+get_cache_dir (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "wireplumber", "lua", NULL);
+}
+
+static gchar *
+get_cache_path (const gchar * uri)
+{
+  g_autoptr (GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_autofree gchar *dir = get_cache_dir ();
+  g_autofree gchar *filename = NULL;
+  const guint8 sizes[] = {
+    sizeof (lua_Integer), sizeof (lua_Number), sizeof (gpointer)
+  };
+
+  g_checksum_update (checksum, (const guchar *) LUA_RELEASE, -1);
+  g_checksum_update (checksum, sizes, sizeof (sizes));
+  g_checksum_update (checksum, (const guchar *) uri, -1);
+  filename = g_strconcat (g_checksum_get_string (checksum), ".luac", NULL);
+  return g_build_filename (dir, filename, NULL);
+}
+
+/* whether a file or directory can only have been written by this user */
+static gboolean
+is_trusted (const struct stat * st)
+{
+  return st->st_uid == getuid () && (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+static gboolean
+check_cache_dir (const gchar * dir)
+{
+  struct stat st;
+
+  if (lstat (dir, &st) < 0)
+    return FALSE;
+
+  if (!S_ISDIR (st.st_mode) || !is_trusted (&st)) {
+    wp_info ("not using bytecode cache directory %s: it is not a directory "
+        "that only the current user can write to", dir);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+compute_payload_checksum (const guint8 * data, gsize size, guint8 * digest)
+{
+  g_autoptr (GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  gsize len = CACHE_CHECKSUM_SIZE;
+
+  g_checksum_update (checksum, data, size);
+  g_checksum_get_digest (checksum, digest, &len);
+}
+
+gchar *
+_wplua_bytecode_cache_key (const gchar * buf, gsize size, const gchar * name)
+{
+  g_autoptr (GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  g_checksum_update (checksum, (const guchar *) name, strlen (name) + 1);
+  g_checksum_update (checksum, (const guchar *) buf, size);
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+gboolean
+_wplua_bytecode_cache_load (lua_State * L, const gchar * uri,
+    const gchar * key, const gchar * name)
+{
+  g_autofree gchar *dir = get_cache_dir ();
+  g_autofree gchar *path = get_cache_path (uri);
+  g_autoptr (GMappedFile) file = NULL;
+  const gchar *contents;
+  guint8 digest[CACHE_CHECKSUM_SIZE];
+  struct stat st;
+  gsize len;
+  int fd;
+
+  if (!check_cache_dir (dir))
+    return FALSE;
+
+  fd = open (path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &st) < 0 || !S_ISREG (st.st_mode) || !is_trusted (&st)) {
+    wp_info ("ignoring bytecode cache entry %s: it is not a regular file "
+        "that only the current user can write to", path);
+    close (fd);
+    return FALSE;
+  }
+
+  file = g_mapped_file_new_from_fd (fd, FALSE, NULL);
+  close (fd);
+  if (!file)
+    return FALSE;
+
+  contents = g_mapped_file_get_contents (file);
+  len = g_mapped_file_get_length (file);
+
+  if (len <= CACHE_HEADER_SIZE ||
+      memcmp (contents, CACHE_MAGIC, CACHE_MAGIC_SIZE) != 0) {
+    wp_info ("discarding invalid bytecode cache entry %s", path);
+    goto invalid;
+  }
+
+  /* an outdated entry is replaced when the script is stored again */
+  if (memcmp (contents + CACHE_MAGIC_SIZE, key, CACHE_KEY_SIZE) != 0) {
+    wp_debug ("bytecode cache entry of '%s' is outdated", name);
+    return FALSE;
+  }
+
+  compute_payload_checksum ((const guint8 *) contents + CACHE_HEADER_SIZE,
+      len - CACHE_HEADER_SIZE, digest);
+  if (memcmp (contents + CACHE_MAGIC_SIZE + CACHE_KEY_SIZE, digest,
+          CACHE_CHECKSUM_SIZE) != 0) {
+    wp_info ("discarding corrupted bytecode cache entry %s", path);
+    goto invalid;
+  }
+
+  if (luaL_loadbufferx (L, contents + CACHE_HEADER_SIZE,
+          len - CACHE_HEADER_SIZE, name, "b") != LUA_OK) {
+    wp_info ("discarding bytecode cache entry %s: %s", path,
+        lua_tostring (L, -1));
+    lua_pop (L, 1);
+    goto invalid;
+  }
+
+  /* the modification time tells when the entry was last used */
+  g_utime (path, NULL);
+
+  wp_debug ("loaded '%s' from bytecode cache", name);
+  return TRUE;
+
+invalid:
+  g_unlink (path);
+  return FALSE;
+}
+
+/* removes the entries that have not been used for CACHE_MAX_AGE_DAYS,
+   i.e. those of scripts that were removed or renamed */
+static void
+prune_cache (const gchar * dir)
+{
+  g_autoptr (GDir) d = g_dir_open (dir, 0, NULL);
+  gint64 limit = g_get_real_time () / G_USEC_PER_SEC -
+      CACHE_MAX_AGE_DAYS * 24 * 60 * 60;
+  const gchar *filename;
+
+  while (d && (filename = g_dir_read_name (d))) {
+    g_autofree gchar *path = NULL;
+    struct stat st;
+
+    if (!g_str_has_suffix (filename, ".luac"))
+      continue;
+
+    path = g_build_filename (dir, filename, NULL);
+    if (lstat (path, &st) == 0 && S_ISREG (st.st_mode) && st.st_mtime < limit) {
+      wp_debug ("removing unused bytecode cache entry %s", path);
+      g_unlink (path);
+    }
+  }
+}
+
+static int
+bytecode_writer (lua_State * L, const void * p, size_t sz, void * ud)
+{
+  g_byte_array_append ((GByteArray *) ud, p, sz);
+  return 0;
+}
+
+void
+_wplua_bytecode_cache_store (lua_State * L, const gchar * uri,
+    const gchar * key)
+{
+  g_autoptr (GByteArray) data = g_byte_array_new ();
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *dir = get_cache_dir ();
+  g_autofree gchar *path = NULL;
+  guint8 header[CACHE_HEADER_SIZE] = { 0 };
+
+  g_return_if_fail (lua_isfunction (L, -1));
+  g_return_if_fail (strlen (key) == CACHE_KEY_SIZE);
+
+  g_byte_array_append (data, header, sizeof (header));
+  if (lua_dump (L, bytecode_writer, data, 0) != 0 ||
+      data->len <= CACHE_HEADER_SIZE)
+    return;
+
+  memcpy (data->data, CACHE_MAGIC, CACHE_MAGIC_SIZE);
+  memcpy (data->data + CACHE_MAGIC_SIZE, key, CACHE_KEY_SIZE);
+  compute_payload_checksum (data->data + CACHE_HEADER_SIZE,
+      data->len - CACHE_HEADER_SIZE,
+      data->data + CACHE_MAGIC_SIZE + CACHE_KEY_SIZE);
+
+  if (g_mkdir_with_parents (dir, 0700) < 0) {
+    wp_debug ("cannot create bytecode cache directory %s: %s", dir,
+        g_strerror (errno));
+    return;
+  }
+
+  /* do not add entries to a directory that others may have written to;
+     they would be ignored when loading anyway */
+  if (!check_cache_dir (dir))
+    return;
+
+  /* g_file_set_contents() writes to a temporary file and renames it,
+     so concurrent readers never observe a partially written entry */
+  path = get_cache_path (uri);
+  if (!g_file_set_contents (path, (const gchar *) data->data, data->len,
+          &error)) {
+    wp_debug ("failed to store bytecode cache entry: %s", error->message);
+    return;
+  }
+  g_chmod (path, 0600);
+
+  /* entries are only stored when a script is new or has changed, which is
+     rare enough to look for unused ones at the same time */
+  prune_cache (dir);
+}
@@ -18,13 +18,57 @@ typedef struct _WpLuaClosureStore WpLuaClosureStore;
 struct _WpLuaClosureStore
 {
   GPtrArray *closures;
+
+  /* events of deferred closures that wait to be dispatched */
+  GPtrArray *pending;
+  GSource *dispatch_source;
+
+  /* set once the profiler is started for the first time */
+  WpLuaProfiler *profiler;
+};
+
+/* A signal emission that was captured by a deferred closure */
+typedef struct _WpLuaPendingEvent WpLuaPendingEvent;
+struct _WpLuaPendingEvent
+{
+  GClosure *closure;
+  guint n_values;
+  GValue *values;
 };
 
+static WpLuaPendingEvent *
+_wplua_pending_event_new (GClosure * closure, guint n_values,
+    const GValue * values)
+{
+  WpLuaPendingEvent *self = g_slice_new0 (WpLuaPendingEvent);
+  self->closure = g_closure_ref (closure);
+  self->n_values = n_values;
+  self->values = g_new0 (GValue, n_values);
+  for (guint i = 0; i < n_values; i++) {
+    g_value_init (&self->values[i], G_VALUE_TYPE (&values[i]));
+    g_value_copy (&values[i], &self->values[i]);
+  }
+  return self;
+}
+
+static void
+_wplua_pending_event_free (WpLuaPendingEvent * self)
+{
+  for (guint i = 0; i < self->n_values; i++)
+    g_value_unset (&self->values[i]);
+  g_free (self->values);
+  g_closure_unref (self->closure);
+  g_slice_free (WpLuaPendingEvent, self);
+}
+
 static WpLuaClosureStore *
 _wplua_closure_store_new (void)
 {
   WpLuaClosureStore *self = g_rc_box_new (WpLuaClosureStore);
   self->closures = g_ptr_array_new ();
+  self->pending = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) _wplua_pending_event_free);
+  self->dispatch_source = NULL;
   return self;
 }
 
@@ -39,6 +83,13 @@ _wplua_closure_store_finalize (WpLuaClosureStore * self)
     g_closure_unref (c);
   }
   g_ptr_array_unref (self->closures);
+
+  if (self->dispatch_source) {
+    g_source_destroy (self->dispatch_source);
+    g_source_unref (self->dispatch_source);
+  }
+  g_ptr_array_unref (self->pending);
+  g_clear_pointer (&self->profiler, _wplua_profiler_free);
 }
 
 static WpLuaClosureStore *
@@ -63,36 +114,74 @@ struct _WpLuaClosure
   GClosure closure;
   int func_ref;
   GPtrArray *closures;
+
+  /* only valid while the closure is valid; used by deferred closures */
+  WpLuaClosureStore *store;
 };
 
+static gchar *
+describe_lua_closure (gconstpointer instance)
+{
+  const WpLuaClosure *c = instance;
+  lua_State *L = c->closure.data;
+  lua_Debug ar;
+
+  /* the closure may have been invalidated while it was running */
+  if (c->func_ref == LUA_NOREF || c->func_ref == LUA_REFNIL)
+    return NULL;
+
+  lua_rawgeti (L, LUA_REGISTRYINDEX, c->func_ref);
+  if (!lua_isfunction (L, -1)) {
+    lua_pop (L, 1);
+    return NULL;
+  }
+  /* lua_getinfo() pops the function */
+  if (!lua_getinfo (L, ">S", &ar))
+    return NULL;
+  return g_strdup_printf ("%s:%d", ar.short_src, ar.linedefined);
+}
+
 static void
-_wplua_closure_marshal (GClosure *closure, GValue *return_value,
-    guint n_param_values, const GValue *param_values,
-    gpointer invocation_hint, gpointer marshal_data)
+_wplua_closure_call (GClosure *closure, GValue *return_value,
+    guint n_param_values, const GValue *param_values)
 {
   static int reentrant = 0;
   lua_State *L = closure->data;
   int func_ref = ((WpLuaClosure *) closure)->func_ref;
+  WpLuaProfiler *profiler;
+  WpLuaProfileFrame frame;
+  gboolean profiling = FALSE;
+  gboolean watched;
 
   /* invalid closure, skip it */
   if (func_ref == LUA_NOREF || func_ref == LUA_REFNIL)
     return;
 
-  /* stop the garbage collector */
-  if (reentrant == 0)
-    lua_gc (L, LUA_GCSTOP, 0);
+  profiler = ((WpLuaClosure *) closure)->store->profiler;
+
+  _wplua_gc_callback_enter (L, reentrant);
 
   /* push the function */
   lua_rawgeti (L, LUA_REGISTRYINDEX, func_ref);
 
+  if (G_UNLIKELY (profiler))
+    profiling = _wplua_profiler_enter (profiler, L, -1, &frame);
+
   /* push arguments */
   for (guint i = 0; i < n_param_values; i++)
     wplua_gvalue_to_lua (L, &param_values[i]);
 
   /* call in protected mode */
+  watched = wp_watchdog_push ("lua callback", G_TYPE_CLOSURE, closure,
+      describe_lua_closure);
   reentrant++;
   int res = _wplua_pcall (L, n_param_values, return_value ? 1 : 0);
   reentrant--;
+  if (watched)
+    wp_watchdog_pop ();
+
+  if (G_UNLIKELY (profiling))
+    _wplua_profiler_leave (profiler, L, &frame);
 
   /* handle the result */
   if (res == LUA_OK && return_value) {
@@ -101,9 +190,126 @@ _wplua_closure_marshal (GClosure *closure, GValue *return_value,
   }
 
   /* clean up */
-  lua_gc (L, LUA_GCCOLLECT, 0);
-  if (reentrant == 0)
-    lua_gc (L, LUA_GCRESTART, 0);
+  _wplua_gc_callback_leave (L, reentrant);
+}
+
+static void
+_wplua_closure_marshal (GClosure *closure, GValue *return_value,
+    guint n_param_values, const GValue *param_values,
+    gpointer invocation_hint, gpointer marshal_data)
+{
+  _wplua_closure_call (closure, return_value, n_param_values, param_values);
+}
+
+/* compares the values of two signal emissions; objects and boxed types
+   are compared by identity, since this is what the callback receives */
+static gboolean
+_wplua_gvalue_equal (const GValue * a, const GValue * b)
+{
+  if (G_VALUE_TYPE (a) != G_VALUE_TYPE (b))
+    return FALSE;
+
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (a))) {
+  case G_TYPE_CHAR:
+    return g_value_get_schar (a) == g_value_get_schar (b);
+  case G_TYPE_UCHAR:
+    return g_value_get_uchar (a) == g_value_get_uchar (b);
+  case G_TYPE_BOOLEAN:
+    return g_value_get_boolean (a) == g_value_get_boolean (b);
+  case G_TYPE_INT:
+    return g_value_get_int (a) == g_value_get_int (b);
+  case G_TYPE_UINT:
+    return g_value_get_uint (a) == g_value_get_uint (b);
+  case G_TYPE_LONG:
+    return g_value_get_long (a) == g_value_get_long (b);
+  case G_TYPE_ULONG:
+    return g_value_get_ulong (a) == g_value_get_ulong (b);
+  case G_TYPE_INT64:
+    return g_value_get_int64 (a) == g_value_get_int64 (b);
+  case G_TYPE_UINT64:
+    return g_value_get_uint64 (a) == g_value_get_uint64 (b);
+  case G_TYPE_FLOAT:
+    return g_value_get_float (a) == g_value_get_float (b);
+  case G_TYPE_DOUBLE:
+    return g_value_get_double (a) == g_value_get_double (b);
+  case G_TYPE_ENUM:
+    return g_value_get_enum (a) == g_value_get_enum (b);
+  case G_TYPE_FLAGS:
+    return g_value_get_flags (a) == g_value_get_flags (b);
+  case G_TYPE_STRING:
+    return !g_strcmp0 (g_value_get_string (a), g_value_get_string (b));
+  case G_TYPE_OBJECT:
+  case G_TYPE_INTERFACE:
+  case G_TYPE_BOXED:
+  case G_TYPE_PARAM:
+  case G_TYPE_VARIANT:
+    return g_value_peek_pointer (a) == g_value_peek_pointer (b);
+  default:
+    return FALSE;
+  }
+}
+
+static gboolean
+_wplua_closure_store_dispatch (WpLuaClosureStore * self)
+{
+  g_autoptr (GPtrArray) pending = self->pending;
+
+  /* events that are emitted from the callbacks go to the next batch */
+  self->pending = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) _wplua_pending_event_free);
+  g_clear_pointer (&self->dispatch_source, g_source_unref);
+
+  for (guint i = 0; i < pending->len; i++) {
+    WpLuaPendingEvent *ev = g_ptr_array_index (pending, i);
+
+    /* the closure may have been disconnected in the meantime */
+    if (ev->closure->is_invalid)
+      continue;
+    _wplua_closure_call (ev->closure, NULL, ev->n_values, ev->values);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_wplua_deferred_closure_marshal (GClosure *closure, GValue *return_value,
+    guint n_param_values, const GValue *param_values,
+    gpointer invocation_hint, gpointer marshal_data)
+{
+  WpLuaClosure *wlc = (WpLuaClosure *) closure;
+  WpLuaClosureStore *store = wlc->store;
+
+  /* invalid closure, skip it */
+  if (wlc->func_ref == LUA_NOREF || wlc->func_ref == LUA_REFNIL)
+    return;
+
+  /* collapse with an identical event that has not been dispatched yet */
+  for (guint i = 0; i < store->pending->len; i++) {
+    WpLuaPendingEvent *ev = g_ptr_array_index (store->pending, i);
+    guint j;
+
+    if (ev->closure != closure || ev->n_values != n_param_values)
+      continue;
+    for (j = 0; j < n_param_values; j++) {
+      if (!_wplua_gvalue_equal (&ev->values[j], &param_values[j]))
+        break;
+    }
+    if (j == n_param_values) {
+      wp_trace_boxed (G_TYPE_CLOSURE, closure, "collapsed pending event");
+      return;
+    }
+  }
+
+  g_ptr_array_add (store->pending,
+      _wplua_pending_event_new (closure, n_param_values, param_values));
+
+  if (!store->dispatch_source) {
+    g_autoptr (GMainContext) context = g_main_context_ref_thread_default ();
+
+    store->dispatch_source = g_idle_source_new ();
+    g_source_set_callback (store->dispatch_source,
+        (GSourceFunc) _wplua_closure_store_dispatch, store, NULL);
+    g_source_attach (store->dispatch_source, context);
+  }
 }
 
 static void
@@ -121,6 +327,24 @@ _wplua_closure_finalize (lua_State *L, WpLuaClosure *c)
   g_ptr_array_unref (c->closures);
 }
 
+static WpLuaClosureStore *
+_wplua_closure_store_get (lua_State *L)
+{
+  WpLuaClosureStore *store;
+
+  lua_pushliteral (L, "wplua_closures");
+  lua_gettable (L, LUA_REGISTRYINDEX);
+  store = wplua_toboxed (L, -1);
+  lua_pop (L, 1);
+  return store;
+}
+
+WpLuaProfiler **
+_wplua_closure_store_profiler (lua_State *L)
+{
+  return &_wplua_closure_store_get (L)->profiler;
+}
+
 GClosure *
 wplua_checkclosure (lua_State *L, int idx)
 {
@@ -159,17 +383,36 @@ wplua_function_to_closure (lua_State *L, int idx)
      so that we can invalidate the closure when lua_State closes;
      keep a strong ref of the array in the closure so that
      _wplua_closure_finalize() works even after the state is closed */
-  lua_pushliteral (L, "wplua_closures");
-  lua_gettable (L, LUA_REGISTRYINDEX);
-  store = wplua_toboxed (L, -1);
-  lua_pop (L, 1);
-
+  store = _wplua_closure_store_get (L);
   g_ptr_array_add (store->closures, c);
   wlc->closures = g_ptr_array_ref (store->closures);
+  wlc->store = store;
 
   return c;
 }
 
+/**
+ * wplua_function_to_deferred_closure:
+ *
+ * Make a GClosure out of a Lua function at index @em idx, which does not
+ * call the function synchronously when it is invoked. Instead, the invocation
+ * is queued and all queued invocations are dispatched together from an idle
+ * callback on the thread-default main context. Invocations with the same
+ * arguments as one that is still queued are collapsed into it.
+ *
+ * Deferred closures cannot return values.
+ *
+ * Returns: (transfer floating): the new closure
+ */
+GClosure *
+wplua_function_to_deferred_closure (lua_State *L, int idx)
+{
+  GClosure *c = wplua_function_to_closure (L, idx);
+  if (c)
+    g_closure_set_marshal (c, _wplua_deferred_closure_marshal);
+  return c;
+}
+
 void
 _wplua_init_closure (lua_State *L)
 {
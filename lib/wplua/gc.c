@@ -0,0 +1,233 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "wplua.h"
+#include "private.h"
+#include <wp/wp.h>
+
+/*
+ * Garbage collection policy of a lua_State.
+ *
+ * In the incremental and generational modes, the collector runs as Lua
+ * normally runs it, driven by allocations. On top of that, after a callback
+ * returns to the main loop, an idle source performs collection steps while
+ * the loop is otherwise quiet, spending at most idle_budget_us on each
+ * main loop iteration, so that garbage created by event handlers is reclaimed
+ * without delaying the handling of the next event.
+ *
+ * The full mode keeps the collector stopped while callbacks run and performs
+ * a full collection after each one.
+ */
+
+#define DEFAULT_STEP_KB 0
+#define DEFAULT_IDLE_BUDGET_US 1000
+
+typedef struct _WpLuaGc WpLuaGc;
+struct _WpLuaGc
+{
+  lua_State *L;
+  WpLuaGcMode mode;
+  guint step_kb;
+  guint idle_budget_us;
+  GSource *idle_source;
+  gboolean closing;
+  WpLuaGcStats stats;
+};
+
+static inline WpLuaGc *
+get_gc (lua_State *L)
+{
+  return *(WpLuaGc **) lua_getextraspace (L);
+}
+
+static void
+update_heap_stats (WpLuaGc *gc)
+{
+  gc->stats.heap_size = (gsize) lua_gc (gc->L, LUA_GCCOUNT, 0) * 1024 +
+      (gsize) lua_gc (gc->L, LUA_GCCOUNTB, 0);
+  gc->stats.peak_heap_size =
+      MAX (gc->stats.peak_heap_size, gc->stats.heap_size);
+}
+
+static void
+apply_mode (WpLuaGc *gc)
+{
+  switch (gc->mode) {
+  case WP_LUA_GC_MODE_GENERATIONAL:
+#ifdef LUA_GCGEN
+    lua_gc (gc->L, LUA_GCGEN, 0, 0);
+    break;
+#else
+    wp_info ("generational GC is not supported by Lua " LUA_RELEASE
+        ", using incremental");
+    gc->mode = WP_LUA_GC_MODE_INCREMENTAL;
+#endif
+    G_GNUC_FALLTHROUGH;
+  case WP_LUA_GC_MODE_INCREMENTAL:
+  case WP_LUA_GC_MODE_FULL:
+#ifdef LUA_GCINC
+    lua_gc (gc->L, LUA_GCINC, 0, 0, 0);
+#endif
+    break;
+  }
+}
+
+static gboolean
+idle_collect (gpointer data)
+{
+  WpLuaGc *gc = data;
+  gint64 start = g_get_monotonic_time ();
+  gint64 now;
+  gboolean done;
+
+  do {
+    done = lua_gc (gc->L, LUA_GCSTEP, gc->step_kb);
+    gc->stats.n_steps++;
+    now = g_get_monotonic_time ();
+
+    /* in generational mode, a step is a whole (minor) collection */
+    if (gc->mode == WP_LUA_GC_MODE_GENERATIONAL)
+      done = TRUE;
+  } while (!done && now - start < gc->idle_budget_us);
+
+  gc->stats.time_us += now - start;
+  update_heap_stats (gc);
+
+  if (done) {
+    gc->stats.n_cycles++;
+    wp_trace ("lua_State %p: GC cycle done, heap: %" G_GSIZE_FORMAT
+        " bytes, total GC time: %" G_GUINT64_FORMAT " us", gc->L,
+        gc->stats.heap_size, gc->stats.time_us);
+    g_clear_pointer (&gc->idle_source, g_source_unref);
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+schedule_idle_collect (WpLuaGc *gc)
+{
+  if (gc->idle_source)
+    return;
+
+  gc->idle_source = g_idle_source_new ();
+  g_source_set_priority (gc->idle_source, G_PRIORITY_LOW);
+  g_source_set_callback (gc->idle_source, idle_collect, gc, NULL);
+  g_source_attach (gc->idle_source, g_main_context_get_thread_default ());
+}
+
+void
+_wplua_init_gc (lua_State *L)
+{
+  WpLuaGc *gc = g_slice_new0 (WpLuaGc);
+
+  gc->L = L;
+  gc->mode = WP_LUA_GC_MODE_INCREMENTAL;
+  gc->step_kb = DEFAULT_STEP_KB;
+  gc->idle_budget_us = DEFAULT_IDLE_BUDGET_US;
+  *(WpLuaGc **) lua_getextraspace (L) = gc;
+  apply_mode (gc);
+}
+
+/* called before lua_close(), which may still invoke callbacks from
+   finalizers; from then on, no collection work is done or scheduled */
+gpointer
+_wplua_gc_detach (lua_State *L)
+{
+  WpLuaGc *gc = get_gc (L);
+
+  if (gc->idle_source) {
+    g_source_destroy (gc->idle_source);
+    g_clear_pointer (&gc->idle_source, g_source_unref);
+  }
+  gc->closing = TRUE;
+  return gc;
+}
+
+void
+_wplua_gc_free (gpointer data)
+{
+  g_slice_free (WpLuaGc, data);
+}
+
+void
+_wplua_gc_callback_enter (lua_State *L, int depth)
+{
+  WpLuaGc *gc = get_gc (L);
+
+  if (!gc->closing && gc->mode == WP_LUA_GC_MODE_FULL && depth == 0)
+    lua_gc (L, LUA_GCSTOP, 0);
+}
+
+void
+_wplua_gc_callback_leave (lua_State *L, int depth)
+{
+  WpLuaGc *gc = get_gc (L);
+
+  if (gc->closing)
+    return;
+
+  if (gc->mode == WP_LUA_GC_MODE_FULL) {
+    gint64 start = g_get_monotonic_time ();
+
+    lua_gc (L, LUA_GCCOLLECT, 0);
+    gc->stats.time_us += g_get_monotonic_time () - start;
+    gc->stats.n_cycles++;
+    update_heap_stats (gc);
+
+    if (depth == 0)
+      lua_gc (L, LUA_GCRESTART, 0);
+  }
+  else if (depth == 0) {
+    schedule_idle_collect (gc);
+  }
+}
+
+/**
+ * wplua_set_gc_policy:
+ * @L: the lua_State
+ * @mode: the collector mode
+ * @step_kb: the size of each step performed from the idle source, in KiB of
+ *   allocation it accounts for; 0 performs a basic step
+ * @idle_budget_us: the maximum time to spend on collection steps on each
+ *   iteration of an otherwise idle main loop
+ *
+ * @brief Configures how garbage is collected on @L.
+ */
+void
+wplua_set_gc_policy (lua_State *L, WpLuaGcMode mode, guint step_kb,
+    guint idle_budget_us)
+{
+  WpLuaGc *gc = get_gc (L);
+
+  wp_debug ("lua_State %p: GC mode %d, step %u KiB, idle budget %u us", L,
+      mode, step_kb, idle_budget_us);
+
+  gc->mode = mode;
+  gc->step_kb = step_kb;
+  gc->idle_budget_us = MAX (idle_budget_us, 1);
+  apply_mode (gc);
+}
+
+/**
+ * wplua_get_gc_stats:
+ * @L: the lua_State
+ * @stats: (out): the location to store the statistics
+ *
+ * @brief Retrieves the counters of the garbage collection work that was
+ * explicitly scheduled on @L, along with its current and peak heap size.
+ */
+void
+wplua_get_gc_stats (lua_State *L, WpLuaGcStats *stats)
+{
+  WpLuaGc *gc = get_gc (L);
+
+  g_return_if_fail (stats != NULL);
+
+  update_heap_stats (gc);
+  *stats = gc->stats;
+}
@@ -21,7 +21,7 @@ _wplua_gobject_call (lua_State *L)
   GQuark detail = 0;
 
   if (G_UNLIKELY (!g_signal_parse_name (sig_name, G_TYPE_FROM_INSTANCE (obj),
-                                        &sig_id, &detail, FALSE)))
+                                        &sig_id, &detail, TRUE)))
     luaL_error (L, "unknown signal '%s::%s'", G_OBJECT_TYPE_NAME (obj),
         sig_name);
 
@@ -73,7 +73,7 @@ _wplua_gobject_connect (lua_State *L)
   GQuark detail = 0;
 
   if (G_UNLIKELY (!g_signal_parse_name (sig_name, G_TYPE_FROM_INSTANCE (obj),
-                                        &sig_id, &detail, FALSE)))
+                                        &sig_id, &detail, TRUE)))
     luaL_error (L, "unknown signal '%s::%s'", G_OBJECT_TYPE_NAME (obj),
         sig_name);
 
@@ -85,6 +85,42 @@ _wplua_gobject_connect (lua_State *L)
   return 1;
 }
 
+static int
+_wplua_gobject_connect_deferred (lua_State *L)
+{
+  GObject *obj = wplua_checkobject (L, 1, G_TYPE_OBJECT);
+  const char *sig_name = luaL_checkstring (L, 2);
+  luaL_checktype (L, 3, LUA_TFUNCTION);
+
+  guint sig_id = 0;
+  GQuark detail = 0;
+  GSignalQuery query;
+
+  if (G_UNLIKELY (!g_signal_parse_name (sig_name, G_TYPE_FROM_INSTANCE (obj),
+                                        &sig_id, &detail, TRUE)))
+    luaL_error (L, "unknown signal '%s::%s'", G_OBJECT_TYPE_NAME (obj),
+        sig_name);
+
+  /* the callback runs after the emission has finished, so it can neither
+     return a value nor receive arguments that are only valid during it */
+  g_signal_query (sig_id, &query);
+  if (query.return_type != G_TYPE_NONE)
+    luaL_error (L, "signal '%s::%s' has a return value and cannot be deferred",
+        G_OBJECT_TYPE_NAME (obj), sig_name);
+  for (guint i = 0; i < query.n_params; i++) {
+    if (G_TYPE_FUNDAMENTAL (query.param_types[i]) == G_TYPE_POINTER)
+      luaL_error (L, "signal '%s::%s' has pointer arguments and cannot be "
+          "deferred", G_OBJECT_TYPE_NAME (obj), sig_name);
+  }
+
+  GClosure *closure = wplua_function_to_deferred_closure (L, 3);
+  gulong handler =
+      g_signal_connect_closure_by_id (obj, sig_id, detail, closure, FALSE);
+
+  lua_pushinteger (L, handler);
+  return 1;
+}
+
 static lua_CFunction
 find_method_in_luaL_Reg (luaL_Reg *reg, const gchar *method)
 {
@@ -115,6 +151,8 @@ _wplua_gobject___index (lua_State *L)
     func = _wplua_gobject_call;
   else if (!g_strcmp0 (key, "connect"))
     func = _wplua_gobject_connect;
+  else if (!g_strcmp0 (key, "connect_deferred"))
+    func = _wplua_gobject_connect_deferred;
 
   /* search in registered vtables */
   if (!func) {
@@ -213,12 +251,20 @@ wplua_pushobject (lua_State * L, gpointer object)
 {
   g_return_if_fail (G_IS_OBJECT (object));
 
+  /* already in Lua; drop the reference that was passed to us */
+  if (_wplua_push_interned (L, object, G_TYPE_FROM_INSTANCE (object))) {
+    g_object_unref (object);
+    return;
+  }
+
   GValue *v = _wplua_pushgvalue_userdata (L, G_TYPE_FROM_INSTANCE (object));
   wp_trace_object (object, "pushing to Lua, v=%p", v);
   g_value_take_object (v, object);
 
   luaL_getmetatable (L, "GObject");
   lua_setmetatable (L, -2);
+
+  _wplua_intern (L, -1, object);
 }
 
 gpointer
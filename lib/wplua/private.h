@@ -13,16 +13,57 @@
 
 G_BEGIN_DECLS
 
+/* alloc.c */
+void * _wplua_pool_alloc (void *ud, void *ptr, size_t osize, size_t nsize);
+gpointer _wplua_pool_new (gsize max_pooled_size, gsize slab_size);
+void _wplua_pool_free (gpointer pool);
+
 /* boxed.c */
 void _wplua_init_gboxed (lua_State *L);
 
+/* bytecode.c */
+gchar * _wplua_bytecode_cache_key (const gchar * buf, gsize size,
+    const gchar * name);
+gboolean _wplua_bytecode_cache_load (lua_State * L, const gchar * uri,
+    const gchar * key, const gchar * name);
+void _wplua_bytecode_cache_store (lua_State * L, const gchar * uri,
+    const gchar * key);
+
 /* closure.c */
+typedef struct _WpLuaProfiler WpLuaProfiler;
+
 void _wplua_init_closure (lua_State *L);
+WpLuaProfiler ** _wplua_closure_store_profiler (lua_State *L);
+
+/* gc.c */
+void _wplua_init_gc (lua_State *L);
+gpointer _wplua_gc_detach (lua_State *L);
+void _wplua_gc_free (gpointer gc);
+void _wplua_gc_callback_enter (lua_State *L, int depth);
+void _wplua_gc_callback_leave (lua_State *L, int depth);
 
 /* object.c */
 void _wplua_init_gobject (lua_State *L);
 
+/* profiler.c */
+#define WPLUA_PROFILE_LOCATION_SIZE (LUA_IDSIZE + 16)
+
+typedef struct {
+  gint64 start;
+  guint64 n_allocs;
+  gchar location[WPLUA_PROFILE_LOCATION_SIZE];
+} WpLuaProfileFrame;
+
+void _wplua_profiler_free (WpLuaProfiler *self);
+gboolean _wplua_profiler_enter (WpLuaProfiler *self, lua_State *L, int idx,
+    WpLuaProfileFrame *frame);
+void _wplua_profiler_leave (WpLuaProfiler *self, lua_State *L,
+    WpLuaProfileFrame *frame);
+
 /* userdata.c */
+void _wplua_init_interned (lua_State *L);
+gboolean _wplua_push_interned (lua_State *L, gpointer instance, GType type);
+void _wplua_intern (lua_State *L, int idx, gpointer instance);
 GValue * _wplua_pushgvalue_userdata (lua_State * L, GType type);
 gboolean _wplua_isgvalue_userdata (lua_State *L, int idx, GType type);
 
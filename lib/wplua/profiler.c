@@ -0,0 +1,324 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "wplua.h"
+#include "private.h"
+#include <wp/wp.h>
+
+/*
+ * Latency profiler for Lua callbacks.
+ *
+ * While it is running, every closure invocation and every chunk that is
+ * loaded is accounted to the location of the Lua function that runs, in the
+ * "source:line" form, where line is the line that the function is defined
+ * on (0 for the main chunk). Times are wall-clock and inclusive, i.e. a
+ * handler that triggers another handler synchronously is also charged for
+ * the time of the inner one.
+ *
+ * Optionally, a count hook interrupts Lua every sample_interval VM
+ * instructions and charges the time since the previous interruption to the
+ * function that is running at that point, which shows where the time goes
+ * inside a handler.
+ *
+ * The profiler is created the first time it is started and lives in the
+ * closure store until the lua_State is closed. Until then, the only cost
+ * on a closure invocation is checking for a NULL pointer.
+ */
+
+typedef struct _WpLuaProfileEntry WpLuaProfileEntry;
+struct _WpLuaProfileEntry
+{
+  guint64 n_calls;
+  guint64 total_us;
+  guint64 max_us;
+  guint64 n_allocs;
+};
+
+typedef struct _WpLuaSampleEntry WpLuaSampleEntry;
+struct _WpLuaSampleEntry
+{
+  guint64 n_samples;
+  guint64 time_us;
+};
+
+struct _WpLuaProfiler
+{
+  gboolean running;
+  guint sample_interval;
+  guint depth;
+  gint64 last_sample;
+
+  /* location -> WpLuaProfileEntry */
+  GHashTable *handlers;
+  /* location -> WpLuaSampleEntry */
+  GHashTable *samples;
+};
+
+static void
+format_location (lua_Debug *ar, gchar *location)
+{
+  g_snprintf (location, WPLUA_PROFILE_LOCATION_SIZE, "%s:%d",
+      ar->short_src, ar->linedefined);
+}
+
+static gpointer
+lookup_entry (GHashTable *table, const gchar *location, gsize size)
+{
+  gpointer entry = g_hash_table_lookup (table, location);
+
+  if (!entry) {
+    entry = g_malloc0 (size);
+    g_hash_table_insert (table, g_strdup (location), entry);
+  }
+  return entry;
+}
+
+static guint64
+get_n_allocs (lua_State *L)
+{
+  WpLuaAllocStats stats;
+  wplua_get_alloc_stats (L, &stats);
+  return stats.n_allocs;
+}
+
+static void
+sample_hook (lua_State *L, lua_Debug *ar)
+{
+  WpLuaProfiler *self = *_wplua_closure_store_profiler (L);
+  gchar location[WPLUA_PROFILE_LOCATION_SIZE];
+  WpLuaSampleEntry *entry;
+  gint64 now;
+
+  if (!self || !self->running || self->depth == 0 ||
+      !lua_getinfo (L, "S", ar))
+    return;
+
+  now = g_get_monotonic_time ();
+  format_location (ar, location);
+  entry = lookup_entry (self->samples, location, sizeof (WpLuaSampleEntry));
+  entry->n_samples++;
+  entry->time_us += now - self->last_sample;
+  self->last_sample = now;
+}
+
+void
+_wplua_profiler_free (WpLuaProfiler *self)
+{
+  g_hash_table_unref (self->handlers);
+  g_hash_table_unref (self->samples);
+  g_slice_free (WpLuaProfiler, self);
+}
+
+gboolean
+_wplua_profiler_enter (WpLuaProfiler *self, lua_State *L, int idx,
+    WpLuaProfileFrame *frame)
+{
+  lua_Debug ar;
+
+  if (!self->running)
+    return FALSE;
+
+  lua_pushvalue (L, idx);
+  lua_getinfo (L, ">S", &ar);
+  format_location (&ar, frame->location);
+
+  frame->n_allocs = get_n_allocs (L);
+  frame->start = g_get_monotonic_time ();
+  if (self->depth++ == 0)
+    self->last_sample = frame->start;
+  return TRUE;
+}
+
+void
+_wplua_profiler_leave (WpLuaProfiler *self, lua_State *L,
+    WpLuaProfileFrame *frame)
+{
+  WpLuaProfileEntry *entry;
+  guint64 elapsed = g_get_monotonic_time () - frame->start;
+
+  self->depth--;
+
+  /* stopped from within the callback */
+  if (!self->running)
+    return;
+
+  entry = lookup_entry (self->handlers, frame->location,
+      sizeof (WpLuaProfileEntry));
+  entry->n_calls++;
+  entry->total_us += elapsed;
+  entry->max_us = MAX (entry->max_us, elapsed);
+  entry->n_allocs += get_n_allocs (L) - frame->n_allocs;
+}
+
+/**
+ * wplua_profiler_start:
+ * @L: the lua_State
+ * @sample_interval: if not 0, also sample the running function every this
+ *   many VM instructions
+ *
+ * @brief Starts collecting timing statistics of the Lua callbacks and
+ * chunks that run on @L. Statistics collected earlier are kept; use
+ * wplua_profiler_reset() to discard them.
+ */
+void
+wplua_profiler_start (lua_State *L, guint sample_interval)
+{
+  WpLuaProfiler **p = _wplua_closure_store_profiler (L);
+
+  if (!*p) {
+    *p = g_slice_new0 (WpLuaProfiler);
+    (*p)->handlers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_free);
+    (*p)->samples = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_free);
+  }
+
+  (*p)->running = TRUE;
+  (*p)->sample_interval = sample_interval;
+
+  if (sample_interval > 0)
+    lua_sethook (L, sample_hook, LUA_MASKCOUNT, sample_interval);
+  else
+    lua_sethook (L, NULL, 0, 0);
+
+  wp_info ("lua profiler started on lua_State %p, sample interval: %u", L,
+      sample_interval);
+}
+
+/**
+ * wplua_profiler_stop:
+ * @L: the lua_State
+ *
+ * @brief Stops collecting statistics. The statistics collected so far
+ * remain available through wplua_profiler_get_report().
+ */
+void
+wplua_profiler_stop (lua_State *L)
+{
+  WpLuaProfiler *self = *_wplua_closure_store_profiler (L);
+
+  if (!self || !self->running)
+    return;
+
+  self->running = FALSE;
+  lua_sethook (L, NULL, 0, 0);
+  wp_info ("lua profiler stopped on lua_State %p", L);
+}
+
+/**
+ * wplua_profiler_reset:
+ * @L: the lua_State
+ *
+ * @brief Discards the statistics collected so far
+ */
+void
+wplua_profiler_reset (lua_State *L)
+{
+  WpLuaProfiler *self = *_wplua_closure_store_profiler (L);
+
+  if (!self)
+    return;
+
+  g_hash_table_remove_all (self->handlers);
+  g_hash_table_remove_all (self->samples);
+}
+
+typedef struct _EntryRef EntryRef;
+struct _EntryRef
+{
+  const gchar *location;
+  gpointer entry;
+};
+
+static gint
+compare_handlers (gconstpointer a, gconstpointer b)
+{
+  const WpLuaProfileEntry *ea = ((const EntryRef *) a)->entry;
+  const WpLuaProfileEntry *eb = ((const EntryRef *) b)->entry;
+  return (ea->total_us < eb->total_us) - (ea->total_us > eb->total_us);
+}
+
+static gint
+compare_samples (gconstpointer a, gconstpointer b)
+{
+  const WpLuaSampleEntry *ea = ((const EntryRef *) a)->entry;
+  const WpLuaSampleEntry *eb = ((const EntryRef *) b)->entry;
+  return (ea->time_us < eb->time_us) - (ea->time_us > eb->time_us);
+}
+
+/* returns the entries of @table, sorted with @cmp */
+static GArray *
+sorted_entries (GHashTable *table, GCompareFunc cmp)
+{
+  GArray *arr = g_array_sized_new (FALSE, FALSE, sizeof (EntryRef),
+      g_hash_table_size (table));
+  GHashTableIter iter;
+  EntryRef ref;
+
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &ref.location,
+              &ref.entry))
+    g_array_append_val (arr, ref);
+  g_array_sort (arr, cmp);
+  return arr;
+}
+
+/**
+ * wplua_profiler_get_report:
+ * @L: the lua_State
+ *
+ * @brief Retrieves the statistics collected by the profiler
+ *
+ * The report is a dictionary with the following keys:
+ *  - "running" (b): whether the profiler is collecting statistics
+ *  - "sample-interval" (u): the sampling interval, in VM instructions
+ *  - "handlers" (a(stttt)): the location, number of calls, total and
+ *    maximum time in microseconds, and number of Lua allocations of each
+ *    function that was called from C, sorted by total time
+ *  - "samples" (a(stt)): the location, number of samples and time in
+ *    microseconds attributed to each function by sampling, sorted by time
+ *
+ * Returns: (transfer floating): the report, as a GVariant of type a{sv}
+ */
+GVariant *
+wplua_profiler_get_report (lua_State *L)
+{
+  WpLuaProfiler *self = *_wplua_closure_store_profiler (L);
+  g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+  g_auto (GVariantBuilder) hb = G_VARIANT_BUILDER_INIT (
+      G_VARIANT_TYPE ("a(stttt)"));
+  g_auto (GVariantBuilder) sb = G_VARIANT_BUILDER_INIT (
+      G_VARIANT_TYPE ("a(stt)"));
+
+  if (self) {
+    g_autoptr (GArray) handlers = sorted_entries (self->handlers,
+        compare_handlers);
+    g_autoptr (GArray) samples = sorted_entries (self->samples,
+        compare_samples);
+
+    for (guint i = 0; i < handlers->len; i++) {
+      EntryRef *ref = &g_array_index (handlers, EntryRef, i);
+      WpLuaProfileEntry *e = ref->entry;
+      g_variant_builder_add (&hb, "(stttt)", ref->location, e->n_calls,
+          e->total_us, e->max_us, e->n_allocs);
+    }
+    for (guint i = 0; i < samples->len; i++) {
+      EntryRef *ref = &g_array_index (samples, EntryRef, i);
+      WpLuaSampleEntry *e = ref->entry;
+      g_variant_builder_add (&sb, "(stt)", ref->location, e->n_samples,
+          e->time_us);
+    }
+  }
+
+  g_variant_builder_add (&b, "{sv}", "running",
+      g_variant_new_boolean (self && self->running));
+  g_variant_builder_add (&b, "{sv}", "sample-interval",
+      g_variant_new_uint32 (self ? self->sample_interval : 0));
+  g_variant_builder_add (&b, "{sv}", "handlers", g_variant_builder_end (&hb));
+  g_variant_builder_add (&b, "{sv}", "samples", g_variant_builder_end (&sb));
+  return g_variant_builder_end (&b);
+}
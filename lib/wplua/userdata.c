@@ -19,6 +19,47 @@ _wplua_pushgvalue_userdata (lua_State * L, GType type)
   return v;
 }
 
+void
+_wplua_init_interned (lua_State *L)
+{
+  /* maps instance pointers (light userdata) to the GValue userdata that
+     holds them; weak values, so that the cache does not keep them alive */
+  lua_newtable (L);
+  lua_newtable (L);
+  lua_pushliteral (L, "v");
+  lua_setfield (L, -2, "__mode");
+  lua_setmetatable (L, -2);
+  lua_setfield (L, LUA_REGISTRYINDEX, "wplua_interned");
+}
+
+gboolean
+_wplua_push_interned (lua_State *L, gpointer instance, GType type)
+{
+  lua_getfield (L, LUA_REGISTRYINDEX, "wplua_interned");
+  if (lua_rawgetp (L, -1, instance) == LUA_TUSERDATA) {
+    GValue *v = lua_touserdata (L, -1);
+
+    /* the userdata holds a reference, so the instance is still the same
+       one; just make sure it is also stored with the same type */
+    if (G_VALUE_TYPE (v) == type) {
+      lua_remove (L, -2);
+      return TRUE;
+    }
+  }
+  lua_pop (L, 2);
+  return FALSE;
+}
+
+void
+_wplua_intern (lua_State *L, int idx, gpointer instance)
+{
+  idx = lua_absindex (L, idx);
+  lua_getfield (L, LUA_REGISTRYINDEX, "wplua_interned");
+  lua_pushvalue (L, idx);
+  lua_rawsetp (L, -2, instance);
+  lua_pop (L, 1);
+}
+
 gboolean
 _wplua_isgvalue_userdata (lua_State *L, int idx, GType type)
 {
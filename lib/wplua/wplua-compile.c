@@ -0,0 +1,74 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Build-time helper that precompiles the Lua scripts that are embedded
+ * in gresource bundles, so that they do not need to be parsed at runtime.
+ * The chunk name is the basename of the input, which is the same name
+ * that wplua_load_uri() would have used to compile the source text.
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+static int
+writer (lua_State * L, const void * p, size_t sz, void * ud)
+{
+  g_byte_array_append ((GByteArray *) ud, p, sz);
+  return 0;
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GByteArray) data = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *name = NULL;
+  const gchar *buf;
+  gsize size = 0;
+  lua_State *L;
+  gint ret = 0;
+
+  if (argc != 3) {
+    g_printerr ("Usage: %s <input.lua> <output>\n", argv[0]);
+    return 1;
+  }
+
+  if (!g_file_get_contents (argv[1], &contents, &size, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 1;
+  }
+
+  /* skip shebang, if present */
+  buf = contents;
+  if (g_str_has_prefix (buf, "#!/")) {
+    const char *tmp = strchr (buf, '\n');
+    size -= (tmp - buf);
+    buf = tmp;
+  }
+
+  name = g_path_get_basename (argv[1]);
+  data = g_byte_array_new ();
+  L = luaL_newstate ();
+
+  if (luaL_loadbuffer (L, buf, size, name) != LUA_OK) {
+    g_printerr ("%s\n", lua_tostring (L, -1));
+    ret = 1;
+  } else if (lua_dump (L, writer, data, 0) != 0 ||
+      !g_file_set_contents (argv[2], (const gchar *) data->data, data->len,
+          &error)) {
+    g_printerr ("Failed to write '%s': %s\n", argv[2],
+        error ? error->message : "dump failed");
+    ret = 1;
+  }
+
+  lua_close (L);
+  return ret;
+}
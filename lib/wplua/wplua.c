@@ -12,6 +12,9 @@
 
 #define URI_SANDBOX "resource:///org/freedesktop/pipewire/wireplumber/wplua/sandbox.lua"
 
+#define DEFAULT_MAX_POOLED_SIZE 256
+#define DEFAULT_SLAB_SIZE (16 * 1024)
+
 extern void _wplua_register_resource (void);
 
 G_DEFINE_QUARK (wplua, wp_domain_lua);
@@ -76,11 +79,42 @@ _wplua_pcall (lua_State *L, int nargs, int nret)
   return ret;
 }
 
+static int
+_wplua_panic (lua_State *L)
+{
+  const gchar *msg = lua_tostring (L, -1);
+  wp_critical ("unprotected error in call to Lua API: %s",
+      msg ? msg : "(error object is not a string)");
+  return 0;
+}
+
 lua_State *
 wplua_new (void)
+{
+  return wplua_new_full (DEFAULT_MAX_POOLED_SIZE, DEFAULT_SLAB_SIZE);
+}
+
+/**
+ * wplua_new_full:
+ * @max_pooled_size: blocks up to this size are allocated from per-size-class
+ *   pools; 0 disables the pools
+ * @slab_size: the size of the chunks that the pools are allocated in; it is
+ *   rounded up to a power of two
+ *
+ * @brief Creates a new lua_State with the given allocator settings
+ */
+lua_State *
+wplua_new_full (gsize max_pooled_size, gsize slab_size)
 {
   static gboolean resource_registered = FALSE;
-  lua_State *L = luaL_newstate ();
+  gpointer pool = _wplua_pool_new (max_pooled_size, slab_size);
+  lua_State *L = lua_newstate (_wplua_pool_alloc, pool);
+
+  /* like g_malloc(), treat running out of memory as fatal */
+  if (G_UNLIKELY (!L))
+    g_error ("failed to allocate a lua_State");
+
+  lua_atpanic (L, _wplua_panic);
 
   wp_debug ("initializing lua_State %p", L);
 
@@ -89,7 +123,9 @@ wplua_new (void)
     resource_registered = TRUE;
   }
 
+  _wplua_init_gc (L);
   _wplua_openlibs (L);
+  _wplua_init_interned (L);
   _wplua_init_gboxed (L);
   _wplua_init_gobject (L);
   _wplua_init_closure (L);
@@ -107,8 +143,16 @@ wplua_new (void)
 void
 wplua_free (lua_State * L)
 {
+  gpointer gc = _wplua_gc_detach (L);
+  gpointer pool = NULL;
+
+  lua_getallocf (L, &pool);
+  wplua_profiler_stop (L);
+
   wp_debug ("closing lua_State %p", L);
   lua_close (L);
+  _wplua_gc_free (gc);
+  _wplua_pool_free (pool);
 }
 
 void
@@ -177,8 +221,13 @@ wplua_register_type_methods (lua_State * L, GType type,
 
 static gboolean
 _wplua_load_buffer (lua_State * L, const gchar *buf, gsize size,
-    const gchar * name, int nargs, int nres, GError **error)
+    const gchar * name, const gchar * cache_uri, int nargs, int nres,
+    GError **error)
 {
+  g_autofree gchar *cache_key = NULL;
+  WpLuaProfiler *profiler = *_wplua_closure_store_profiler (L);
+  WpLuaProfileFrame frame;
+  gboolean profiling = FALSE;
   int ret;
   int sandbox = 0;
   int args_top = lua_gettop (L);
@@ -196,6 +245,16 @@ _wplua_load_buffer (lua_State * L, const gchar *buf, gsize size,
     buf = tmp;
   }
 
+  /* precompiled chunks (ex. from gresource) are loaded as they are */
+  if (size > 0 && buf[0] == LUA_SIGNATURE[0])
+    cache_uri = NULL;
+
+  if (cache_uri) {
+    cache_key = _wplua_bytecode_cache_key (buf, size, name);
+    if (_wplua_bytecode_cache_load (L, cache_uri, cache_key, name))
+      goto loaded;
+  }
+
   ret = luaL_loadbuffer (L, buf, size, name);
   if (ret != LUA_OK) {
     g_set_error (error, WP_DOMAIN_LUA, WP_LUA_ERROR_COMPILATION,
@@ -204,10 +263,20 @@ _wplua_load_buffer (lua_State * L, const gchar *buf, gsize size,
     return FALSE;
   }
 
+  if (cache_key)
+    _wplua_bytecode_cache_store (L, cache_uri, cache_key);
+
+loaded:
+  if (profiler)
+    profiling = _wplua_profiler_enter (profiler, L, -1, &frame);
+
   /* push sandbox() and the chunk below the arguments */
   lua_rotate (L, args_top, -nargs);
 
   ret = _wplua_pcall (L, nargs + sandbox, nres);
+
+  if (profiling)
+    _wplua_profiler_leave (profiler, L, &frame);
   if (ret != LUA_OK) {
     g_set_error (error, WP_DOMAIN_LUA, WP_LUA_ERROR_RUNTIME,
         "Runtime error while loading '%s'", name);
@@ -227,7 +296,7 @@ wplua_load_buffer (lua_State * L, const gchar *buf, gsize size,
 
   g_autofree gchar *name =
       g_strdup_printf ("buffer@%p;size=%" G_GSIZE_FORMAT, buf, size);
-  return _wplua_load_buffer (L, buf, size, name, nargs, nres, error);
+  return _wplua_load_buffer (L, buf, size, name, NULL, nargs, nres, error);
 }
 
 gboolean
@@ -253,7 +322,13 @@ wplua_load_uri (lua_State * L, const gchar *uri, int nargs, int nres,
 
   name = g_path_get_basename (uri);
   data = g_bytes_get_data (bytes, &size);
-  return _wplua_load_buffer (L, data, size, name, nargs, nres, error);
+
+  /* only scripts read from the filesystem go through the bytecode cache;
+     embedded resources are precompiled at build time */
+  return _wplua_load_buffer (L, data, size, name,
+      (g_file_is_native (file) && !g_getenv ("WIREPLUMBER_NO_LUA_CACHE")) ?
+          uri : NULL,
+      nargs, nres, error);
 }
 
 gboolean
@@ -48,9 +48,67 @@ typedef enum {
   WP_LUA_SANDBOX_ISOLATE_ENV,
 } WpLuaSandboxFlags;
 
+/**
+ * WpLuaGcMode:
+ *
+ * @brief
+ * @em WP_LUA_GC_MODE_FULL: stop the collector while callbacks run and
+ *   perform a full collection after each callback
+ * @em WP_LUA_GC_MODE_INCREMENTAL: use the incremental collector and perform
+ *   additional steps from an idle source
+ * @em WP_LUA_GC_MODE_GENERATIONAL: use the generational collector, if
+ *   supported by the Lua version, and perform minor collections from an
+ *   idle source
+ */
+typedef enum {
+  WP_LUA_GC_MODE_FULL,
+  WP_LUA_GC_MODE_INCREMENTAL,
+  WP_LUA_GC_MODE_GENERATIONAL,
+} WpLuaGcMode;
+
+typedef struct {
+  guint64 time_us;        /* time spent in scheduled collection work */
+  guint64 n_steps;        /* number of steps performed from the idle source */
+  guint64 n_cycles;       /* number of completed collections */
+  gsize heap_size;        /* current size of the Lua heap, in bytes */
+  gsize peak_heap_size;   /* largest heap size observed, in bytes */
+} WpLuaGcStats;
+
+/* the largest block size that wplua_new_full() can serve from its pools */
+#define WPLUA_ALLOC_MAX_POOLED_SIZE 1024
+
+typedef struct {
+  gsize live_bytes;       /* bytes currently allocated by Lua */
+  gsize peak_live_bytes;  /* largest value that live_bytes has reached */
+  gsize pool_bytes;       /* bytes reserved by the small block pools */
+  guint64 n_allocs;       /* number of new blocks allocated */
+  guint64 n_frees;        /* number of blocks freed */
+} WpLuaAllocStats;
+
+typedef struct {
+  gsize block_size;       /* the size of the blocks in this class */
+  gsize n_used;           /* number of blocks in use */
+  gsize n_free;           /* number of blocks reserved but not in use */
+  guint64 n_allocs;       /* number of blocks handed out from this class */
+} WpLuaAllocClassStats;
+
 lua_State * wplua_new (void);
+lua_State * wplua_new_full (gsize max_pooled_size, gsize slab_size);
 void wplua_free (lua_State * L);
 
+void wplua_get_alloc_stats (lua_State *L, WpLuaAllocStats *stats);
+guint wplua_get_alloc_class_stats (lua_State *L, WpLuaAllocClassStats *stats,
+    guint n_stats);
+
+void wplua_set_gc_policy (lua_State *L, WpLuaGcMode mode, guint step_kb,
+    guint idle_budget_us);
+void wplua_get_gc_stats (lua_State *L, WpLuaGcStats *stats);
+
+void wplua_profiler_start (lua_State *L, guint sample_interval);
+void wplua_profiler_stop (lua_State *L);
+void wplua_profiler_reset (lua_State *L);
+GVariant * wplua_profiler_get_report (lua_State *L);
+
 void wplua_enable_sandbox (lua_State * L, WpLuaSandboxFlags flags);
 
 void wplua_register_type_methods (lua_State * L, GType type,
@@ -73,6 +131,7 @@ gboolean wplua_isboxed (lua_State *L, int idx, GType type);
 /* transfer floating */
 GClosure * wplua_checkclosure (lua_State *L, int idx);
 GClosure * wplua_function_to_closure (lua_State *L, int idx);
+GClosure * wplua_function_to_deferred_closure (lua_State *L, int idx);
 
 void wplua_enum_to_lua (lua_State *L, gint enum_val, GType enum_type);
 gint wplua_lua_to_enum (lua_State *L, int idx, GType enum_type);
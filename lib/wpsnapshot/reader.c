@@ -0,0 +1,189 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_ATTEMPTS 64
+
+struct wp_graph_snapshot_reader
+{
+  const struct wp_graph_snapshot_header *header;
+  size_t map_size;
+  size_t size;
+};
+
+static inline uint32_t
+load_generation (const struct wp_graph_snapshot_reader *reader)
+{
+  return __atomic_load_n (&reader->header->generation, __ATOMIC_ACQUIRE);
+}
+
+static inline int
+array_fits (const struct wp_graph_snapshot_header *header, uint32_t offset,
+    uint32_t n_items, size_t item_size)
+{
+  return offset >= sizeof (*header) && offset <= header->size &&
+      (uint64_t) n_items * item_size <= header->size - offset;
+}
+
+int
+wp_graph_snapshot_get_default_path (char *buf, size_t size)
+{
+  const char *dir = getenv ("XDG_RUNTIME_DIR");
+
+  /* unlike the GLib helpers, never fall back to a per-user directory that
+     is not private to the session */
+  if (!dir || dir[0] == '\0')
+    return -ENOENT;
+  if (snprintf (buf, size, "%s/%s", dir, WP_GRAPH_SNAPSHOT_DEFAULT_NAME)
+          >= (int) size)
+    return -ENAMETOOLONG;
+  return 0;
+}
+
+int
+wp_graph_snapshot_reader_open (const char *path,
+    struct wp_graph_snapshot_reader **reader)
+{
+  char default_path[PATH_MAX];
+  struct wp_graph_snapshot_reader *self;
+  const struct wp_graph_snapshot_header *header;
+  struct stat st;
+  void *data;
+  int fd, res;
+
+  if (!path) {
+    if ((res = wp_graph_snapshot_get_default_path (default_path,
+            sizeof (default_path))) < 0)
+      return res;
+    path = default_path;
+  }
+
+  if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -errno;
+
+  if (fstat (fd, &st) < 0) {
+    res = -errno;
+    close (fd);
+    return res;
+  }
+  if ((size_t) st.st_size < sizeof (struct wp_graph_snapshot_header)) {
+    close (fd);
+    return -EINVAL;
+  }
+
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  res = -errno;
+  close (fd);
+  if (data == MAP_FAILED)
+    return res;
+
+  /* the module fills the header before publishing the file and the layout
+     does not change afterwards */
+  header = data;
+  if (header->magic != WP_GRAPH_SNAPSHOT_MAGIC ||
+      header->version != WP_GRAPH_SNAPSHOT_VERSION ||
+      header->size > (size_t) st.st_size ||
+      !array_fits (header, header->nodes_offset, header->max_nodes,
+          sizeof (struct wp_graph_snapshot_node)) ||
+      !array_fits (header, header->devices_offset, header->max_devices,
+          sizeof (struct wp_graph_snapshot_device)) ||
+      !array_fits (header, header->links_offset, header->max_links,
+          sizeof (struct wp_graph_snapshot_link))) {
+    munmap (data, st.st_size);
+    return -EINVAL;
+  }
+
+  if (!(self = calloc (1, sizeof (*self)))) {
+    munmap (data, st.st_size);
+    return -ENOMEM;
+  }
+  self->header = header;
+  self->map_size = st.st_size;
+  self->size = header->size;
+  *reader = self;
+  return 0;
+}
+
+void
+wp_graph_snapshot_reader_close (struct wp_graph_snapshot_reader *reader)
+{
+  if (!reader)
+    return;
+  munmap ((void *) reader->header, reader->map_size);
+  free (reader);
+}
+
+uint32_t
+wp_graph_snapshot_reader_get_generation (
+    struct wp_graph_snapshot_reader *reader)
+{
+  return load_generation (reader);
+}
+
+int
+wp_graph_snapshot_reader_read (struct wp_graph_snapshot_reader *reader,
+    struct wp_graph_snapshot_header **snapshot)
+{
+  struct wp_graph_snapshot_header *copy;
+
+  if (!(copy = malloc (reader->size)))
+    return -ENOMEM;
+
+  for (int i = 0; i < MAX_ATTEMPTS; i++) {
+    uint32_t gen = load_generation (reader);
+
+    /* the writer is in the middle of an update */
+    if (gen & 1) {
+      sched_yield ();
+      continue;
+    }
+
+    memcpy (copy, reader->header, reader->size);
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+    if (load_generation (reader) != gen)
+      continue;
+
+    if (copy->flags & WP_GRAPH_SNAPSHOT_FLAG_CLOSED) {
+      free (copy);
+      return -ESTALE;
+    }
+
+    /* never let the accessors go beyond the copy */
+    if (copy->size != reader->size ||
+        copy->n_nodes > copy->max_nodes ||
+        copy->n_devices > copy->max_devices ||
+        copy->n_links > copy->max_links ||
+        !array_fits (copy, copy->nodes_offset, copy->max_nodes,
+            sizeof (struct wp_graph_snapshot_node)) ||
+        !array_fits (copy, copy->devices_offset, copy->max_devices,
+            sizeof (struct wp_graph_snapshot_device)) ||
+        !array_fits (copy, copy->links_offset, copy->max_links,
+            sizeof (struct wp_graph_snapshot_link))) {
+      free (copy);
+      return -EINVAL;
+    }
+
+    *snapshot = copy;
+    return 0;
+  }
+
+  free (copy);
+  return -EAGAIN;
+}
@@ -0,0 +1,170 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_GRAPH_SNAPSHOT_H__
+#define __WIREPLUMBER_GRAPH_SNAPSHOT_H__
+
+/*
+ * The graph snapshot is a compact, read-only view of the PipeWire graph
+ * (nodes, devices, links, default nodes and volumes) that the graph-snapshot
+ * module publishes in a shared memory file, so that monitoring tools can
+ * read it without connecting to PipeWire.
+ *
+ * The file starts with a wp_graph_snapshot_header, followed by the arrays of
+ * nodes, devices and links at the offsets that the header specifies. All
+ * strings are NUL-terminated and truncated to fit in their fields.
+ *
+ * The module rewrites the file in place. While it does so, the generation
+ * counter in the header is odd; readers must copy the data and check that
+ * the generation was even and did not change during the copy, retrying
+ * otherwise. The reader functions below implement this protocol.
+ *
+ * This header, and the reader, do not depend on GLib or PipeWire.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WP_GRAPH_SNAPSHOT_MAGIC 0x47535057 /* "WPSG" */
+#define WP_GRAPH_SNAPSHOT_VERSION 1
+
+/* the file name of the snapshot, in $XDG_RUNTIME_DIR */
+#define WP_GRAPH_SNAPSHOT_DEFAULT_NAME "wireplumber-graph-snapshot"
+
+#define WP_GRAPH_SNAPSHOT_NAME_LEN 128
+#define WP_GRAPH_SNAPSHOT_CLASS_LEN 64
+
+#define WP_GRAPH_SNAPSHOT_INVALID_ID 0xffffffffu
+
+enum {
+  /* some objects did not fit in the snapshot */
+  WP_GRAPH_SNAPSHOT_FLAG_TRUNCATED = (1 << 0),
+  /* the module has stopped; the data will not be updated anymore */
+  WP_GRAPH_SNAPSHOT_FLAG_CLOSED = (1 << 1),
+};
+
+enum {
+  WP_GRAPH_SNAPSHOT_DEFAULT_AUDIO_SINK = 0,
+  WP_GRAPH_SNAPSHOT_DEFAULT_AUDIO_SOURCE,
+  WP_GRAPH_SNAPSHOT_DEFAULT_VIDEO_SOURCE,
+  WP_GRAPH_SNAPSHOT_N_DEFAULTS,
+};
+
+enum {
+  /* the node has volume controls; volume and muted are valid */
+  WP_GRAPH_SNAPSHOT_NODE_HAS_VOLUME = (1 << 0),
+  WP_GRAPH_SNAPSHOT_NODE_MUTED = (1 << 1),
+};
+
+struct wp_graph_snapshot_header
+{
+  uint32_t magic;
+  uint32_t version;
+  /* incremented before and after every update; odd while updating */
+  uint32_t generation;
+  uint32_t flags;
+  /* the size of the whole snapshot, in bytes */
+  uint32_t size;
+
+  uint32_t nodes_offset;
+  uint32_t max_nodes;
+  uint32_t n_nodes;
+
+  uint32_t devices_offset;
+  uint32_t max_devices;
+  uint32_t n_devices;
+
+  uint32_t links_offset;
+  uint32_t max_links;
+  uint32_t n_links;
+
+  /* the ids of the default nodes, or WP_GRAPH_SNAPSHOT_INVALID_ID */
+  uint32_t default_nodes[WP_GRAPH_SNAPSHOT_N_DEFAULTS];
+  uint32_t padding;
+
+  /* the time of the last update, in CLOCK_MONOTONIC microseconds */
+  uint64_t update_time;
+};
+
+struct wp_graph_snapshot_node
+{
+  uint32_t id;
+  /* the id of the device of the node, or WP_GRAPH_SNAPSHOT_INVALID_ID */
+  uint32_t device_id;
+  /* a pw_node_state value */
+  int32_t state;
+  uint32_t flags;
+  /* the volume of the first channel, in the scale of the mixer-api module */
+  float volume;
+  uint32_t n_channels;
+  char name[WP_GRAPH_SNAPSHOT_NAME_LEN];
+  char description[WP_GRAPH_SNAPSHOT_NAME_LEN];
+  char media_class[WP_GRAPH_SNAPSHOT_CLASS_LEN];
+};
+
+struct wp_graph_snapshot_device
+{
+  uint32_t id;
+  uint32_t padding;
+  char name[WP_GRAPH_SNAPSHOT_NAME_LEN];
+  char description[WP_GRAPH_SNAPSHOT_NAME_LEN];
+  char media_class[WP_GRAPH_SNAPSHOT_CLASS_LEN];
+};
+
+struct wp_graph_snapshot_link
+{
+  uint32_t id;
+  uint32_t output_node;
+  uint32_t output_port;
+  uint32_t input_node;
+  uint32_t input_port;
+  uint32_t padding;
+};
+
+/* accessors for a snapshot that was returned by
+   wp_graph_snapshot_reader_read() */
+#define WP_GRAPH_SNAPSHOT_NODES(h) ((const struct wp_graph_snapshot_node *) \
+    ((const uint8_t *) (h) + (h)->nodes_offset))
+#define WP_GRAPH_SNAPSHOT_DEVICES(h) ((const struct wp_graph_snapshot_device *) \
+    ((const uint8_t *) (h) + (h)->devices_offset))
+#define WP_GRAPH_SNAPSHOT_LINKS(h) ((const struct wp_graph_snapshot_link *) \
+    ((const uint8_t *) (h) + (h)->links_offset))
+
+struct wp_graph_snapshot_reader;
+
+/* writes the default location of the snapshot, which both the module and
+   the reader use, into @buf; returns 0 on success, -ENOENT if
+   $XDG_RUNTIME_DIR is not set or -ENAMETOOLONG if @buf is too small */
+int wp_graph_snapshot_get_default_path (char *buf, size_t size);
+
+/* opens the snapshot at @path, or at the default location if @path is NULL;
+   returns 0 on success or a negative errno */
+int wp_graph_snapshot_reader_open (const char *path,
+    struct wp_graph_snapshot_reader **reader);
+
+void wp_graph_snapshot_reader_close (struct wp_graph_snapshot_reader *reader);
+
+/* returns the current generation; a cheap way to check for changes */
+uint32_t wp_graph_snapshot_reader_get_generation (
+    struct wp_graph_snapshot_reader *reader);
+
+/* copies a consistent snapshot into a newly allocated buffer, to be freed
+   with free(); returns 0 on success, -EAGAIN if the writer kept updating
+   during all the attempts, or -ESTALE if the module has stopped, in which
+   case the reader has to be reopened to see the data of its next instance */
+int wp_graph_snapshot_reader_read (struct wp_graph_snapshot_reader *reader,
+    struct wp_graph_snapshot_header **snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
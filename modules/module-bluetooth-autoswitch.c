@@ -0,0 +1,860 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Switches bluetooth headsets to a profile with an input route (such as HFP)
+ * while a communication stream is capturing audio and the default sink is a
+ * bluetooth device, and restores the previous profile a while after the last
+ * such stream has gone away. This is the native equivalent of
+ * policy-bluetooth.lua.
+ *
+ * The profile and route tables of each device are parsed only when the
+ * device params change; stream events just update a counter of active
+ * streams and look up profiles by index or name.
+ */
+
+#include <wp/wp.h>
+#include <pipewire/pipewire.h>
+#include <pipewire/keys.h>
+#include <spa/pod/iter.h>
+
+#define NAME "bluetooth-autoswitch"
+#define STATE_NAME "policy-bluetooth"
+#define SAVE_INTERVAL_MS 1000
+#define RESTORE_TIMEOUT_MS 2000
+
+enum {
+  PROP_0,
+  PROP_USE_PERSISTENT_STORAGE,
+  PROP_USE_HEADSET_PROFILE,
+  PROP_APPLICATIONS,
+  PROP_ACTIVE_STREAMS,
+};
+
+typedef struct _ProfileEntry ProfileEntry;
+struct _ProfileEntry
+{
+  gint index;
+  gint priority;
+  gchar *name;
+};
+
+/* A bluez device with its profile table, indexed by profile index and name,
+ * and the set of profiles that have an input route */
+typedef struct _DeviceEntry DeviceEntry;
+struct _DeviceEntry
+{
+  WpDevice *device;
+  gchar *name;
+  GArray *profiles;               /* ProfileEntry */
+  GHashTable *profiles_by_index;  /* index -> ProfileEntry, not owned */
+  GHashTable *profiles_by_name;   /* name -> ProfileEntry, not owned */
+  GHashTable *input_profiles;     /* indexes of profiles with input routes */
+  const ProfileEntry *best_input; /* highest priority one with input route */
+  gint current;                   /* index of the current profile, or -1 */
+  gchar *last_profile;            /* profile to restore; NULL if not switched */
+};
+
+typedef struct _StreamEntry StreamEntry;
+struct _StreamEntry
+{
+  gboolean communication;  /* it has the role or is one of the applications */
+  gboolean active;         /* it is counted in n_active */
+  gboolean seen;           /* it has been active before */
+};
+
+struct _WpBluetoothAutoswitch
+{
+  WpPlugin parent;
+
+  WpState *state;
+  WpProperties *headset_profiles;
+  WpTimer *save_timer;
+  WpTimer *restore_timer;
+
+  WpObjectManager *metadata_om;
+  WpObjectManager *devices_om;
+  WpObjectManager *streams_om;
+
+  GHashTable *devices;   /* WpDevice -> DeviceEntry */
+  GHashTable *streams;   /* WpNode -> StreamEntry */
+  guint n_active;
+  guint n_switched;
+  gboolean bluez_default_sink;
+
+  /* properties */
+  gboolean use_persistent_storage;
+  gboolean use_headset_profile;
+  GHashTable *applications;
+};
+
+G_DECLARE_FINAL_TYPE (WpBluetoothAutoswitch, wp_bluetooth_autoswitch,
+                      WP, BLUETOOTH_AUTOSWITCH, WpPlugin)
+G_DEFINE_TYPE (WpBluetoothAutoswitch, wp_bluetooth_autoswitch, WP_TYPE_PLUGIN)
+
+static void
+profile_entry_clear (ProfileEntry * profile)
+{
+  g_clear_pointer (&profile->name, g_free);
+}
+
+static DeviceEntry *
+device_entry_new (WpDevice * device)
+{
+  DeviceEntry *entry = g_slice_new0 (DeviceEntry);
+  const gchar *name = wp_pipewire_object_get_property (
+      WP_PIPEWIRE_OBJECT (device), PW_KEY_DEVICE_NAME);
+
+  entry->device = g_object_ref (device);
+  entry->name = g_strdup (name ? name : "");
+  entry->profiles = g_array_new (FALSE, FALSE, sizeof (ProfileEntry));
+  g_array_set_clear_func (entry->profiles,
+      (GDestroyNotify) profile_entry_clear);
+  entry->profiles_by_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+  entry->profiles_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+  entry->input_profiles = g_hash_table_new (g_direct_hash, g_direct_equal);
+  entry->current = -1;
+  return entry;
+}
+
+static void
+device_entry_free (DeviceEntry * entry)
+{
+  g_clear_object (&entry->device);
+  g_clear_pointer (&entry->name, g_free);
+  g_clear_pointer (&entry->profiles_by_index, g_hash_table_unref);
+  g_clear_pointer (&entry->profiles_by_name, g_hash_table_unref);
+  g_clear_pointer (&entry->profiles, g_array_unref);
+  g_clear_pointer (&entry->input_profiles, g_hash_table_unref);
+  g_clear_pointer (&entry->last_profile, g_free);
+  g_slice_free (DeviceEntry, entry);
+}
+
+static const ProfileEntry *
+device_entry_get_current (DeviceEntry * entry)
+{
+  return g_hash_table_lookup (entry->profiles_by_index,
+      GINT_TO_POINTER (entry->current));
+}
+
+static gboolean
+device_entry_has_input_route (DeviceEntry * entry,
+    const ProfileEntry * profile)
+{
+  return g_hash_table_contains (entry->input_profiles,
+      GINT_TO_POINTER (profile->index));
+}
+
+static void
+device_entry_update_best_input (DeviceEntry * entry)
+{
+  entry->best_input = NULL;
+
+  for (guint i = 0; i < entry->profiles->len; i++) {
+    const ProfileEntry *p = &g_array_index (entry->profiles, ProfileEntry, i);
+    if (device_entry_has_input_route (entry, p) &&
+        (!entry->best_input || entry->best_input->priority < p->priority))
+      entry->best_input = p;
+  }
+}
+
+static void
+device_entry_load_profiles (DeviceEntry * entry)
+{
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+
+  g_hash_table_remove_all (entry->profiles_by_index);
+  g_hash_table_remove_all (entry->profiles_by_name);
+  g_array_set_size (entry->profiles, 0);
+  entry->best_input = NULL;
+
+  it = wp_pipewire_object_enum_params_sync (
+      WP_PIPEWIRE_OBJECT (entry->device), "EnumProfile", NULL);
+  for (; it && wp_iterator_next (it, &item); g_value_unset (&item)) {
+    WpSpaPod *pod = g_value_get_boxed (&item);
+    ProfileEntry profile = { 0, };
+    const gchar *name = NULL;
+
+    if (!wp_spa_pod_get_object (pod, NULL,
+        "index", "i", &profile.index,
+        "name", "s", &name,
+        "priority", "?i", &profile.priority,
+        NULL))
+      continue;
+
+    profile.name = g_strdup (name);
+    g_array_append_val (entry->profiles, profile);
+  }
+
+  /* index the profiles only once the array does not grow anymore */
+  for (guint i = 0; i < entry->profiles->len; i++) {
+    ProfileEntry *p = &g_array_index (entry->profiles, ProfileEntry, i);
+    g_hash_table_insert (entry->profiles_by_index,
+        GINT_TO_POINTER (p->index), p);
+    g_hash_table_insert (entry->profiles_by_name, p->name, p);
+  }
+
+  device_entry_update_best_input (entry);
+}
+
+static void
+device_entry_load_routes (DeviceEntry * entry)
+{
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+
+  g_hash_table_remove_all (entry->input_profiles);
+
+  it = wp_pipewire_object_enum_params_sync (
+      WP_PIPEWIRE_OBJECT (entry->device), "EnumRoute", NULL);
+  for (; it && wp_iterator_next (it, &item); g_value_unset (&item)) {
+    WpSpaPod *pod = g_value_get_boxed (&item);
+    g_autoptr (WpSpaPod) profiles = NULL;
+    guint32 direction = SPA_DIRECTION_OUTPUT;
+    const struct spa_pod *arr;
+    gint32 *index;
+
+    if (!wp_spa_pod_get_object (pod, NULL,
+        "direction", "I", &direction,
+        "profiles", "?P", &profiles,
+        NULL))
+      continue;
+
+    if (direction != SPA_DIRECTION_INPUT || !profiles)
+      continue;
+
+    arr = wp_spa_pod_get_spa_pod (profiles);
+    if (!spa_pod_is_array (arr) ||
+        SPA_POD_ARRAY_VALUE_TYPE (arr) != SPA_TYPE_Int) {
+      wp_warning_object (entry->device, "invalid profiles in EnumRoute");
+      continue;
+    }
+
+    SPA_POD_ARRAY_FOREACH ((const struct spa_pod_array *) arr, index)
+      g_hash_table_add (entry->input_profiles, GINT_TO_POINTER (*index));
+  }
+
+  device_entry_update_best_input (entry);
+}
+
+static void
+device_entry_load_current (DeviceEntry * entry)
+{
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+
+  entry->current = -1;
+
+  it = wp_pipewire_object_enum_params_sync (
+      WP_PIPEWIRE_OBJECT (entry->device), "Profile", NULL);
+  for (; it && wp_iterator_next (it, &item); g_value_unset (&item)) {
+    WpSpaPod *pod = g_value_get_boxed (&item);
+    gint index = -1;
+
+    if (wp_spa_pod_get_object (pod, NULL, "index", "i", &index, NULL)) {
+      entry->current = index;
+      g_value_unset (&item);
+      break;
+    }
+  }
+}
+
+static void
+set_device_profile (WpBluetoothAutoswitch * self, DeviceEntry * entry,
+    const ProfileEntry * profile)
+{
+  const ProfileEntry *current = device_entry_get_current (entry);
+
+  wp_info_object (self, "setting profile of '%s' from: %s to: %s",
+      entry->name, current ? current->name : "(unknown)", profile->name);
+
+  wp_pipewire_object_set_param (WP_PIPEWIRE_OBJECT (entry->device),
+      "Profile", 0, wp_spa_pod_new_object (
+          "Spa:Pod:Object:Param:Profile", "Profile",
+          "index", "i", profile->index,
+          NULL));
+}
+
+static void
+timeout_save_callback (WpTimer * timer, WpBluetoothAutoswitch * self)
+{
+  g_autoptr (GError) error = NULL;
+
+  if (!wp_state_save (self->state, self->headset_profiles, &error))
+    wp_warning_object (self, "%s", error->message);
+}
+
+static void
+save_headset_profile (WpBluetoothAutoswitch * self, DeviceEntry * entry,
+    const gchar * profile_name)
+{
+  g_autofree gchar *key =
+      g_strdup_printf ("saved-headset-profile:%s", entry->name);
+
+  wp_properties_set (self->headset_profiles, key, profile_name);
+
+  /* coalesce consecutive changes into a single write */
+  if (self->use_persistent_storage && self->save_timer)
+    wp_timer_start (self->save_timer, SAVE_INTERVAL_MS);
+}
+
+static const ProfileEntry *
+get_saved_headset_profile (WpBluetoothAutoswitch * self, DeviceEntry * entry)
+{
+  g_autofree gchar *key =
+      g_strdup_printf ("saved-headset-profile:%s", entry->name);
+  const gchar *name = wp_properties_get (self->headset_profiles, key);
+
+  return name ? g_hash_table_lookup (entry->profiles_by_name, name) : NULL;
+}
+
+static void
+switch_profiles (WpBluetoothAutoswitch * self)
+{
+  GHashTableIter iter;
+  DeviceEntry *entry;
+
+  if (self->restore_timer)
+    wp_timer_stop (self->restore_timer);
+
+  /* nothing left to switch; this is the common case for repeated events */
+  if (self->n_switched == g_hash_table_size (self->devices))
+    return;
+
+  g_hash_table_iter_init (&iter, self->devices);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+    const ProfileEntry *current, *target;
+
+    if (entry->last_profile)
+      continue;
+
+    current = device_entry_get_current (entry);
+    if (!current) {
+      wp_debug_object (self, "current profile of '%s' is not known",
+          entry->name);
+      continue;
+    }
+
+    entry->last_profile = g_strdup (current->name);
+    self->n_switched++;
+
+    if (device_entry_has_input_route (entry, current)) {
+      wp_info_object (self, "current profile of '%s' has input route, "
+          "not switching", entry->name);
+      continue;
+    }
+
+    target = get_saved_headset_profile (self, entry);
+    if (!target)
+      target = entry->best_input;
+
+    if (target)
+      set_device_profile (self, entry, target);
+    else
+      wp_warning_object (self, "no profile with input route on '%s'",
+          entry->name);
+  }
+}
+
+static void
+restore_profiles (WpBluetoothAutoswitch * self)
+{
+  GHashTableIter iter;
+  DeviceEntry *entry;
+
+  g_hash_table_iter_init (&iter, self->devices);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+    g_autofree gchar *last_profile = g_steal_pointer (&entry->last_profile);
+    const ProfileEntry *current, *target;
+
+    if (!last_profile)
+      continue;
+
+    self->n_switched--;
+
+    /* remember the headset profile that was in use, in case the user
+       changed it while switched */
+    current = device_entry_get_current (entry);
+    if (current) {
+      wp_info_object (self, "setting saved headset profile to: %s",
+          current->name);
+      save_headset_profile (self, entry, current->name);
+    }
+
+    target = g_hash_table_lookup (entry->profiles_by_name, last_profile);
+    if (target)
+      set_device_profile (self, entry, target);
+    else
+      wp_warning_object (self, "failed to restore profile '%s' on '%s'",
+          last_profile, entry->name);
+  }
+}
+
+static void
+timeout_restore_callback (WpTimer * timer, WpBluetoothAutoswitch * self)
+{
+  restore_profiles (self);
+}
+
+static void
+trigger_restore_profiles (WpBluetoothAutoswitch * self)
+{
+  if (!self->restore_timer || wp_timer_is_pending (self->restore_timer) ||
+      self->n_active > 0 || self->n_switched == 0)
+    return;
+
+  wp_timer_start (self->restore_timer, RESTORE_TIMEOUT_MS);
+}
+
+static void
+stream_entry_free (StreamEntry * entry)
+{
+  g_slice_free (StreamEntry, entry);
+}
+
+static void
+stream_entry_update_communication (WpBluetoothAutoswitch * self,
+    StreamEntry * entry, WpNode * node)
+{
+  const gchar *role = wp_pipewire_object_get_property (
+      WP_PIPEWIRE_OBJECT (node), PW_KEY_MEDIA_ROLE);
+  const gchar *app_name = wp_pipewire_object_get_property (
+      WP_PIPEWIRE_OBJECT (node), PW_KEY_APP_NAME);
+
+  entry->communication = !g_strcmp0 (role, "Communication") ||
+      (app_name && g_hash_table_contains (self->applications, app_name));
+}
+
+static void
+handle_stream (WpBluetoothAutoswitch * self, WpNode * node)
+{
+  StreamEntry *entry = g_hash_table_lookup (self->streams, node);
+  gboolean active;
+
+  if (!self->use_headset_profile || !entry)
+    return;
+
+  /* If a stream we previously saw stops running, we consider it inactive,
+     because some applications (Teams) just cork input streams, but don't
+     close them */
+  active = entry->communication && self->bluez_default_sink &&
+      !(entry->seen && wp_node_get_state (node, NULL) != WP_NODE_STATE_RUNNING);
+
+  if (active) {
+    if (!entry->active)
+      self->n_active++;
+    entry->active = TRUE;
+    entry->seen = TRUE;
+    switch_profiles (self);
+  } else {
+    if (entry->active)
+      self->n_active--;
+    entry->active = FALSE;
+    trigger_restore_profiles (self);
+  }
+}
+
+static void
+handle_all_streams (WpBluetoothAutoswitch * self)
+{
+  GHashTableIter iter;
+  WpNode *node;
+
+  g_hash_table_iter_init (&iter, self->streams);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &node, NULL))
+    handle_stream (self, node);
+}
+
+static void
+on_stream_state_changed (WpNode * node, WpNodeState old_state,
+    WpNodeState new_state, WpBluetoothAutoswitch * self)
+{
+  handle_stream (self, node);
+}
+
+static void
+on_stream_properties_changed (WpNode * node, GParamSpec * spec,
+    WpBluetoothAutoswitch * self)
+{
+  StreamEntry *entry = g_hash_table_lookup (self->streams, node);
+
+  if (entry) {
+    stream_entry_update_communication (self, entry, node);
+    handle_stream (self, node);
+  }
+}
+
+static void
+on_stream_added (WpObjectManager * om, WpNode * node,
+    WpBluetoothAutoswitch * self)
+{
+  StreamEntry *entry = g_slice_new0 (StreamEntry);
+
+  stream_entry_update_communication (self, entry, node);
+  g_hash_table_insert (self->streams, node, entry);
+
+  g_signal_connect_object (node, "state-changed",
+      G_CALLBACK (on_stream_state_changed), self, 0);
+  g_signal_connect_object (node, "notify::properties",
+      G_CALLBACK (on_stream_properties_changed), self, 0);
+
+  handle_stream (self, node);
+}
+
+static void
+on_stream_removed (WpObjectManager * om, WpNode * node,
+    WpBluetoothAutoswitch * self)
+{
+  StreamEntry *entry = g_hash_table_lookup (self->streams, node);
+
+  if (!entry)
+    return;
+
+  g_signal_handlers_disconnect_by_data (node, self);
+  if (entry->active)
+    self->n_active--;
+  g_hash_table_remove (self->streams, node);
+
+  trigger_restore_profiles (self);
+}
+
+static void
+on_device_params_changed (WpPipewireObject * device, const gchar * param_name,
+    WpBluetoothAutoswitch * self)
+{
+  DeviceEntry *entry = g_hash_table_lookup (self->devices, device);
+
+  if (!entry)
+    return;
+
+  if (g_strcmp0 (param_name, "EnumProfile") == 0)
+    device_entry_load_profiles (entry);
+  else if (g_strcmp0 (param_name, "EnumRoute") == 0)
+    device_entry_load_routes (entry);
+  else if (g_strcmp0 (param_name, "Profile") == 0)
+    device_entry_load_current (entry);
+}
+
+static void
+on_device_added (WpObjectManager * om, WpDevice * device,
+    WpBluetoothAutoswitch * self)
+{
+  DeviceEntry *entry = device_entry_new (device);
+
+  g_hash_table_insert (self->devices, device, entry);
+  device_entry_load_profiles (entry);
+  device_entry_load_routes (entry);
+  device_entry_load_current (entry);
+
+  g_signal_connect_object (device, "params-changed",
+      G_CALLBACK (on_device_params_changed), self, 0);
+
+  handle_all_streams (self);
+}
+
+static void
+on_device_removed (WpObjectManager * om, WpDevice * device,
+    WpBluetoothAutoswitch * self)
+{
+  DeviceEntry *entry = g_hash_table_lookup (self->devices, device);
+
+  if (!entry)
+    return;
+
+  g_signal_handlers_disconnect_by_data (device, self);
+  if (entry->last_profile)
+    self->n_switched--;
+  g_hash_table_remove (self->devices, device);
+}
+
+static void
+update_default_sink (WpBluetoothAutoswitch * self, const gchar * value)
+{
+  self->bluez_default_sink =
+      value && g_strstr_len (value, -1, "bluez_output.") != NULL;
+
+  /* if a bluez sink is set as default, rescan for active input streams */
+  if (self->bluez_default_sink)
+    handle_all_streams (self);
+}
+
+static void
+on_metadata_changed (WpMetadata * m, guint32 subject, const gchar * key,
+    const gchar * type, const gchar * value, WpBluetoothAutoswitch * self)
+{
+  if (subject == 0 && !g_strcmp0 (key, "default.audio.sink"))
+    update_default_sink (self, value);
+}
+
+static void
+on_metadata_added (WpObjectManager * om, WpMetadata * metadata,
+    WpBluetoothAutoswitch * self)
+{
+  g_signal_connect_object (metadata, "changed",
+      G_CALLBACK (on_metadata_changed), self, 0);
+  update_default_sink (self,
+      wp_metadata_find (metadata, 0, "default.audio.sink", NULL));
+}
+
+static void
+on_metadata_removed (WpObjectManager * om, WpMetadata * metadata,
+    WpBluetoothAutoswitch * self)
+{
+  self->bluez_default_sink = FALSE;
+}
+
+static void
+wp_bluetooth_autoswitch_enable (WpPlugin * plugin, WpTransition * transition)
+{
+  WpBluetoothAutoswitch *self = WP_BLUETOOTH_AUTOSWITCH (plugin);
+  g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (plugin));
+
+  /* the save timer outlives a disable, so that the last change is flushed */
+  if (!self->save_timer)
+    self->save_timer = wp_timer_new (core,
+        (WpTimerFunc) timeout_save_callback, self, NULL);
+  self->restore_timer = wp_timer_new (core,
+      (WpTimerFunc) timeout_restore_callback, self, NULL);
+
+  self->metadata_om = wp_object_manager_new ();
+  wp_object_manager_add_interest (self->metadata_om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "metadata.name", "=s", "default",
+      NULL);
+  wp_object_manager_request_object_features (self->metadata_om,
+      WP_TYPE_METADATA, WP_OBJECT_FEATURES_ALL);
+  g_signal_connect_object (self->metadata_om, "object-added",
+      G_CALLBACK (on_metadata_added), self, 0);
+  g_signal_connect_object (self->metadata_om, "object-removed",
+      G_CALLBACK (on_metadata_removed), self, 0);
+  wp_core_install_object_manager (core, self->metadata_om);
+
+  self->devices_om = wp_object_manager_new ();
+  wp_object_manager_add_interest (self->devices_om, WP_TYPE_DEVICE,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_DEVICE_API, "=s", "bluez5",
+      NULL);
+  wp_object_manager_request_object_features (self->devices_om,
+      WP_TYPE_DEVICE, WP_PIPEWIRE_OBJECT_FEATURES_ALL);
+  g_signal_connect_object (self->devices_om, "object-added",
+      G_CALLBACK (on_device_added), self, 0);
+  g_signal_connect_object (self->devices_om, "object-removed",
+      G_CALLBACK (on_device_removed), self, 0);
+  wp_core_install_object_manager (core, self->devices_om);
+
+  /* streams are added and removed as their properties change */
+  self->streams_om = wp_object_manager_new ();
+  wp_object_manager_add_interest (self->streams_om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      PW_KEY_MEDIA_CLASS, "=s", "Stream/Input/Audio",
+      /* do not consider monitor streams */
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_STREAM_MONITOR, "!s", "true",
+      NULL);
+  wp_object_manager_request_object_features (self->streams_om,
+      WP_TYPE_NODE, WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  wp_object_manager_set_live (self->streams_om, TRUE);
+  g_signal_connect_object (self->streams_om, "object-added",
+      G_CALLBACK (on_stream_added), self, 0);
+  g_signal_connect_object (self->streams_om, "object-removed",
+      G_CALLBACK (on_stream_removed), self, 0);
+  wp_core_install_object_manager (core, self->streams_om);
+
+  wp_object_update_features (WP_OBJECT (self), WP_PLUGIN_FEATURE_ENABLED, 0);
+}
+
+static void
+wp_bluetooth_autoswitch_disable (WpPlugin * plugin)
+{
+  WpBluetoothAutoswitch *self = WP_BLUETOOTH_AUTOSWITCH (plugin);
+  GHashTableIter iter;
+  gpointer object;
+
+  if (self->restore_timer)
+    wp_timer_stop (self->restore_timer);
+  g_clear_pointer (&self->restore_timer, wp_timer_unref);
+
+  g_hash_table_iter_init (&iter, self->streams);
+  while (g_hash_table_iter_next (&iter, &object, NULL))
+    g_signal_handlers_disconnect_by_data (object, self);
+  g_hash_table_iter_init (&iter, self->devices);
+  while (g_hash_table_iter_next (&iter, &object, NULL))
+    g_signal_handlers_disconnect_by_data (object, self);
+
+  g_clear_object (&self->streams_om);
+  g_clear_object (&self->devices_om);
+  g_clear_object (&self->metadata_om);
+
+  g_hash_table_remove_all (self->streams);
+  g_hash_table_remove_all (self->devices);
+  self->n_active = 0;
+  self->n_switched = 0;
+  self->bluez_default_sink = FALSE;
+}
+
+static void
+wp_bluetooth_autoswitch_init (WpBluetoothAutoswitch * self)
+{
+  self->devices = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) device_entry_free);
+  self->streams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) stream_entry_free);
+  self->applications = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+}
+
+static void
+wp_bluetooth_autoswitch_constructed (GObject * object)
+{
+  WpBluetoothAutoswitch *self = WP_BLUETOOTH_AUTOSWITCH (object);
+
+  self->state = wp_state_new (STATE_NAME);
+  self->headset_profiles = self->use_persistent_storage ?
+      wp_state_load (self->state) : wp_properties_new_empty ();
+
+  G_OBJECT_CLASS (wp_bluetooth_autoswitch_parent_class)->constructed (object);
+}
+
+static void
+wp_bluetooth_autoswitch_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  WpBluetoothAutoswitch *self = WP_BLUETOOTH_AUTOSWITCH (object);
+
+  switch (property_id) {
+  case PROP_USE_PERSISTENT_STORAGE:
+    self->use_persistent_storage = g_value_get_boolean (value);
+    break;
+  case PROP_USE_HEADSET_PROFILE:
+    self->use_headset_profile = g_value_get_boolean (value);
+    break;
+  case PROP_APPLICATIONS: {
+    const gchar * const *apps = g_value_get_boxed (value);
+    g_hash_table_remove_all (self->applications);
+    for (; apps && *apps; apps++)
+      g_hash_table_add (self->applications, g_strdup (*apps));
+    break;
+  }
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+wp_bluetooth_autoswitch_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  WpBluetoothAutoswitch *self = WP_BLUETOOTH_AUTOSWITCH (object);
+
+  switch (property_id) {
+  case PROP_ACTIVE_STREAMS:
+    g_value_set_uint (value, self->n_active);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+wp_bluetooth_autoswitch_finalize (GObject * object)
+{
+  WpBluetoothAutoswitch *self = WP_BLUETOOTH_AUTOSWITCH (object);
+
+  /* flush the pending save */
+  if (self->save_timer) {
+    if (wp_timer_is_pending (self->save_timer)) {
+      wp_timer_stop (self->save_timer);
+      timeout_save_callback (self->save_timer, self);
+    }
+    g_clear_pointer (&self->save_timer, wp_timer_unref);
+  }
+
+  g_clear_pointer (&self->headset_profiles, wp_properties_unref);
+  g_clear_object (&self->state);
+  g_clear_pointer (&self->streams, g_hash_table_unref);
+  g_clear_pointer (&self->devices, g_hash_table_unref);
+  g_clear_pointer (&self->applications, g_hash_table_unref);
+
+  G_OBJECT_CLASS (wp_bluetooth_autoswitch_parent_class)->finalize (object);
+}
+
+static void
+wp_bluetooth_autoswitch_class_init (WpBluetoothAutoswitchClass * klass)
+{
+  GObjectClass *object_class = (GObjectClass *) klass;
+  WpPluginClass *plugin_class = (WpPluginClass *) klass;
+
+  object_class->constructed = wp_bluetooth_autoswitch_constructed;
+  object_class->finalize = wp_bluetooth_autoswitch_finalize;
+  object_class->set_property = wp_bluetooth_autoswitch_set_property;
+  object_class->get_property = wp_bluetooth_autoswitch_get_property;
+
+  plugin_class->enable = wp_bluetooth_autoswitch_enable;
+  plugin_class->disable = wp_bluetooth_autoswitch_disable;
+
+  g_object_class_install_property (object_class, PROP_USE_PERSISTENT_STORAGE,
+      g_param_spec_boolean ("use-persistent-storage", "use-persistent-storage",
+          "use-persistent-storage", FALSE,
+          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_USE_HEADSET_PROFILE,
+      g_param_spec_boolean ("use-headset-profile", "use-headset-profile",
+          "use-headset-profile", FALSE,
+          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_APPLICATIONS,
+      g_param_spec_boxed ("applications", "applications",
+          "applications", G_TYPE_STRV,
+          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_ACTIVE_STREAMS,
+      g_param_spec_uint ("active-streams", "active-streams",
+          "The number of communication streams that hold the headset profile",
+          0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+WP_PLUGIN_EXPORT gboolean
+wireplumber__module_init (WpCore * core, GVariant * args, GError ** error)
+{
+  gboolean use_persistent_storage = FALSE;
+  gboolean use_headset_profile = FALSE;
+  g_autoptr (GPtrArray) applications = g_ptr_array_new_with_free_func (g_free);
+
+  if (args) {
+    g_autoptr (GVariant) apps = NULL;
+
+    g_variant_lookup (args, "use-persistent-storage", "b",
+        &use_persistent_storage);
+    g_variant_lookup (args, "media-role.use-headset-profile", "b",
+        &use_headset_profile);
+
+    /* Lua lists arrive as dictionaries with the indexes as keys */
+    apps = g_variant_lookup_value (args, "media-role.applications",
+        G_VARIANT_TYPE_VARDICT);
+    if (apps) {
+      GVariantIter iter;
+      const gchar *key;
+      GVariant *value;
+
+      g_variant_iter_init (&iter, apps);
+      while (g_variant_iter_loop (&iter, "{&sv}", &key, &value)) {
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+          g_ptr_array_add (applications, g_variant_dup_string (value, NULL));
+      }
+    }
+  }
+  g_ptr_array_add (applications, NULL);
+
+  wp_plugin_register (g_object_new (wp_bluetooth_autoswitch_get_type (),
+          "name", NAME,
+          "core", core,
+          "use-persistent-storage", use_persistent_storage,
+          "use-headset-profile", use_headset_profile,
+          "applications", applications->pdata,
+          NULL));
+  return TRUE;
+}
@@ -29,6 +29,29 @@ enum {
   PROP_ECHO_CANCEL_SOURCE_NAME,
 };
 
+static const gchar * MEDIA_CLASSES[N_DEFAULT_NODES][5] = {
+  [AUDIO_SINK] = {
+    "Audio/Sink",
+    "Audio/Duplex",
+    NULL },
+  [AUDIO_SOURCE] = {
+    "Audio/Source",
+    "Audio/Source/Virtual",
+    "Audio/Duplex",
+    "Audio/Sink",
+    NULL },
+  [VIDEO_SOURCE] = {
+    "Video/Source",
+    "Video/Source/Virtual",
+    NULL },
+};
+
+static const WpDirection DIRECTION[N_DEFAULT_NODES] = {
+  [AUDIO_SINK] = WP_DIRECTION_INPUT,
+  [AUDIO_SOURCE] = WP_DIRECTION_OUTPUT,
+  [VIDEO_SOURCE] = WP_DIRECTION_OUTPUT,
+};
+
 typedef struct _WpDefaultNode WpDefaultNode;
 struct _WpDefaultNode
 {
@@ -36,6 +59,32 @@ struct _WpDefaultNode
   gchar *config_value;
 };
 
+/* A device, as far as default node selection is concerned. Entries are also
+ * created for devices that are referenced by nodes but not known yet */
+typedef struct _DeviceEntry DeviceEntry;
+struct _DeviceEntry
+{
+  WpDevice *device;
+  GPtrArray *nodes;      /* NodeEntry, not owned */
+  GHashTable *routes;    /* card.profile.device -> availability, cached */
+  gint total_nodes;      /* number of nodes of the profile; -1 if unknown */
+};
+
+/* A node and its position in the candidate set of each default node type.
+ * Nodes that are not eligible for a type are not part of its set */
+typedef struct _NodeEntry NodeEntry;
+struct _NodeEntry
+{
+  WpNode *node;
+  gchar *name;
+  gint device_id;
+  gint cpd;
+  guint64 seq;
+  gint priority[N_DEFAULT_NODES];
+  gint class_rank[N_DEFAULT_NODES];
+  GSequenceIter *iter[N_DEFAULT_NODES];
+};
+
 struct _WpDefaultNodes
 {
   WpPlugin parent;
@@ -46,6 +95,13 @@ struct _WpDefaultNodes
   WpObjectManager *rescan_om;
   GSource *timeout_source;
 
+  /* candidate nodes of each type, best first */
+  GSequence *candidates[N_DEFAULT_NODES];
+  GHashTable *nodes;          /* WpNode -> NodeEntry */
+  GHashTable *nodes_by_name;  /* node.name -> GPtrArray of NodeEntry */
+  GHashTable *devices;        /* device bound id -> DeviceEntry */
+  guint64 next_seq;
+
   /* properties */
   guint save_interval_ms;
   gboolean use_persistent_storage;
@@ -57,9 +113,25 @@ G_DECLARE_FINAL_TYPE (WpDefaultNodes, wp_default_nodes,
                       WP, DEFAULT_NODES, WpPlugin)
 G_DEFINE_TYPE (WpDefaultNodes, wp_default_nodes, WP_TYPE_PLUGIN)
 
+static void
+device_entry_free (DeviceEntry * entry)
+{
+  g_clear_object (&entry->device);
+  g_clear_pointer (&entry->nodes, g_ptr_array_unref);
+  g_clear_pointer (&entry->routes, g_hash_table_unref);
+  g_slice_free (DeviceEntry, entry);
+}
+
 static void
 wp_default_nodes_init (WpDefaultNodes * self)
 {
+  for (gint i = 0; i < N_DEFAULT_NODES; i++)
+    self->candidates[i] = g_sequence_new (NULL);
+  self->nodes = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->nodes_by_name = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) g_ptr_array_unref);
+  self->devices = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) device_entry_free);
 }
 
 static void
@@ -106,26 +178,10 @@ timer_start (WpDefaultNodes *self)
 }
 
 static gboolean
-node_has_available_routes (WpDefaultNodes * self, WpNode *node)
-{
-  const gchar *dev_id_str = wp_pipewire_object_get_property (
-          WP_PIPEWIRE_OBJECT (node), PW_KEY_DEVICE_ID);
-  const gchar *cpd_str = wp_pipewire_object_get_property (
-          WP_PIPEWIRE_OBJECT (node), "card.profile.device");
-  gint dev_id = dev_id_str ? atoi (dev_id_str) : -1;
-  gint cpd = cpd_str ? atoi (cpd_str) : -1;
-  g_autoptr (WpDevice) device = NULL;
+device_has_available_routes (WpDevice *device, gint cpd)
+{
   gint found = 0;
 
-  if (dev_id == -1 || cpd == -1)
-    return TRUE;
-
-  /* Get the device */
-  device = wp_object_manager_lookup (self->rescan_om, WP_TYPE_DEVICE,
-      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=i", dev_id, NULL);
-  if (!device)
-    return TRUE;
-
   /* Check if the current device route supports the node card device profile */
   {
     g_autoptr (WpIterator) routes = NULL;
@@ -192,6 +248,55 @@ node_has_available_routes (WpDefaultNodes * self, WpNode *node)
   return FALSE;
 }
 
+static DeviceEntry *
+ensure_device_entry (WpDefaultNodes * self, gint device_id)
+{
+  DeviceEntry *entry = g_hash_table_lookup (self->devices,
+      GINT_TO_POINTER (device_id));
+
+  if (!entry) {
+    entry = g_slice_new0 (DeviceEntry);
+    entry->nodes = g_ptr_array_new ();
+    entry->routes = g_hash_table_new (g_direct_hash, g_direct_equal);
+    entry->total_nodes = -1;
+    g_hash_table_insert (self->devices, GINT_TO_POINTER (device_id), entry);
+  }
+  return entry;
+}
+
+static void
+maybe_drop_device_entry (WpDefaultNodes * self, gint device_id)
+{
+  DeviceEntry *entry = g_hash_table_lookup (self->devices,
+      GINT_TO_POINTER (device_id));
+
+  if (entry && !entry->device && entry->nodes->len == 0)
+    g_hash_table_remove (self->devices, GINT_TO_POINTER (device_id));
+}
+
+static gboolean
+node_has_available_routes (WpDefaultNodes * self, NodeEntry *node)
+{
+  DeviceEntry *dev;
+  gpointer avail;
+
+  if (node->device_id == -1 || node->cpd == -1)
+    return TRUE;
+
+  dev = g_hash_table_lookup (self->devices, GINT_TO_POINTER (node->device_id));
+  if (!dev || !dev->device)
+    return TRUE;
+
+  /* the answer only changes when the device params change */
+  if (!g_hash_table_lookup_extended (dev->routes, GINT_TO_POINTER (node->cpd),
+          NULL, &avail)) {
+    avail = GINT_TO_POINTER (
+        device_has_available_routes (dev->device, node->cpd));
+    g_hash_table_insert (dev->routes, GINT_TO_POINTER (node->cpd), avail);
+  }
+  return GPOINTER_TO_INT (avail);
+}
+
 static gboolean
 is_echo_cancel_node (WpDefaultNodes * self, WpNode *node, WpDirection direction)
 {
@@ -207,109 +312,175 @@ is_echo_cancel_node (WpDefaultNodes * self, WpNode *node, WpDirection direction)
   return g_strcmp0 (name, self->echo_cancel_names[direction]) == 0;
 }
 
-static WpNode *
-find_best_media_class_node (WpDefaultNodes * self, const gchar *media_class,
-    const gchar *node_name, WpDirection direction, gint *priority)
+static gint
+compare_candidates (gint t, const NodeEntry *a, gint a_bonus,
+    const NodeEntry *b, gint b_bonus)
 {
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) val = G_VALUE_INIT;
-  gint highest_prio = 0;
-  WpNode *res = NULL;
+  gint a_prio = a->priority[t] + a_bonus;
+  gint b_prio = b->priority[t] + b_bonus;
+
+  /* highest priority first; then follow the order of the media classes
+   * and, finally, the order in which the nodes appeared */
+  if (a_prio != b_prio)
+    return a_prio > b_prio ? -1 : 1;
+  if (a->class_rank[t] != b->class_rank[t])
+    return a->class_rank[t] < b->class_rank[t] ? -1 : 1;
+  return (a->seq > b->seq) - (a->seq < b->seq);
+}
 
-  g_return_val_if_fail (media_class, NULL);
+static gint
+compare_candidates_func (gconstpointer a, gconstpointer b, gpointer data)
+{
+  return compare_candidates (GPOINTER_TO_INT (data), a, 0, b, 0);
+}
 
-  it = wp_object_manager_new_filtered_iterator (self->rescan_om, WP_TYPE_NODE,
-      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "=s", media_class,
-      NULL);
+static gint
+get_class_rank (gint node_t, const gchar *media_class)
+{
+  for (gint i = 0; media_class && MEDIA_CLASSES[node_t][i]; i++) {
+    if (g_strcmp0 (media_class, MEDIA_CLASSES[node_t][i]) == 0)
+      return i;
+  }
+  return -1;
+}
 
-  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
-    WpNode *node = g_value_get_object (&val);
-    gint n_ports = direction == WP_DIRECTION_INPUT ?
-        wp_node_get_n_input_ports (node, NULL) :
-        wp_node_get_n_output_ports (node, NULL);
-    if (n_ports > 0) {
-      const gchar *name = wp_pipewire_object_get_property (
-          WP_PIPEWIRE_OBJECT (node), PW_KEY_NODE_NAME);
-      const gchar *prio_str = wp_pipewire_object_get_property (
-          WP_PIPEWIRE_OBJECT (node), PW_KEY_PRIORITY_SESSION);
-      gint prio = prio_str ? atoi (prio_str) : -1;
-
-      if (!node_has_available_routes (self, node))
-        continue;
+static void
+unlink_node_entry (WpDefaultNodes * self, NodeEntry *entry)
+{
+  for (gint t = 0; t < N_DEFAULT_NODES; t++)
+    g_clear_pointer (&entry->iter[t], g_sequence_remove);
+
+  if (entry->name) {
+    GPtrArray *named = g_hash_table_lookup (self->nodes_by_name, entry->name);
+    if (named) {
+      g_ptr_array_remove_fast (named, entry);
+      if (named->len == 0)
+        g_hash_table_remove (self->nodes_by_name, entry->name);
+    }
+    g_clear_pointer (&entry->name, g_free);
+  }
 
-      if (self->auto_echo_cancel && is_echo_cancel_node (self, node, direction))
-        prio += 10000;
+  if (entry->device_id != -1) {
+    DeviceEntry *dev = g_hash_table_lookup (self->devices,
+        GINT_TO_POINTER (entry->device_id));
+    if (dev)
+      g_ptr_array_remove_fast (dev->nodes, entry);
+    maybe_drop_device_entry (self, entry->device_id);
+    entry->device_id = -1;
+  }
+}
 
-      if (name && node_name && g_strcmp0 (name, node_name) == 0)
-        prio += 20000;
+/* the node properties that affect the default node candidates */
+static const gchar * const node_watched_keys[] = {
+  PW_KEY_NODE_NAME,
+  PW_KEY_MEDIA_CLASS,
+  PW_KEY_PRIORITY_SESSION,
+  PW_KEY_DEVICE_ID,
+  "card.profile.device",
+};
 
-      if (prio > highest_prio || res == NULL) {
-        highest_prio = prio;
-        res = node;
-      }
+/* (re-)computes the eligibility and priority of a node for each default node
+ * type and moves it to the right position in the candidate sets */
+static void
+update_node_entry (WpDefaultNodes * self, NodeEntry *entry)
+{
+  WpPipewireObject *proxy = WP_PIPEWIRE_OBJECT (entry->node);
+  const gchar *name = wp_pipewire_object_get_property (proxy, PW_KEY_NODE_NAME);
+  const gchar *media_class =
+      wp_pipewire_object_get_property (proxy, PW_KEY_MEDIA_CLASS);
+  const gchar *prio_str =
+      wp_pipewire_object_get_property (proxy, PW_KEY_PRIORITY_SESSION);
+  const gchar *dev_id_str =
+      wp_pipewire_object_get_property (proxy, PW_KEY_DEVICE_ID);
+  const gchar *cpd_str =
+      wp_pipewire_object_get_property (proxy, "card.profile.device");
+  gint prio = prio_str ? atoi (prio_str) : -1;
+
+  unlink_node_entry (self, entry);
+
+  entry->device_id = dev_id_str ? atoi (dev_id_str) : -1;
+  entry->cpd = cpd_str ? atoi (cpd_str) : -1;
+  if (entry->device_id != -1)
+    g_ptr_array_add (ensure_device_entry (self, entry->device_id)->nodes,
+        entry);
+
+  if (name) {
+    GPtrArray *named = g_hash_table_lookup (self->nodes_by_name, name);
+    if (!named) {
+      named = g_ptr_array_new ();
+      g_hash_table_insert (self->nodes_by_name, g_strdup (name), named);
     }
+    g_ptr_array_add (named, entry);
+    entry->name = g_strdup (name);
   }
 
-  if (priority)
-    *priority = highest_prio;
-  return res;
-}
+  for (gint t = 0; t < N_DEFAULT_NODES; t++) {
+    gint n_ports = DIRECTION[t] == WP_DIRECTION_INPUT ?
+        wp_node_get_n_input_ports (entry->node, NULL) :
+        wp_node_get_n_output_ports (entry->node, NULL);
 
-static WpNode *
-find_best_media_classes_node (WpDefaultNodes * self,
-    const gchar **media_classes, const gchar *node_name, WpDirection direction)
-{
-  gint highest_prio = -1;
-  WpNode *res = NULL;
-  for (guint i = 0; media_classes[i]; i++) {
-    gint prio = -1;
-    WpNode *node = find_best_media_class_node (self, media_classes[i],
-        node_name, direction, &prio);
-    if (node && (!res || prio > highest_prio)) {
-      highest_prio = prio;
-      res = node;
-    }
+    entry->class_rank[t] = get_class_rank (t, media_class);
+    if (entry->class_rank[t] < 0 || n_ports <= 0)
+      continue;
+
+    if (!node_has_available_routes (self, entry))
+      continue;
+
+    entry->priority[t] = prio;
+    if (self->auto_echo_cancel &&
+        is_echo_cancel_node (self, entry->node, DIRECTION[t]))
+      entry->priority[t] += 10000;
+
+    entry->iter[t] = g_sequence_insert_sorted (self->candidates[t], entry,
+        compare_candidates_func, GINT_TO_POINTER (t));
   }
-  return res;
+}
+
+static void
+update_device_nodes (WpDefaultNodes * self, gint device_id)
+{
+  DeviceEntry *dev = g_hash_table_lookup (self->devices,
+      GINT_TO_POINTER (device_id));
+  g_autoptr (GPtrArray) nodes = NULL;
+
+  if (!dev)
+    return;
+
+  /* updating a node re-links it, so iterate over a copy */
+  nodes = g_ptr_array_copy (dev->nodes, NULL, NULL);
+  for (guint i = 0; i < nodes->len; i++)
+    update_node_entry (self, g_ptr_array_index (nodes, i));
 }
 
 static WpNode *
 find_best_node (WpDefaultNodes * self, gint node_t)
 {
   const gchar *name = self->defaults[node_t].config_value;
-
-  switch (node_t) {
-  case AUDIO_SINK: {
-    const gchar *media_classes[] = {
-        "Audio/Sink",
-        "Audio/Duplex",
-        NULL};
-    return find_best_media_classes_node (self, media_classes, name,
-        WP_DIRECTION_INPUT);
-  }
-  case AUDIO_SOURCE: {
-    const gchar *media_classes[] = {
-        "Audio/Source",
-        "Audio/Source/Virtual",
-        "Audio/Duplex",
-        "Audio/Sink",
-        NULL};
-    return find_best_media_classes_node (self, media_classes, name,
-        WP_DIRECTION_OUTPUT);
-  }
-  case VIDEO_SOURCE: {
-    const gchar *media_classes[] = {
-        "Video/Source",
-        "Video/Source/Virtual",
-        NULL};
-    return find_best_media_classes_node (self, media_classes, name,
-        WP_DIRECTION_OUTPUT);
-  }
-  default:
-    break;
+  GSequenceIter *begin = g_sequence_get_begin_iter (self->candidates[node_t]);
+  NodeEntry *best = NULL;
+  gint best_bonus = 0;
+  GPtrArray *named;
+
+  if (g_sequence_iter_is_end (begin))
+    return NULL;
+
+  best = g_sequence_get (begin);
+  if (name && g_strcmp0 (best->name, name) == 0)
+    best_bonus = 20000;
+
+  /* the configured node gets a priority bonus; since only nodes with that
+   * name are affected, the result is either one of them or the top node */
+  named = name ? g_hash_table_lookup (self->nodes_by_name, name) : NULL;
+  for (guint i = 0; named && i < named->len; i++) {
+    NodeEntry *entry = g_ptr_array_index (named, i);
+    if (entry->iter[node_t] &&
+        compare_candidates (node_t, entry, 20000, best, best_bonus) < 0) {
+      best = entry;
+      best_bonus = 20000;
+    }
   }
 
-  return NULL;
+  return best->node;
 }
 
 static void
@@ -404,41 +575,43 @@ get_device_total_nodes (WpPipewireObject * proxy)
 static gboolean
 nodes_ready (WpDefaultNodes * self)
 {
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) val = G_VALUE_INIT;
+  GHashTableIter iter;
+  gpointer value;
 
   /* Get the total number of nodes for each device and make sure they exist
    * and have at least 1 port */
-  it = wp_object_manager_new_filtered_iterator (self->rescan_om,
-      WP_TYPE_DEVICE, NULL);
-  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
-    WpPipewireObject *device = g_value_get_object (&val);
-    guint total_nodes = get_device_total_nodes (device);
-    if (total_nodes > 0) {
-      guint32 device_id = wp_proxy_get_bound_id (WP_PROXY (device));
-      g_autoptr (WpIterator) node_it = NULL;
-      g_auto (GValue) node_val = G_VALUE_INIT;
+  g_hash_table_iter_init (&iter, self->devices);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    DeviceEntry *dev = value;
+
+    if (!dev->device)
+      continue;
+
+    /* the profile only changes when the device params change */
+    if (dev->total_nodes < 0)
+      dev->total_nodes =
+          get_device_total_nodes (WP_PIPEWIRE_OBJECT (dev->device));
+
+    if (dev->total_nodes > 0) {
       guint ready_nodes = 0;
 
-      node_it = wp_object_manager_new_filtered_iterator (self->rescan_om,
-          WP_TYPE_NODE, WP_CONSTRAINT_TYPE_PW_PROPERTY,
-          PW_KEY_DEVICE_ID, "=i", device_id, NULL);
-      for (; wp_iterator_next (node_it, &node_val); g_value_unset (&node_val)) {
-        WpPipewireObject *node = g_value_get_object (&node_val);
+      for (guint i = 0; i < dev->nodes->len; i++) {
+        NodeEntry *entry = g_ptr_array_index (dev->nodes, i);
         g_autoptr (WpPort) port =
               wp_object_manager_lookup (self->rescan_om,
               WP_TYPE_PORT, WP_CONSTRAINT_TYPE_PW_PROPERTY,
-              PW_KEY_NODE_ID, "=u", wp_proxy_get_bound_id (WP_PROXY (node)),
+              PW_KEY_NODE_ID, "=u",
+              wp_proxy_get_bound_id (WP_PROXY (entry->node)),
               NULL);
         if (port)
           ready_nodes++;
       }
 
-      if (ready_nodes < total_nodes) {
+      if (ready_nodes < (guint) dev->total_nodes) {
         const gchar *device_name = wp_pipewire_object_get_property (
-            WP_PIPEWIRE_OBJECT (device), PW_KEY_DEVICE_NAME);
-        wp_debug_object (self, "device '%s' is not ready (%d/%d)", device_name,
-            ready_nodes, total_nodes);
+            WP_PIPEWIRE_OBJECT (dev->device), PW_KEY_DEVICE_NAME);
+        wp_debug_object (self, "device '%s' is not ready (%u/%d)", device_name,
+            ready_nodes, dev->total_nodes);
         return FALSE;
       }
     }
@@ -549,17 +722,135 @@ on_metadata_changed (WpMetadata *m, guint32 subject,
   }
 }
 
+static void
+on_node_changed (WpNode *node, GParamSpec *pspec, WpDefaultNodes * self)
+{
+  NodeEntry *entry = g_hash_table_lookup (self->nodes, node);
+  if (entry)
+    update_node_entry (self, entry);
+}
+
+static void
+on_node_property_changed (WpNode *node, const gchar *key, const gchar *value,
+    WpDefaultNodes * self)
+{
+  NodeEntry *entry = g_hash_table_lookup (self->nodes, node);
+  if (entry)
+    update_node_entry (self, entry);
+}
+
+static void
+on_device_params_changed (WpDevice *device, const gchar *id,
+    WpDefaultNodes * self)
+{
+  guint32 device_id = wp_proxy_get_bound_id (WP_PROXY (device));
+  DeviceEntry *dev = g_hash_table_lookup (self->devices,
+      GINT_TO_POINTER (device_id));
+
+  if (dev) {
+    g_hash_table_remove_all (dev->routes);
+    dev->total_nodes = -1;
+    update_device_nodes (self, device_id);
+  }
+
+  schedule_rescan (self);
+}
+
 static void
 on_object_added (WpObjectManager *om, WpPipewireObject *proxy, gpointer d)
 {
   WpDefaultNodes * self = WP_DEFAULT_NODES (d);
 
   if (WP_IS_DEVICE (proxy)) {
+    guint32 device_id = wp_proxy_get_bound_id (WP_PROXY (proxy));
+    DeviceEntry *dev = ensure_device_entry (self, device_id);
+
+    g_set_object (&dev->device, WP_DEVICE (proxy));
+    g_hash_table_remove_all (dev->routes);
+    dev->total_nodes = -1;
+    update_device_nodes (self, device_id);
+
     g_signal_connect_object (proxy, "params-changed",
-        G_CALLBACK (schedule_rescan), self, G_CONNECT_SWAPPED);
+        G_CALLBACK (on_device_params_changed), self, 0);
+  }
+  else if (WP_IS_NODE (proxy)) {
+    NodeEntry *entry = g_slice_new0 (NodeEntry);
+
+    entry->node = g_object_ref (WP_NODE (proxy));
+    entry->device_id = -1;
+    entry->seq = self->next_seq++;
+    g_hash_table_insert (self->nodes, entry->node, entry);
+    update_node_entry (self, entry);
+
+    /* only the properties that update_node_entry() looks at */
+    for (guint i = 0; i < G_N_ELEMENTS (node_watched_keys); i++) {
+      g_autofree gchar *signal =
+          g_strconcat ("properties-changed::", node_watched_keys[i], NULL);
+      g_signal_connect_object (proxy, signal,
+          G_CALLBACK (on_node_property_changed), self, 0);
+    }
+    g_signal_connect_object (proxy, "notify::n-input-ports",
+        G_CALLBACK (on_node_changed), self, 0);
+    g_signal_connect_object (proxy, "notify::n-output-ports",
+        G_CALLBACK (on_node_changed), self, 0);
+  }
+}
+
+static void
+remove_node_entry (WpDefaultNodes * self, NodeEntry * entry)
+{
+  g_signal_handlers_disconnect_by_data (entry->node, self);
+  unlink_node_entry (self, entry);
+  g_hash_table_remove (self->nodes, entry->node);
+  g_object_unref (entry->node);
+  g_slice_free (NodeEntry, entry);
+}
+
+static void
+on_object_removed (WpObjectManager *om, WpPipewireObject *proxy, gpointer d)
+{
+  WpDefaultNodes * self = WP_DEFAULT_NODES (d);
+
+  if (WP_IS_DEVICE (proxy)) {
+    guint32 device_id = wp_proxy_get_bound_id (WP_PROXY (proxy));
+    DeviceEntry *dev = g_hash_table_lookup (self->devices,
+        GINT_TO_POINTER (device_id));
+
+    g_signal_handlers_disconnect_by_data (proxy, self);
+    if (dev && dev->device == WP_DEVICE (proxy)) {
+      g_clear_object (&dev->device);
+      g_hash_table_remove_all (dev->routes);
+      dev->total_nodes = -1;
+      update_device_nodes (self, device_id);
+      maybe_drop_device_entry (self, device_id);
+    }
+  }
+  else if (WP_IS_NODE (proxy)) {
+    NodeEntry *entry = g_hash_table_lookup (self->nodes, proxy);
+    if (entry)
+      remove_node_entry (self, entry);
   }
 }
 
+static void
+clear_candidates (WpDefaultNodes * self)
+{
+  g_autoptr (GList) nodes = g_hash_table_get_values (self->nodes);
+  GHashTableIter iter;
+  gpointer value;
+
+  for (GList *l = nodes; l; l = g_list_next (l))
+    remove_node_entry (self, l->data);
+
+  g_hash_table_iter_init (&iter, self->devices);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    DeviceEntry *dev = value;
+    if (dev->device)
+      g_signal_handlers_disconnect_by_data (dev->device, self);
+  }
+  g_hash_table_remove_all (self->devices);
+}
+
 static void
 on_metadata_added (WpObjectManager *om, WpMetadata *metadata, gpointer d)
 {
@@ -595,6 +886,8 @@ on_metadata_added (WpObjectManager *om, WpMetadata *metadata, gpointer d)
       G_CALLBACK (schedule_rescan), self, G_CONNECT_SWAPPED);
   g_signal_connect_object (self->rescan_om, "object-added",
       G_CALLBACK (on_object_added), self, 0);
+  g_signal_connect_object (self->rescan_om, "object-removed",
+      G_CALLBACK (on_object_removed), self, 0);
   wp_core_install_object_manager (core, self->rescan_om);
 }
 
@@ -642,6 +935,7 @@ wp_default_nodes_disable (WpPlugin * plugin)
   g_clear_object (&self->metadata_om);
   g_clear_object (&self->rescan_om);
   g_clear_object (&self->state);
+  clear_candidates (self);
 }
 
 static void
@@ -682,6 +976,13 @@ wp_default_nodes_finalize (GObject * object)
   g_clear_pointer (&self->echo_cancel_names[WP_DIRECTION_INPUT], g_free);
   g_clear_pointer (&self->echo_cancel_names[WP_DIRECTION_OUTPUT], g_free);
 
+  clear_candidates (self);
+  for (gint i = 0; i < N_DEFAULT_NODES; i++)
+    g_clear_pointer (&self->candidates[i], g_sequence_free);
+  g_clear_pointer (&self->nodes, g_hash_table_unref);
+  g_clear_pointer (&self->nodes_by_name, g_hash_table_unref);
+  g_clear_pointer (&self->devices, g_hash_table_unref);
+
   G_OBJECT_CLASS (wp_default_nodes_parent_class)->finalize (object);
 }
 
@@ -0,0 +1,577 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <wp/wp.h>
+#include <pipewire/pipewire.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+/*
+ * The graph snapshot module keeps a copy of the objects that WirePlumber
+ * already tracks in a shared memory file (see snapshot.h), so that
+ * monitoring tools can read the state of the graph with a memory copy
+ * instead of connecting to PipeWire and binding all the globals.
+ *
+ * The file has a fixed size, which is computed from the maximum number of
+ * nodes, devices and links that it can hold. It is created with a temporary
+ * name, initialized and then renamed into place, so that readers never see
+ * a partially initialized header. Changes are coalesced and the file is
+ * rewritten once per main loop iteration at most.
+ */
+
+#define NAME "graph-snapshot"
+#define DEFAULT_MAX_NODES 256
+#define DEFAULT_MAX_DEVICES 64
+#define DEFAULT_MAX_LINKS 512
+
+#define ALIGN8(x) (((x) + 7) & ~((gsize) 7))
+
+static const gchar * DEFAULT_NODE_CLASSES[WP_GRAPH_SNAPSHOT_N_DEFAULTS] = {
+  [WP_GRAPH_SNAPSHOT_DEFAULT_AUDIO_SINK] = "Audio/Sink",
+  [WP_GRAPH_SNAPSHOT_DEFAULT_AUDIO_SOURCE] = "Audio/Source",
+  [WP_GRAPH_SNAPSHOT_DEFAULT_VIDEO_SOURCE] = "Video/Source",
+};
+
+struct _WpGraphSnapshot
+{
+  WpPlugin parent;
+
+  /* properties */
+  gchar *path;
+  guint max_nodes;
+  guint max_devices;
+  guint max_links;
+
+  struct wp_graph_snapshot_header *header;
+  gsize size;
+  ino_t inode;
+
+  WpObjectManager *om;
+  WpPlugin *mixer_api;
+  WpPlugin *default_nodes_api;
+  GSource *update_source;
+};
+
+enum {
+  PROP_0,
+  PROP_PATH,
+  PROP_MAX_NODES,
+  PROP_MAX_DEVICES,
+  PROP_MAX_LINKS,
+};
+
+G_DECLARE_FINAL_TYPE (WpGraphSnapshot, wp_graph_snapshot, WP, GRAPH_SNAPSHOT,
+    WpPlugin)
+G_DEFINE_TYPE (WpGraphSnapshot, wp_graph_snapshot, WP_TYPE_PLUGIN)
+
+static void
+wp_graph_snapshot_init (WpGraphSnapshot * self)
+{
+}
+
+static void
+copy_string (gchar * dest, gsize size, const gchar * str)
+{
+  g_strlcpy (dest, str ? str : "", size);
+}
+
+static guint32
+parse_id (const gchar * str)
+{
+  return str ? (guint32) g_ascii_strtoull (str, NULL, 10) :
+      WP_GRAPH_SNAPSHOT_INVALID_ID;
+}
+
+/* seqlock: the generation is odd while the data is being written */
+static void
+begin_update (struct wp_graph_snapshot_header * h)
+{
+  g_atomic_int_inc ((gint *) &h->generation);
+}
+
+static void
+end_update (struct wp_graph_snapshot_header * h)
+{
+  h->update_time = g_get_monotonic_time ();
+  g_atomic_int_inc ((gint *) &h->generation);
+}
+
+static gboolean
+create_snapshot (WpGraphSnapshot * self, GError ** error)
+{
+  g_autofree gchar *tmp_path = g_strdup_printf ("%s.XXXXXX", self->path);
+  struct wp_graph_snapshot_header *h;
+  gsize nodes_offset, devices_offset, links_offset, size;
+  struct stat st;
+  gpointer data;
+  int fd;
+
+  nodes_offset = ALIGN8 (sizeof (struct wp_graph_snapshot_header));
+  devices_offset = ALIGN8 (nodes_offset +
+      self->max_nodes * sizeof (struct wp_graph_snapshot_node));
+  links_offset = ALIGN8 (devices_offset +
+      self->max_devices * sizeof (struct wp_graph_snapshot_device));
+  size = ALIGN8 (links_offset +
+      self->max_links * sizeof (struct wp_graph_snapshot_link));
+
+  if (size > G_MAXUINT32) {
+    g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT,
+        "graph snapshot of %" G_GSIZE_FORMAT " bytes is too large", size);
+    return FALSE;
+  }
+
+  fd = g_mkstemp_full (tmp_path, O_RDWR | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
+        "failed to create '%s': %s", tmp_path, g_strerror (errno));
+    return FALSE;
+  }
+
+  if (ftruncate (fd, size) < 0 || fstat (fd, &st) < 0 ||
+      (data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))
+          == MAP_FAILED) {
+    g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
+        "failed to map '%s': %s", tmp_path, g_strerror (errno));
+    close (fd);
+    g_unlink (tmp_path);
+    return FALSE;
+  }
+  close (fd);
+
+  h = data;
+  h->magic = WP_GRAPH_SNAPSHOT_MAGIC;
+  h->version = WP_GRAPH_SNAPSHOT_VERSION;
+  h->size = size;
+  h->nodes_offset = nodes_offset;
+  h->max_nodes = self->max_nodes;
+  h->devices_offset = devices_offset;
+  h->max_devices = self->max_devices;
+  h->links_offset = links_offset;
+  h->max_links = self->max_links;
+  for (guint i = 0; i < WP_GRAPH_SNAPSHOT_N_DEFAULTS; i++)
+    h->default_nodes[i] = WP_GRAPH_SNAPSHOT_INVALID_ID;
+
+  /* publish the file only after the header is complete */
+  if (g_rename (tmp_path, self->path) < 0) {
+    g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
+        "failed to rename '%s' to '%s': %s", tmp_path, self->path,
+        g_strerror (errno));
+    munmap (data, size);
+    g_unlink (tmp_path);
+    return FALSE;
+  }
+
+  self->header = h;
+  self->size = size;
+  self->inode = st.st_ino;
+  return TRUE;
+}
+
+static void
+destroy_snapshot (WpGraphSnapshot * self)
+{
+  struct stat st;
+
+  if (!self->header)
+    return;
+
+  /* tell the readers that have it mapped to reopen it */
+  begin_update (self->header);
+  self->header->flags |= WP_GRAPH_SNAPSHOT_FLAG_CLOSED;
+  end_update (self->header);
+
+  /* unless another instance has replaced it already */
+  if (g_stat (self->path, &st) == 0 && st.st_ino == self->inode)
+    g_unlink (self->path);
+
+  munmap (self->header, self->size);
+  self->header = NULL;
+}
+
+static void
+fill_node (WpGraphSnapshot * self, struct wp_graph_snapshot_node * entry,
+    WpNode * node)
+{
+  WpPipewireObject *pwobj = WP_PIPEWIRE_OBJECT (node);
+  const gchar *desc;
+
+  entry->id = wp_proxy_get_bound_id (WP_PROXY (node));
+  entry->device_id =
+      parse_id (wp_pipewire_object_get_property (pwobj, PW_KEY_DEVICE_ID));
+  entry->state = wp_node_get_state (node, NULL);
+
+  desc = wp_pipewire_object_get_property (pwobj, PW_KEY_NODE_DESCRIPTION);
+  if (!desc)
+    desc = wp_pipewire_object_get_property (pwobj, PW_KEY_NODE_NICK);
+
+  copy_string (entry->name, sizeof (entry->name),
+      wp_pipewire_object_get_property (pwobj, PW_KEY_NODE_NAME));
+  copy_string (entry->description, sizeof (entry->description), desc);
+  copy_string (entry->media_class, sizeof (entry->media_class),
+      wp_pipewire_object_get_property (pwobj, PW_KEY_MEDIA_CLASS));
+
+  if (self->mixer_api) {
+    g_autoptr (GVariant) v = NULL;
+    g_autoptr (GVariant) channels = NULL;
+    gdouble volume = 0.0;
+    gboolean mute = FALSE;
+
+    g_signal_emit_by_name (self->mixer_api, "get-volume", entry->id, &v);
+    if (v && g_variant_lookup (v, "volume", "d", &volume)) {
+      entry->flags |= WP_GRAPH_SNAPSHOT_NODE_HAS_VOLUME;
+      entry->volume = volume;
+      if (g_variant_lookup (v, "mute", "b", &mute) && mute)
+        entry->flags |= WP_GRAPH_SNAPSHOT_NODE_MUTED;
+      channels = g_variant_lookup_value (v, "channelVolumes",
+          G_VARIANT_TYPE_VARDICT);
+      entry->n_channels = channels ? g_variant_n_children (channels) : 0;
+    }
+  }
+}
+
+static void
+fill_device (WpGraphSnapshot * self, struct wp_graph_snapshot_device * entry,
+    WpDevice * device)
+{
+  WpPipewireObject *pwobj = WP_PIPEWIRE_OBJECT (device);
+
+  entry->id = wp_proxy_get_bound_id (WP_PROXY (device));
+  copy_string (entry->name, sizeof (entry->name),
+      wp_pipewire_object_get_property (pwobj, PW_KEY_DEVICE_NAME));
+  copy_string (entry->description, sizeof (entry->description),
+      wp_pipewire_object_get_property (pwobj, PW_KEY_DEVICE_DESCRIPTION));
+  copy_string (entry->media_class, sizeof (entry->media_class),
+      wp_pipewire_object_get_property (pwobj, PW_KEY_MEDIA_CLASS));
+}
+
+static void
+fill_link (WpGraphSnapshot * self, struct wp_graph_snapshot_link * entry,
+    WpLink * link)
+{
+  entry->id = wp_proxy_get_bound_id (WP_PROXY (link));
+  wp_link_get_linked_object_ids (link, &entry->output_node,
+      &entry->output_port, &entry->input_node, &entry->input_port);
+}
+
+/* fills in the entries of the objects of @type; returns FALSE if some
+   did not fit */
+static gboolean
+fill_entries (WpGraphSnapshot * self, GType type, guint8 * entries,
+    gsize entry_size, guint32 max, guint32 * n)
+{
+  g_autoptr (WpIterator) it =
+      wp_object_manager_new_filtered_iterator (self->om, type, NULL);
+  g_auto (GValue) val = G_VALUE_INIT;
+  gboolean complete = TRUE;
+
+  *n = 0;
+  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
+    gpointer obj = g_value_get_object (&val);
+    gpointer entry = entries + (gsize) *n * entry_size;
+
+    if (*n == max) {
+      complete = FALSE;
+      continue;
+    }
+
+    memset (entry, 0, entry_size);
+    if (type == WP_TYPE_NODE)
+      fill_node (self, entry, obj);
+    else if (type == WP_TYPE_DEVICE)
+      fill_device (self, entry, obj);
+    else
+      fill_link (self, entry, obj);
+    (*n)++;
+  }
+  return complete;
+}
+
+static void schedule_update (WpGraphSnapshot * self);
+
+/* the api plugins may be loaded after this module; look them up until
+   they are found */
+static void
+find_plugin (WpGraphSnapshot * self, const gchar * name, WpPlugin ** plugin)
+{
+  g_autoptr (WpCore) core = NULL;
+
+  if (*plugin)
+    return;
+
+  core = wp_object_get_core (WP_OBJECT (self));
+  if ((*plugin = wp_plugin_find (core, name))) {
+    g_signal_connect_object (*plugin, "changed",
+        G_CALLBACK (schedule_update), self, G_CONNECT_SWAPPED);
+  }
+}
+
+static gboolean
+update_snapshot (WpGraphSnapshot * self)
+{
+  struct wp_graph_snapshot_header *h = self->header;
+  gboolean complete = TRUE;
+
+  g_clear_pointer (&self->update_source, g_source_unref);
+
+  find_plugin (self, "mixer-api", &self->mixer_api);
+  find_plugin (self, "default-nodes-api", &self->default_nodes_api);
+
+  begin_update (h);
+
+  complete &= fill_entries (self, WP_TYPE_NODE, (guint8 *) h + h->nodes_offset,
+      sizeof (struct wp_graph_snapshot_node), h->max_nodes, &h->n_nodes);
+  complete &= fill_entries (self, WP_TYPE_DEVICE,
+      (guint8 *) h + h->devices_offset,
+      sizeof (struct wp_graph_snapshot_device), h->max_devices, &h->n_devices);
+  complete &= fill_entries (self, WP_TYPE_LINK, (guint8 *) h + h->links_offset,
+      sizeof (struct wp_graph_snapshot_link), h->max_links, &h->n_links);
+
+  for (guint i = 0; i < WP_GRAPH_SNAPSHOT_N_DEFAULTS; i++) {
+    guint32 id = WP_GRAPH_SNAPSHOT_INVALID_ID;
+    if (self->default_nodes_api)
+      g_signal_emit_by_name (self->default_nodes_api, "get-default-node",
+          DEFAULT_NODE_CLASSES[i], &id);
+    h->default_nodes[i] = id;
+  }
+
+  if (complete)
+    h->flags &= ~WP_GRAPH_SNAPSHOT_FLAG_TRUNCATED;
+  else
+    h->flags |= WP_GRAPH_SNAPSHOT_FLAG_TRUNCATED;
+
+  end_update (h);
+
+  if (!complete)
+    wp_info_object (self, "the graph does not fit in the snapshot; "
+        "consider raising max-nodes, max-devices or max-links");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_update (WpGraphSnapshot * self)
+{
+  g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (self));
+
+  if (self->update_source || !self->header)
+    return;
+
+  wp_core_idle_add (core, &self->update_source, G_SOURCE_FUNC (update_snapshot),
+      self, NULL);
+}
+
+static void
+on_object_added (WpObjectManager * om, GObject * obj, WpGraphSnapshot * self)
+{
+  g_signal_connect_object (obj, "notify::properties",
+      G_CALLBACK (schedule_update), self, G_CONNECT_SWAPPED);
+  if (WP_IS_NODE (obj))
+    g_signal_connect_object (obj, "state-changed",
+        G_CALLBACK (schedule_update), self, G_CONNECT_SWAPPED);
+}
+
+static void
+on_om_installed (WpObjectManager * om, WpGraphSnapshot * self)
+{
+  update_snapshot (self);
+  wp_object_update_features (WP_OBJECT (self), WP_PLUGIN_FEATURE_ENABLED, 0);
+}
+
+static void
+wp_graph_snapshot_enable (WpPlugin * plugin, WpTransition * transition)
+{
+  WpGraphSnapshot *self = WP_GRAPH_SNAPSHOT (plugin);
+  g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (plugin));
+  g_autoptr (GError) error = NULL;
+
+  if (!self->path) {
+    wp_transition_return_error (transition, g_error_new (WP_DOMAIN_LIBRARY,
+            WP_LIBRARY_ERROR_OPERATION_FAILED,
+            "no snapshot path was given and XDG_RUNTIME_DIR is not set"));
+    return;
+  }
+
+  if (!create_snapshot (self, &error)) {
+    wp_transition_return_error (transition, g_steal_pointer (&error));
+    return;
+  }
+
+  self->om = wp_object_manager_new ();
+  wp_object_manager_add_interest (self->om, WP_TYPE_NODE, NULL);
+  wp_object_manager_add_interest (self->om, WP_TYPE_DEVICE, NULL);
+  wp_object_manager_add_interest (self->om, WP_TYPE_LINK, NULL);
+  wp_object_manager_request_object_features (self->om,
+      WP_TYPE_GLOBAL_PROXY, WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  g_signal_connect_object (self->om, "object-added",
+      G_CALLBACK (on_object_added), self, 0);
+  g_signal_connect_object (self->om, "objects-changed",
+      G_CALLBACK (schedule_update), self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->om, "installed",
+      G_CALLBACK (on_om_installed), self, 0);
+  wp_core_install_object_manager (core, self->om);
+
+  wp_info_object (self, "publishing the graph snapshot in '%s'", self->path);
+}
+
+static void
+wp_graph_snapshot_disable (WpPlugin * plugin)
+{
+  WpGraphSnapshot *self = WP_GRAPH_SNAPSHOT (plugin);
+
+  if (self->update_source)
+    g_source_destroy (self->update_source);
+  g_clear_pointer (&self->update_source, g_source_unref);
+
+  if (self->mixer_api)
+    g_signal_handlers_disconnect_by_data (self->mixer_api, self);
+  if (self->default_nodes_api)
+    g_signal_handlers_disconnect_by_data (self->default_nodes_api, self);
+  g_clear_object (&self->mixer_api);
+  g_clear_object (&self->default_nodes_api);
+  g_clear_object (&self->om);
+
+  destroy_snapshot (self);
+}
+
+static void
+wp_graph_snapshot_finalize (GObject * object)
+{
+  WpGraphSnapshot *self = WP_GRAPH_SNAPSHOT (object);
+
+  g_clear_pointer (&self->path, g_free);
+
+  G_OBJECT_CLASS (wp_graph_snapshot_parent_class)->finalize (object);
+}
+
+static void
+wp_graph_snapshot_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  WpGraphSnapshot *self = WP_GRAPH_SNAPSHOT (object);
+
+  switch (property_id) {
+  case PROP_PATH:
+    g_clear_pointer (&self->path, g_free);
+    self->path = g_value_dup_string (value);
+    if (!self->path) {
+      /* the same location that the reader library looks in */
+      gchar path[PATH_MAX];
+      if (wp_graph_snapshot_get_default_path (path, sizeof (path)) == 0)
+        self->path = g_strdup (path);
+    }
+    break;
+  case PROP_MAX_NODES:
+    self->max_nodes = g_value_get_uint (value);
+    break;
+  case PROP_MAX_DEVICES:
+    self->max_devices = g_value_get_uint (value);
+    break;
+  case PROP_MAX_LINKS:
+    self->max_links = g_value_get_uint (value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+wp_graph_snapshot_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  WpGraphSnapshot *self = WP_GRAPH_SNAPSHOT (object);
+
+  switch (property_id) {
+  case PROP_PATH:
+    g_value_set_string (value, self->path);
+    break;
+  case PROP_MAX_NODES:
+    g_value_set_uint (value, self->max_nodes);
+    break;
+  case PROP_MAX_DEVICES:
+    g_value_set_uint (value, self->max_devices);
+    break;
+  case PROP_MAX_LINKS:
+    g_value_set_uint (value, self->max_links);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+wp_graph_snapshot_class_init (WpGraphSnapshotClass * klass)
+{
+  GObjectClass *object_class = (GObjectClass *) klass;
+  WpPluginClass *plugin_class = (WpPluginClass *) klass;
+
+  object_class->finalize = wp_graph_snapshot_finalize;
+  object_class->set_property = wp_graph_snapshot_set_property;
+  object_class->get_property = wp_graph_snapshot_get_property;
+
+  plugin_class->enable = wp_graph_snapshot_enable;
+  plugin_class->disable = wp_graph_snapshot_disable;
+
+  g_object_class_install_property (object_class, PROP_PATH,
+      g_param_spec_string ("path", "path",
+          "The path of the snapshot file", NULL,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_MAX_NODES,
+      g_param_spec_uint ("max-nodes", "max-nodes",
+          "The maximum number of nodes in the snapshot", 0, 65536,
+          DEFAULT_MAX_NODES,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_MAX_DEVICES,
+      g_param_spec_uint ("max-devices", "max-devices",
+          "The maximum number of devices in the snapshot", 0, 65536,
+          DEFAULT_MAX_DEVICES,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_MAX_LINKS,
+      g_param_spec_uint ("max-links", "max-links",
+          "The maximum number of links in the snapshot", 0, 65536,
+          DEFAULT_MAX_LINKS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+}
+
+WP_PLUGIN_EXPORT gboolean
+wireplumber__module_init (WpCore * core, GVariant * args, GError ** error)
+{
+  const gchar *path = NULL;
+  gint64 max_nodes = DEFAULT_MAX_NODES;
+  gint64 max_devices = DEFAULT_MAX_DEVICES;
+  gint64 max_links = DEFAULT_MAX_LINKS;
+
+  if (args) {
+    g_variant_lookup (args, "path", "&s", &path);
+    g_variant_lookup (args, "max-nodes", "x", &max_nodes);
+    g_variant_lookup (args, "max-devices", "x", &max_devices);
+    g_variant_lookup (args, "max-links", "x", &max_links);
+  }
+
+  wp_plugin_register (g_object_new (wp_graph_snapshot_get_type (),
+          "name", NAME,
+          "core", core,
+          "path", path,
+          "max-nodes", (guint) CLAMP (max_nodes, 0, 65536),
+          "max-devices", (guint) CLAMP (max_devices, 0, 65536),
+          "max-links", (guint) CLAMP (max_links, 0, 65536),
+          NULL));
+  return TRUE;
+}
@@ -21,6 +21,7 @@ struct _WpLuaScriptingPlugin
   GArray *scripts;
   WpCore *export_core;
   lua_State *L;
+  WpImplMetadata *profiler_metadata;
 };
 
 struct ScriptData
@@ -47,6 +48,78 @@ execute_script (lua_State *L, struct ScriptData * s, GError ** error)
   return wplua_load_path (L, s->filename, nargs, 0, error);
 }
 
+static lua_State *
+new_lua_state (WpCore * core)
+{
+  g_autoptr (WpProperties) p = wp_core_get_properties (core);
+  const gchar *str;
+  gsize max_pooled_size = 256;
+  gsize slab_size = 16 * 1024;
+
+  if ((str = wp_properties_get (p, "wireplumber.lua-alloc.max-pooled-size")))
+    max_pooled_size = (gsize) g_ascii_strtoull (str, NULL, 10);
+  if ((str = wp_properties_get (p, "wireplumber.lua-alloc.slab-size")))
+    slab_size = (gsize) g_ascii_strtoull (str, NULL, 10);
+
+  return wplua_new_full (max_pooled_size, slab_size);
+}
+
+static void
+log_lua_stats (lua_State *L)
+{
+  WpLuaGcStats gc;
+  WpLuaAllocStats alloc;
+  WpLuaAllocClassStats classes[WPLUA_ALLOC_MAX_POOLED_SIZE / 16];
+  guint n_classes;
+
+  wplua_get_gc_stats (L, &gc);
+  wp_debug ("lua GC: %" G_GUINT64_FORMAT " us in %"
+      G_GUINT64_FORMAT " steps, %" G_GUINT64_FORMAT " cycles, heap: %"
+      G_GSIZE_FORMAT " bytes (peak %" G_GSIZE_FORMAT ")", gc.time_us,
+      gc.n_steps, gc.n_cycles, gc.heap_size, gc.peak_heap_size);
+
+  wplua_get_alloc_stats (L, &alloc);
+  wp_debug ("lua memory: %" G_GSIZE_FORMAT " bytes live (peak %"
+      G_GSIZE_FORMAT "), %" G_GSIZE_FORMAT " bytes in pools, %"
+      G_GUINT64_FORMAT " allocations, %" G_GUINT64_FORMAT " frees",
+      alloc.live_bytes, alloc.peak_live_bytes, alloc.pool_bytes,
+      alloc.n_allocs, alloc.n_frees);
+
+  n_classes = wplua_get_alloc_class_stats (L, classes,
+      G_N_ELEMENTS (classes));
+  for (guint i = 0; i < MIN (n_classes, G_N_ELEMENTS (classes)); i++) {
+    wp_trace ("  %4" G_GSIZE_FORMAT " bytes: %" G_GSIZE_FORMAT
+        " used, %" G_GSIZE_FORMAT " free, %" G_GUINT64_FORMAT " allocations",
+        classes[i].block_size, classes[i].n_used, classes[i].n_free,
+        classes[i].n_allocs);
+  }
+}
+
+static void
+configure_gc (lua_State *L, WpCore * core)
+{
+  g_autoptr (WpProperties) p = wp_core_get_properties (core);
+  const gchar *str;
+  WpLuaGcMode mode = WP_LUA_GC_MODE_INCREMENTAL;
+  guint step_kb = 0;
+  guint idle_budget_us = 1000;
+
+  str = wp_properties_get (p, "wireplumber.lua-gc.mode");
+  if (!g_strcmp0 (str, "full"))
+    mode = WP_LUA_GC_MODE_FULL;
+  else if (!g_strcmp0 (str, "generational"))
+    mode = WP_LUA_GC_MODE_GENERATIONAL;
+  else if (str && g_strcmp0 (str, "incremental") != 0)
+    wp_warning_object (core, "unknown wireplumber.lua-gc.mode '%s'", str);
+
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.step-kb")))
+    step_kb = (guint) g_ascii_strtoull (str, NULL, 10);
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.idle-budget-us")))
+    idle_budget_us = (guint) g_ascii_strtoull (str, NULL, 10);
+
+  wplua_set_gc_policy (L, mode, step_kb, idle_budget_us);
+}
+
 G_DECLARE_FINAL_TYPE (WpLuaScriptingPlugin, wp_lua_scripting_plugin,
                       WP, LUA_SCRIPTING_PLUGIN, WpComponentLoader)
 G_DEFINE_TYPE (WpLuaScriptingPlugin, wp_lua_scripting_plugin,
@@ -69,6 +142,157 @@ wp_lua_scripting_plugin_finalize (GObject * object)
   G_OBJECT_CLASS (wp_lua_scripting_plugin_parent_class)->finalize (object);
 }
 
+/* the builder has no 64-bit integer values */
+static void
+builder_add_uint64 (WpSpaJsonBuilder * b, const gchar * key, guint64 value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  g_autoptr (WpSpaJson) json = NULL;
+
+  g_snprintf (buf, sizeof (buf), "%" G_GUINT64_FORMAT, value);
+  json = wp_spa_json_new_from_string (buf);
+  wp_spa_json_builder_add_property (b, key);
+  wp_spa_json_builder_add_json (b, json);
+}
+
+static WpSpaJson *
+profiler_report_to_json (GVariant * report)
+{
+  g_autoptr (WpSpaJsonBuilder) b = wp_spa_json_builder_new_object ();
+  g_autoptr (WpSpaJsonBuilder) handlers_b = wp_spa_json_builder_new_array ();
+  g_autoptr (WpSpaJsonBuilder) samples_b = wp_spa_json_builder_new_array ();
+  g_autoptr (WpSpaJson) handlers_json = NULL;
+  g_autoptr (WpSpaJson) samples_json = NULL;
+  g_autoptr (GVariantIter) handlers = NULL;
+  g_autoptr (GVariantIter) samples = NULL;
+  gboolean running = FALSE;
+  guint32 sample_interval = 0;
+  const gchar *location;
+  guint64 calls, total_us, max_us, allocs, n_samples, time_us;
+
+  g_variant_lookup (report, "running", "b", &running);
+  g_variant_lookup (report, "sample-interval", "u", &sample_interval);
+  g_variant_lookup (report, "handlers", "a(stttt)", &handlers);
+  g_variant_lookup (report, "samples", "a(stt)", &samples);
+
+  while (handlers && g_variant_iter_next (handlers, "(&stttt)", &location,
+              &calls, &total_us, &max_us, &allocs)) {
+    g_autoptr (WpSpaJsonBuilder) h = wp_spa_json_builder_new_object ();
+    g_autoptr (WpSpaJson) json = NULL;
+
+    wp_spa_json_builder_add_property (h, "location");
+    wp_spa_json_builder_add_string (h, location);
+    builder_add_uint64 (h, "calls", calls);
+    builder_add_uint64 (h, "total-us", total_us);
+    builder_add_uint64 (h, "max-us", max_us);
+    builder_add_uint64 (h, "allocs", allocs);
+    json = wp_spa_json_builder_end (h);
+    wp_spa_json_builder_add_json (handlers_b, json);
+  }
+
+  while (samples && g_variant_iter_next (samples, "(&stt)", &location,
+              &n_samples, &time_us)) {
+    g_autoptr (WpSpaJsonBuilder) s = wp_spa_json_builder_new_object ();
+    g_autoptr (WpSpaJson) json = NULL;
+
+    wp_spa_json_builder_add_property (s, "location");
+    wp_spa_json_builder_add_string (s, location);
+    builder_add_uint64 (s, "samples", n_samples);
+    builder_add_uint64 (s, "time-us", time_us);
+    json = wp_spa_json_builder_end (s);
+    wp_spa_json_builder_add_json (samples_b, json);
+  }
+
+  handlers_json = wp_spa_json_builder_end (handlers_b);
+  samples_json = wp_spa_json_builder_end (samples_b);
+
+  wp_spa_json_builder_add_property (b, "running");
+  wp_spa_json_builder_add_boolean (b, running);
+  builder_add_uint64 (b, "sample-interval", sample_interval);
+  wp_spa_json_builder_add_property (b, "handlers");
+  wp_spa_json_builder_add_json (b, handlers_json);
+  wp_spa_json_builder_add_property (b, "samples");
+  wp_spa_json_builder_add_json (b, samples_json);
+  return wp_spa_json_builder_end (b);
+}
+
+/* The "lua-profiler" metadata object controls the profiler of the engine.
+   Clients write a command to the "command" key: "start", "start <N>" to
+   also sample every N Lua instructions, "stop", "reset" or "report". After
+   executing it, the report is written to the "report" key, as JSON. */
+static void
+on_profiler_command (WpMetadata * m, guint32 subject, const gchar * key,
+    const gchar * type, const gchar * value, WpLuaScriptingPlugin * self)
+{
+  g_autoptr (GVariant) report = NULL;
+  g_autoptr (WpSpaJson) json = NULL;
+
+  if (subject != 0 || g_strcmp0 (key, "command") != 0 || !value || !self->L)
+    return;
+
+  wp_debug_object (self, "lua profiler command: %s", value);
+
+  if (!g_strcmp0 (value, "start"))
+    wplua_profiler_start (self->L, 0);
+  else if (g_str_has_prefix (value, "start "))
+    wplua_profiler_start (self->L,
+        (guint) g_ascii_strtoull (value + sizeof ("start ") - 1, NULL, 10));
+  else if (!g_strcmp0 (value, "stop"))
+    wplua_profiler_stop (self->L);
+  else if (!g_strcmp0 (value, "reset"))
+    wplua_profiler_reset (self->L);
+  else if (g_strcmp0 (value, "report") != 0) {
+    wp_notice_object (self, "unknown lua profiler command '%s'", value);
+    return;
+  }
+
+  report = g_variant_ref_sink (wplua_profiler_get_report (self->L));
+  json = profiler_report_to_json (report);
+  wp_metadata_set (m, 0, "report", "Spa:String:JSON",
+      wp_spa_json_get_data (json));
+}
+
+static void
+on_profiler_metadata_activated (WpObject * m, GAsyncResult * res,
+    WpLuaScriptingPlugin * self)
+{
+  g_autoptr (GError) error = NULL;
+
+  if (!wp_object_activate_finish (m, res, &error)) {
+    wp_warning_object (self, "failed to export the lua-profiler metadata: %s",
+        error->message);
+    if (self->profiler_metadata == (WpImplMetadata *) m)
+      g_clear_object (&self->profiler_metadata);
+  }
+  g_object_unref (self);
+}
+
+static void
+setup_profiler (WpLuaScriptingPlugin * self, WpCore * core)
+{
+  g_autoptr (WpProperties) p = wp_core_get_properties (core);
+  const gchar *str;
+
+  if (g_strcmp0 (wp_properties_get (p, "wireplumber.daemon"), "true") != 0)
+    return;
+
+  str = wp_properties_get (p, "wireplumber.lua-profiler.start");
+  if (str && !g_strcmp0 (str, "true")) {
+    str = wp_properties_get (p, "wireplumber.lua-profiler.sample-interval");
+    wplua_profiler_start (self->L,
+        str ? (guint) g_ascii_strtoull (str, NULL, 10) : 0);
+  }
+
+  self->profiler_metadata =
+      wp_impl_metadata_new_full (core, "lua-profiler", NULL);
+  g_signal_connect_object (self->profiler_metadata, "changed",
+      G_CALLBACK (on_profiler_command), self, 0);
+  wp_object_activate (WP_OBJECT (self->profiler_metadata),
+      WP_OBJECT_FEATURES_ALL, NULL,
+      (GAsyncReadyCallback) on_profiler_metadata_activated,
+      g_object_ref (self));
+}
+
 static void
 wp_lua_scripting_plugin_enable (WpPlugin * plugin, WpTransition * transition)
 {
@@ -82,7 +306,8 @@ wp_lua_scripting_plugin_enable (WpPlugin * plugin, WpTransition * transition)
     g_object_ref (self->export_core);
 
   /* init lua engine */
-  self->L = wplua_new ();
+  self->L = new_lua_state (core);
+  configure_gc (self->L, core);
 
   lua_pushliteral (self->L, "wireplumber_core");
   lua_pushlightuserdata (self->L, core);
@@ -94,6 +319,7 @@ wp_lua_scripting_plugin_enable (WpPlugin * plugin, WpTransition * transition)
 
   wp_lua_scripting_api_init (self->L);
   wplua_enable_sandbox (self->L, WP_LUA_SANDBOX_ISOLATE_ENV);
+  setup_profiler (self, core);
 
   /* execute scripts that were queued in for loading */
   for (guint i = 0; i < self->scripts->len; i++) {
@@ -113,6 +339,10 @@ wp_lua_scripting_plugin_disable (WpPlugin * plugin)
 {
   WpLuaScriptingPlugin * self = WP_LUA_SCRIPTING_PLUGIN (plugin);
 
+  g_clear_object (&self->profiler_metadata);
+  if (self->L)
+    log_lua_stats (self->L);
+
   g_clear_pointer (&self->L, wplua_free);
   g_clear_object (&self->export_core);
 }
@@ -112,6 +112,51 @@ static const luaL_Reg source_methods[] = {
   { NULL, NULL }
 };
 
+/* WpTimer */
+
+static int
+timer_new (lua_State *L)
+{
+  luaL_checktype (L, 1, LUA_TFUNCTION);
+  wplua_pushboxed (L, WP_TYPE_TIMER, wp_timer_new_closure (get_wp_core (L),
+          wplua_function_to_closure (L, 1)));
+  return 1;
+}
+
+static int
+timer_start (lua_State *L)
+{
+  WpTimer *timer = wplua_checkboxed (L, 1, WP_TYPE_TIMER);
+  lua_Integer timeout_ms = luaL_checkinteger (L, 2);
+  luaL_argcheck (L, timeout_ms >= 0 && timeout_ms <= G_MAXUINT, 2,
+      "timeout out of range");
+  wp_timer_start (timer, timeout_ms);
+  return 0;
+}
+
+static int
+timer_stop (lua_State *L)
+{
+  WpTimer *timer = wplua_checkboxed (L, 1, WP_TYPE_TIMER);
+  wp_timer_stop (timer);
+  return 0;
+}
+
+static int
+timer_is_pending (lua_State *L)
+{
+  WpTimer *timer = wplua_checkboxed (L, 1, WP_TYPE_TIMER);
+  lua_pushboolean (L, wp_timer_is_pending (timer));
+  return 1;
+}
+
+static const luaL_Reg timer_methods[] = {
+  { "start", timer_start },
+  { "stop", timer_stop },
+  { "is_pending", timer_is_pending },
+  { NULL, NULL }
+};
+
 /* WpCore */
 
 static int
@@ -152,6 +197,8 @@ core_timeout_add (lua_State *L)
 {
   GSource *source = NULL;
   lua_Integer timeout_ms = luaL_checkinteger (L, 1);
+  luaL_argcheck (L, timeout_ms >= 0 && timeout_ms <= G_MAXUINT, 1,
+      "timeout out of range");
   luaL_checktype (L, 2, LUA_TFUNCTION);
   wp_core_timeout_add_closure (get_wp_core (L), &source, timeout_ms,
       wplua_function_to_closure (L, 2));
@@ -229,6 +276,46 @@ core_require_api (lua_State *L)
   return wp_require_api_transition_new_from_lua (L, core);
 }
 
+static int
+core_get_memory_stats (lua_State *L)
+{
+  WpLuaAllocStats stats;
+  WpLuaAllocClassStats classes[WPLUA_ALLOC_MAX_POOLED_SIZE / 16];
+  guint n_classes;
+
+  wplua_get_alloc_stats (L, &stats);
+  n_classes = wplua_get_alloc_class_stats (L, classes, G_N_ELEMENTS (classes));
+  n_classes = MIN (n_classes, G_N_ELEMENTS (classes));
+
+  lua_newtable (L);
+  lua_pushinteger (L, stats.live_bytes);
+  lua_setfield (L, -2, "live_bytes");
+  lua_pushinteger (L, stats.peak_live_bytes);
+  lua_setfield (L, -2, "peak_live_bytes");
+  lua_pushinteger (L, stats.pool_bytes);
+  lua_setfield (L, -2, "pool_bytes");
+  lua_pushinteger (L, stats.n_allocs);
+  lua_setfield (L, -2, "n_allocs");
+  lua_pushinteger (L, stats.n_frees);
+  lua_setfield (L, -2, "n_frees");
+
+  lua_createtable (L, n_classes, 0);
+  for (guint i = 0; i < n_classes; i++) {
+    lua_createtable (L, 0, 4);
+    lua_pushinteger (L, classes[i].block_size);
+    lua_setfield (L, -2, "block_size");
+    lua_pushinteger (L, classes[i].n_used);
+    lua_setfield (L, -2, "n_used");
+    lua_pushinteger (L, classes[i].n_free);
+    lua_setfield (L, -2, "n_free");
+    lua_pushinteger (L, classes[i].n_allocs);
+    lua_setfield (L, -2, "n_allocs");
+    lua_rawseti (L, -2, i + 1);
+  }
+  lua_setfield (L, -2, "classes");
+  return 1;
+}
+
 static const luaL_Reg core_funcs[] = {
   { "get_info", core_get_info },
   { "idle_add", core_idle_add },
@@ -236,6 +323,7 @@ static const luaL_Reg core_funcs[] = {
   { "sync", core_sync },
   { "quit", core_quit },
   { "require_api", core_require_api },
+  { "get_memory_stats", core_get_memory_stats },
   { NULL, NULL }
 };
 
@@ -710,9 +798,16 @@ object_manager_new (lua_State *L)
 
   lua_pushnil (L);
   while (lua_next (L, 1)) {
-    WpObjectInterest *interest =
-        wplua_checkboxed (L, -1, WP_TYPE_OBJECT_INTEREST);
-    wp_object_manager_add_interest_full (om, wp_object_interest_ref (interest));
+    /* live = true|false */
+    if (lua_type (L, -2) == LUA_TSTRING &&
+        !g_strcmp0 (lua_tostring (L, -2), "live")) {
+      wp_object_manager_set_live (om, lua_toboolean (L, -1));
+    } else {
+      WpObjectInterest *interest =
+          wplua_checkboxed (L, -1, WP_TYPE_OBJECT_INTEREST);
+      wp_object_manager_add_interest_full (om,
+          wp_object_interest_ref (interest));
+    }
     lua_pop (L, 1);
   }
 
@@ -1187,18 +1282,11 @@ session_item_reset (lua_State *L)
   return 0;
 }
 
-static int
-session_item_configure (lua_State *L)
+static void
+session_item_table_to_config (lua_State *L, int idx, WpProperties *props)
 {
-  WpSessionItem *si = wplua_checkobject (L, 1, WP_TYPE_SESSION_ITEM);
-  WpProperties *props = wp_properties_new_empty ();
-
-  /* validate arguments */
-  luaL_checktype (L, 2, LUA_TTABLE);
-
-  /* build the configuration properties */
   lua_pushnil (L);
-  while (lua_next (L, 2)) {
+  while (lua_next (L, idx)) {
     const gchar *key = NULL;
     g_autofree gchar *var = NULL;
 
@@ -1231,6 +1319,157 @@ session_item_configure (lua_State *L)
     wp_properties_set (props, key, var);
     lua_pop (L, 2);
   }
+}
+
+static int
+session_item_configure (lua_State *L)
+{
+  WpSessionItem *si = wplua_checkobject (L, 1, WP_TYPE_SESSION_ITEM);
+  WpProperties *props = wp_properties_new_empty ();
+
+  /* validate arguments */
+  luaL_checktype (L, 2, LUA_TTABLE);
+
+  /* build the configuration properties */
+  session_item_table_to_config (L, 2, props);
+
+  lua_pushboolean (L, wp_session_item_configure (si, props));
+  return 1;
+}
+
+/* node properties that are always copied to the item configuration */
+static const gchar * const node_config_keys[] = {
+  PW_KEY_CLIENT_ID,
+  PW_KEY_OBJECT_PATH,
+  PW_KEY_OBJECT_SERIAL,
+  "target.object",
+  PW_KEY_PRIORITY_SESSION,
+  PW_KEY_DEVICE_ID,
+  "card.profile.device",
+  NULL
+};
+
+/* prefixes of node properties that are copied unless the caller
+   specifies its own list */
+static const gchar * const default_node_config_prefixes[] = {
+  "node", "stream", "media", NULL
+};
+
+static gboolean
+node_config_key_matches (const gchar *key, const gchar * const *prefixes)
+{
+  for (guint i = 0; node_config_keys[i]; i++)
+    if (g_str_equal (key, node_config_keys[i]))
+      return TRUE;
+  for (guint i = 0; prefixes[i]; i++)
+    if (g_str_has_prefix (key, prefixes[i]))
+      return TRUE;
+  return FALSE;
+}
+
+/* raises the same errors as session_item_table_to_config(), so that they can
+   be checked before anything is allocated */
+static void
+session_item_check_config_table (lua_State *L, int idx)
+{
+  lua_pushnil (L);
+  while (lua_next (L, idx)) {
+    switch (lua_type (L, -1)) {
+      case LUA_TBOOLEAN:
+      case LUA_TNUMBER:
+      case LUA_TSTRING:
+      case LUA_TUSERDATA:
+        break;
+      default:
+        luaL_error (L, "configure does not support lua type %s",
+            lua_typename (L, lua_type (L, -1)));
+        break;
+    }
+    lua_pop (L, 1);
+  }
+}
+
+static int
+session_item_configure_for_node (lua_State *L)
+{
+  WpSessionItem *si = wplua_checkobject (L, 1, WP_TYPE_SESSION_ITEM);
+  WpNode *node = wplua_checkobject (L, 2, WP_TYPE_NODE);
+  g_autoptr (WpProperties) node_props = NULL;
+  g_autofree const gchar **custom_prefixes = NULL;
+  const gchar * const *prefixes = default_node_config_prefixes;
+  WpProperties *props;
+  const struct spa_dict_item *item;
+  const gchar *media_class = NULL;
+  lua_Integer n_prefixes = 0;
+
+  /* validate the arguments before allocating anything, as lua errors
+     do not return */
+  if (!lua_isnoneornil (L, 3)) {
+    luaL_checktype (L, 3, LUA_TTABLE);
+    session_item_check_config_table (L, 3);
+  }
+  if (!lua_isnoneornil (L, 4)) {
+    luaL_checktype (L, 4, LUA_TTABLE);
+    n_prefixes = luaL_len (L, 4);
+    for (lua_Integer i = 1; i <= n_prefixes; i++) {
+      if (lua_geti (L, 4, i) != LUA_TSTRING)
+        luaL_error (L, "node property prefixes must be strings");
+      lua_pop (L, 1);
+    }
+
+    custom_prefixes = g_new0 (const gchar *, n_prefixes + 1);
+    for (lua_Integer i = 1; i <= n_prefixes; i++) {
+      lua_geti (L, 4, i);
+      /* the strings stay referenced by the table at index 4 */
+      custom_prefixes[i - 1] = lua_tostring (L, -1);
+      lua_pop (L, 1);
+    }
+    prefixes = custom_prefixes;
+  }
+
+  /* copy the relevant node properties, straight from the node's dict */
+  props = wp_properties_new_empty ();
+  node_props = wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (node));
+  if (node_props) {
+    spa_dict_for_each (item, wp_properties_peek_dict (node_props)) {
+      if (node_config_key_matches (item->key, prefixes))
+        wp_properties_set (props, item->key, item->value);
+    }
+    /* the media class is needed below even if the prefixes exclude it */
+    media_class = wp_properties_get (node_props, PW_KEY_MEDIA_CLASS);
+  }
+
+  wp_properties_setf (props, "item.node", "%p", node);
+  wp_properties_setf (props, "node.id", "%u",
+      wp_proxy_get_bound_id (WP_PROXY (node)));
+
+  /* derive the item type and direction from the media class */
+  if (!media_class)
+    media_class = "";
+
+  if (!wp_properties_get (props, PW_KEY_MEDIA_TYPE)) {
+    static const gchar * const media_types[] = { "Audio", "Video", "Midi" };
+    for (guint i = 0; i < G_N_ELEMENTS (media_types); i++) {
+      if (strstr (media_class, media_types[i])) {
+        wp_properties_set (props, PW_KEY_MEDIA_TYPE, media_types[i]);
+        break;
+      }
+    }
+  }
+
+  wp_properties_set (props, "item.node.type",
+      g_str_has_prefix (media_class, "Stream/") ? "stream" : "device");
+
+  if (strstr (media_class, "Sink") ||
+      strstr (media_class, "Input") ||
+      strstr (media_class, "Duplex"))
+    wp_properties_set (props, "item.node.direction", "input");
+  else if (strstr (media_class, "Source") || strstr (media_class, "Output"))
+    wp_properties_set (props, "item.node.direction", "output");
+
+  /* the explicitly given properties override everything else */
+  if (!lua_isnoneornil (L, 3))
+    session_item_table_to_config (L, 3, props);
 
   lua_pushboolean (L, wp_session_item_configure (si, props));
   return 1;
@@ -1256,6 +1495,7 @@ static const luaL_Reg session_item_methods[] = {
   { "get_associated_proxy", session_item_get_associated_proxy },
   { "reset", session_item_reset },
   { "configure", session_item_configure },
+  { "configure_for_node", session_item_configure_for_node },
   { "register", session_item_register },
   { "remove", session_item_remove },
   { NULL, NULL }
@@ -1330,10 +1570,154 @@ state_load (lua_State *L)
   return 1;
 }
 
+/* converts a Lua value to a state record; tables with a sequence part are
+   stored as typed arrays and all other tables as nested groups, whose keys
+   must be strings or numbers */
+static GVariant *
+state_record_from_lua (lua_State *L, int idx)
+{
+  idx = lua_absindex (L, idx);
+
+  switch (lua_type (L, idx)) {
+  case LUA_TBOOLEAN:
+    return g_variant_new_boolean (lua_toboolean (L, idx));
+  case LUA_TNUMBER:
+    if (lua_isinteger (L, idx))
+      return g_variant_new_int64 (lua_tointeger (L, idx));
+    else
+      return g_variant_new_double (lua_tonumber (L, idx));
+  case LUA_TSTRING:
+    return g_variant_new_string (lua_tostring (L, idx));
+  case LUA_TTABLE: {
+    lua_Unsigned n = lua_rawlen (L, idx);
+
+    if (n > 0) {
+      const GVariantType *type = NULL;
+      GVariantBuilder b;
+
+      /* the array is typed after its first element; mixed arrays
+         and integers mixed with floats fall back to wider types */
+      for (lua_Unsigned i = 1; i <= n; i++) {
+        const GVariantType *t;
+
+        switch (lua_rawgeti (L, idx, i)) {
+        case LUA_TNUMBER:
+          t = lua_isinteger (L, -1) ? G_VARIANT_TYPE_INT64 :
+              G_VARIANT_TYPE_DOUBLE;
+          break;
+        case LUA_TSTRING:
+          t = G_VARIANT_TYPE_STRING;
+          break;
+        case LUA_TBOOLEAN:
+          t = G_VARIANT_TYPE_BOOLEAN;
+          break;
+        default:
+          t = G_VARIANT_TYPE_VARIANT;
+          break;
+        }
+        lua_pop (L, 1);
+
+        if (!type)
+          type = t;
+        else if (g_variant_type_equal (type, t))
+          continue;
+        else if ((g_variant_type_equal (type, G_VARIANT_TYPE_INT64) ||
+                  g_variant_type_equal (type, G_VARIANT_TYPE_DOUBLE)) &&
+                 (g_variant_type_equal (t, G_VARIANT_TYPE_INT64) ||
+                  g_variant_type_equal (t, G_VARIANT_TYPE_DOUBLE)))
+          type = G_VARIANT_TYPE_DOUBLE;
+        else
+          type = G_VARIANT_TYPE_VARIANT;
+      }
+
+      g_variant_builder_init (&b, G_VARIANT_TYPE_ARRAY);
+      for (lua_Unsigned i = 1; i <= n; i++) {
+        GVariant *v;
+
+        lua_rawgeti (L, idx, i);
+        if (g_variant_type_equal (type, G_VARIANT_TYPE_DOUBLE))
+          v = g_variant_new_double (lua_tonumber (L, -1));
+        else if (g_variant_type_equal (type, G_VARIANT_TYPE_VARIANT)) {
+          v = state_record_from_lua (L, -1);
+          v = g_variant_new_variant (v ? v : g_variant_new ("()"));
+        } else
+          v = state_record_from_lua (L, -1);
+        lua_pop (L, 1);
+
+        g_variant_builder_add_value (&b, v);
+      }
+      return g_variant_builder_end (&b);
+    } else {
+      GVariantBuilder b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+
+      lua_pushnil (L);
+      while (lua_next (L, idx)) {
+        GVariant *v;
+
+        if (lua_type (L, -2) != LUA_TSTRING &&
+            lua_type (L, -2) != LUA_TNUMBER) {
+          wp_warning ("skipping state record with a key of type %s",
+              luaL_typename (L, -2));
+          lua_pop (L, 1);
+          continue;
+        }
+
+        v = state_record_from_lua (L, -1);
+        /* copy key to convert it to string */
+        lua_pushvalue (L, -2);
+        if (v)
+          g_variant_builder_add (&b, "{sv}", lua_tostring (L, -1), v);
+        lua_pop (L, 2);
+      }
+      return g_variant_builder_end (&b);
+    }
+  }
+  default:
+    wp_warning ("skipping state record value of type %s",
+        luaL_typename (L, idx));
+    return NULL;
+  }
+}
+
+static int
+state_save_records (lua_State *L)
+{
+  WpState *state = wplua_checkobject (L, 1, WP_TYPE_STATE);
+  luaL_checktype (L, 2, LUA_TTABLE);
+  lua_settop (L, 2);
+  /* an empty table is stored as an empty group */
+  GVariant *records = lua_rawlen (L, 2) == 0 ?
+      state_record_from_lua (L, 2) : NULL;
+  g_autoptr (GError) error = NULL;
+  gboolean saved = FALSE;
+  if (records)
+    saved = wp_state_save_records (state, records, &error);
+  else
+    g_set_error (&error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT,
+        "state records must be a table with string keys");
+  lua_pushboolean (L, saved);
+  lua_pushstring (L, error ? error->message : "");
+  return 2;
+}
+
+/* the records are converted to a Lua table all at once; only the C API
+   (wp_state_load_records) defers the validation of the data until it is
+   accessed */
+static int
+state_load_records (lua_State *L)
+{
+  WpState *state = wplua_checkobject (L, 1, WP_TYPE_STATE);
+  g_autoptr (GVariant) records = wp_state_load_records (state);
+  wplua_gvariant_to_lua (L, records);
+  return 1;
+}
+
 static const luaL_Reg state_methods[] = {
   { "clear", state_clear },
   { "save" , state_save },
   { "load" , state_load },
+  { "save_records", state_save_records },
+  { "load_records", state_load_records },
   { NULL, NULL }
 };
 
@@ -1388,6 +1772,8 @@ wp_lua_scripting_api_init (lua_State *L)
 
   wplua_register_type_methods (L, G_TYPE_SOURCE,
       NULL, source_methods);
+  wplua_register_type_methods (L, WP_TYPE_TIMER,
+      timer_new, timer_methods);
   wplua_register_type_methods (L, WP_TYPE_OBJECT,
       NULL, object_methods);
   wplua_register_type_methods (L, WP_TYPE_PROXY,
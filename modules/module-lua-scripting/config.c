@@ -8,10 +8,28 @@
 
 #include <wp/wp.h>
 #include <wplua/wplua.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
 
-static gboolean
-load_components (lua_State *L, WpCore * core, GError ** error)
+/*
+ * The result of evaluating a configuration is the list of components that it
+ * declares, which is cached on disk as a serialized GVariant of this type:
+ * (fingerprint, [(component, type, optional, args), ...])
+ *
+ * The fingerprint covers the names and contents of all the files that make up
+ * the configuration, so any edit, addition or removal of a fragment causes the
+ * configuration to be evaluated again. Config files run in the minimal sandbox,
+ * which has no access to the environment, so the result depends on nothing else.
+ */
+#define CONFIG_CACHE_FORMAT "(sa(ssbmv))"
+
+static GVariant *
+collect_components (lua_State *L, GError ** error)
 {
+  g_auto (GVariantBuilder) b =
+      G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(ssbmv)"));
+
   lua_getglobal (L, "SANDBOX_COMMON_ENV");
 
   switch (lua_getfield (L, -1, "components")) {
@@ -23,7 +41,7 @@ load_components (lua_State *L, WpCore * core, GError ** error)
   default:
     g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT,
         "Expected 'components' to be a table");
-    return FALSE;
+    return NULL;
   }
 
   lua_pushnil (L);
@@ -32,7 +50,7 @@ load_components (lua_State *L, WpCore * core, GError ** error)
     if (lua_type (L, -1) != LUA_TTABLE) {
       g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT,
           "'components' must be a table with tables as values");
-      return FALSE;
+      return NULL;
     }
 
     /* record indexes to the current key and value of the components table */
@@ -44,7 +62,7 @@ load_components (lua_State *L, WpCore * core, GError ** error)
       g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT,
           "components['%s'] has a non-string or unspecified component name",
           lua_tostring (L, key));
-      return FALSE;
+      return NULL;
     }
     const char * component = lua_tostring (L, -1);
 
@@ -53,7 +71,7 @@ load_components (lua_State *L, WpCore * core, GError ** error)
       g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT,
           "components['%s'] has a non-string or unspecified component type",
           lua_tostring (L, key));
-      return FALSE;
+      return NULL;
     }
     const char * type = lua_tostring (L, -1);
 
@@ -68,10 +86,38 @@ load_components (lua_State *L, WpCore * core, GError ** error)
       optional = lua_toboolean (L, -1);
     }
 
+    g_variant_builder_add (&b, "(ssbm@v)", component, type, optional,
+        args ? g_variant_new_variant (args) : NULL);
+
+    /* clear the stack up to the key */
+    lua_settop (L, key);
+  }
+
+done:
+  lua_pop (L, 2); /* pop components & SANDBOX_COMMON_ENV */
+  return g_variant_builder_end (&b);
+}
+
+static gboolean
+load_components (GVariant * components, WpCore * core, GError ** error)
+{
+  gsize n_components = g_variant_n_children (components);
+
+  for (gsize i = 0; i < n_components; i++) {
+    g_autoptr (GVariant) args_v = NULL;
+    g_autoptr (GVariant) args = NULL;
+    g_autoptr (GError) load_error = NULL;
+    const gchar *component, *type;
+    gboolean optional;
+
+    g_variant_get_child (components, i, "(&s&sbm@v)", &component, &type,
+        &optional, &args_v);
+    if (args_v)
+      args = g_variant_get_variant (args_v);
+
     wp_debug ("load component: %s (%s) optional(%s)",
      component, type, (optional ? "true" : "false"));
 
-    g_autoptr (GError) load_error = NULL;
     if (!wp_core_load_component (core, component, type, args, &load_error)) {
       if (!optional) {
         g_propagate_error (error, g_steal_pointer (&load_error));
@@ -80,36 +126,93 @@ load_components (lua_State *L, WpCore * core, GError ** error)
         wp_message ("%s", load_error->message);
       }
     }
-
-    /* clear the stack up to the key */
-    lua_settop (L, key);
   }
 
-done:
-  lua_pop (L, 2); /* pop components & SANDBOX_COMMON_ENV */
   return TRUE;
 }
 
-static gboolean
-load_file (const GValue *item, GValue *ret, gpointer data)
+static gchar *
+compute_fingerprint (const gchar * conf_file, GPtrArray * files)
 {
-  lua_State *L = data;
-  const gchar *path = g_value_get_string (item);
-  g_autoptr (GError) error = NULL;
+  g_autoptr (GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
 
-  if (g_file_test (path, G_FILE_TEST_IS_DIR))
-    return TRUE;
+  g_checksum_update (checksum, (const guchar *) WIREPLUMBER_VERSION, -1);
+  g_checksum_update (checksum, (const guchar *) conf_file, strlen (conf_file) + 1);
 
-  wp_info ("loading config file: %s", path);
-  if (!wplua_load_path (L, path, 0, 0, &error)) {
-    g_value_unset (ret);
-    g_value_init (ret, G_TYPE_ERROR);
-    g_value_take_boxed (ret, g_steal_pointer (&error));
-    return FALSE;
+  for (guint i = 0; i < files->len; i++) {
+    const gchar *path = g_ptr_array_index (files, i);
+    g_autofree gchar *contents = NULL;
+    gsize len = 0;
+
+    /* a file that cannot be read now will fail to load later anyway */
+    if (!g_file_get_contents (path, &contents, &len, NULL))
+      return NULL;
+
+    g_checksum_update (checksum, (const guchar *) path, strlen (path) + 1);
+    g_checksum_update (checksum, (const guchar *) &len, sizeof (len));
+    g_checksum_update (checksum, (const guchar *) contents, len);
   }
 
-  g_value_set_int (ret, g_value_get_int (ret) + 1);
-  return TRUE;
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+static gchar *
+get_cache_path (const gchar * conf_file)
+{
+  g_autofree gchar *name = g_strconcat (conf_file, ".cache", NULL);
+
+  g_strdelimit (name, G_DIR_SEPARATOR_S, '_');
+  return g_build_filename (g_get_user_cache_dir (), "wireplumber", "config",
+      name, NULL);
+}
+
+static GVariant *
+load_cached_components (const gchar * conf_file, const gchar * fingerprint)
+{
+  g_autofree gchar *path = get_cache_path (conf_file);
+  g_autoptr (GMappedFile) file = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GVariant) cache = NULL;
+  g_autoptr (GVariant) components = NULL;
+  const gchar *cached_fingerprint = NULL;
+
+  if (!(file = g_mapped_file_new (path, FALSE, NULL)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (
+          G_VARIANT_TYPE (CONFIG_CACHE_FORMAT), bytes, FALSE));
+
+  g_variant_get (cache, "(&s@a(ssbmv))", &cached_fingerprint, &components);
+  if (g_strcmp0 (cached_fingerprint, fingerprint) != 0) {
+    wp_debug ("configuration cache for '%s' is outdated", conf_file);
+    return NULL;
+  }
+
+  wp_info ("loading configuration '%s' from cache", conf_file);
+  return g_steal_pointer (&components);
+}
+
+static void
+store_cached_components (const gchar * conf_file, const gchar * fingerprint,
+    GVariant * components)
+{
+  g_autofree gchar *path = get_cache_path (conf_file);
+  g_autofree gchar *dir = g_path_get_dirname (path);
+  g_autoptr (GVariant) cache = NULL;
+  g_autoptr (GError) error = NULL;
+
+  if (g_mkdir_with_parents (dir, 0700) < 0) {
+    wp_debug ("cannot create configuration cache directory %s: %s", dir,
+        g_strerror (errno));
+    return;
+  }
+
+  cache = g_variant_ref_sink (g_variant_new ("(s@a(ssbmv))", fingerprint,
+          components));
+  if (!g_file_set_contents (path, g_variant_get_data (cache),
+          g_variant_get_size (cache), &error))
+    wp_debug ("failed to store configuration cache: %s", error->message);
 }
 
 #define CONFIG_DIRS_LOOKUP_SET \
@@ -118,48 +221,78 @@ load_file (const GValue *item, GValue *ret, gpointer data)
      WP_LOOKUP_DIR_ETC | \
      WP_LOOKUP_DIR_PREFIX_SHARE)
 
-gboolean
-wp_lua_scripting_load_configuration (const gchar * conf_file,
-    WpCore * core, GError ** error)
+static GPtrArray *
+find_config_files (const gchar * conf_file)
 {
-  g_autoptr (lua_State) L = wplua_new ();
-  g_autofree gchar * path = NULL;
+  GPtrArray *files = g_ptr_array_new_with_free_func (g_free);
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *subdir = NULL;
   g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) fold_ret = G_VALUE_INIT;
-  gint nfiles = 0;
+  g_auto (GValue) item = G_VALUE_INIT;
+
+  /* conf_file itself */
+  path = wp_find_file (CONFIG_DIRS_LOOKUP_SET, conf_file, NULL);
+  if (path)
+    g_ptr_array_add (files, g_steal_pointer (&path));
+
+  /* fragments in conf_file.d, in the order in which they are loaded */
+  subdir = g_strdup_printf ("%s.d", conf_file);
+  it = wp_new_files_iterator (CONFIG_DIRS_LOOKUP_SET, subdir, ".lua");
+  for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+    const gchar *p = g_value_get_string (&item);
+    if (!g_file_test (p, G_FILE_TEST_IS_DIR))
+      g_ptr_array_add (files, g_strdup (p));
+  }
+
+  return files;
+}
+
+static GVariant *
+evaluate_configuration (GPtrArray * files, GError ** error)
+{
+  g_autoptr (lua_State) L = wplua_new ();
 
   wplua_enable_sandbox (L, WP_LUA_SANDBOX_MINIMAL_STD);
 
-  /* load conf_file itself */
-  path = wp_find_file (CONFIG_DIRS_LOOKUP_SET, conf_file, NULL);
-  if (path) {
+  for (guint i = 0; i < files->len; i++) {
+    const gchar *path = g_ptr_array_index (files, i);
+
     wp_info ("loading config file: %s", path);
     if (!wplua_load_path (L, path, 0, 0, error))
-      return FALSE;
-    nfiles = 1;
+      return NULL;
   }
-  g_clear_pointer (&path, g_free);
 
-  path = g_strdup_printf ("%s.d", conf_file);
-  it = wp_new_files_iterator (CONFIG_DIRS_LOOKUP_SET, path, ".lua");
+  return collect_components (L, error);
+}
 
-  g_value_init (&fold_ret, G_TYPE_INT);
-  g_value_set_int (&fold_ret, nfiles);
-  if (!wp_iterator_fold (it, load_file, &fold_ret, L)) {
-    if (error && G_VALUE_HOLDS (&fold_ret, G_TYPE_ERROR))
-      *error = g_value_dup_boxed (&fold_ret);
-    return FALSE;
-  }
-  nfiles = g_value_get_int (&fold_ret);
+gboolean
+wp_lua_scripting_load_configuration (const gchar * conf_file,
+    WpCore * core, GError ** error)
+{
+  g_autoptr (GPtrArray) files = find_config_files (conf_file);
+  g_autoptr (GVariant) components = NULL;
+  g_autofree gchar *fingerprint = NULL;
 
-  if (nfiles == 0) {
+  if (files->len == 0) {
     g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
         "Could not locate configuration file '%s'", conf_file);
     return FALSE;
   }
 
-  if (!load_components (L, core, error))
-    return FALSE;
+  if (!g_getenv ("WIREPLUMBER_NO_LUA_CACHE")) {
+    fingerprint = compute_fingerprint (conf_file, files);
+    if (fingerprint)
+      components = load_cached_components (conf_file, fingerprint);
+  }
 
-  return TRUE;
+  if (!components) {
+    if (!(components = evaluate_configuration (files, error)))
+      return FALSE;
+    g_variant_ref_sink (components);
+
+    if (fingerprint)
+      store_cached_components (conf_file, fingerprint, components);
+  }
+
+  return load_components (components, core, error);
 }
@@ -10,6 +10,7 @@
 #include <wplua/wplua.h>
 
 #include <spa/utils/type.h>
+#include <spa/pod/iter.h>
 
 #define MAX_LUA_TYPES 9
 
@@ -1154,6 +1155,108 @@ spa_pod_parse (lua_State *L)
   return 1;
 }
 
+/* looks up a direct child of an Object (by property short name) or of a
+   Struct (by 1-based index) without decoding any of its siblings; the
+   returned pod wraps the memory of the parent */
+static WpSpaPod *
+lookup_child_pod (lua_State *L, WpSpaPod *pod, int idx,
+    WpSpaIdValue *field_idval)
+{
+  const struct spa_pod *spa_pod = wp_spa_pod_get_spa_pod (pod);
+
+  *field_idval = NULL;
+
+  if (wp_spa_pod_is_object (pod)) {
+    WpSpaIdTable values_table =
+        wp_spa_type_get_values_table (wp_spa_pod_get_spa_type (pod));
+    const gchar *key = luaL_checkstring (L, idx);
+    const struct spa_pod_prop *prop;
+    WpSpaIdValue idval =
+        wp_spa_id_table_find_value_from_short_name (values_table, key);
+    guint32 key_id;
+
+    /* unknown keys are named "id-%08x", like in wp_spa_pod_get_property() */
+    if (idval)
+      key_id = wp_spa_id_value_number (idval);
+    else if (!g_str_has_prefix (key, "id-") ||
+        sscanf (key, "id-%08x", &key_id) != 1)
+      return NULL;
+
+    prop = spa_pod_object_find_prop ((const struct spa_pod_object *) spa_pod,
+        NULL, key_id);
+    if (!prop)
+      return NULL;
+    *field_idval = idval;
+    return wp_spa_pod_new_wrap_const (&prop->value);
+  }
+
+  else if (wp_spa_pod_is_struct (pod)) {
+    lua_Integer n = luaL_checkinteger (L, idx);
+    const struct spa_pod *child;
+
+    SPA_POD_STRUCT_FOREACH (spa_pod, child) {
+      if (--n == 0)
+        return wp_spa_pod_new_wrap_const (child);
+    }
+  }
+
+  return NULL;
+}
+
+static int
+spa_pod_get (lua_State *L)
+{
+  WpSpaPod *pod = wplua_checkboxed (L, 1, WP_TYPE_SPA_POD);
+  g_autoptr (WpSpaPod) current = wp_spa_pod_ref (pod);
+  WpSpaIdValue field_idval = NULL;
+  int n_args = lua_gettop (L);
+
+  for (int i = 2; i <= n_args; i++) {
+    WpSpaPod *child = lookup_child_pod (L, current, i, &field_idval);
+    if (!child)
+      return 0;
+    wp_spa_pod_unref (current);
+    current = child;
+  }
+
+  push_luapod (L, current, field_idval);
+  return 1;
+}
+
+static int
+spa_pod_pick (lua_State *L)
+{
+  WpSpaPod *pod = wplua_checkboxed (L, 1, WP_TYPE_SPA_POD);
+  int n_args = lua_gettop (L);
+
+  if (!wp_spa_pod_is_object (pod))
+    return 0;
+
+  lua_createtable (L, 0, n_args - 1);
+  for (int i = 2; i <= n_args; i++) {
+    WpSpaIdValue field_idval = NULL;
+    g_autoptr (WpSpaPod) child = lookup_child_pod (L, pod, i, &field_idval);
+    if (child) {
+      push_luapod (L, child, field_idval);
+      lua_setfield (L, -2, lua_tostring (L, i));
+    }
+  }
+  return 1;
+}
+
+static int
+spa_pod_get_object_id (lua_State *L)
+{
+  WpSpaPod *pod = wplua_checkboxed (L, 1, WP_TYPE_SPA_POD);
+  const gchar *id_name = NULL;
+
+  if (!wp_spa_pod_is_object (pod) ||
+      !wp_spa_pod_get_object (pod, &id_name, NULL))
+    return 0;
+  lua_pushstring (L, id_name);
+  return 1;
+}
+
 static int
 spa_pod_fixate (lua_State *L)
 {
@@ -1185,6 +1288,9 @@ spa_pod_filter (lua_State *L)
 static const luaL_Reg spa_pod_methods[] = {
   { "get_type_name", spa_pod_get_type_name },
   { "parse", spa_pod_parse },
+  { "get", spa_pod_get },
+  { "pick", spa_pod_pick },
+  { "get_object_id", spa_pod_get_object_id },
   { "fixate", spa_pod_fixate },
   { "filter", spa_pod_filter },
   { NULL, NULL }
@@ -38,6 +38,7 @@ struct _WpSiAudioAdapter
   struct spa_audio_info_raw raw_format;
 
   gulong ports_changed_sigid;
+  GArray *port_sets[2];  /* WpSiPortInfo, indexed by WpDirection */
 
   WpSpaPod *format;
   gchar mode[32];
@@ -59,6 +60,13 @@ si_audio_adapter_init (WpSiAudioAdapter * self)
 {
 }
 
+static void
+si_audio_adapter_clear_port_sets (WpSiAudioAdapter * self)
+{
+  g_clear_pointer (&self->port_sets[WP_DIRECTION_INPUT], g_array_unref);
+  g_clear_pointer (&self->port_sets[WP_DIRECTION_OUTPUT], g_array_unref);
+}
+
 static void
 si_audio_adapter_reset (WpSessionItem * item)
 {
@@ -89,6 +97,7 @@ si_audio_adapter_reset (WpSessionItem * item)
   }
   g_clear_pointer (&self->format, wp_spa_pod_unref);
   self->mode[0] = '\0';
+  si_audio_adapter_clear_port_sets (self);
 
   WP_SESSION_ITEM_CLASS (si_audio_adapter_parent_class)->reset (item);
 }
@@ -487,6 +496,9 @@ on_port_param_info (WpPipewireObject * port, GParamSpec * param,
 static void
 on_node_ports_changed (WpObject * node, WpSiAudioAdapter *self)
 {
+  /* the cached port sets are rebuilt on the next request */
+  si_audio_adapter_clear_port_sets (self);
+
   /* clear port and handler */
   if (self->port) {
     g_signal_handlers_disconnect_by_func (self->port, on_port_param_info, self);
@@ -557,6 +569,7 @@ si_audio_adapter_disable_active (WpSessionItem *si)
     g_signal_handler_disconnect (self->node, self->ports_changed_sigid);
     self->ports_changed_sigid = 0;
   }
+  si_audio_adapter_clear_port_sets (self);
 
   wp_object_update_features (WP_OBJECT (self), 0,
       WP_SESSION_ITEM_FEATURE_ACTIVE);
@@ -676,29 +689,14 @@ si_audio_adapter_adapter_init (WpSiAdapterInterface * iface)
   iface->set_ports_format_finish = si_audio_adapter_set_ports_format_finish;
 }
 
-static GVariant *
-si_audio_adapter_get_ports (WpSiLinkable * item, const gchar * context)
+static GArray *
+si_audio_adapter_build_port_set (WpSiAudioAdapter * self,
+    WpDirection direction)
 {
-  WpSiAudioAdapter *self = WP_SI_AUDIO_ADAPTER (item);
-  g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_ARRAY);
   g_autoptr (WpIterator) it = NULL;
   g_auto (GValue) val = G_VALUE_INIT;
-  WpDirection direction;
-  guint32 node_id;
-
-  if (!g_strcmp0 (context, "output")) {
-    direction = WP_DIRECTION_OUTPUT;
-  }
-  else if (!g_strcmp0 (context, "input")) {
-    direction = WP_DIRECTION_INPUT;
-  }
-  else {
-    /* on any other context, return an empty list of ports */
-    return g_variant_new_array (G_VARIANT_TYPE ("(uuu)"), NULL, 0);
-  }
-
-  g_variant_builder_init (&b, G_VARIANT_TYPE ("a(uuu)"));
-  node_id = wp_proxy_get_bound_id (WP_PROXY (self->node));
+  GArray *arr = g_array_new (FALSE, FALSE, sizeof (WpSiPortInfo));
+  guint32 node_id = wp_proxy_get_bound_id (WP_PROXY (self->node));
 
   for (it = wp_node_new_ports_iterator (self->node);
        wp_iterator_next (it, &val);
@@ -707,27 +705,69 @@ si_audio_adapter_get_ports (WpSiLinkable * item, const gchar * context)
     WpPort *port = g_value_get_object (&val);
     g_autoptr (WpProperties) props = NULL;
     const gchar *channel;
-    guint32 port_id, channel_id = 0;
+    WpSiPortInfo info = { node_id, 0, 0 };
 
     if (wp_port_get_direction (port) != direction)
       continue;
 
-    port_id = wp_proxy_get_bound_id (WP_PROXY (port));
+    info.port_id = wp_proxy_get_bound_id (WP_PROXY (port));
     props = wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (port));
 
     /* try to find the audio channel; if channel is NULL, this will silently
-       leave the channel_id to its default value, 0 */
+       leave the channel to its default value, 0 */
     channel = wp_properties_get (props, PW_KEY_AUDIO_CHANNEL);
     if (channel) {
       WpSpaIdValue idval = wp_spa_id_value_from_short_name (
           "Spa:Enum:AudioChannel", channel);
       if (idval)
-        channel_id = wp_spa_id_value_number (idval);
+        info.channel = wp_spa_id_value_number (idval);
     }
 
-    g_variant_builder_add (&b, "(uuu)", node_id, port_id, channel_id);
+    g_array_append_val (arr, info);
+  }
+
+  return arr;
+}
+
+static GArray *
+si_audio_adapter_get_port_set (WpSiLinkable * item, const gchar * context)
+{
+  WpSiAudioAdapter *self = WP_SI_AUDIO_ADAPTER (item);
+  WpDirection direction;
+
+  if (!g_strcmp0 (context, "output")) {
+    direction = WP_DIRECTION_OUTPUT;
+  }
+  else if (!g_strcmp0 (context, "input")) {
+    direction = WP_DIRECTION_INPUT;
+  }
+  else {
+    /* on any other context, return an empty list of ports */
+    return g_array_new (FALSE, FALSE, sizeof (WpSiPortInfo));
   }
 
+  /* only cache while active, since that is when ports-changed is tracked */
+  if (!self->ports_changed_sigid)
+    return si_audio_adapter_build_port_set (self, direction);
+
+  if (!self->port_sets[direction])
+    self->port_sets[direction] =
+        si_audio_adapter_build_port_set (self, direction);
+  return g_array_ref (self->port_sets[direction]);
+}
+
+static GVariant *
+si_audio_adapter_get_ports (WpSiLinkable * item, const gchar * context)
+{
+  g_autoptr (GArray) ports = si_audio_adapter_get_port_set (item, context);
+  g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_ARRAY);
+
+  g_variant_builder_init (&b, G_VARIANT_TYPE ("a(uuu)"));
+  for (guint i = 0; i < ports->len; i++) {
+    WpSiPortInfo *info = &g_array_index (ports, WpSiPortInfo, i);
+    g_variant_builder_add (&b, "(uuu)", info->node_id, info->port_id,
+        info->channel);
+  }
   return g_variant_builder_end (&b);
 }
 
@@ -735,6 +775,7 @@ static void
 si_audio_adapter_linkable_init (WpSiLinkableInterface * iface)
 {
   iface->get_ports = si_audio_adapter_get_ports;
+  iface->get_port_set = si_audio_adapter_get_port_set;
 }
 
 WP_PLUGIN_EXPORT gboolean
@@ -353,10 +353,18 @@ si_audio_endpoint_get_ports (WpSiLinkable * item, const gchar * context)
   return wp_si_linkable_get_ports (WP_SI_LINKABLE (self->adapter), context);
 }
 
+static GArray *
+si_audio_endpoint_get_port_set (WpSiLinkable * item, const gchar * context)
+{
+  WpSiAudioEndpoint *self = WP_SI_AUDIO_ENDPOINT (item);
+  return wp_si_linkable_get_port_set (WP_SI_LINKABLE (self->adapter), context);
+}
+
 static void
 si_audio_endpoint_linkable_init (WpSiLinkableInterface * iface)
 {
   iface->get_ports = si_audio_endpoint_get_ports;
+  iface->get_port_set = si_audio_endpoint_get_port_set;
 }
 
 static WpSpaPod *
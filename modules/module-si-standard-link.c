@@ -239,59 +239,51 @@ score_ports(struct port *out, struct port *in)
 
 static gboolean
 create_links (WpSiStandardLink * self, WpTransition * transition,
-    GVariant * out_ports, GVariant * in_ports)
+    GArray * out_ports, GArray * in_ports)
 {
   g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (self));
   g_autoptr (GArray) in_ports_arr = NULL;
   struct port out_port = {0};
   struct port *in_port;
-  GVariantIter *iter = NULL;
-  guint i;
+  guint i, j;
 
   /* Clear old links if any */
   self->n_active_links = 0;
   self->n_failed_links = 0;
   g_clear_pointer (&self->node_links, g_ptr_array_unref);
 
-  /* tuple format:
-      uint32 node_id;
-      uint32 port_id;
-      uint32 channel;  // enum spa_audio_channel
-   */
-  if (!g_variant_is_of_type (out_ports, G_VARIANT_TYPE("a(uuu)")))
-    return FALSE;
-  if (!g_variant_is_of_type (in_ports, G_VARIANT_TYPE("a(uuu)")))
-    return FALSE;
-
-  i = g_variant_n_children (in_ports);
-  if (i == 0)
+  if (in_ports->len == 0)
     return FALSE;
 
   self->node_links = g_ptr_array_new_with_free_func (g_object_unref);
 
   /* transfer the in ports to an array so that we can
      mark them when they are linked */
-  in_ports_arr = g_array_sized_new (FALSE, TRUE, sizeof (struct port), i + 1);
-  g_array_set_size (in_ports_arr, i + 1);
-  g_variant_get (in_ports, "a(uuu)", &iter);
-  i = 0;
-  do {
-    in_port = &g_array_index (in_ports_arr, struct port, i++);
-  } while (g_variant_iter_loop (iter, "(uuu)", &in_port->node_id,
-              &in_port->port_id, &in_port->channel));
-  g_variant_iter_free (iter);
+  in_ports_arr = g_array_sized_new (FALSE, TRUE, sizeof (struct port),
+      in_ports->len);
+  g_array_set_size (in_ports_arr, in_ports->len);
+  for (i = 0; i < in_ports->len; i++) {
+    WpSiPortInfo *info = &g_array_index (in_ports, WpSiPortInfo, i);
+    in_port = &g_array_index (in_ports_arr, struct port, i);
+    in_port->node_id = info->node_id;
+    in_port->port_id = info->port_id;
+    in_port->channel = info->channel;
+  }
 
   /* now loop over the out ports and figure out where they should be linked */
-  g_variant_get (out_ports, "a(uuu)", &iter);
-  while (g_variant_iter_loop (iter, "(uuu)", &out_port.node_id,
-              &out_port.port_id, &out_port.channel))
+  for (j = 0; j < out_ports->len; j++)
   {
+    WpSiPortInfo *info = &g_array_index (out_ports, WpSiPortInfo, j);
     int best_score = 0;
     struct port *best_port = NULL;
     WpProperties *props = NULL;
     WpLink *link;
 
-    for (i = 0; i < in_ports_arr->len - 1; i++) {
+    out_port.node_id = info->node_id;
+    out_port.port_id = info->port_id;
+    out_port.channel = info->channel;
+
+    for (i = 0; i < in_ports_arr->len; i++) {
       in_port = &g_array_index (in_ports_arr, struct port, i);
       int score = score_ports (&out_port, in_port);
       if (score > best_score) {
@@ -331,7 +323,6 @@ create_links (WpSiStandardLink * self, WpTransition * transition,
         g_cclosure_new_object (
             (GCallback) on_link_activated, G_OBJECT (transition)));
   }
-  g_variant_iter_free (iter);
   return self->node_links->len > 0;
 }
 
@@ -340,8 +331,8 @@ get_ports_and_create_links (WpSiStandardLink *self, WpTransition *transition)
 {
   g_autoptr (WpSiLinkable) si_out = NULL;
   g_autoptr (WpSiLinkable) si_in = NULL;
-  g_autoptr (GVariant) out_ports = NULL;
-  g_autoptr (GVariant) in_ports = NULL;
+  g_autoptr (GArray) out_ports = NULL;
+  g_autoptr (GArray) in_ports = NULL;
 
   si_out = WP_SI_LINKABLE (g_weak_ref_get (&self->out_item));
   si_in = WP_SI_LINKABLE (g_weak_ref_get (&self->in_item));
@@ -355,8 +346,9 @@ get_ports_and_create_links (WpSiStandardLink *self, WpTransition *transition)
     return;
   }
 
-  out_ports = wp_si_linkable_get_ports (si_out, self->out_item_port_context);
-  in_ports = wp_si_linkable_get_ports (si_in, self->in_item_port_context);
+  out_ports = wp_si_linkable_get_port_set (si_out,
+      self->out_item_port_context);
+  in_ports = wp_si_linkable_get_port_set (si_in, self->in_item_port_context);
   if (!out_ports || !in_ports) {
     wp_transition_return_error (transition, g_error_new (WP_DOMAIN_LIBRARY,
           WP_LIBRARY_ERROR_INVARIANT,
@@ -20,3 +20,9 @@ load_script("intended-roles.lua")
 
 -- Automatically suspends idle nodes after 3 seconds
 load_script("suspend-node.lua")
+
+-- Publish a read-only snapshot of the graph in $XDG_RUNTIME_DIR, for
+-- monitoring tools that link to libwireplumber-graph-snapshot;
+-- volumes and defaults are filled in when the policy loads the mixer
+-- and default-nodes APIs
+--load_module("graph-snapshot", { ["max-nodes"] = 256 })
@@ -61,6 +61,8 @@ function default_policy.enable()
   -- Link endpoints with device nodes to make media flow in the graph
   load_script("policy-endpoint-device.lua", default_policy.policy)
 
-  -- Switch bluetooth profile based on media.role
+  -- Switch bluetooth profile based on media.role; the bluetooth-autoswitch
+  -- module implements the same logic natively and can be loaded instead:
+  -- load_module("bluetooth-autoswitch", bluetooth_policy.policy)
   load_script("policy-bluetooth.lua", bluetooth_policy.policy)
 end
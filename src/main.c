@@ -375,6 +375,25 @@ signal_handler_term (gpointer data)
 }
 
 
+static void
+start_watchdog (WpCore * core)
+{
+  struct pw_context *pw_ctx = wp_core_get_pw_context (core);
+  const struct pw_properties *props = pw_context_get_properties (pw_ctx);
+  guint threshold_ms = 0;
+  guint summary_interval = 60;
+  const gchar *str;
+
+  if ((str = pw_properties_get (props, "wireplumber.watchdog.threshold-ms")))
+    threshold_ms = (guint) g_ascii_strtoull (str, NULL, 10);
+  if ((str = pw_properties_get (props,
+              "wireplumber.watchdog.summary-interval")))
+    summary_interval = (guint) g_ascii_strtoull (str, NULL, 10);
+
+  if (threshold_ms > 0)
+    wp_watchdog_start (NULL, threshold_ms, summary_interval);
+}
+
 static gboolean
 init_start (WpTransition * transition)
 {
@@ -449,7 +468,9 @@ main (gint argc, gchar **argv)
           NULL, (GAsyncReadyCallback) init_done, &d));
 
   /* run */
+  start_watchdog (d.core);
   g_main_loop_run (d.loop);
+  wp_watchdog_stop ();
   wp_core_disconnect (d.core);
   return d.exit_code;
 }
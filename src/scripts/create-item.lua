@@ -10,54 +10,6 @@ local config = ... or {}
 
 items = {}
 
-function configProperties(node)
-  local np = node.properties
-  local properties = {
-    ["item.node"] = node,
-    ["item.plugged.usec"] = GLib.get_monotonic_time(),
-    ["item.features.no-dsp"] = config["audio.no-dsp"],
-    ["item.features.monitor"] = true,
-    ["item.features.control-port"] = false,
-    ["node.id"] = node["bound-id"],
-    ["client.id"] = np["client.id"],
-    ["object.path"] = np["object.path"],
-    ["object.serial"] = np["object.serial"],
-    ["target.object"] = np["target.object"],
-    ["priority.session"] = np["priority.session"],
-    ["device.id"] = np["device.id"],
-    ["card.profile.device"] = np["card.profile.device"],
-  }
-
-  for k, v in pairs(np) do
-    if k:find("^node") or k:find("^stream") or k:find("^media") then
-      properties[k] = v
-    end
-  end
-
-  local media_class = properties["media.class"] or ""
-
-  if not properties["media.type"] then
-    for _, i in ipairs({ "Audio", "Video", "Midi" }) do
-      if media_class:find(i) then
-        properties["media.type"] = i
-        break
-      end
-    end
-  end
-
-  properties["item.node.type"] =
-      media_class:find("^Stream/") and "stream" or "device"
-
-  if media_class:find("Sink") or
-      media_class:find("Input") or
-      media_class:find("Duplex") then
-    properties["item.node.direction"] = "input"
-  elseif media_class:find("Source") or media_class:find("Output") then
-    properties["item.node.direction"] = "output"
-  end
-  return properties
-end
-
 function addItem (node, item_type)
   local id = node["bound-id"]
   local item
@@ -66,8 +18,13 @@ function addItem (node, item_type)
   item = SessionItem ( item_type )
   items[id] = item
 
-  -- configure item
-  if not item:configure(configProperties(node)) then
+  -- configure item; the node properties are copied natively
+  if not item:configure_for_node(node, {
+    ["item.plugged.usec"] = GLib.get_monotonic_time(),
+    ["item.features.no-dsp"] = config["audio.no-dsp"],
+    ["item.features.monitor"] = true,
+    ["item.features.control-port"] = false,
+  }) then
     Log.warning(item, "failed to configure item for node " .. tostring(id))
     return
   end
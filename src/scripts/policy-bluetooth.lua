@@ -31,8 +31,8 @@ local use_headset_profile = config["media-role.use-headset-profile"] or false
 local profile_restore_timeout_msec = 2000
 
 local INVALID = -1
-local timeout_source = nil
-local restore_timeout_source = nil
+local store_timer = nil
+local restore_timer = nil
 
 local state = use_persistent_storage and State("policy-bluetooth") or nil
 local headset_profiles = state and state:load() or {}
@@ -65,15 +65,19 @@ streams_om = ObjectManager {
     Constraint { "media.class", "matches", "Stream/Input/Audio", type = "pw-global" },
     -- Do not consider monitor streams
     Constraint { "stream.monitor", "!", "true" }
-  }
+  },
+  -- streams are added and removed as their properties change
+  live = true,
 }
 
-local function parseParam(param_to_parse, id)
-  local param = param_to_parse:parse()
-  if param.pod_type == "Object" and param.object_id == id then
-    return param.properties
-  else
+local function parseParam(param, id, ...)
+  -- only decode the requested properties, if any were given
+  if param:get_object_id() ~= id then
     return nil
+  elseif select("#", ...) > 0 then
+    return param:pick(...)
+  else
+    return param:parse().properties
   end
 end
 
@@ -82,16 +86,15 @@ local function storeAfterTimeout()
     return
   end
 
-  if timeout_source then
-    timeout_source:destroy()
+  if not store_timer then
+    store_timer = Timer(function ()
+      local saved, err = state:save(headset_profiles)
+      if not saved then
+        Log.warning(err)
+      end
+    end)
   end
-  timeout_source = Core.timeout_add(1000, function ()
-    local saved, err = state:save(headset_profiles)
-    if not saved then
-      Log.warning(err)
-    end
-    timeout_source = nil
-  end)
+  store_timer:start(1000)
 end
 
 local function saveHeadsetProfile(device, profile_name)
@@ -132,7 +135,7 @@ end
 
 local function findProfile(device, index, name)
   for p in device:iterate_params("EnumProfile") do
-    local profile = parseParam(p, "EnumProfile")
+    local profile = parseParam(p, "EnumProfile", "index", "name", "priority")
     if not profile then
       goto skip_enum_profile
     end
@@ -152,7 +155,7 @@ end
 
 local function getCurrentProfile(device)
   for p in device:iterate_params("Profile") do
-    local profile = parseParam(p, "Profile")
+    local profile = parseParam(p, "Profile", "name")
     if profile then
       return profile.name
     end
@@ -167,7 +170,8 @@ local function highestPrioProfileWithInputRoute(device)
   local profile_name = nil
 
   for p in device:iterate_params("EnumRoute") do
-    local route = parseParam(p, "EnumRoute")
+    local route = parseParam(p, "EnumRoute",
+        "index", "direction", "name", "description", "priority", "profiles")
     -- Parse pod
     if not route then
       goto skip_enum_route
@@ -201,7 +205,7 @@ end
 
 local function hasProfileInputRoute(device, profile_index)
   for p in device:iterate_params("EnumRoute") do
-    local route = parseParam(p, "EnumRoute")
+    local route = parseParam(p, "EnumRoute", "direction", "profiles")
     if route and route.direction == "Input" and route.profiles then
       for _, v in pairs(route.profiles) do
         if v == profile_index then
@@ -217,9 +221,8 @@ local function switchProfile()
   local index
   local name
 
-  if restore_timeout_source then
-    restore_timeout_source:destroy()
-    restore_timeout_source = nil
+  if restore_timer then
+    restore_timer:stop()
   end
 
   for device in devices_om:iterate() do
@@ -300,16 +303,18 @@ local function restoreProfile()
 end
 
 local function triggerRestoreProfile()
-  if restore_timeout_source then
+  if restore_timer and restore_timer:is_pending() then
     return
   end
   if next(active_streams) ~= nil then
     return
   end
-  restore_timeout_source = Core.timeout_add(profile_restore_timeout_msec, function ()
-    restore_timeout_source = nil
-    restoreProfile()
-  end)
+  if not restore_timer then
+    restore_timer = Timer(function ()
+      restoreProfile()
+    end)
+  end
+  restore_timer:start(profile_restore_timeout_msec)
 end
 
 -- We consider a Stream of interest to have role Communication if it has
@@ -337,11 +342,24 @@ local function checkStreamStatus(stream)
   return true
 end
 
+-- streams that are currently in streams_om, by bound id
+local tracked_streams = {}
+-- streams whose signals are connected; since streams_om is live, the same
+-- stream may be removed and added again, while its handlers stay connected.
+-- Entries are dropped when the stream goes away from PipeWire.
+local connected_streams = {}
+
 local function handleStream(stream)
   if not use_headset_profile then
     return
   end
 
+  -- the handlers of a stream that does not match streams_om anymore are
+  -- still connected; ignore them
+  if not tracked_streams[stream["bound-id"]] then
+    return
+  end
+
   if checkStreamStatus(stream) then
     active_streams[stream["bound-id"]] = true
     previous_streams[stream["bound-id"]] = true
@@ -353,23 +371,28 @@ local function handleStream(stream)
 end
 
 local function handleAllStreams()
-  for stream in streams_om:iterate {
-    Constraint { "media.class", "matches", "Stream/Input/Audio", type = "pw-global" },
-    Constraint { "stream.monitor", "!", "true" }
-  } do
+  for stream in streams_om:iterate() do
     handleStream(stream)
   end
 end
 
 streams_om:connect("object-added", function (_, stream)
-  stream:connect("state-changed", function (stream, old_state, cur_state)
-    handleStream(stream)
-  end)
-  stream:connect("params-changed", handleStream)
+  tracked_streams[stream["bound-id"]] = true
+  if not connected_streams[stream] then
+    connected_streams[stream] = true
+    stream:connect("state-changed", function (stream, old_state, cur_state)
+      handleStream(stream)
+    end)
+    stream:connect("params-changed", handleStream)
+    stream:connect("pw-proxy-destroyed", function (stream)
+      connected_streams[stream] = nil
+    end)
+  end
   handleStream(stream)
 end)
 
 streams_om:connect("object-removed", function (_, stream)
+  tracked_streams[stream["bound-id"]] = nil
   active_streams[stream["bound-id"]] = nil
   previous_streams[stream["bound-id"]] = nil
   triggerRestoreProfile()
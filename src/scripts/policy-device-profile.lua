@@ -46,12 +46,14 @@ function isProfilePersistent(device_props, profile_name)
 end
 
 
-function parseParam(param, id)
-  local parsed = param:parse()
-  if parsed.pod_type == "Object" and parsed.object_id == id then
-    return parsed.properties
-  else
+function parseParam(param, id, ...)
+  -- only decode the requested properties, if any were given
+  if param:get_object_id() ~= id then
     return nil
+  elseif select("#", ...) > 0 then
+    return param:pick(...)
+  else
+    return param:parse().properties
   end
 end
 
@@ -81,7 +83,8 @@ function findDefaultProfile (device)
   end
 
   for p in device:iterate_params("EnumProfile") do
-    local profile = parseParam(p, "EnumProfile")
+    local profile = parseParam(p, "EnumProfile",
+        "index", "name", "available", "priority")
     if profile.name == def_name then
       return profile
     end
@@ -96,7 +99,8 @@ function findBestProfile (device)
   local unk_profile = nil
 
   for p in device:iterate_params("EnumProfile") do
-    profile = parseParam(p, "EnumProfile")
+    profile = parseParam(p, "EnumProfile",
+        "index", "name", "available", "priority")
     if profile and profile.name ~= "pro-audio" then
       if profile.name == "off" then
         off_profile = profile
@@ -127,7 +131,8 @@ function handleActiveProfile (device, dev_id, dev_name)
   -- Get active profile
   local profile = nil
   for p in device:iterate_params("Profile") do
-    profile = parseParam(p, "Profile")
+    profile = parseParam(p, "Profile",
+        "index", "name", "available", "priority")
   end
   if profile == nil then
     Log.info ("Cannot find active profile for device " .. dev_name)
@@ -19,9 +19,11 @@ default_volume = tonumber(config["default-volume"] or 0.4)
 -- table of device info
 dev_infos = {}
 
--- the state storage
+-- the state storage; saved profile routes are stored as properties and
+-- route props as typed records, one group per device route
 state = use_persistent_storage and State("default-routes") or nil
 state_table = state and state:load() or {}
+route_records = state and state:load_records() or {}
 
 -- simple serializer {"foo", "bar"} -> "foo;bar;"
 function serializeArray(a)
@@ -53,6 +55,41 @@ function parseArray(str, convert_value)
   return array
 end
 
+-- moves route props stored as strings by older versions into the records
+function migrateLegacyState()
+  local migrated = false
+  for k, v in pairs(state_table) do
+    local key_base, prop = k:match("^(.*):(%a+)$")
+    local record = nil
+    if prop == "volume" or prop == "mute" or prop == "channelVolumes" or
+        prop == "channelMap" or prop == "latencyOffsetNsec" or
+        prop == "iec958Codecs" then
+      record = route_records[key_base] or {}
+      route_records[key_base] = record
+    end
+
+    if prop == "volume" then
+      record.volume = tonumber(v)
+    elseif prop == "mute" then
+      record.mute = (v == "true")
+    elseif prop == "channelVolumes" then
+      record.channelVolumes = parseArray(v, tonumber)
+    elseif prop == "channelMap" then
+      record.channelMap = parseArray(v)
+    elseif prop == "latencyOffsetNsec" then
+      record.latencyOffsetNsec = math.tointeger(v)
+    elseif prop == "iec958Codecs" then
+      record.iec958Codecs = parseArray(v)
+    end
+
+    if record then
+      state_table[k] = nil
+      migrated = true
+    end
+  end
+  return migrated
+end
+
 function arrayContains(a, value)
   for _, v in ipairs(a) do
     if v == value then
@@ -62,26 +99,31 @@ function arrayContains(a, value)
   return false
 end
 
-function parseParam(param, id)
-  local route = param:parse()
-  if route.pod_type == "Object" and route.object_id == id then
-    return route.properties
-  else
+function parseParam(param, id, ...)
+  -- only decode the requested properties, if any were given
+  if param:get_object_id() ~= id then
     return nil
+  elseif select("#", ...) > 0 then
+    return param:pick(...)
+  else
+    return param:parse().properties
   end
 end
 
 function storeAfterTimeout()
-  if timeout_source then
-    timeout_source:destroy()
+  if not store_timer then
+    store_timer = Timer(function ()
+      local saved, err = state:save(state_table)
+      if not saved then
+        Log.warning(err)
+      end
+      saved, err = state:save_records(route_records)
+      if not saved then
+        Log.warning(err)
+      end
+    end)
   end
-  timeout_source = Core.timeout_add(1000, function ()
-    local saved, err = state:save(state_table)
-    if not saved then
-      Log.warning(err)
-    end
-    timeout_source = nil
-  end)
+  store_timer:start(1000)
 end
 
 function saveProfile(dev_info, profile_name)
@@ -109,22 +151,18 @@ function saveRouteProps(dev_info, route)
   end
 
   local props = route.props.properties
-  local key_base = dev_info.name .. ":" ..
-                   route.direction:lower() .. ":" ..
-                   route.name .. ":"
-
-  state_table[key_base .. "volume"] =
-    props.volume and tostring(props.volume) or nil
-  state_table[key_base .. "mute"] =
-    props.mute and tostring(props.mute) or nil
-  state_table[key_base .. "channelVolumes"] =
-    props.channelVolumes and serializeArray(props.channelVolumes) or nil
-  state_table[key_base .. "channelMap"] =
-    props.channelMap and serializeArray(props.channelMap) or nil
-  state_table[key_base .. "latencyOffsetNsec"] =
-    props.latencyOffsetNsec and tostring(props.latencyOffsetNsec) or nil
-  state_table[key_base .. "iec958Codecs"] =
-    props.iec958Codecs and serializeArray(props.iec958Codecs) or nil
+  local key = dev_info.name .. ":" ..
+              route.direction:lower() .. ":" ..
+              route.name
+
+  route_records[key] = {
+    volume = props.volume,
+    mute = props.mute,
+    channelVolumes = props.channelVolumes,
+    channelMap = props.channelMap,
+    latencyOffsetNsec = props.latencyOffsetNsec,
+    iec958Codecs = props.iec958Codecs,
+  }
 
   storeAfterTimeout()
 end
@@ -139,41 +177,35 @@ function restoreRoute(device, dev_info, device_id, route)
 
   -- restore props from persistent storage
   if use_persistent_storage then
-    local key_base = dev_info.name .. ":" ..
-                     route.direction:lower() .. ":" ..
-                     route.name .. ":"
-
-    local str = state_table[key_base .. "volume"]
-    props.volume = str and tonumber(str) or props.volume
-
-    local str = state_table[key_base .. "mute"]
-    props.mute = str and (str == "true") or false
-
-    local str = state_table[key_base .. "channelVolumes"]
-    props.channelVolumes = str and parseArray(str, tonumber) or props.channelVolumes
-
-    local str = state_table[key_base .. "channelMap"]
-    props.channelMap = str and parseArray(str) or props.channelMap
-
-    local str = state_table[key_base .. "latencyOffsetNsec"]
-    props.latencyOffsetNsec = str and math.tointeger(str) or props.latencyOffsetNsec
-
-    local str = state_table[key_base .. "iec958Codecs"]
-    props.iec958Codecs = str and parseArray(str) or props.iec958Codecs
+    local key = dev_info.name .. ":" ..
+                route.direction:lower() .. ":" ..
+                route.name
+    local record = route_records[key] or {}
+
+    props.volume = record.volume or props.volume
+    props.mute = record.mute or false
+    props.channelVolumes = record.channelVolumes or props.channelVolumes
+    props.channelMap = record.channelMap or props.channelMap
+    props.latencyOffsetNsec =
+        math.tointeger(record.latencyOffsetNsec) or props.latencyOffsetNsec
+    props.iec958Codecs = record.iec958Codecs or props.iec958Codecs
   end
 
   -- convert arrays to Spa Pod
   if props.channelVolumes then
-    table.insert(props.channelVolumes, 1, "Spa:Float")
-    props.channelVolumes = Pod.Array(props.channelVolumes)
+    props.channelVolumes = Pod.Array {
+      "Spa:Float", table.unpack(props.channelVolumes)
+    }
   end
   if props.channelMap then
-    table.insert(props.channelMap, 1, "Spa:Enum:AudioChannel")
-    props.channelMap = Pod.Array(props.channelMap)
+    props.channelMap = Pod.Array {
+      "Spa:Enum:AudioChannel", table.unpack(props.channelMap)
+    }
   end
   if props.iec958Codecs then
-    table.insert(props.iec958Codecs, 1, "Spa:Enum:AudioIEC958Codec")
-    props.iec958Codecs = Pod.Array(props.iec958Codecs)
+    props.iec958Codecs = Pod.Array {
+      "Spa:Enum:AudioIEC958Codec", table.unpack(props.iec958Codecs)
+    }
   end
 
   -- construct Route param
@@ -356,13 +388,14 @@ function handleDevice(device)
 
   -- get current profile
   for p in device:iterate_params("Profile") do
-    profile = parseParam(p, "Profile")
+    profile = parseParam(p, "Profile", "index", "name", "classes")
   end
 
   -- look at all the routes and update/reset cached information
   for p in device:iterate_params("EnumRoute") do
     -- parse pod
-    local route = parseParam(p, "EnumRoute")
+    local route = parseParam(p, "EnumRoute", "index", "name", "direction",
+        "devices", "priority", "available", "profiles")
     if not route then
       goto skip_enum_route
     end
@@ -444,6 +477,10 @@ function handleDevice(device)
   end
 end
 
+if use_persistent_storage and migrateLegacyState() then
+  storeAfterTimeout()
+end
+
 om = ObjectManager {
   Interest {
     type = "device",
@@ -154,8 +154,7 @@ function canPassthrough (si, si_target)
   local n1 = si:get_associated_proxy ("node")
   local n2 = si_target:get_associated_proxy ("node")
   for p1 in n1:iterate_params("EnumFormat") do
-    local p1p = p1:parse()
-    if p1p.properties.mediaSubtype ~= "raw" then
+    if p1:get("mediaSubtype") ~= "raw" then
       for p2 in n2:iterate_params("EnumFormat") do
         if p1:filter(p2) then
           return true
@@ -324,12 +323,14 @@ function findDefinedTarget (properties)
   return nil, (target_value ~= nil), node_defined
 end
 
-function parseParam(param, id)
-  local route = param:parse()
-  if route.pod_type == "Object" and route.object_id == id then
-    return route.properties
-  else
+function parseParam(param, id, ...)
+  -- only decode the requested properties, if any were given
+  if param:get_object_id() ~= id then
     return nil
+  elseif select("#", ...) > 0 then
+    return param:pick(...)
+  else
+    return param:parse().properties
   end
 end
 
@@ -362,7 +363,7 @@ function haveAvailableRoutes (si_props)
   -- First check "SPA_PARAM_Route" if there are any active devices
   -- in an active profile.
   for p in device:iterate_params("Route") do
-    local route = parseParam(p, "Route")
+    local route = parseParam(p, "Route", "device", "available")
     if not route then
       goto skip_route
     end
@@ -383,7 +384,7 @@ function haveAvailableRoutes (si_props)
   -- Second check "SPA_PARAM_EnumRoute" if there is any route that
   -- is available if not active.
   for p in device:iterate_params("EnumRoute") do
-    local route = parseParam(p, "EnumRoute")
+    local route = parseParam(p, "EnumRoute", "devices", "available")
     if not route then
       goto skip_enum_route
     end
@@ -868,7 +869,7 @@ linkables_om:connect("object-removed", function (om, si)
 end)
 
 devices_om:connect("object-added", function (om, device)
-  device:connect("params-changed", function (d, param_name)
+  device:connect_deferred("params-changed", function (d, param_name)
     scheduleRescan ()
   end)
 end)
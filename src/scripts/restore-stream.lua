@@ -44,21 +44,34 @@ function rulesApplyProperties(properties)
   end
 end
 
--- the state storage
+-- the state storage; stream targets are stored as properties and
+-- stream props as typed records, one group per stream key
 state = State("restore-stream")
 state_table = state:load()
+stream_records = state:load_records()
 
--- simple serializer {"foo", "bar"} -> "foo;bar;"
-function serializeArray(a)
-  local str = ""
-  for _, v in ipairs(a) do
-    str = str .. tostring(v):gsub(";", "\\;") .. ";"
+-- returns the record group of the given stream key, creating it if needed
+function getStreamRecord(key_base)
+  local record = stream_records[key_base]
+  if type(record) ~= "table" then
+    record = {}
+    stream_records[key_base] = record
   end
-  return str
+  return record
 end
 
--- simple deserializer "foo;bar;" -> {"foo", "bar"}
-function parseArray(str, convert_value, with_type)
+-- copies an array, marking it as such for jsonTable()
+function jsonArray(a)
+  local array = { pod_type = "Array" }
+  for i, v in ipairs(a) do
+    array[i] = v
+  end
+  return array
+end
+
+-- simple deserializer "foo;bar;" -> {"foo", "bar"}, used to migrate
+-- stream props that older versions stored as strings
+function parseArray(str, convert_value)
   local array = {}
   local val = ""
   local escaped = false
@@ -75,32 +88,57 @@ function parseArray(str, convert_value, with_type)
       escaped = false
     end
   end
-  if with_type then
-    array["pod_type"] = "Array"
-  end
   return array
 end
 
-function parseParam(param, id)
-  local route = param:parse()
-  if route.pod_type == "Object" and route.object_id == id then
-    return route.properties
-  else
+-- moves stream props stored as strings by older versions into the records
+function migrateLegacyState()
+  local migrated = false
+  for k, v in pairs(state_table) do
+    local key_base, prop = k:match("^(.*):(%a+)$")
+    if prop == "volume" then
+      getStreamRecord(key_base).volume = tonumber(v)
+    elseif prop == "mute" then
+      getStreamRecord(key_base).mute = (v == "true")
+    elseif prop == "channelVolumes" then
+      getStreamRecord(key_base).channelVolumes = parseArray(v, tonumber)
+    elseif prop == "channelMap" then
+      getStreamRecord(key_base).channelMap = parseArray(v)
+    else
+      goto next_key
+    end
+    state_table[k] = nil
+    migrated = true
+    ::next_key::
+  end
+  return migrated
+end
+
+function parseParam(param, id, ...)
+  -- only decode the requested properties, if any were given
+  if param:get_object_id() ~= id then
     return nil
+  elseif select("#", ...) > 0 then
+    return param:pick(...)
+  else
+    return param:parse().properties
   end
 end
 
 function storeAfterTimeout()
-  if timeout_source then
-    timeout_source:destroy()
+  if not store_timer then
+    store_timer = Timer(function ()
+      local saved, err = state:save(state_table)
+      if not saved then
+        Log.warning(err)
+      end
+      saved, err = state:save_records(stream_records)
+      if not saved then
+        Log.warning(err)
+      end
+    end)
   end
-  timeout_source = Core.timeout_add(1000, function ()
-    local saved, err = state:save(state_table)
-    if not saved then
-      Log.warning(err)
-    end
-    timeout_source = nil
-  end)
+  store_timer:start(1000)
 end
 
 function findSuitableKey(properties)
@@ -238,24 +276,25 @@ function moveToMetadata(key_base, metadata)
   key = "restore.stream." .. key_base
   key = string.gsub(key, ":", ".", 1);
 
-  local str = state_table[key_base .. ":volume"]
-  if str then
-    route_table["volume"] = tonumber(str)
+  local record = stream_records[key_base]
+  if type(record) ~= "table" then
+    return
+  end
+
+  if record.volume then
+    route_table["volume"] = record.volume
     count = count + 1;
   end
-  local str = state_table[key_base .. ":mute"]
-  if str then
-    route_table["mute"] = str == "true"
+  if record.mute ~= nil then
+    route_table["mute"] = record.mute
     count = count + 1;
   end
-  local str = state_table[key_base .. ":channelVolumes"]
-  if str then
-    route_table["volumes"] = parseArray(str, tonumber, true)
+  if record.channelVolumes then
+    route_table["volumes"] = jsonArray(record.channelVolumes)
     count = count + 1;
   end
-  local str = state_table[key_base .. ":channelMap"]
-  if str then
-    route_table["channels"] = parseArray(str, nil, true)
+  if record.channelMap then
+    route_table["channels"] = jsonArray(record.channelMap)
     count = count + 1;
   end
 
@@ -279,22 +318,24 @@ function saveStream(node)
         tostring(stream_props["node.name"]))
 
     for p in node:iterate_params("Props") do
-      local props = parseParam(p, "Props")
+      local props = parseParam(p, "Props",
+          "volume", "mute", "channelVolumes", "channelMap")
       if not props then
         goto skip_prop
       end
 
+      local record = getStreamRecord(key_base)
       if props.volume then
-        state_table[key_base .. ":volume"] = tostring(props.volume)
+        record.volume = props.volume
       end
       if props.mute ~= nil then
-        state_table[key_base .. ":mute"] = tostring(props.mute)
+        record.mute = props.mute
       end
       if props.channelVolumes then
-        state_table[key_base .. ":channelVolumes"] = serializeArray(props.channelVolumes)
+        record.channelVolumes = props.channelVolumes
       end
       if props.channelMap then
-        state_table[key_base .. ":channelMap"] = serializeArray(props.channelMap)
+        record.channelMap = props.channelMap
       end
 
       ::skip_prop::
@@ -314,36 +355,28 @@ function restoreStream(node)
   end
 
   if config_restore_props and stream_props["state.restore-props"] ~= false then
-    local needsRestore = false
-    local props = { "Spa:Pod:Object:Param:Props", "Props" }
-
-    local str = state_table[key_base .. ":volume"]
-    needsRestore = str and true or needsRestore
-    props.volume = str and tonumber(str) or nil
-
-    local str = state_table[key_base .. ":mute"]
-    needsRestore = str and true or needsRestore
-    props.mute = str and (str == "true") or nil
-
-    local str = state_table[key_base .. ":channelVolumes"]
-    needsRestore = str and true or needsRestore
-    props.channelVolumes = str and parseArray(str, tonumber) or nil
-
-    local str = state_table[key_base .. ":channelMap"]
-    needsRestore = str and true or needsRestore
-    props.channelMap = str and parseArray(str) or nil
-
-    -- convert arrays to Spa Pod
-    if props.channelVolumes then
-      table.insert(props.channelVolumes, 1, "Spa:Float")
-      props.channelVolumes = Pod.Array(props.channelVolumes)
-    end
-    if props.channelMap then
-      table.insert(props.channelMap, 1, "Spa:Enum:AudioChannel")
-      props.channelMap = Pod.Array(props.channelMap)
-    end
+    local record = stream_records[key_base]
+    local needsRestore = type(record) == "table" and
+        (record.volume ~= nil or record.mute ~= nil or
+         record.channelVolumes ~= nil or record.channelMap ~= nil)
 
     if needsRestore then
+      local props = { "Spa:Pod:Object:Param:Props", "Props" }
+      props.volume = record.volume
+      props.mute = record.mute
+
+      -- convert arrays to Spa Pod
+      if record.channelVolumes then
+        props.channelVolumes = Pod.Array {
+          "Spa:Float", table.unpack(record.channelVolumes)
+        }
+      end
+      if record.channelMap then
+        props.channelMap = Pod.Array {
+          "Spa:Enum:AudioChannel", table.unpack(record.channelMap)
+        }
+      end
+
       Log.info(node, "restore values from " .. key_base)
 
       local param = Pod.Object(props)
@@ -402,23 +435,28 @@ function handleRouteSettings(subject, key, type, value)
 
   key_base = string.gsub(key_base, "%.", ":", 1);
 
+  local record = getStreamRecord(key_base)
   if vparsed.volume ~= nil then
-    state_table[key_base .. ":volume"] = tostring (vparsed.volume)
+    record.volume = vparsed.volume
   end
   if vparsed.mute ~= nil then
-    state_table[key_base .. ":mute"] = tostring (vparsed.mute)
+    record.mute = vparsed.mute
   end
   if vparsed.channels ~= nil then
-    state_table[key_base .. ":channelMap"] = serializeArray (vparsed.channels)
+    record.channelMap = vparsed.channels
   end
   if vparsed.volumes ~= nil then
-    state_table[key_base .. ":channelVolumes"] = serializeArray (vparsed.volumes)
+    record.channelVolumes = vparsed.volumes
   end
 
   storeAfterTimeout()
 end
 
 
+if migrateLegacyState() then
+  storeAfterTimeout()
+end
+
 rs_metadata = ImplMetadata("route-settings")
 rs_metadata:activate(Features.ALL, function (m, e)
   if e then
@@ -456,7 +494,7 @@ streams_om = ObjectManager {
   },
 }
 streams_om:connect("object-added", function (streams_om, node)
-  node:connect("params-changed", saveStream)
+  node:connect_deferred("params-changed", saveStream)
   restoreStream(node)
 end)
 streams_om:activate()
@@ -14,18 +14,18 @@ om = ObjectManager {
   },
 }
 
-sources = {}
+timers = {}
 
 om:connect("object-added", function (om, node)
   node:connect("state-changed", function (node, old_state, cur_state)
-    -- Always clear the current source if any
+    -- Always stop the current timer if any
     local id = node["bound-id"]
-    if sources[id] then
-      sources[id]:destroy()
-      sources[id] = nil
+    local timer = timers[id]
+    if timer then
+      timer:stop()
     end
 
-    -- Add a timeout source if idle for at least 5 seconds
+    -- Start the timer if idle for at least 5 seconds
     if cur_state == "idle" then
       -- honor "session.suspend-timeout-seconds" if specified
       local timeout =
@@ -35,22 +35,29 @@ om:connect("object-added", function (om, node)
         return
       end
 
-      -- add idle timeout; multiply by 1000, timeout_add() expects ms
-      sources[id] = Core.timeout_add(timeout * 1000, function()
-        -- Suspend the node
-        Log.info(node, "was idle for a while; suspending ...")
-        node:send_command("Suspend")
-
-        -- Unref the source
-        sources[id] = nil
+      -- the timer is created once per node and re-armed on every change
+      if not timer then
+        timer = Timer(function()
+          -- Suspend the node
+          Log.info(node, "was idle for a while; suspending ...")
+          node:send_command("Suspend")
+        end)
+        timers[id] = timer
+      end
 
-        -- false (== G_SOURCE_REMOVE) destroys the source so that this
-        -- function does not get fired again after 5 seconds
-        return false
-      end)
+      -- multiply by 1000, start() expects ms
+      timer:start(timeout * 1000)
     end
 
   end)
 end)
 
+om:connect("object-removed", function (om, node)
+  local id = node["bound-id"]
+  if timers[id] then
+    timers[id]:stop()
+    timers[id] = nil
+  end
+end)
+
 om:activate()
@@ -8,6 +8,8 @@
 
 #include <wp/wp.h>
 #include <stdio.h>
+#include <math.h>
+#include <unistd.h>
 #include <spa/utils/defs.h>
 #include <pipewire/keys.h>
 #include <pipewire/extensions/session-manager/keys.h>
@@ -27,11 +29,25 @@ struct _WpCtl
   GPtrArray *apis;
   WpObjectManager *om;
   guint pending_plugins;
+  /* in batch mode, a failure of any command is kept until the end */
   gint exit_code;
+
+  /* batch mode */
+  struct {
+    GIOChannel *channel;
+    guint watch_id;
+    gboolean active;
+    gboolean busy;
+    gboolean processing;
+  } batch;
 };
 
 static struct {
   union {
+    struct {
+      gboolean fast;
+    } status;
+
     struct {
       guint32 id;
       gboolean show_referenced;
@@ -58,6 +74,14 @@ static struct {
     struct {
       guint32 id;
     } clear_default;
+
+    struct {
+      gchar command[32];
+    } profile;
+
+    struct {
+      const gchar *file;
+    } batch;
   };
 } cmdline;
 
@@ -66,6 +90,9 @@ G_DEFINE_QUARK (wpctl-error, wpctl_error_domain)
 static void
 wp_ctl_clear (WpCtl * self)
 {
+  if (self->batch.watch_id)
+    g_source_remove (self->batch.watch_id);
+  g_clear_pointer (&self->batch.channel, g_io_channel_unref);
   g_clear_pointer (&self->apis, g_ptr_array_unref);
   g_clear_object (&self->om);
   g_clear_object (&self->core);
@@ -73,10 +100,30 @@ wp_ctl_clear (WpCtl * self)
   g_clear_pointer (&self->context, g_option_context_free);
 }
 
+static void batch_process (WpCtl * self);
+
+/* called by every command when it has finished running */
+static void
+command_done (WpCtl * self)
+{
+  if (!self->batch.active) {
+    g_main_loop_quit (self->loop);
+    return;
+  }
+
+  fflush (stdout);
+  self->batch.busy = FALSE;
+
+  /* continue with the next command, unless we are called synchronously
+     from within batch_process(), which will pick it up by itself */
+  if (!self->batch.processing)
+    batch_process (self);
+}
+
 static void
-async_quit (WpCore *core, GAsyncResult *res, WpCtl * self)
+async_done (WpCore *core, GAsyncResult *res, WpCtl * self)
 {
-  g_main_loop_quit (self->loop);
+  command_done (self);
 }
 
 /* status */
@@ -100,20 +147,162 @@ status_prepare (WpCtl * self, GError ** error)
 #define TREE_INDENT_END  " └─ "
 #define TREE_INDENT_EMPTY "    "
 
+/* used by 'status --fast'; indexes all the objects of the object manager
+   in one pass, so that printing does not need to query it repeatedly */
+struct status_snapshot
+{
+  WpCtl *self;
+  GPtrArray *clients;
+  GPtrArray *devices;
+  GPtrArray *nodes;
+  GPtrArray *endpoints;
+  GHashTable *ports;    /* node id -> GPtrArray of WpPort */
+  GHashTable *links;    /* port id -> WpLink */
+  GHashTable *objects;  /* bound id -> WpProxy */
+  GHashTable *volumes;  /* node id -> GVariant, when there is no mixer api */
+  gboolean lazy_volumes;
+  guint pending;
+};
+
 struct print_context
 {
   WpCtl *self;
   guint32 default_node;
   WpPlugin *mixer_api;
+  struct status_snapshot *snapshot;
 };
 
+static void
+status_snapshot_free (struct status_snapshot * snapshot)
+{
+  g_clear_pointer (&snapshot->clients, g_ptr_array_unref);
+  g_clear_pointer (&snapshot->devices, g_ptr_array_unref);
+  g_clear_pointer (&snapshot->nodes, g_ptr_array_unref);
+  g_clear_pointer (&snapshot->endpoints, g_ptr_array_unref);
+  g_clear_pointer (&snapshot->ports, g_hash_table_unref);
+  g_clear_pointer (&snapshot->links, g_hash_table_unref);
+  g_clear_pointer (&snapshot->objects, g_hash_table_unref);
+  g_clear_pointer (&snapshot->volumes, g_hash_table_unref);
+  g_slice_free (struct status_snapshot, snapshot);
+}
+
+static struct status_snapshot *
+status_snapshot_new (WpCtl * self)
+{
+  struct status_snapshot *snapshot = g_slice_new0 (struct status_snapshot);
+  g_autoptr (WpIterator) it = wp_object_manager_new_iterator (self->om);
+  g_auto (GValue) val = G_VALUE_INIT;
+
+  snapshot->self = self;
+  snapshot->clients = g_ptr_array_new_with_free_func (g_object_unref);
+  snapshot->devices = g_ptr_array_new_with_free_func (g_object_unref);
+  snapshot->nodes = g_ptr_array_new_with_free_func (g_object_unref);
+  snapshot->endpoints = g_ptr_array_new_with_free_func (g_object_unref);
+  snapshot->ports = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) g_ptr_array_unref);
+  snapshot->links = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, g_object_unref);
+  snapshot->objects = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, g_object_unref);
+  snapshot->volumes = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) g_variant_unref);
+
+  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
+    WpProxy *proxy = g_value_get_object (&val);
+    guint32 id = wp_proxy_get_bound_id (proxy);
+
+    g_hash_table_insert (snapshot->objects, GUINT_TO_POINTER (id),
+        g_object_ref (proxy));
+
+    if (WP_IS_CLIENT (proxy)) {
+      g_ptr_array_add (snapshot->clients, g_object_ref (proxy));
+    } else if (WP_IS_DEVICE (proxy)) {
+      g_ptr_array_add (snapshot->devices, g_object_ref (proxy));
+    } else if (WP_IS_NODE (proxy)) {
+      g_ptr_array_add (snapshot->nodes, g_object_ref (proxy));
+    } else if (WP_IS_ENDPOINT (proxy)) {
+      g_ptr_array_add (snapshot->endpoints, g_object_ref (proxy));
+    } else if (WP_IS_PORT (proxy)) {
+      const gchar *str = wp_pipewire_object_get_property (
+          WP_PIPEWIRE_OBJECT (proxy), PW_KEY_NODE_ID);
+      gpointer node_id = GUINT_TO_POINTER (str ? atoi (str) : SPA_ID_INVALID);
+      GPtrArray *ports = g_hash_table_lookup (snapshot->ports, node_id);
+      if (!ports) {
+        ports = g_ptr_array_new ();
+        g_hash_table_insert (snapshot->ports, node_id, ports);
+      }
+      /* kept alive by the objects table */
+      g_ptr_array_add (ports, proxy);
+    } else if (WP_IS_LINK (proxy)) {
+      guint32 out_port, in_port;
+      wp_link_get_linked_object_ids (WP_LINK (proxy),
+          NULL, &out_port, NULL, &in_port);
+      /* like wp_object_manager_lookup(), keep the first link of each port */
+      if (!g_hash_table_contains (snapshot->links, GUINT_TO_POINTER (out_port)))
+        g_hash_table_insert (snapshot->links, GUINT_TO_POINTER (out_port),
+            g_object_ref (proxy));
+      if (!g_hash_table_contains (snapshot->links, GUINT_TO_POINTER (in_port)))
+        g_hash_table_insert (snapshot->links, GUINT_TO_POINTER (in_port),
+            g_object_ref (proxy));
+    }
+  }
+
+  return snapshot;
+}
+
+/* returns the objects of the given type whose media.class matches
+   both patterns; class_glob may be NULL to match any class */
+static WpIterator *
+status_new_iterator (struct print_context *context, GType type,
+    const gchar *class_glob, const gchar *media_type_glob)
+{
+  GPtrArray *source = NULL;
+  GPtrArray *items;
+
+  if (!context->snapshot)
+    return wp_object_manager_new_filtered_iterator (context->self->om, type,
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s",
+            class_glob ? class_glob : "*",
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s",
+            media_type_glob,
+        NULL);
+
+  if (type == WP_TYPE_DEVICE)
+    source = context->snapshot->devices;
+  else if (type == WP_TYPE_NODE)
+    source = context->snapshot->nodes;
+  else if (type == WP_TYPE_ENDPOINT)
+    source = context->snapshot->endpoints;
+  g_return_val_if_fail (source, NULL);
+
+  /* the items are kept alive by the snapshot */
+  items = g_ptr_array_new ();
+  for (guint i = 0; i < source->len; i++) {
+    WpPipewireObject *obj = g_ptr_array_index (source, i);
+    const gchar *media_class =
+        wp_pipewire_object_get_property (obj, PW_KEY_MEDIA_CLASS);
+
+    if (media_class &&
+        g_pattern_match_simple (media_type_glob, media_class) &&
+        (!class_glob || g_pattern_match_simple (class_glob, media_class)))
+      g_ptr_array_add (items, obj);
+  }
+  return wp_iterator_new_ptr_array (items, type);
+}
+
 static void
 print_controls (guint32 id, struct print_context *context)
 {
   g_autoptr (GVariant) dict = NULL;
 
-  if (context->mixer_api)
+  if (context->mixer_api) {
     g_signal_emit_by_name (context->mixer_api, "get-volume", id, &dict);
+  } else if (context->snapshot) {
+    dict = g_hash_table_lookup (context->snapshot->volumes,
+        GUINT_TO_POINTER (id));
+    if (dict)
+      g_variant_ref (dict);
+  }
 
   if (dict) {
     gboolean mute = FALSE;
@@ -177,10 +366,57 @@ print_endpoint (const GValue *item, gpointer data)
   print_controls (node_id, context);
 }
 
+static WpIterator *
+status_new_ports_iterator (struct print_context *context, guint32 node_id)
+{
+  GPtrArray *ports;
+
+  if (!context->snapshot)
+    return wp_object_manager_new_filtered_iterator (context->self->om,
+        WP_TYPE_PORT, WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_NODE_ID, "=u",
+        node_id, NULL);
+
+  ports = g_hash_table_lookup (context->snapshot->ports,
+      GUINT_TO_POINTER (node_id));
+  return wp_iterator_new_ptr_array (
+      ports ? g_ptr_array_ref (ports) : g_ptr_array_new (), WP_TYPE_PORT);
+}
+
+static WpLink *
+status_lookup_link (struct print_context *context, guint32 port_id,
+    WpDirection dir)
+{
+  WpLink *link;
+
+  if (!context->snapshot)
+    return wp_object_manager_lookup (context->self->om, WP_TYPE_LINK,
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, (dir == WP_DIRECTION_OUTPUT) ?
+            PW_KEY_LINK_OUTPUT_PORT : PW_KEY_LINK_INPUT_PORT, "=u", port_id,
+        NULL);
+
+  link = g_hash_table_lookup (context->snapshot->links,
+      GUINT_TO_POINTER (port_id));
+  return link ? g_object_ref (link) : NULL;
+}
+
+static WpPipewireObject *
+status_lookup_port (struct print_context *context, guint32 port_id)
+{
+  WpProxy *port;
+
+  if (!context->snapshot)
+    return wp_object_manager_lookup (context->self->om, WP_TYPE_PORT,
+        WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", port_id, NULL);
+
+  port = g_hash_table_lookup (context->snapshot->objects,
+      GUINT_TO_POINTER (port_id));
+  return (port && WP_IS_PORT (port)) ? g_object_ref (port) : NULL;
+}
+
 static void
 print_stream_node (const GValue *item, gpointer data)
 {
-  WpCtl * self = data;
+  struct print_context *context = data;
   WpPipewireObject *obj = g_value_get_object (item);
   guint32 id = wp_proxy_get_bound_id (WP_PROXY (obj));
   const gchar *name = wp_pipewire_object_get_property (obj, PW_KEY_APP_NAME);
@@ -189,9 +425,7 @@ print_stream_node (const GValue *item, gpointer data)
 
   printf (TREE_INDENT_EMPTY "  %4u. %-60s\n", id, name);
 
-  g_autoptr (WpIterator) it = wp_object_manager_new_filtered_iterator (self->om,
-      WP_TYPE_PORT, WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_NODE_ID, "=u", id,
-      NULL);
+  g_autoptr (WpIterator) it = status_new_ports_iterator (context, id);
   g_auto (GValue) val = G_VALUE_INIT;
 
   for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
@@ -203,19 +437,13 @@ print_stream_node (const GValue *item, gpointer data)
 
     printf (TREE_INDENT_EMPTY "       %4u. %-15s", id, name);
 
-    g_autoptr (WpLink) link = wp_object_manager_lookup (self->om, WP_TYPE_LINK,
-        WP_CONSTRAINT_TYPE_PW_PROPERTY, (dir == WP_DIRECTION_OUTPUT) ?
-            PW_KEY_LINK_OUTPUT_PORT : PW_KEY_LINK_INPUT_PORT, "=u", id,
-        NULL);
+    g_autoptr (WpLink) link = status_lookup_link (context, id, dir);
     if (link) {
       guint32 peer_id = -1;
       wp_link_get_linked_object_ids(link,
           NULL, (dir == WP_DIRECTION_INPUT) ? &peer_id : NULL,
           NULL, (dir == WP_DIRECTION_OUTPUT) ? &peer_id : NULL);
-      g_autoptr (WpPipewireObject) peer = wp_object_manager_lookup (
-          self->om, WP_TYPE_PORT,
-          WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", peer_id,
-          NULL);
+      g_autoptr (WpPipewireObject) peer = status_lookup_port (context, peer_id);
       name = wp_pipewire_object_get_property (peer, PW_KEY_PORT_ALIAS);
 
       printf (" %c %s\n", (dir == WP_DIRECTION_OUTPUT) ? '>' : '<', name);
@@ -226,12 +454,12 @@ print_stream_node (const GValue *item, gpointer data)
 }
 
 static void
-status_run (WpCtl * self)
+status_print (WpCtl * self, struct status_snapshot * snapshot)
 {
   g_autoptr (WpIterator) it = NULL;
   g_auto (GValue) val = G_VALUE_INIT;
   g_autoptr (WpPlugin) def_nodes_api = NULL;
-  struct print_context context = { .self = self };
+  struct print_context context = { .self = self, .snapshot = snapshot };
 
   def_nodes_api = wp_plugin_find (self->core, "default-nodes-api");
   context.mixer_api = wp_plugin_find (self->core, "mixer-api");
@@ -245,7 +473,10 @@ status_run (WpCtl * self)
       wp_core_get_remote_cookie (self->core));
 
   printf (TREE_INDENT_END "Clients:\n");
-  it = wp_object_manager_new_filtered_iterator (self->om, WP_TYPE_CLIENT, NULL);
+  it = snapshot ?
+      wp_iterator_new_ptr_array (g_ptr_array_ref (snapshot->clients),
+          WP_TYPE_CLIENT) :
+      wp_object_manager_new_filtered_iterator (self->om, WP_TYPE_CLIENT, NULL);
   for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
     WpProxy *client = g_value_get_object (&val);
     g_autoptr (WpProperties) properties =
@@ -278,10 +509,8 @@ status_run (WpCtl * self)
       g_snprintf (media_type_glob, sizeof(media_type_glob), "*%s*", media_type);
 
       printf (TREE_INDENT_NODE "Devices:\n");
-      child_it = wp_object_manager_new_filtered_iterator (self->om,
-          WP_TYPE_DEVICE,
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", media_type_glob,
-          NULL);
+      child_it = status_new_iterator (&context, WP_TYPE_DEVICE, NULL,
+          media_type_glob);
       wp_iterator_foreach (child_it, print_device, self);
       g_clear_pointer (&child_it, wp_iterator_unref);
 
@@ -293,22 +522,16 @@ status_run (WpCtl * self)
       if (def_nodes_api)
         g_signal_emit_by_name (def_nodes_api, "get-default-node", media_class,
             &context.default_node);
-      child_it = wp_object_manager_new_filtered_iterator (self->om,
-          WP_TYPE_NODE,
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", "*/Sink*",
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", media_type_glob,
-          NULL);
+      child_it = status_new_iterator (&context, WP_TYPE_NODE, "*/Sink*",
+          media_type_glob);
       wp_iterator_foreach (child_it, print_dev_node, (gpointer) &context);
       g_clear_pointer (&child_it, wp_iterator_unref);
 
       printf (TREE_INDENT_LINE "\n");
 
       printf (TREE_INDENT_NODE "Sink endpoints:\n");
-      child_it = wp_object_manager_new_filtered_iterator (self->om,
-          WP_TYPE_ENDPOINT,
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", "*/Sink*",
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", media_type_glob,
-          NULL);
+      child_it = status_new_iterator (&context, WP_TYPE_ENDPOINT, "*/Sink*",
+          media_type_glob);
       wp_iterator_foreach (child_it, print_endpoint, (gpointer) &context);
       g_clear_pointer (&child_it, wp_iterator_unref);
 
@@ -320,34 +543,25 @@ status_run (WpCtl * self)
       if (def_nodes_api)
         g_signal_emit_by_name (def_nodes_api, "get-default-node", media_class,
             &context.default_node);
-      child_it = wp_object_manager_new_filtered_iterator (self->om,
-          WP_TYPE_NODE,
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", "*/Source*",
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", media_type_glob,
-          NULL);
+      child_it = status_new_iterator (&context, WP_TYPE_NODE, "*/Source*",
+          media_type_glob);
       wp_iterator_foreach (child_it, print_dev_node, (gpointer) &context);
       g_clear_pointer (&child_it, wp_iterator_unref);
 
       printf (TREE_INDENT_LINE "\n");
 
       printf (TREE_INDENT_NODE "Source endpoints:\n");
-      child_it = wp_object_manager_new_filtered_iterator (self->om,
-          WP_TYPE_ENDPOINT,
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", "*/Source*",
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", media_type_glob,
-          NULL);
+      child_it = status_new_iterator (&context, WP_TYPE_ENDPOINT, "*/Source*",
+          media_type_glob);
       wp_iterator_foreach (child_it, print_endpoint, (gpointer) &context);
       g_clear_pointer (&child_it, wp_iterator_unref);
 
       printf (TREE_INDENT_LINE "\n");
 
       printf (TREE_INDENT_END "Streams:\n");
-      child_it = wp_object_manager_new_filtered_iterator (self->om,
-          WP_TYPE_NODE,
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", "Stream/*",
-          WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_MEDIA_CLASS, "#s", media_type_glob,
-          NULL);
-      wp_iterator_foreach (child_it, print_stream_node, self);
+      child_it = status_new_iterator (&context, WP_TYPE_NODE, "Stream/*",
+          media_type_glob);
+      wp_iterator_foreach (child_it, print_stream_node, &context);
       g_clear_pointer (&child_it, wp_iterator_unref);
     }
 
@@ -370,7 +584,195 @@ status_run (WpCtl * self)
   }
 
   g_clear_object (&context.mixer_api);
-  g_main_loop_quit (self->loop);
+}
+
+static gboolean
+status_node_has_controls (WpPipewireObject * node)
+{
+  const gchar *media_class =
+      wp_pipewire_object_get_property (node, PW_KEY_MEDIA_CLASS);
+
+  /* the nodes printed in the "Sinks" and "Sources" sections */
+  return media_class &&
+      (g_pattern_match_simple ("*Audio*", media_class) ||
+       g_pattern_match_simple ("*Video*", media_class)) &&
+      (g_pattern_match_simple ("*/Sink*", media_class) ||
+       g_pattern_match_simple ("*/Source*", media_class));
+}
+
+/* builds the same dictionary as the mixer api "get-volume" action, limited
+   to the keys that we print, from a Props object */
+static GVariant *
+status_volume_from_props (WpSpaPod * props)
+{
+  g_autoptr (WpSpaPod) channel_volumes = NULL;
+  g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+  gboolean mute = FALSE;
+  float volume = 1.0f;
+
+  if (!wp_spa_pod_get_object (props, NULL,
+          "mute", "b", &mute,
+          "channelVolumes", "P", &channel_volumes,
+          NULL))
+    return NULL;
+
+  wp_spa_pod_get_object (props, NULL, "volume", "?f", &volume, NULL);
+  {
+    g_autoptr (WpIterator) vit = wp_spa_pod_new_iterator (channel_volumes);
+    g_auto (GValue) v = G_VALUE_INIT;
+    if (vit && wp_iterator_next (vit, &v))
+      volume = *(float *) g_value_get_pointer (&v);
+  }
+
+  /* same as the cubic scale that main() configures on the mixer api */
+  g_variant_builder_add (&b, "{sv}", "mute", g_variant_new_boolean (mute));
+  g_variant_builder_add (&b, "{sv}", "volume",
+      g_variant_new_double (volume > 0.0f ? cbrt (volume) : 0.0));
+  return g_variant_ref_sink (g_variant_builder_end (&b));
+}
+
+/* returns the device of a node whose volume is controlled by a device route,
+   like the mixer api does for the nodes of cards */
+static WpPipewireObject *
+status_get_route_device (struct status_snapshot * snapshot,
+    WpPipewireObject * node)
+{
+  const gchar *dev_id = wp_pipewire_object_get_property (node,
+      PW_KEY_DEVICE_ID);
+  gpointer dev;
+
+  if (!dev_id || !wp_pipewire_object_get_property (node,
+          "card.profile.device"))
+    return NULL;
+
+  dev = g_hash_table_lookup (snapshot->objects,
+      GUINT_TO_POINTER (atoi (dev_id)));
+  return WP_IS_DEVICE (dev) ? WP_PIPEWIRE_OBJECT (dev) : NULL;
+}
+
+/* reads the volume of a node from the Route of its device, if it has one,
+   or from its own Props param otherwise, like the mixer api */
+static GVariant *
+status_read_node_volume (struct status_snapshot * snapshot,
+    WpPipewireObject * node)
+{
+  WpPipewireObject *dev = status_get_route_device (snapshot, node);
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) val = G_VALUE_INIT;
+
+  if (dev) {
+    gint32 p_device = atoi (wp_pipewire_object_get_property (node,
+        "card.profile.device"));
+
+    it = wp_pipewire_object_enum_params_sync (dev, "Route", NULL);
+    for (; it && wp_iterator_next (it, &val); g_value_unset (&val)) {
+      WpSpaPod *param = g_value_get_boxed (&val);
+      g_autoptr (WpSpaPod) props = NULL;
+      gint32 r_device = -1;
+      GVariant *volume;
+
+      if (!wp_spa_pod_get_object (param, NULL,
+              "device", "i", &r_device,
+              "props", "P", &props,
+              NULL) || r_device != p_device)
+        continue;
+
+      if ((volume = status_volume_from_props (props)))
+        return volume;
+    }
+    g_clear_pointer (&it, wp_iterator_unref);
+  }
+
+  it = wp_pipewire_object_enum_params_sync (node, "Props", NULL);
+  for (; it && wp_iterator_next (it, &val); g_value_unset (&val)) {
+    GVariant *volume = status_volume_from_props (g_value_get_boxed (&val));
+    if (volume)
+      return volume;
+  }
+  return NULL;
+}
+
+static void
+status_print_snapshot (struct status_snapshot * snapshot)
+{
+  WpCtl *self = snapshot->self;
+
+  /* without the mixer api, read the volumes that were fetched lazily */
+  for (guint i = 0; i < snapshot->nodes->len; i++) {
+    WpPipewireObject *node = g_ptr_array_index (snapshot->nodes, i);
+    GVariant *volume;
+
+    if (!snapshot->lazy_volumes || !status_node_has_controls (node))
+      continue;
+    volume = status_read_node_volume (snapshot, node);
+    if (volume)
+      g_hash_table_insert (snapshot->volumes,
+          GUINT_TO_POINTER (wp_proxy_get_bound_id (WP_PROXY (node))), volume);
+  }
+
+  status_print (self, snapshot);
+  status_snapshot_free (snapshot);
+  command_done (self);
+}
+
+static void
+on_status_params_ready (WpObject * object, GAsyncResult * res,
+    struct status_snapshot * snapshot)
+{
+  g_autoptr (GError) error = NULL;
+
+  /* not fatal, the node is just printed without volume */
+  if (!wp_object_activate_finish (object, res, &error))
+    wp_debug_object (object, "%s", error->message);
+
+  if (--snapshot->pending == 0)
+    status_print_snapshot (snapshot);
+}
+
+static void
+status_run (WpCtl * self)
+{
+  struct status_snapshot *snapshot;
+  g_autoptr (WpPlugin) mixer_api = NULL;
+
+  if (!cmdline.status.fast) {
+    status_print (self, NULL);
+    command_done (self);
+    return;
+  }
+
+  snapshot = status_snapshot_new (self);
+
+  /* without the mixer api, fetch the volume only of the nodes that
+     are going to be printed with one, and the routes of their devices */
+  mixer_api = wp_plugin_find (self->core, "mixer-api");
+  if (!mixer_api) {
+    g_autoptr (GHashTable) devices =
+        g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    snapshot->lazy_volumes = TRUE;
+    for (guint i = 0; i < snapshot->nodes->len; i++) {
+      WpObject *node = g_ptr_array_index (snapshot->nodes, i);
+      WpPipewireObject *dev;
+
+      if (!status_node_has_controls (WP_PIPEWIRE_OBJECT (node)))
+        continue;
+      snapshot->pending++;
+      wp_object_activate (node, WP_PIPEWIRE_OBJECT_FEATURE_PARAM_PROPS, NULL,
+          (GAsyncReadyCallback) on_status_params_ready, snapshot);
+
+      dev = status_get_route_device (snapshot, WP_PIPEWIRE_OBJECT (node));
+      if (dev && g_hash_table_add (devices, dev)) {
+        snapshot->pending++;
+        wp_object_activate (WP_OBJECT (dev),
+            WP_PIPEWIRE_OBJECT_FEATURE_PARAM_ROUTE, NULL,
+            (GAsyncReadyCallback) on_status_params_ready, snapshot);
+      }
+    }
+  }
+
+  if (snapshot->pending == 0)
+    status_print_snapshot (snapshot);
 }
 
 /* inspect */
@@ -573,7 +975,7 @@ inspect_run (WpCtl * self)
   inspect_print_object (self, proxy, 0);
 
 out:
-  g_main_loop_quit (self->loop);
+  command_done (self);
   return;
 
 out_err:
@@ -629,7 +1031,8 @@ set_default_run (WpCtl * self)
     goto out;
   }
 
-  proxy = wp_object_manager_lookup (self->om, WP_TYPE_NODE, NULL);
+  proxy = wp_object_manager_lookup (self->om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", id, NULL);
   if (!proxy) {
     printf ("Node '%d' not found\n", id);
     goto out;
@@ -655,7 +1058,7 @@ set_default_run (WpCtl * self)
         goto out;
       }
 
-      wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+      wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_done, self);
       return;
     }
   }
@@ -664,7 +1067,7 @@ set_default_run (WpCtl * self)
 
 out:
   self->exit_code = 3;
-  g_main_loop_quit (self->loop);
+  command_done (self);
 }
 
 /* set-volume */
@@ -717,7 +1120,8 @@ set_volume_run (WpCtl * self)
   gboolean res = FALSE;
   guint32 node_id = cmdline.set_volume.id;
 
-  proxy = wp_object_manager_lookup (self->om, WP_TYPE_GLOBAL_PROXY, NULL);
+  proxy = wp_object_manager_lookup (self->om, WP_TYPE_GLOBAL_PROXY,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", cmdline.set_volume.id, NULL);
   if (!proxy) {
     printf ("Object '%d' not found\n", cmdline.set_volume.id);
     goto out;
@@ -744,12 +1148,12 @@ set_volume_run (WpCtl * self)
     goto out;
   }
 
-  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_done, self);
   return;
 
 out:
   self->exit_code = 3;
-  g_main_loop_quit (self->loop);
+  command_done (self);
 }
 
 /* set-mute */
@@ -813,7 +1217,8 @@ set_mute_run (WpCtl * self)
   gboolean mute = FALSE;
   guint32 node_id = cmdline.set_mute.id;
 
-  proxy = wp_object_manager_lookup (self->om, WP_TYPE_GLOBAL_PROXY, NULL);
+  proxy = wp_object_manager_lookup (self->om, WP_TYPE_GLOBAL_PROXY,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", cmdline.set_mute.id, NULL);
   if (!proxy) {
     printf ("Object '%d' not found\n", cmdline.set_mute.id);
     goto out;
@@ -849,12 +1254,12 @@ set_mute_run (WpCtl * self)
 
   g_signal_emit_by_name (mixer_api, "set-volume", node_id, variant, &res);
 
-  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_done, self);
   return;
 
 out:
   self->exit_code = 3;
-  g_main_loop_quit (self->loop);
+  command_done (self);
 }
 
 /* set-profile */
@@ -898,7 +1303,8 @@ set_profile_run (WpCtl * self)
 {
   g_autoptr (WpPipewireObject) proxy = NULL;
 
-  proxy = wp_object_manager_lookup (self->om, WP_TYPE_GLOBAL_PROXY, NULL);
+  proxy = wp_object_manager_lookup (self->om, WP_TYPE_GLOBAL_PROXY,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", cmdline.set_profile.id, NULL);
   if (!proxy) {
     printf ("Object '%d' not found\n", cmdline.set_profile.id);
     goto out;
@@ -908,12 +1314,12 @@ set_profile_run (WpCtl * self)
         "Spa:Pod:Object:Param:Profile", "Profile",
         "index", "i", cmdline.set_profile.index,
         NULL));
-  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_done, self);
   return;
 
 out:
   self->exit_code = 3;
-  g_main_loop_quit (self->loop);
+  command_done (self);
 }
 
 /* clear-default */
@@ -982,14 +1388,214 @@ clear_default_run (WpCtl * self)
     }
   }
 
-  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_done, self);
   return;
 
 out:
   self->exit_code = 3;
-  g_main_loop_quit (self->loop);
+  command_done (self);
+}
+
+/* profile */
+
+static gboolean
+profile_parse_positional (gint argc, gchar ** argv, GError **error)
+{
+  const gchar *action = (argc >= 3) ? argv[2] : "report";
+
+  if (!g_strcmp0 (action, "start") && argc >= 4) {
+    long interval = strtol (argv[3], NULL, 10);
+    if (interval <= 0 || interval >= G_MAXINT32) {
+      g_set_error (error, wpctl_error_domain_quark(), 0,
+          "'%s' is not a valid number", argv[3]);
+      return FALSE;
+    }
+    g_snprintf (cmdline.profile.command, sizeof (cmdline.profile.command),
+        "start %ld", interval);
+  }
+  else if (!g_strcmp0 (action, "start") || !g_strcmp0 (action, "stop") ||
+      !g_strcmp0 (action, "reset") || !g_strcmp0 (action, "report")) {
+    g_strlcpy (cmdline.profile.command, action,
+        sizeof (cmdline.profile.command));
+  }
+  else {
+    g_set_error (error, wpctl_error_domain_quark(), 0,
+        "'%s' is not a valid profiler command", action);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+profile_prepare (WpCtl * self, GError ** error)
+{
+  wp_object_manager_add_interest (self->om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "metadata.name", "=s", "lua-profiler",
+      NULL);
+  wp_object_manager_request_object_features (self->om, WP_TYPE_METADATA,
+      WP_OBJECT_FEATURES_ALL);
+  return TRUE;
 }
 
+static guint64
+profile_json_get_uint (WpSpaJson * obj, const gchar * key)
+{
+  g_autoptr (WpSpaJson) value = NULL;
+
+  if (!wp_spa_json_object_get (obj, key, "J", &value, NULL))
+    return 0;
+  return g_ascii_strtoull (wp_spa_json_get_data (value), NULL, 10);
+}
+
+static void
+profile_print_report (const gchar * report)
+{
+  g_autoptr (WpSpaJson) json = wp_spa_json_new_from_string (report);
+  g_autoptr (WpSpaJson) handlers = NULL;
+  g_autoptr (WpSpaJson) samples = NULL;
+  g_autoptr (WpSpaJsonParser) p = NULL;
+  gboolean running = FALSE;
+  guint64 interval;
+
+  if (!wp_spa_json_is_object (json) ||
+      !wp_spa_json_object_get (json, "running", "b", &running,
+          "handlers", "J", &handlers, "samples", "J", &samples, NULL)) {
+    printf ("Invalid profiler report\n");
+    return;
+  }
+
+  interval = profile_json_get_uint (json, "sample-interval");
+  printf ("Lua profiler: %s", running ? "running" : "stopped");
+  if (running && interval > 0)
+    printf (", sampling every %" G_GUINT64_FORMAT " instructions", interval);
+  printf ("\n\n");
+
+  printf (" %8s %10s %10s %10s %10s  %s\n", "calls", "total ms", "avg us",
+      "max us", "allocs", "handler");
+  p = wp_spa_json_parser_new_array (handlers);
+  while (TRUE) {
+    g_autoptr (WpSpaJson) item = wp_spa_json_parser_get_json (p);
+    g_autofree gchar *location = NULL;
+    guint64 calls;
+
+    if (!item)
+      break;
+    if (!wp_spa_json_object_get (item, "location", "s", &location, NULL))
+      continue;
+
+    calls = profile_json_get_uint (item, "calls");
+    printf (" %8" G_GUINT64_FORMAT " %10.1f %10" G_GUINT64_FORMAT
+        " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "  %s\n", calls,
+        profile_json_get_uint (item, "total-us") / 1000.0,
+        calls ? profile_json_get_uint (item, "total-us") / calls : 0,
+        profile_json_get_uint (item, "max-us"),
+        profile_json_get_uint (item, "allocs"),
+        location);
+  }
+  wp_spa_json_parser_end (p);
+  g_clear_pointer (&p, wp_spa_json_parser_unref);
+
+  p = wp_spa_json_parser_new_array (samples);
+  for (gboolean first = TRUE; TRUE; first = FALSE) {
+    g_autoptr (WpSpaJson) item = wp_spa_json_parser_get_json (p);
+    g_autofree gchar *location = NULL;
+
+    if (!item)
+      break;
+    if (first)
+      printf ("\n %8s %10s  %s\n", "samples", "time ms", "function");
+    if (!wp_spa_json_object_get (item, "location", "s", &location, NULL))
+      continue;
+
+    printf (" %8" G_GUINT64_FORMAT " %10.1f  %s\n",
+        profile_json_get_uint (item, "samples"),
+        profile_json_get_uint (item, "time-us") / 1000.0, location);
+  }
+  wp_spa_json_parser_end (p);
+}
+
+static void
+profile_on_metadata_changed (WpMetadata * m, guint32 subject,
+    const gchar * key, const gchar * type, const gchar * value, WpCtl * self)
+{
+  if (subject != 0 || g_strcmp0 (key, "report") != 0 || !value)
+    return;
+
+  g_signal_handlers_disconnect_by_func (m, profile_on_metadata_changed, self);
+
+  if (!g_strcmp0 (cmdline.profile.command, "report"))
+    profile_print_report (value);
+
+  command_done (self);
+}
+
+static void
+profile_run (WpCtl * self)
+{
+  g_autoptr (WpMetadata) m = NULL;
+
+  m = wp_object_manager_lookup (self->om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "metadata.name", "=s", "lua-profiler",
+      NULL);
+  if (!m) {
+    printf ("Lua profiler not available\n");
+    self->exit_code = 3;
+    command_done (self);
+    return;
+  }
+
+  /* the daemon answers every command by updating the report */
+  g_signal_connect (m, "changed", G_CALLBACK (profile_on_metadata_changed),
+      self);
+  wp_metadata_set (m, 0, "command", NULL, cmdline.profile.command);
+}
+
+/* batch */
+
+static gboolean
+batch_parse_positional (gint argc, gchar ** argv, GError **error)
+{
+  cmdline.batch.file = (argc >= 3) ? argv[2] : NULL;
+  return TRUE;
+}
+
+static gboolean
+batch_prepare (WpCtl * self, GError ** error)
+{
+  g_autoptr (GIOChannel) channel = NULL;
+
+  if (cmdline.batch.file && g_strcmp0 (cmdline.batch.file, "-") != 0) {
+    channel = g_io_channel_new_file (cmdline.batch.file, "r", error);
+    if (!channel)
+      return FALSE;
+  } else {
+    channel = g_io_channel_unix_new (STDIN_FILENO);
+  }
+
+  if (g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, error) !=
+          G_IO_STATUS_NORMAL)
+    return FALSE;
+
+  self->batch.channel = g_steal_pointer (&channel);
+
+  /* collect all objects, so that every command can be served from
+     the same object manager; the requested features must be a superset
+     of those of the prepare() function of every command */
+  wp_object_manager_add_interest (self->om, WP_TYPE_GLOBAL_PROXY, NULL);
+  wp_object_manager_request_object_features (self->om, WP_TYPE_GLOBAL_PROXY,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  /* 'set-default' and 'profile' need the metadata contents and
+     its 'changed' signal */
+  wp_object_manager_request_object_features (self->om, WP_TYPE_METADATA,
+      WP_OBJECT_FEATURES_ALL);
+  return TRUE;
+}
+
+static void batch_run (WpCtl * self);
+
 #define N_ENTRIES 3
 
 static const struct subcommand {
@@ -1015,7 +1621,12 @@ static const struct subcommand {
     .positional_args = "",
     .summary = "Displays the current state of objects in PipeWire",
     .description = NULL,
-    .entries = { { NULL } },
+    .entries = {
+      { "fast", 'f', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+        &cmdline.status.fast,
+        "Print from a single snapshot, querying only the shown volumes", NULL },
+      { NULL }
+    },
     .parse_positional = NULL,
     .prepare = status_prepare,
     .run = status_run,
@@ -1087,9 +1698,160 @@ static const struct subcommand {
     .parse_positional = clear_default_parse_positional,
     .prepare = clear_default_prepare,
     .run = clear_default_run,
+  },
+  {
+    .name = "profile",
+    .positional_args = "[start [INTERVAL]|stop|reset|report]",
+    .summary = "Controls the profiler of the Lua scripting engine "
+               "(no argument means 'report')",
+    .description = "'start' makes the daemon measure the wall-clock time and "
+                   "the Lua allocations of every script handler; with an "
+                   "INTERVAL, it also samples the running Lua function every "
+                   "INTERVAL instructions. 'report' prints the statistics "
+                   "collected so far, 'reset' discards them and 'stop' "
+                   "stops collecting them.",
+    .entries = { { NULL } },
+    .parse_positional = profile_parse_positional,
+    .prepare = profile_prepare,
+    .run = profile_run,
+  },
+  {
+    .name = "batch",
+    .positional_args = "[FILE]",
+    .summary = "Runs commands read from FILE (or stdin), one per line, "
+               "over a single connection",
+    .description = "Each line has the same syntax as the wpctl command line, "
+                   "without the 'wpctl' prefix. Commands are executed in "
+                   "order and their output is flushed as soon as they "
+                   "finish. Empty lines and lines starting with '#' "
+                   "are ignored. A failing command does not stop the "
+                   "batch, but the exit status is not 0 if any command "
+                   "failed.",
+    .entries = { { NULL } },
+    .parse_positional = batch_parse_positional,
+    .prepare = batch_prepare,
+    .run = batch_run,
   }
 };
 
+static const struct subcommand *
+find_subcommand (const gchar *name)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (subcommands); i++) {
+    if (!g_strcmp0 (name, subcommands[i].name))
+      return &subcommands[i];
+  }
+  return NULL;
+}
+
+static gboolean
+batch_on_input (GIOChannel * channel, GIOCondition condition, WpCtl * self)
+{
+  self->batch.watch_id = 0;
+  batch_process (self);
+  return G_SOURCE_REMOVE;
+}
+
+/* parses a line the same way main() parses the command line;
+   returns TRUE if a command was started */
+static gboolean
+batch_execute (WpCtl * self, gchar * line)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GOptionContext) context = NULL;
+  g_auto (GStrv) line_argv = NULL;
+  g_autofree gchar **argv = NULL;
+  const struct subcommand *cmd;
+  GOptionGroup *group;
+  gint argc = 0;
+
+  g_strstrip (line);
+  if (line[0] == '\0' || line[0] == '#')
+    return FALSE;
+
+  if (!g_shell_parse_argv (line, &argc, &line_argv, &error))
+    goto error;
+
+  cmd = find_subcommand (line_argv[0]);
+  if (!cmd || cmd->run == batch_run) {
+    g_set_error (&error, wpctl_error_domain_quark(), 0,
+        "'%s' is not a valid command", line_argv[0]);
+    goto error;
+  }
+
+  /* build an argv that looks like the real one; the strings are owned
+     by line_argv, as g_option_context_parse() may reorder this array */
+  argv = g_new0 (gchar *, argc + 2);
+  argv[0] = "wpctl";
+  for (gint i = 0; i < argc; i++)
+    argv[i + 1] = line_argv[i];
+  argc++;
+
+  memset (&cmdline, 0, sizeof (cmdline));
+
+  context = g_option_context_new (NULL);
+  g_option_context_set_help_enabled (context, FALSE);
+  group = g_option_group_new (cmd->name, NULL, NULL, self, NULL);
+  g_option_group_add_entries (group, cmd->entries);
+  g_option_context_set_main_group (context, group);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error) ||
+      (cmd->parse_positional && !cmd->parse_positional (argc, argv, &error)))
+    goto error;
+
+  self->batch.busy = TRUE;
+  cmd->run (self);
+  return TRUE;
+
+error:
+  fprintf (stderr, "Error: %s\n", error->message);
+  fflush (stderr);
+  self->exit_code = 1;
+  return FALSE;
+}
+
+static void
+batch_process (WpCtl * self)
+{
+  self->batch.processing = TRUE;
+
+  while (!self->batch.busy) {
+    g_autoptr (GError) error = NULL;
+    g_autofree gchar *line = NULL;
+
+    switch (g_io_channel_read_line (self->batch.channel, &line, NULL, NULL,
+                &error)) {
+      case G_IO_STATUS_NORMAL:
+        batch_execute (self, line);
+        break;
+      case G_IO_STATUS_AGAIN:
+        /* wait for more input */
+        self->batch.watch_id = g_io_add_watch (self->batch.channel,
+            G_IO_IN | G_IO_HUP | G_IO_ERR, (GIOFunc) batch_on_input, self);
+        goto out;
+      case G_IO_STATUS_EOF:
+        g_main_loop_quit (self->loop);
+        goto out;
+      case G_IO_STATUS_ERROR:
+      default:
+        fprintf (stderr, "%s\n", error ? error->message : "read error");
+        self->exit_code = 1;
+        g_main_loop_quit (self->loop);
+        goto out;
+    }
+  }
+
+out:
+  self->batch.processing = FALSE;
+}
+
+static void
+batch_run (WpCtl * self)
+{
+  self->batch.active = TRUE;
+  batch_process (self);
+}
+
 static void
 on_plugin_activated (WpObject * p, GAsyncResult * res, WpCtl * ctl)
 {
@@ -1124,14 +1886,8 @@ main (gint argc, gchar **argv)
   ctl.om = wp_object_manager_new ();
 
   /* find the subcommand */
-  if (argc > 1) {
-    for (guint i = 0; i < G_N_ELEMENTS (subcommands); i++) {
-      if (!g_strcmp0 (argv[1], subcommands[i].name)) {
-        cmd = &subcommands[i];
-        break;
-      }
-    }
-  }
+  if (argc > 1)
+    cmd = find_subcommand (argv[1]);
 
   /* prepare the subcommand options */
   if (cmd) {
@@ -1192,17 +1948,23 @@ main (gint argc, gchar **argv)
     fprintf (stderr, "%s\n", error->message);
     return 1;
   }
-  if (!wp_core_load_component (ctl.core,
-      "libwireplumber-module-mixer-api", "module", NULL, &error)) {
-    fprintf (stderr, "%s\n", error->message);
-    return 1;
-  }
   g_ptr_array_add (ctl.apis, wp_plugin_find (ctl.core, "default-nodes-api"));
-  g_ptr_array_add (ctl.apis, ({
-    WpPlugin *p = wp_plugin_find (ctl.core, "mixer-api");
-    g_object_set (G_OBJECT (p), "scale", 1 /* cubic */, NULL);
-    p;
-  }));
+
+  /* the mixer api tracks the volume params of all nodes and devices;
+     'status --fast' avoids this and only queries the nodes that it prints
+     and the routes of their devices */
+  if (cmd->run != status_run || !cmdline.status.fast) {
+    if (!wp_core_load_component (ctl.core,
+        "libwireplumber-module-mixer-api", "module", NULL, &error)) {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+    g_ptr_array_add (ctl.apis, ({
+      WpPlugin *p = wp_plugin_find (ctl.core, "mixer-api");
+      g_object_set (G_OBJECT (p), "scale", 1 /* cubic */, NULL);
+      p;
+    }));
+  }
 
   /* connect */
   if (!wp_core_connect (ctl.core)) {
@@ -0,0 +1,640 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Builds synthetic graphs of increasing size on an in-process pipewire
+ * server and measures how the most common session management operations
+ * scale with the number of objects. The results are printed on stdout as
+ * JSON, or written to the file given as the first argument.
+ *
+ * Every graph has, for each size unit, a device that is exported from the
+ * client, a sink (fakesink of the spa test plugin) that belongs to that
+ * device, a stream (fakesrc) and, later, a link between the stream and the
+ * sink, so that the device, port and link paths are all exercised.
+ *
+ * The graph sizes are set in meson.build; they can be overridden with the
+ * WP_BENCHMARK_SIZES environment variable, which is a comma-separated list
+ * of node counts.
+ */
+
+#include "../common/base-test-fixture.h"
+#include <spa/monitor/device.h>
+#include <spa/support/plugin.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N_LOOKUPS 1000
+#define N_METADATA_SETS 1000
+#define N_REEVALUATIONS 10
+#define N_LUA_EVENTS 100
+
+/* a minimal spa_device, with no params and no managed objects; it is
+   only there to be exported, so that the sinks have a device to belong to */
+typedef struct {
+  struct spa_handle handle;
+  struct spa_device device;
+  struct spa_hook_list hooks;
+  gchar name[64];
+} BenchDevice;
+
+static int
+bench_device_add_listener (void *object, struct spa_hook *listener,
+    const struct spa_device_events *events, void *data)
+{
+  BenchDevice *d = object;
+  struct spa_dict_item items[] = {
+    SPA_DICT_ITEM_INIT ("device.name", d->name),
+    SPA_DICT_ITEM_INIT ("media.class", "Audio/Device"),
+  };
+  struct spa_dict props = SPA_DICT_INIT_ARRAY (items);
+  struct spa_device_info info = SPA_DEVICE_INFO_INIT ();
+
+  spa_hook_list_append (&d->hooks, listener, events, data);
+
+  info.change_mask = SPA_DEVICE_CHANGE_MASK_PROPS;
+  info.props = &props;
+  if (events->info)
+    events->info (data, &info);
+  return 0;
+}
+
+static int
+bench_device_sync (void *object, int seq)
+{
+  BenchDevice *d = object;
+  spa_hook_list_call (&d->hooks, struct spa_device_events, result, 0,
+      seq, 0, 0, NULL);
+  return 0;
+}
+
+static int
+bench_device_enum_params (void *object, int seq, uint32_t id,
+    uint32_t index, uint32_t max, const struct spa_pod *filter)
+{
+  return 0;
+}
+
+static int
+bench_device_set_param (void *object, uint32_t id, uint32_t flags,
+    const struct spa_pod *param)
+{
+  return -ENOTSUP;
+}
+
+static const struct spa_device_methods bench_device_methods = {
+  SPA_VERSION_DEVICE_METHODS,
+  .add_listener = bench_device_add_listener,
+  .sync = bench_device_sync,
+  .enum_params = bench_device_enum_params,
+  .set_param = bench_device_set_param,
+};
+
+static int
+bench_device_get_interface (struct spa_handle *handle, const char *type,
+    void **iface)
+{
+  BenchDevice *d = SPA_CONTAINER_OF (handle, BenchDevice, handle);
+
+  if (strcmp (type, SPA_TYPE_INTERFACE_Device) != 0)
+    return -ENOENT;
+  *iface = &d->device;
+  return 0;
+}
+
+static int
+bench_device_clear (struct spa_handle *handle)
+{
+  return 0;
+}
+
+static void
+bench_device_init (BenchDevice * d, guint i)
+{
+  d->handle.version = SPA_VERSION_HANDLE;
+  d->handle.get_interface = bench_device_get_interface;
+  d->handle.clear = bench_device_clear;
+  d->device.iface = SPA_INTERFACE_INIT (SPA_TYPE_INTERFACE_Device,
+      SPA_VERSION_DEVICE, &bench_device_methods, d);
+  spa_hook_list_init (&d->hooks);
+  snprintf (d->name, sizeof (d->name), "bench-device-%u", i);
+}
+
+typedef struct {
+  WpBaseTestFixture base;
+
+  guint n_nodes;
+  BenchDevice *device_impls;
+  GPtrArray *devices;
+  GPtrArray *sinks;
+  GPtrArray *sources;
+  GPtrArray *links;
+  WpObjectManager *om;
+  WpImplMetadata *bench_metadata;
+  WpImplMetadata *default_metadata;
+
+  guint pending;
+  const gchar *wait_key;
+  gchar *wait_value;
+} BenchFixture;
+
+static gdouble
+elapsed_usec (gint64 start)
+{
+  return (gdouble) (g_get_monotonic_time () - start);
+}
+
+static void
+bench_wait_pending (BenchFixture * f)
+{
+  while (f->pending > 0)
+    g_main_context_iteration (f->base.context, TRUE);
+}
+
+static void
+bench_sync (BenchFixture * f, WpCore * core)
+{
+  wp_core_sync (core, NULL, (GAsyncReadyCallback) test_core_done_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+}
+
+static void
+on_object_activated (WpObject * object, GAsyncResult * res, BenchFixture * f)
+{
+  g_autoptr (GError) error = NULL;
+  g_assert_true (wp_object_activate_finish (object, res, &error));
+  g_assert_no_error (error);
+  f->pending--;
+}
+
+static void
+bench_activate (BenchFixture * f, gpointer object, WpObjectFeatures features)
+{
+  f->pending++;
+  wp_object_activate (WP_OBJECT (object), features, NULL,
+      (GAsyncReadyCallback) on_object_activated, f);
+}
+
+static void
+on_metadata_changed (WpMetadata * m, guint32 subject, const gchar * key,
+    const gchar * type, const gchar * value, BenchFixture * f)
+{
+  if (f->wait_key && !g_strcmp0 (key, f->wait_key) &&
+      (!f->wait_value || (value && strstr (value, f->wait_value)))) {
+    f->wait_key = NULL;
+    g_clear_pointer (&f->wait_value, g_free);
+  }
+}
+
+static void
+bench_wait_key (BenchFixture * f)
+{
+  while (f->wait_key)
+    g_main_context_iteration (f->base.context, TRUE);
+}
+
+static gboolean
+bench_setup (BenchFixture * f, guint n_nodes)
+{
+  wp_base_test_fixture_setup (&f->base, WP_BASE_TEST_FLAG_CLIENT_CORE);
+
+  /* the watchdog is tuned for functional tests, large graphs take longer */
+  g_source_destroy (f->base.timeout_source);
+
+  f->n_nodes = n_nodes;
+  f->device_impls = g_new0 (BenchDevice, n_nodes);
+  f->devices = g_ptr_array_new_with_free_func (g_object_unref);
+  f->sinks = g_ptr_array_new_with_free_func (g_object_unref);
+  f->sources = g_ptr_array_new_with_free_func (g_object_unref);
+  f->links = g_ptr_array_new_with_free_func (g_object_unref);
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesink"))
+      return FALSE;
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-link-factory", NULL, NULL));
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-client-device", NULL, NULL));
+  }
+
+  /* the devices are exported from the client core */
+  g_assert_nonnull (pw_context_load_module (
+          wp_core_get_pw_context (f->base.client_core),
+          "libpipewire-module-client-device", NULL, NULL));
+
+  return TRUE;
+}
+
+static void
+bench_teardown (BenchFixture * f)
+{
+  g_clear_object (&f->om);
+  g_clear_pointer (&f->links, g_ptr_array_unref);
+  g_clear_pointer (&f->sources, g_ptr_array_unref);
+  g_clear_pointer (&f->sinks, g_ptr_array_unref);
+  g_clear_pointer (&f->devices, g_ptr_array_unref);
+  g_clear_object (&f->default_metadata);
+  g_clear_object (&f->bench_metadata);
+  g_clear_pointer (&f->wait_value, g_free);
+  wp_base_test_fixture_teardown (&f->base);
+
+  /* the exported devices may be used until the client core disconnects */
+  g_clear_pointer (&f->device_impls, g_free);
+}
+
+/* creates n_nodes devices, n_nodes sinks (one on each device) and n_nodes
+   sources on the "client" core and returns the time it took for all of them
+   to be bound */
+static gdouble
+bench_create_graph (BenchFixture * f)
+{
+  gint64 start = g_get_monotonic_time ();
+
+  for (guint i = 0; i < f->n_nodes; i++) {
+    BenchDevice *d = &f->device_impls[i];
+    WpSpaDevice *device;
+
+    bench_device_init (d, i);
+    device = wp_spa_device_new_wrap (f->base.client_core, &d->handle,
+        wp_properties_new (
+            "device.name", d->name,
+            "device.api", "bench",
+            "media.class", "Audio/Device",
+            NULL));
+    g_assert_nonnull (device);
+    g_ptr_array_add (f->devices, device);
+    bench_activate (f, device,
+        WP_PROXY_FEATURE_BOUND | WP_SPA_DEVICE_FEATURE_ENABLED);
+  }
+  bench_wait_pending (f);
+
+  for (guint i = 0; i < f->n_nodes; i++) {
+    g_autofree gchar *sink_name = g_strdup_printf ("bench-sink-%u", i);
+    g_autofree gchar *source_name = g_strdup_printf ("bench-source-%u", i);
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "factory.name", "fakesink",
+        "node.name", sink_name,
+        "media.class", "Audio/Sink",
+        NULL);
+
+    /* the last sink has the highest priority and becomes the default */
+    wp_properties_setf (props, "priority.session", "%u", i);
+    wp_properties_setf (props, "device.id", "%u", wp_proxy_get_bound_id (
+            g_ptr_array_index (f->devices, i)));
+    wp_properties_set (props, "card.profile.device", "0");
+    g_ptr_array_add (f->sinks, wp_node_new_from_factory (f->base.client_core,
+            "spa-node-factory", g_steal_pointer (&props)));
+
+    g_ptr_array_add (f->sources, wp_node_new_from_factory (
+            f->base.client_core, "spa-node-factory", wp_properties_new (
+                "factory.name", "fakesrc",
+                "node.name", source_name,
+                "media.class", "Stream/Output/Audio",
+                NULL)));
+  }
+
+  for (guint i = 0; i < f->n_nodes; i++) {
+    bench_activate (f, g_ptr_array_index (f->sinks, i),
+        WP_PROXY_FEATURE_BOUND);
+    bench_activate (f, g_ptr_array_index (f->sources, i),
+        WP_PROXY_FEATURE_BOUND);
+  }
+  bench_wait_pending (f);
+
+  /* ensure the session manager core has seen all the globals */
+  bench_sync (f, f->base.core);
+  return elapsed_usec (start);
+}
+
+static gdouble
+bench_om_install (BenchFixture * f)
+{
+  gint64 start;
+
+  f->om = wp_object_manager_new ();
+  wp_object_manager_add_interest (f->om, WP_TYPE_DEVICE, NULL);
+  wp_object_manager_add_interest (f->om, WP_TYPE_NODE, NULL);
+  wp_object_manager_add_interest (f->om, WP_TYPE_PORT, NULL);
+  wp_object_manager_request_object_features (f->om, WP_TYPE_PROXY,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  /* index the ports of the nodes, like the policy does */
+  wp_object_manager_request_object_features (f->om, WP_TYPE_NODE,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL | WP_NODE_FEATURE_PORTS);
+
+  start = g_get_monotonic_time ();
+  test_ensure_object_manager_is_installed (f->om, f->base.core,
+      f->base.loop);
+  return elapsed_usec (start);
+}
+
+/* returns the average time of a node lookup by name */
+static gdouble
+bench_lookup (BenchFixture * f)
+{
+  gchar name[64];
+  gint64 start;
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (f->om), >=,
+      f->n_nodes * 3);
+
+  start = g_get_monotonic_time ();
+  for (guint i = 0; i < N_LOOKUPS; i++) {
+    g_autoptr (WpNode) node = NULL;
+
+    snprintf (name, sizeof (name), "bench-sink-%u",
+        (guint) g_random_int_range (0, f->n_nodes));
+    node = wp_object_manager_lookup (f->om, WP_TYPE_NODE,
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, "node.name", "=s", name, NULL);
+    g_assert_nonnull (node);
+  }
+  return elapsed_usec (start) / N_LOOKUPS;
+}
+
+/* returns the average time of a port lookup on a sink */
+static gdouble
+bench_port_lookup (BenchFixture * f)
+{
+  g_autoptr (GPtrArray) sinks = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr (WpIterator) it = wp_object_manager_new_filtered_iterator (f->om,
+      WP_TYPE_NODE, WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class", "=s",
+      "Audio/Sink", NULL);
+  g_auto (GValue) val = G_VALUE_INIT;
+  gint64 start;
+
+  for (; wp_iterator_next (it, &val); g_value_unset (&val))
+    g_ptr_array_add (sinks, g_value_dup_object (&val));
+  g_assert_cmpuint (sinks->len, ==, f->n_nodes);
+
+  start = g_get_monotonic_time ();
+  for (guint i = 0; i < N_LOOKUPS; i++) {
+    WpNode *node = g_ptr_array_index (sinks,
+        g_random_int_range (0, sinks->len));
+    g_autoptr (WpPort) port = wp_node_lookup_port (node,
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, "port.direction", "=s", "in", NULL);
+    g_assert_nonnull (port);
+  }
+  return elapsed_usec (start) / N_LOOKUPS;
+}
+
+/* returns the number of metadata changes per second that are set on the
+   session manager side and received by the client side */
+static gdouble
+bench_metadata (BenchFixture * f)
+{
+  g_autoptr (WpObjectManager) om = wp_object_manager_new ();
+  g_autoptr (WpMetadata) proxy = NULL;
+  gchar key[64], last_key[64];
+  gulong id;
+  gint64 start;
+  gdouble elapsed;
+
+  f->bench_metadata = wp_impl_metadata_new_full (f->base.core, "bench", NULL);
+  bench_activate (f, f->bench_metadata, WP_OBJECT_FEATURES_ALL);
+  bench_wait_pending (f);
+
+  wp_object_manager_add_interest (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "metadata.name", "=s", "bench",
+      NULL);
+  wp_object_manager_request_object_features (om, WP_TYPE_METADATA,
+      WP_OBJECT_FEATURES_ALL);
+  test_ensure_object_manager_is_installed (om, f->base.client_core,
+      f->base.loop);
+  proxy = wp_object_manager_lookup (om, WP_TYPE_METADATA, NULL);
+  g_assert_nonnull (proxy);
+
+  id = g_signal_connect (proxy, "changed", G_CALLBACK (on_metadata_changed), f);
+
+  snprintf (last_key, sizeof (last_key), "bench.key.%u", N_METADATA_SETS - 1);
+  f->wait_key = last_key;
+
+  start = g_get_monotonic_time ();
+  for (guint i = 0; i < N_METADATA_SETS; i++) {
+    gchar value[16];
+    snprintf (key, sizeof (key), "bench.key.%u", i);
+    snprintf (value, sizeof (value), "%u", i);
+    wp_metadata_set (WP_METADATA (f->bench_metadata), 0, key, "Spa:String",
+        value);
+  }
+  bench_wait_key (f);
+  elapsed = elapsed_usec (start);
+
+  g_signal_handler_disconnect (proxy, id);
+  return N_METADATA_SETS / (elapsed / G_USEC_PER_SEC);
+}
+
+/* returns the average time that module-default-nodes needs to react to
+   a change of the configured default sink */
+static gdouble
+bench_default_nodes (BenchFixture * f)
+{
+  g_autoptr (WpPlugin) plugin = NULL;
+  g_autoptr (GError) error = NULL;
+  guint n_iterations = MIN (N_REEVALUATIONS, f->n_nodes);
+  gint64 start;
+
+  wp_core_load_component (f->base.core,
+      "libwireplumber-module-default-nodes", "module",
+      g_variant_new_parsed ("{ 'use-persistent-storage': <false> }"), &error);
+  g_assert_no_error (error);
+
+  plugin = wp_plugin_find (f->base.core, "default-nodes");
+  g_assert_nonnull (plugin);
+  bench_activate (f, plugin, WP_PLUGIN_FEATURE_ENABLED);
+  bench_wait_pending (f);
+
+  f->default_metadata =
+      wp_impl_metadata_new_full (f->base.core, "default", NULL);
+  g_signal_connect (f->default_metadata, "changed",
+      G_CALLBACK (on_metadata_changed), f);
+
+  /* wait for the initial evaluation */
+  f->wait_key = "default.audio.sink";
+  f->wait_value = g_strdup_printf ("\"bench-sink-%u\"", f->n_nodes - 1);
+  bench_activate (f, f->default_metadata, WP_OBJECT_FEATURES_ALL);
+  bench_wait_pending (f);
+  bench_wait_key (f);
+
+  start = g_get_monotonic_time ();
+  for (guint i = 0; i < n_iterations; i++) {
+    guint target = i * f->n_nodes / n_iterations;
+    g_autofree gchar *name = g_strdup_printf ("bench-sink-%u", target);
+    g_autoptr (WpSpaJson) json = wp_spa_json_new_object (
+        "name", "s", name, NULL);
+
+    f->wait_key = "default.audio.sink";
+    f->wait_value = g_strdup_printf ("\"%s\"", name);
+    wp_metadata_set (WP_METADATA (f->default_metadata), 0,
+        "default.configured.audio.sink", "Spa:String:JSON",
+        wp_spa_json_get_data (json));
+    bench_wait_key (f);
+  }
+  return elapsed_usec (start) / n_iterations;
+}
+
+/* returns the average time needed to create a link, linking every source
+   to the sink with the same index */
+static gdouble
+bench_links (BenchFixture * f)
+{
+  gint64 start = g_get_monotonic_time ();
+
+  for (guint i = 0; i < f->n_nodes; i++) {
+    WpProxy *out = g_ptr_array_index (f->sources, i);
+    WpProxy *in = g_ptr_array_index (f->sinks, i);
+    WpProperties *props = wp_properties_new_empty ();
+    WpLink *link;
+
+    wp_properties_setf (props, "link.output.node", "%u",
+        wp_proxy_get_bound_id (out));
+    wp_properties_setf (props, "link.input.node", "%u",
+        wp_proxy_get_bound_id (in));
+    link = wp_link_new_from_factory (f->base.client_core, "link-factory",
+        props);
+    g_assert_nonnull (link);
+    g_ptr_array_add (f->links, link);
+    bench_activate (f, link, WP_PROXY_FEATURE_BOUND);
+  }
+  bench_wait_pending (f);
+
+  return elapsed_usec (start) / f->n_nodes;
+}
+
+/* returns the average round-trip time of a metadata change that is
+   answered by a lua script */
+static gdouble
+bench_lua (BenchFixture * f)
+{
+  g_autoptr (WpPlugin) plugin = NULL;
+  g_autoptr (GError) error = NULL;
+  gint64 start;
+
+  wp_core_load_component (f->base.core,
+      "libwireplumber-module-lua-scripting", "module", NULL, &error);
+  g_assert_no_error (error);
+
+  plugin = wp_plugin_find (f->base.core, "lua-scripting");
+  g_assert_nonnull (plugin);
+  bench_activate (f, plugin, WP_PLUGIN_FEATURE_ENABLED);
+  bench_wait_pending (f);
+
+  g_signal_connect (f->bench_metadata, "changed",
+      G_CALLBACK (on_metadata_changed), f);
+
+  f->wait_key = "bench.ready";
+  wp_core_load_component (f->base.core, "event-latency.lua", "script/lua",
+      NULL, &error);
+  g_assert_no_error (error);
+  bench_wait_key (f);
+
+  start = g_get_monotonic_time ();
+  for (guint i = 0; i < N_LUA_EVENTS; i++) {
+    g_autofree gchar *value = g_strdup_printf ("<%u>", i);
+
+    f->wait_key = "bench.pong";
+    f->wait_value = g_strdup (value);
+    wp_metadata_set (WP_METADATA (f->bench_metadata), 0, "bench.ping",
+        "Spa:String", value);
+    bench_wait_key (f);
+  }
+  return elapsed_usec (start) / N_LUA_EVENTS;
+}
+
+static WpSpaJson *
+bench_run (guint n_nodes)
+{
+  BenchFixture f = {0};
+  g_autoptr (WpSpaJsonBuilder) b = wp_spa_json_builder_new_object ();
+
+  wp_spa_json_builder_add_property (b, "n-nodes");
+  wp_spa_json_builder_add_int (b, n_nodes);
+
+  if (!bench_setup (&f, n_nodes)) {
+    wp_spa_json_builder_add_property (b, "skipped");
+    wp_spa_json_builder_add_string (b,
+        "The pipewire fakesink factory was not found");
+    bench_teardown (&f);
+    return wp_spa_json_builder_end (b);
+  }
+
+  wp_spa_json_builder_add_property (b, "create-graph-usec");
+  wp_spa_json_builder_add_float (b, bench_create_graph (&f));
+  wp_spa_json_builder_add_property (b, "om-install-usec");
+  wp_spa_json_builder_add_float (b, bench_om_install (&f));
+  wp_spa_json_builder_add_property (b, "om-lookup-usec");
+  wp_spa_json_builder_add_float (b, bench_lookup (&f));
+  wp_spa_json_builder_add_property (b, "port-lookup-usec");
+  wp_spa_json_builder_add_float (b, bench_port_lookup (&f));
+  wp_spa_json_builder_add_property (b, "metadata-sets-per-sec");
+  wp_spa_json_builder_add_float (b, bench_metadata (&f));
+  wp_spa_json_builder_add_property (b, "default-nodes-reevaluate-usec");
+  wp_spa_json_builder_add_float (b, bench_default_nodes (&f));
+  wp_spa_json_builder_add_property (b, "link-create-usec");
+  wp_spa_json_builder_add_float (b, bench_links (&f));
+  wp_spa_json_builder_add_property (b, "lua-event-latency-usec");
+  wp_spa_json_builder_add_float (b, bench_lua (&f));
+
+  bench_teardown (&f);
+  return wp_spa_json_builder_end (b);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  const gchar *sizes_str = g_getenv ("WP_BENCHMARK_SIZES");
+  g_auto (GStrv) sizes = NULL;
+  g_autoptr (WpSpaJsonBuilder) results = wp_spa_json_builder_new_array ();
+  g_autoptr (WpSpaJsonBuilder) b = wp_spa_json_builder_new_object ();
+  g_autoptr (WpSpaJson) json = NULL;
+
+  wp_init (WP_INIT_ALL);
+
+  sizes = g_strsplit (sizes_str ? sizes_str : BENCHMARK_SIZES, ",", -1);
+  for (guint i = 0; sizes[i]; i++) {
+    guint64 n_nodes = g_ascii_strtoull (sizes[i], NULL, 10);
+    g_autoptr (WpSpaJson) result = NULL;
+
+    if (n_nodes < 2 || n_nodes > G_MAXINT) {
+      g_printerr ("invalid graph size '%s'\n", sizes[i]);
+      return 1;
+    }
+
+    g_printerr ("running graph benchmark with %u nodes\n", (guint) n_nodes);
+    result = bench_run ((guint) n_nodes);
+    wp_spa_json_builder_add_json (results, result);
+  }
+
+  wp_spa_json_builder_add_property (b, "benchmark");
+  wp_spa_json_builder_add_string (b, "graph");
+  wp_spa_json_builder_add_property (b, "results");
+  {
+    g_autoptr (WpSpaJson) r = wp_spa_json_builder_end (results);
+    wp_spa_json_builder_add_json (b, r);
+  }
+  json = wp_spa_json_builder_end (b);
+
+  if (argc > 1) {
+    g_autoptr (GError) error = NULL;
+    if (!g_file_set_contents (argv[1], wp_spa_json_get_data (json),
+            wp_spa_json_get_size (json), &error)) {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  } else {
+    g_print ("%.*s\n", (gint) wp_spa_json_get_size (json),
+        wp_spa_json_get_data (json));
+  }
+
+  return 0;
+}
@@ -0,0 +1,27 @@
+-- WirePlumber
+--
+-- Copyright © 2022 Collabora Ltd.
+--
+-- SPDX-License-Identifier: MIT
+--
+-- Answers every "bench.ping" key on the "bench" metadata with a "bench.pong"
+-- key carrying the same value, so that the benchmark can measure the time
+-- it takes for an event to travel through a lua script and back
+
+bench_om = ObjectManager {
+  Interest {
+    type = "metadata",
+    Constraint { "metadata.name", "=", "bench" },
+  }
+}
+
+bench_om:connect("object-added", function (om, metadata)
+  metadata:connect("changed", function (m, subject, key, type, value)
+    if key == "bench.ping" then
+      m:set(subject, "bench.pong", type, value)
+    end
+  end)
+  metadata:set(0, "bench.ready", "Spa:String", "<ready>")
+end)
+
+bench_om:activate()
@@ -0,0 +1,160 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+
+typedef struct {
+  WpBaseTestFixture base;
+  WpPlugin *plugin;
+  WpImplMetadata *metadata;
+} TestFixture;
+
+static void
+test_bluetooth_autoswitch_setup (TestFixture * f, gconstpointer user_data)
+{
+  g_autoptr (GError) error = NULL;
+  g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+  g_auto (GVariantBuilder) apps =
+      G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+
+  wp_base_test_fixture_setup (&f->base, 0);
+
+  /* the same layout as the Lua configuration tables */
+  g_variant_builder_add (&apps, "{sv}", "1",
+      g_variant_new_string ("Test App"));
+  g_variant_builder_add (&b, "{sv}", "media-role.use-headset-profile",
+      g_variant_new_boolean (TRUE));
+  g_variant_builder_add (&b, "{sv}", "media-role.applications",
+      g_variant_builder_end (&apps));
+
+  wp_core_load_component (f->base.core,
+      "libwireplumber-module-bluetooth-autoswitch", "module",
+      g_variant_builder_end (&b), &error);
+  g_assert_no_error (error);
+
+  f->plugin = wp_plugin_find (f->base.core, "bluetooth-autoswitch");
+  g_assert_nonnull (f->plugin);
+}
+
+static void
+test_bluetooth_autoswitch_teardown (TestFixture * f, gconstpointer user_data)
+{
+  g_clear_object (&f->metadata);
+  g_clear_object (&f->plugin);
+  wp_base_test_fixture_teardown (&f->base);
+}
+
+static void
+test_sync (TestFixture * f)
+{
+  wp_core_sync (f->base.core, NULL,
+      (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+}
+
+static guint
+get_active_streams (TestFixture * f)
+{
+  guint n = 0;
+  g_object_get (f->plugin, "active-streams", &n, NULL);
+  return n;
+}
+
+static WpNode *
+create_stream (TestFixture * f, const gchar * name, const gchar * key,
+    const gchar * value)
+{
+  WpNode *node = wp_node_new_from_factory (f->base.core,
+      "spa-node-factory",
+      wp_properties_new (
+          "factory.name", "fakesrc",
+          "node.name", name,
+          "media.class", "Stream/Input/Audio",
+          key, value,
+          NULL));
+  g_assert_nonnull (node);
+  wp_object_activate (WP_OBJECT (node), WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+  return node;
+}
+
+static void
+test_bluetooth_autoswitch_streams (TestFixture * f, gconstpointer user_data)
+{
+  g_autoptr (WpNode) by_role = NULL;
+  g_autoptr (WpNode) by_app = NULL;
+  g_autoptr (WpNode) other = NULL;
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesrc")) {
+      g_test_skip ("The pipewire fakesrc factory was not found");
+      return;
+    }
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+  }
+
+  wp_object_activate (WP_OBJECT (f->plugin), WP_PLUGIN_FEATURE_ENABLED,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  f->metadata = wp_impl_metadata_new_full (f->base.core, "default", NULL);
+  wp_object_activate (WP_OBJECT (f->metadata), WP_OBJECT_FEATURES_ALL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  by_role = create_stream (f, "stream-by-role", "media.role", "Communication");
+  by_app = create_stream (f, "stream-by-app", "application.name", "Test App");
+  other = create_stream (f, "stream-other", "media.role", "Music");
+  test_sync (f);
+
+  /* the default sink is not a bluetooth one */
+  g_assert_cmpuint (get_active_streams (f), ==, 0);
+
+  wp_metadata_set (WP_METADATA (f->metadata), 0, "default.audio.sink",
+      "Spa:String:JSON", "{ \"name\": \"bluez_output.00_00_00_00_00_00.1\" }");
+  test_sync (f);
+
+  /* both communication streams hold the headset profile */
+  g_assert_cmpuint (get_active_streams (f), ==, 2);
+
+  g_clear_object (&other);
+  test_sync (f);
+  g_assert_cmpuint (get_active_streams (f), ==, 2);
+
+  g_clear_object (&by_role);
+  test_sync (f);
+  g_assert_cmpuint (get_active_streams (f), ==, 1);
+
+  g_clear_object (&by_app);
+  test_sync (f);
+  g_assert_cmpuint (get_active_streams (f), ==, 0);
+
+  wp_object_deactivate (WP_OBJECT (f->plugin), WP_PLUGIN_FEATURE_ENABLED);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/modules/bluetooth-autoswitch/streams",
+      TestFixture, NULL,
+      test_bluetooth_autoswitch_setup,
+      test_bluetooth_autoswitch_streams,
+      test_bluetooth_autoswitch_teardown);
+
+  return g_test_run ();
+}
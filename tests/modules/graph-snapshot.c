@@ -0,0 +1,201 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+
+#include "../common/base-test-fixture.h"
+#include "snapshot.h"
+
+typedef struct {
+  WpBaseTestFixture base;
+  WpPlugin *plugin;
+  gchar *dir;
+  gchar *path;
+} TestFixture;
+
+static void
+test_graph_snapshot_setup (TestFixture * f, gconstpointer user_data)
+{
+  g_autoptr (GError) error = NULL;
+  g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+
+  wp_base_test_fixture_setup (&f->base, 0);
+
+  f->dir = g_dir_make_tmp ("wp-graph-snapshot-XXXXXX", &error);
+  g_assert_no_error (error);
+  f->path = g_build_filename (f->dir, "snapshot", NULL);
+
+  g_variant_builder_add (&b, "{sv}", "path", g_variant_new_string (f->path));
+  wp_core_load_component (f->base.core,
+      "libwireplumber-module-graph-snapshot", "module",
+      g_variant_builder_end (&b), &error);
+  g_assert_no_error (error);
+
+  f->plugin = wp_plugin_find (f->base.core, "graph-snapshot");
+  g_assert_nonnull (f->plugin);
+}
+
+static void
+test_graph_snapshot_teardown (TestFixture * f, gconstpointer user_data)
+{
+  g_clear_object (&f->plugin);
+  wp_base_test_fixture_teardown (&f->base);
+  g_unlink (f->path);
+  g_rmdir (f->dir);
+  g_clear_pointer (&f->path, g_free);
+  g_clear_pointer (&f->dir, g_free);
+}
+
+static void
+on_plugin_activated (WpObject * plugin, GAsyncResult * res, TestFixture * f)
+{
+  g_autoptr (GError) error = NULL;
+  if (!wp_object_activate_finish (plugin, res, &error))
+    wp_critical_object (plugin, "%s", error->message);
+  g_main_loop_quit (f->base.loop);
+}
+
+/* looks up the node named @name in the current snapshot */
+static gboolean
+find_node (struct wp_graph_snapshot_reader * reader, const gchar * name,
+    struct wp_graph_snapshot_node * node)
+{
+  struct wp_graph_snapshot_header *s = NULL;
+  const struct wp_graph_snapshot_node *nodes;
+  gboolean found = FALSE;
+
+  g_assert_cmpint (wp_graph_snapshot_reader_read (reader, &s), ==, 0);
+  g_assert_cmpuint (s->magic, ==, WP_GRAPH_SNAPSHOT_MAGIC);
+  g_assert_cmpuint (s->generation % 2, ==, 0);
+
+  nodes = WP_GRAPH_SNAPSHOT_NODES (s);
+  for (guint i = 0; i < s->n_nodes && !found; i++) {
+    if (g_str_equal (nodes[i].name, name)) {
+      *node = nodes[i];
+      found = TRUE;
+    }
+  }
+  free (s);
+  return found;
+}
+
+static void
+test_graph_snapshot_basic (TestFixture * f, gconstpointer user_data)
+{
+  struct wp_graph_snapshot_reader *reader = NULL;
+  struct wp_graph_snapshot_header *s = NULL;
+  struct wp_graph_snapshot_node entry;
+  g_autoptr (WpNode) node = NULL;
+  guint32 generation;
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesink")) {
+      g_test_skip ("The pipewire fakesink factory was not found");
+      return;
+    }
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+  }
+
+  wp_object_activate (WP_OBJECT (f->plugin), WP_PLUGIN_FEATURE_ENABLED,
+      NULL, (GAsyncReadyCallback) on_plugin_activated, f);
+  g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (wp_object_get_active_features (WP_OBJECT (f->plugin)),
+      ==, WP_PLUGIN_FEATURE_ENABLED);
+
+  g_assert_cmpint (wp_graph_snapshot_reader_open (f->path, &reader), ==, 0);
+  g_assert_false (find_node (reader, "Fakesink", &entry));
+
+  /* a new node shows up in the snapshot */
+  generation = wp_graph_snapshot_reader_get_generation (reader);
+  node = wp_node_new_from_factory (f->base.core,
+      "spa-node-factory",
+      wp_properties_new (
+          "factory.name", "fakesink",
+          "node.name", "Fakesink",
+          "node.description", "Fake sink",
+          NULL));
+  g_assert_nonnull (node);
+  wp_object_activate (WP_OBJECT (node), WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  while (!find_node (reader, "Fakesink", &entry))
+    g_main_context_iteration (f->base.context, TRUE);
+
+  g_assert_cmpuint (wp_graph_snapshot_reader_get_generation (reader), >,
+      generation);
+  g_assert_cmpuint (entry.id, ==, wp_proxy_get_bound_id (WP_PROXY (node)));
+  g_assert_cmpstr (entry.description, ==, "Fake sink");
+  g_assert_cmpuint (entry.device_id, ==, WP_GRAPH_SNAPSHOT_INVALID_ID);
+  g_assert_cmpuint (entry.flags & WP_GRAPH_SNAPSHOT_NODE_HAS_VOLUME, ==, 0);
+
+  /* and goes away with it */
+  g_clear_object (&node);
+  while (find_node (reader, "Fakesink", &entry))
+    g_main_context_iteration (f->base.context, TRUE);
+
+  /* disabling the module invalidates the snapshot */
+  wp_object_deactivate (WP_OBJECT (f->plugin), WP_PLUGIN_FEATURE_ENABLED);
+  g_assert_cmpint (wp_graph_snapshot_reader_read (reader, &s), ==, -ESTALE);
+  g_assert_false (g_file_test (f->path, G_FILE_TEST_EXISTS));
+  wp_graph_snapshot_reader_close (reader);
+  g_assert_cmpint (wp_graph_snapshot_reader_open (f->path, &reader), ==,
+      -ENOENT);
+}
+
+static void
+test_graph_snapshot_default_path (void)
+{
+  g_autofree gchar *runtime_dir = g_strdup (g_getenv ("XDG_RUNTIME_DIR"));
+  g_autofree gchar *expected = NULL;
+  char path[64];
+
+  /* the module and the reader agree on the same location */
+  g_setenv ("XDG_RUNTIME_DIR", "/run/user/1000", TRUE);
+  expected = g_build_filename ("/run/user/1000",
+      WP_GRAPH_SNAPSHOT_DEFAULT_NAME, NULL);
+  g_assert_cmpint (wp_graph_snapshot_get_default_path (path, sizeof (path)),
+      ==, 0);
+  g_assert_cmpstr (path, ==, expected);
+  g_assert_cmpint (wp_graph_snapshot_get_default_path (path, 8), ==,
+      -ENAMETOOLONG);
+
+  /* there is no fallback location */
+  g_unsetenv ("XDG_RUNTIME_DIR");
+  g_assert_cmpint (wp_graph_snapshot_get_default_path (path, sizeof (path)),
+      ==, -ENOENT);
+
+  if (runtime_dir)
+    g_setenv ("XDG_RUNTIME_DIR", runtime_dir, TRUE);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/modules/graph-snapshot/basic",
+      TestFixture, NULL,
+      test_graph_snapshot_setup,
+      test_graph_snapshot_basic,
+      test_graph_snapshot_teardown);
+
+  g_test_add_func ("/modules/graph-snapshot/default-path",
+      test_graph_snapshot_default_path);
+
+  return g_test_run ();
+}
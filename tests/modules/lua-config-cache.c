@@ -0,0 +1,147 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <glib/gstdio.h>
+
+#include "../common/base-test-fixture.h"
+
+#define CONF_FILE "test-config-cache.lua"
+
+typedef struct {
+  WpBaseTestFixture base;
+  gchar *dir;
+  gchar *conf_path;
+  gchar *fragment_dir;
+  gchar *fragment_path;
+  gchar *cache_path;
+} TestFixture;
+
+static void
+test_lua_config_cache_setup (TestFixture * f, gconstpointer user_data)
+{
+  g_autoptr (GError) error = NULL;
+
+  wp_base_test_fixture_setup (&f->base, WP_BASE_TEST_FLAG_DONT_CONNECT);
+
+  f->dir = g_dir_make_tmp ("wp-lua-config-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  f->conf_path = g_build_filename (f->dir, CONF_FILE, NULL);
+  f->fragment_dir = g_build_filename (f->dir, CONF_FILE ".d", NULL);
+  f->fragment_path = g_build_filename (f->fragment_dir, "10-test.lua", NULL);
+  f->cache_path = g_build_filename (g_get_user_cache_dir (), "wireplumber",
+      "config", CONF_FILE ".cache", NULL);
+  g_unlink (f->cache_path);
+
+  g_setenv ("WIREPLUMBER_CONFIG_DIR", f->dir, TRUE);
+
+  wp_core_load_component (f->base.core,
+      "libwireplumber-module-lua-scripting", "module", NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_lua_config_cache_teardown (TestFixture * f, gconstpointer user_data)
+{
+  g_setenv ("WIREPLUMBER_CONFIG_DIR", "/invalid", TRUE);
+  wp_base_test_fixture_teardown (&f->base);
+  g_unlink (f->cache_path);
+  g_unlink (f->fragment_path);
+  g_rmdir (f->fragment_dir);
+  g_unlink (f->conf_path);
+  g_rmdir (f->dir);
+  g_clear_pointer (&f->cache_path, g_free);
+  g_clear_pointer (&f->fragment_path, g_free);
+  g_clear_pointer (&f->fragment_dir, g_free);
+  g_clear_pointer (&f->conf_path, g_free);
+  g_clear_pointer (&f->dir, g_free);
+}
+
+static GVariant *
+read_cache (TestFixture * f)
+{
+  g_autoptr (GError) error = NULL;
+  gchar *contents = NULL;
+  gsize len = 0;
+
+  g_file_get_contents (f->cache_path, &contents, &len, &error);
+  g_assert_no_error (error);
+  return g_variant_ref_sink (g_variant_new_from_data (
+          G_VARIANT_TYPE ("(sa(ssbmv))"), contents, len, FALSE, g_free,
+          contents));
+}
+
+static void
+test_lua_config_cache (TestFixture * f, gconstpointer user_data)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GVariant) cache = NULL;
+  g_autoptr (GVariant) tampered = NULL;
+  g_autoptr (GVariant) components = NULL;
+  g_autofree gchar *fingerprint = NULL;
+  const gchar *new_fingerprint = NULL;
+  g_auto (GVariantBuilder) b =
+      G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(ssbmv)"));
+
+  g_file_set_contents (f->conf_path, "components = {}\n", -1, &error);
+  g_assert_no_error (error);
+
+  /* the first load evaluates the configuration and stores the result */
+  g_assert_true (wp_core_load_component (f->base.core, CONF_FILE,
+          "config/lua", NULL, &error));
+  g_assert_no_error (error);
+  g_assert_true (g_file_test (f->cache_path, G_FILE_TEST_IS_REGULAR));
+
+  cache = read_cache (f);
+  g_variant_get (cache, "(s@a(ssbmv))", &fingerprint, &components);
+  g_assert_cmpuint (g_variant_n_children (components), ==, 0);
+  g_clear_pointer (&components, g_variant_unref);
+  g_clear_pointer (&cache, g_variant_unref);
+
+  /* replace the cached components while keeping the fingerprint; a load
+     that comes from the cache tries to load this component and fails */
+  g_variant_builder_add (&b, "(ssbm@v)", "test-cached-component",
+      "test/nonexistent", FALSE, NULL);
+  tampered = g_variant_ref_sink (g_variant_new ("(s@a(ssbmv))", fingerprint,
+          g_variant_builder_end (&b)));
+  g_file_set_contents (f->cache_path, g_variant_get_data (tampered),
+      g_variant_get_size (tampered), &error);
+  g_assert_no_error (error);
+
+  g_assert_false (wp_core_load_component (f->base.core, CONF_FILE,
+          "config/lua", NULL, &error));
+  g_assert_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVALID_ARGUMENT);
+  g_clear_error (&error);
+
+  /* adding a fragment invalidates the cache */
+  g_assert_cmpint (g_mkdir (f->fragment_dir, 0700), ==, 0);
+  g_file_set_contents (f->fragment_path, "-- empty fragment\n", -1, &error);
+  g_assert_no_error (error);
+
+  g_assert_true (wp_core_load_component (f->base.core, CONF_FILE,
+          "config/lua", NULL, &error));
+  g_assert_no_error (error);
+
+  cache = read_cache (f);
+  g_variant_get (cache, "(&s@a(ssbmv))", &new_fingerprint, &components);
+  g_assert_cmpstr (new_fingerprint, !=, fingerprint);
+  g_assert_cmpuint (g_variant_n_children (components), ==, 0);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/modules/lua-config-cache/hit-and-invalidation",
+      TestFixture, NULL,
+      test_lua_config_cache_setup,
+      test_lua_config_cache,
+      test_lua_config_cache_teardown);
+
+  return g_test_run ();
+}
@@ -145,6 +145,21 @@ test_si_node_configure_activate (TestFixture * f, gconstpointer user_data)
       g_assert_nonnull (port);
       g_assert_cmpuint (port_id, ==, wp_proxy_get_bound_id (port));
     }
+
+    /* the typed port set must match the variant */
+    {
+      g_autoptr (GArray) ports =
+          wp_si_linkable_get_port_set (WP_SI_LINKABLE (item),
+          (data->expected_direction == WP_DIRECTION_INPUT) ? "input" : "output");
+      WpSiPortInfo *info;
+
+      g_assert_nonnull (ports);
+      g_assert_cmpuint (ports->len, ==, 1);
+      info = &g_array_index (ports, WpSiPortInfo, 0);
+      g_assert_cmpuint (info->node_id, ==, node_id);
+      g_assert_cmpuint (info->port_id, ==, port_id);
+      g_assert_cmpuint (info->channel, ==, channel);
+    }
   }
 
   /* deactivate - configuration should not be altered  */
@@ -87,6 +87,347 @@ test_om_interest_on_pw_props (TestFixture *f, gconstpointer user_data)
   g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 0);
 }
 
+static WpNode *
+create_fakesink (TestFixture *f, const gchar *name)
+{
+  WpNode *node = wp_node_new_from_factory (f->base.client_core,
+      "spa-node-factory",
+      wp_properties_new (
+          "factory.name", "fakesink",
+          "node.name", name,
+          NULL));
+  g_assert_nonnull (node);
+
+  wp_object_activate (WP_OBJECT (node), WP_OBJECT_FEATURES_ALL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+  return node;
+}
+
+static WpObjectManager *
+install_ports_om (TestFixture *f, guint32 node_id)
+{
+  WpObjectManager *om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_PORT,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_NODE_ID, "=u", node_id,
+      NULL);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+  return om;
+}
+
+static void
+assert_ports_of_node (WpObjectManager *om, guint32 node_id)
+{
+  g_autoptr (WpIterator) it = wp_object_manager_new_iterator (om);
+  g_auto (GValue) val = G_VALUE_INIT;
+  g_autofree gchar *expected = g_strdup_printf ("%u", node_id);
+
+  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
+    WpPipewireObject *port = g_value_get_object (&val);
+    g_assert_true (WP_IS_PORT (port));
+    g_assert_cmpstr (
+        wp_pipewire_object_get_property (port, PW_KEY_NODE_ID), ==, expected);
+  }
+}
+
+static void
+test_om_interest_on_node_id (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpNode) node_a = NULL;
+  g_autoptr (WpNode) node_b = NULL;
+  g_autoptr (WpObjectManager) om_a = NULL;
+  g_autoptr (WpObjectManager) om_b = NULL;
+  g_autoptr (WpObjectManager) om_none = NULL;
+  g_autoptr (WpObjectManager) om_all = NULL;
+  guint32 id_a, id_b;
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesink")) {
+      g_test_skip ("The pipewire fakesink factory was not found");
+      return;
+    }
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+  }
+
+  /* this one is installed before the nodes exist */
+  om_all = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_all, WP_TYPE_PORT, NULL);
+  wp_object_manager_request_object_features (om_all, WP_TYPE_PORT,
+      WP_PIPEWIRE_OBJECT_FEATURE_INFO);
+  test_ensure_object_manager_is_installed (om_all, f->base.core, f->base.loop);
+
+  node_a = create_fakesink (f, "Fakesink-A");
+  node_b = create_fakesink (f, "Fakesink-B");
+  id_a = wp_proxy_get_bound_id (WP_PROXY (node_a));
+  id_b = wp_proxy_get_bound_id (WP_PROXY (node_b));
+
+  /* ensure the base core is in sync */
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  om_a = install_ports_om (f, id_a);
+  om_b = install_ports_om (f, id_b);
+  om_none = install_ports_om (f, G_MAXUINT32 - 1);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_a), >, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), >, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_none), ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_all), ==,
+      wp_object_manager_get_n_objects (om_a) +
+      wp_object_manager_get_n_objects (om_b));
+  assert_ports_of_node (om_a, id_a);
+  assert_ports_of_node (om_b, id_b);
+
+  /* destroying node A removes its ports only from the interested managers */
+  g_clear_object (&node_a);
+  wp_core_sync (f->base.client_core, NULL,
+      (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_a), ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), >, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_all), ==,
+      wp_object_manager_get_n_objects (om_b));
+  assert_ports_of_node (om_b, id_b);
+}
+
+static void
+count_ports_changed (guint * n)
+{
+  (*n)++;
+}
+
+static void
+test_om_node_ports (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpNode) node_a = NULL;
+  g_autoptr (WpNode) node_b = NULL;
+  g_autoptr (WpPort) port = NULL;
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) val = G_VALUE_INIT;
+  g_autofree gchar *id_a = NULL;
+  guint n_ports = 0;
+  guint n_ports_changed = 0;
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesink")) {
+      g_test_skip ("The pipewire fakesink factory was not found");
+      return;
+    }
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+  }
+
+  /* both nodes share the same port index on the client core */
+  node_a = create_fakesink (f, "Fakesink-A");
+  node_b = create_fakesink (f, "Fakesink-B");
+  id_a = g_strdup_printf ("%u", wp_proxy_get_bound_id (WP_PROXY (node_a)));
+
+  g_assert_true (wp_object_get_active_features (WP_OBJECT (node_a)) &
+      WP_NODE_FEATURE_PORTS);
+  g_assert_cmpuint (wp_node_get_n_ports (node_a), >, 0);
+  g_assert_cmpuint (wp_node_get_n_ports (node_b), >, 0);
+
+  for (it = wp_node_new_ports_iterator (node_a);
+       wp_iterator_next (it, &val);
+       g_value_unset (&val)) {
+    WpPipewireObject *p = g_value_get_object (&val);
+    g_assert_cmpstr (wp_pipewire_object_get_property (p, PW_KEY_NODE_ID), ==,
+        id_a);
+    n_ports++;
+  }
+  g_assert_cmpuint (n_ports, ==, wp_node_get_n_ports (node_a));
+
+  port = wp_node_lookup_port (node_a,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_PORT_DIRECTION, "=s", "in",
+      NULL);
+  g_assert_nonnull (port);
+  g_assert_cmpint (wp_port_get_direction (port), ==, WP_DIRECTION_INPUT);
+  g_clear_object (&port);
+
+  /* fakesink has no output ports */
+  port = wp_node_lookup_port (node_a,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_PORT_DIRECTION, "=s", "out",
+      NULL);
+  g_assert_null (port);
+
+  /* disabling the feature on one node does not affect the other */
+  wp_object_deactivate (WP_OBJECT (node_a), WP_NODE_FEATURE_PORTS);
+  g_assert_false (wp_object_get_active_features (WP_OBJECT (node_a)) &
+      WP_NODE_FEATURE_PORTS);
+  g_assert_cmpuint (wp_node_get_n_ports (node_b), >, 0);
+
+  /* enabling the feature again announces the existing ports */
+  g_signal_connect_swapped (node_a, "ports-changed",
+      G_CALLBACK (count_ports_changed), &n_ports_changed);
+  wp_object_activate (WP_OBJECT (node_a), WP_NODE_FEATURE_PORTS,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (n_ports_changed, ==, 1);
+  g_assert_cmpuint (wp_node_get_n_ports (node_a), ==, n_ports);
+
+  /* no duplicate emission follows */
+  wp_core_sync (f->base.client_core, NULL,
+      (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (n_ports_changed, ==, 1);
+}
+
+static void
+update_server_node_properties (TestFixture *f, guint32 id,
+    const struct spa_dict * props)
+{
+  g_autoptr (WpTestServerLocker) lock =
+      wp_test_server_locker_new (&f->base.server);
+  struct pw_global *global =
+      pw_context_find_global (f->base.server.context, id);
+
+  g_assert_nonnull (global);
+  g_assert_cmpint (pw_impl_node_update_properties (
+          pw_global_get_object (global), props), >=, 0);
+}
+
+static void
+count_signal (WpObjectManager *om, gpointer object, guint *counter)
+{
+  (*counter)++;
+}
+
+static void
+test_om_live (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpNode) node = NULL;
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpObjectManager) static_om = NULL;
+  guint n_added = 0, n_removed = 0;
+  guint32 id;
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesink")) {
+      g_test_skip ("The pipewire fakesink factory was not found");
+      return;
+    }
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+  }
+
+  node = create_fakesink (f, "Fakesink-Live");
+  id = wp_proxy_get_bound_id (WP_PROXY (node));
+
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  om = wp_object_manager_new ();
+  wp_object_manager_set_live (om, TRUE);
+  g_assert_true (wp_object_manager_is_live (om));
+  wp_object_manager_add_interest (om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "node.name", "=s", "Fakesink-Live",
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "test.live", "=s", "yes",
+      NULL);
+  g_signal_connect (om, "object-added", G_CALLBACK (count_signal), &n_added);
+  g_signal_connect (om, "object-removed", G_CALLBACK (count_signal),
+      &n_removed);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+
+  static_om = wp_object_manager_new ();
+  wp_object_manager_add_interest (static_om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "node.name", "=s", "Fakesink-Live",
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "test.live", "=s", "yes",
+      NULL);
+  test_ensure_object_manager_is_installed (static_om, f->base.core,
+      f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (static_om), ==, 0);
+
+  /* the node starts matching */
+  {
+    const struct spa_dict_item items[] = { { "test.live", "yes" } };
+    update_server_node_properties (f, id, &SPA_DICT_INIT_ARRAY (items));
+  }
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 1);
+  g_assert_cmpuint (n_added, ==, 1);
+  g_assert_cmpuint (n_removed, ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (static_om), ==, 0);
+
+  /* a key that is not constrained changes; nothing happens */
+  {
+    const struct spa_dict_item items[] = { { "test.other", "1" } };
+    update_server_node_properties (f, id, &SPA_DICT_INIT_ARRAY (items));
+  }
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 1);
+  g_assert_cmpuint (n_added, ==, 1);
+  g_assert_cmpuint (n_removed, ==, 0);
+
+  /* the node stops matching */
+  {
+    const struct spa_dict_item items[] = { { "test.live", "no" } };
+    update_server_node_properties (f, id, &SPA_DICT_INIT_ARRAY (items));
+  }
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 0);
+  g_assert_cmpuint (n_added, ==, 1);
+  g_assert_cmpuint (n_removed, ==, 1);
+
+  /* and the node goes away while it is a candidate */
+  g_clear_object (&node);
+  wp_core_sync (f->base.client_core, NULL,
+      (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 0);
+  g_assert_cmpuint (n_removed, ==, 1);
+}
+
+static void
+test_om_live_max_interests (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = wp_object_manager_new ();
+
+  wp_object_manager_set_live (om, TRUE);
+  for (guint i = 0; i < 32; i++)
+    wp_object_manager_add_interest (om, WP_TYPE_NODE, NULL);
+  g_assert_true (wp_object_manager_is_live (om));
+
+  /* one more interest does not fit in the match masks */
+  wp_object_manager_add_interest (om, WP_TYPE_NODE, NULL);
+  g_assert_false (wp_object_manager_is_live (om));
+
+  wp_object_manager_set_live (om, TRUE);
+  g_assert_false (wp_object_manager_is_live (om));
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -95,6 +436,14 @@ main (gint argc, gchar *argv[])
 
   g_test_add ("/wp/om/interest-on-pw-props", TestFixture, NULL,
       test_om_setup, test_om_interest_on_pw_props, test_om_teardown);
+  g_test_add ("/wp/om/interest-on-node-id", TestFixture, NULL,
+      test_om_setup, test_om_interest_on_node_id, test_om_teardown);
+  g_test_add ("/wp/om/node-ports", TestFixture, NULL,
+      test_om_setup, test_om_node_ports, test_om_teardown);
+  g_test_add ("/wp/om/live", TestFixture, NULL,
+      test_om_setup, test_om_live, test_om_teardown);
+  g_test_add ("/wp/om/live-max-interests", TestFixture, NULL,
+      test_om_setup, test_om_live_max_interests, test_om_teardown);
 
   return g_test_run ();
 }
@@ -136,6 +136,58 @@ test_properties_to_pw_props (void)
   pw_properties_free (props);
 }
 
+static void
+test_properties_take_pw_props (void)
+{
+  struct spa_dict_item items[] = {
+    SPA_DICT_ITEM_INIT ("key1", "value1"),
+  };
+  struct spa_dict dict = SPA_DICT_INIT_ARRAY (items);
+  struct pw_properties *props, *wrapped;
+  WpProperties *p, *ref;
+
+  /* a uniquely owned set gives away its pw_properties */
+  wrapped = pw_properties_new ("key1", "value1", NULL);
+  p = wp_properties_new_take (wrapped);
+  props = wp_properties_unref_and_take_pw_properties (p);
+  g_assert_true (props == wrapped);
+  g_assert_cmpstr (pw_properties_get (props, "key1"), ==, "value1");
+  pw_properties_free (props);
+
+  /* a shared set is copied and stays valid */
+  wrapped = pw_properties_new ("key1", "value1", NULL);
+  p = wp_properties_new_take (wrapped);
+  ref = wp_properties_ref (p);
+  props = wp_properties_unref_and_take_pw_properties (p);
+  g_assert_true (props != wrapped);
+  g_assert_cmpint (pw_properties_set (props, "key2", "value2"), ==, 1);
+  g_assert_cmpstr (wp_properties_get (ref, "key1"), ==, "value1");
+  g_assert_null (wp_properties_get (ref, "key2"));
+  pw_properties_free (props);
+  wp_properties_unref (ref);
+
+  /* a wrapped dict is copied */
+  p = wp_properties_new_wrap_dict (&dict);
+  ref = wp_properties_ref (p);
+  props = wp_properties_unref_and_take_pw_properties (p);
+  g_assert_cmpstr (pw_properties_get (props, "key1"), ==, "value1");
+  g_assert_cmpint (pw_properties_set (props, "key2", "value2"), ==, 1);
+  pw_properties_free (props);
+  props = wp_properties_unref_and_take_pw_properties (ref);
+  g_assert_cmpstr (pw_properties_get (props, "key1"), ==, "value1");
+  pw_properties_free (props);
+
+  /* a wrapped pw_properties is copied and not freed */
+  wrapped = pw_properties_new ("key1", "value1", NULL);
+  p = wp_properties_new_wrap (wrapped);
+  props = wp_properties_unref_and_take_pw_properties (p);
+  g_assert_true (props != wrapped);
+  g_assert_cmpstr (pw_properties_get (props, "key1"), ==, "value1");
+  pw_properties_free (props);
+  g_assert_cmpstr (pw_properties_get (wrapped, "key1"), ==, "value1");
+  pw_properties_free (wrapped);
+}
+
 static void
 test_properties_iterate (void)
 {
@@ -165,6 +217,122 @@ test_properties_iterate (void)
   g_assert_cmpint (i, ==, 5);
 }
 
+static void
+test_properties_interned (void)
+{
+  g_autoptr (WpProperties) p1 = NULL;
+  g_autoptr (WpProperties) p2 = NULL;
+  g_autoptr (WpProperties) p3 = NULL;
+  const struct spa_dict *d1, *d2, *d3;
+  const gchar *long_value =
+      "a value that is too long to be worth interning in the pool";
+
+  p1 = wp_properties_new ("media.class", "Audio/Sink",
+      "node.description", long_value, NULL);
+  p2 = wp_properties_new_empty ();
+  g_assert_cmpint (wp_properties_set (p2, "media.class", "Audio/Sink"), ==, 1);
+  g_assert_cmpint (wp_properties_set (p2, "node.description", long_value),
+      ==, 1);
+  g_assert_cmpint (wp_properties_set (p2, "media.class", "Audio/Sink"), ==, 0);
+
+  /* keys and short values are shared */
+  d1 = wp_properties_peek_dict (p1);
+  d2 = wp_properties_peek_dict (p2);
+  g_assert_cmpuint (d1->n_items, ==, 2);
+  g_assert_cmpuint (d2->n_items, ==, 2);
+  g_assert_true (d1->items[0].key == d2->items[0].key);
+  g_assert_true (d1->items[0].value == d2->items[0].value);
+  g_assert_true (d1->items[1].key == d2->items[1].key);
+  g_assert_true (d1->items[1].value != d2->items[1].value);
+  g_assert_cmpstr (d1->items[1].value, ==, d2->items[1].value);
+
+  /* copies share all the strings */
+  p3 = wp_properties_copy (p1);
+  d3 = wp_properties_peek_dict (p3);
+  g_assert_true (d3->items[1].value == d1->items[1].value);
+
+  /* the copies are independent */
+  g_assert_cmpint (wp_properties_set (p1, "media.class", NULL), ==, 1);
+  g_assert_cmpint (wp_properties_setf (p1, "node.description", "%d", 5), ==, 1);
+  g_assert_cmpstr (wp_properties_get (p1, "media.class"), ==, NULL);
+  g_assert_cmpstr (wp_properties_get (p1, "node.description"), ==, "5");
+  g_assert_cmpstr (wp_properties_get (p3, "media.class"), ==, "Audio/Sink");
+  g_assert_cmpstr (wp_properties_get (p3, "node.description"), ==, long_value);
+
+  /* taking the pw_properties makes a copy */
+  {
+    struct pw_properties *props =
+        wp_properties_unref_and_take_pw_properties (g_steal_pointer (&p3));
+    g_assert_cmpstr (pw_properties_get (props, "media.class"), ==,
+        "Audio/Sink");
+    pw_properties_free (props);
+  }
+}
+
+static void
+test_properties_index (void)
+{
+  g_autoptr (WpProperties) p = wp_properties_new_empty ();
+  g_autoptr (WpProperties) w = NULL;
+  g_autoptr (WpProperties) c = NULL;
+  struct spa_dict_item items[40];
+  struct spa_dict dict;
+  gchar keys[40][16], values[40][16];
+
+  for (guint i = 0; i < 40; i++) {
+    g_snprintf (keys[i], sizeof (keys[i]), "key%u", i);
+    g_snprintf (values[i], sizeof (values[i]), "value%u", i);
+    items[i] = SPA_DICT_ITEM_INIT (keys[i], values[i]);
+    g_assert_cmpint (wp_properties_set (p, keys[i], values[i]), ==, 1);
+  }
+
+  /* the index is built once the set has enough items */
+  g_assert_cmpstr (wp_properties_get (p, "key7"), ==, "value7");
+  g_assert_cmpstr (wp_properties_get (p, "key39"), ==, "value39");
+  g_assert_null (wp_properties_get (p, "key40"));
+
+  /* appending keeps it up to date */
+  g_assert_cmpint (wp_properties_set (p, "key40", "value40"), ==, 1);
+  g_assert_cmpstr (wp_properties_get (p, "key40"), ==, "value40");
+
+  /* removing shifts the items that follow */
+  g_assert_cmpint (wp_properties_set (p, "key3", NULL), ==, 1);
+  g_assert_null (wp_properties_get (p, "key3"));
+  g_assert_cmpstr (wp_properties_get (p, "key4"), ==, "value4");
+  g_assert_cmpstr (wp_properties_get (p, "key40"), ==, "value40");
+
+  /* changing a value keeps the position */
+  g_assert_cmpint (wp_properties_setf (p, "key20", "%s", "changed"), ==, 1);
+  g_assert_cmpstr (wp_properties_get (p, "key20"), ==, "changed");
+
+  wp_properties_sort (p);
+  g_assert_cmpstr (wp_properties_get (p, "key4"), ==, "value4");
+  g_assert_cmpstr (wp_properties_get (p, "key20"), ==, "changed");
+  g_assert_cmpstr (wp_properties_get (p, "key0"), ==, "value0");
+
+  /* copies are indexed when they are created */
+  c = wp_properties_copy (p);
+  g_assert_cmpstr (wp_properties_get (c, "key4"), ==, "value4");
+  g_assert_cmpstr (wp_properties_get (c, "key20"), ==, "changed");
+  g_assert_null (wp_properties_get (c, "key3"));
+
+  /* shrinking below the threshold drops the index */
+  for (guint i = 0; i < 36; i++)
+    wp_properties_set (c, keys[i], NULL);
+  g_assert_cmpuint (wp_properties_peek_dict (c)->n_items, ==, 5);
+  g_assert_null (wp_properties_get (c, "key4"));
+  g_assert_cmpstr (wp_properties_get (c, "key39"), ==, "value39");
+  g_assert_cmpstr (wp_properties_get (c, "key40"), ==, "value40");
+
+  /* wrapped dicts may change externally and are not indexed, but the
+     lookups work the same */
+  dict = SPA_DICT_INIT (items, 40);
+  w = wp_properties_new_wrap_dict (&dict);
+  for (guint i = 0; i < 40; i++)
+    g_assert_cmpstr (wp_properties_get (w, keys[i]), ==, values[i]);
+  g_assert_null (wp_properties_get (w, "key40"));
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -177,7 +345,11 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/properties/wrap", test_properties_wrap);
   g_test_add_func ("/wp/properties/take", test_properties_take);
   g_test_add_func ("/wp/properties/to_pw_props", test_properties_to_pw_props);
+  g_test_add_func ("/wp/properties/take_pw_props",
+      test_properties_take_pw_props);
   g_test_add_func ("/wp/properties/iterate", test_properties_iterate);
+  g_test_add_func ("/wp/properties/interned", test_properties_interned);
+  g_test_add_func ("/wp/properties/index", test_properties_index);
 
   return g_test_run ();
 }
@@ -290,6 +290,129 @@ test_enum_params_error (TestFixture *f, gconstpointer data)
   g_main_loop_run (f->base.loop);
 }
 
+static void
+on_properties_changed (WpPipewireObject * node, const gchar * key,
+    const gchar * value, GString * changes)
+{
+  g_string_append_printf (changes, "%s=%s;", key, value ? value : "(null)");
+}
+
+static void
+on_properties_notify (WpPipewireObject * node, GParamSpec * pspec,
+    guint * n_notify)
+{
+  (*n_notify)++;
+}
+
+static void
+update_server_node_properties (TestFixture *f, guint32 id,
+    const struct spa_dict * props)
+{
+  g_autoptr (WpTestServerLocker) lock =
+      wp_test_server_locker_new (&f->base.server);
+  struct pw_global *global =
+      pw_context_find_global (f->base.server.context, id);
+
+  g_assert_nonnull (global);
+  g_assert_cmpint (pw_impl_node_update_properties (
+          pw_global_get_object (global), props), >=, 0);
+}
+
+static void
+test_properties_changed (TestFixture *f, gconstpointer data)
+{
+  g_autoptr (WpNode) node = NULL;
+  g_autoptr (GString) changes = g_string_new (NULL);
+  g_autoptr (GString) answer_changes = g_string_new (NULL);
+  guint n_notify = 0;
+  guint32 id;
+
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_cmpint (pw_context_add_spa_lib (f->base.server.context,
+            "fake*", "test/libspa-test"), ==, 0);
+    if (!test_is_spa_lib_installed (&f->base, "fakesink")) {
+      g_test_skip ("The pipewire fakesink factory was not found");
+      return;
+    }
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+  }
+
+  node = wp_node_new_from_factory (f->base.core,
+      "spa-node-factory",
+      wp_properties_new (
+          "factory.name", "fakesink",
+          "node.name", "Fakesink",
+          NULL));
+  g_assert_nonnull (node);
+
+  wp_object_activate (WP_OBJECT (node), WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+  id = wp_proxy_get_bound_id (WP_PROXY (node));
+
+  g_signal_connect (node, "properties-changed",
+      G_CALLBACK (on_properties_changed), changes);
+  g_signal_connect (node, "properties-changed::test.answer",
+      G_CALLBACK (on_properties_changed), answer_changes);
+  g_signal_connect (node, "notify::properties",
+      G_CALLBACK (on_properties_notify), &n_notify);
+
+  /* one key is added, the other one keeps its value */
+  {
+    const struct spa_dict_item items[] = {
+      { "test.answer", "42" },
+      { "node.name", "Fakesink" },
+    };
+    update_server_node_properties (f, id, &SPA_DICT_INIT_ARRAY (items));
+  }
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpstr (changes->str, ==, "test.answer=42;");
+  g_assert_cmpstr (answer_changes->str, ==, "test.answer=42;");
+  g_assert_cmpuint (n_notify, ==, 1);
+  g_assert_cmpstr (wp_pipewire_object_get_property (
+          WP_PIPEWIRE_OBJECT (node), "test.answer"), ==, "42");
+
+  /* a key that is not watched by the detailed handler changes */
+  g_string_truncate (changes, 0);
+  g_string_truncate (answer_changes, 0);
+  {
+    const struct spa_dict_item items[] = {
+      { "test.question", "unknown" },
+    };
+    update_server_node_properties (f, id, &SPA_DICT_INIT_ARRAY (items));
+  }
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpstr (changes->str, ==, "test.question=unknown;");
+  g_assert_cmpstr (answer_changes->str, ==, "");
+  g_assert_cmpuint (n_notify, ==, 2);
+
+  /* removing a key */
+  g_string_truncate (changes, 0);
+  {
+    const struct spa_dict_item items[] = {
+      { "test.answer", NULL },
+    };
+    update_server_node_properties (f, id, &SPA_DICT_INIT_ARRAY (items));
+  }
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpstr (changes->str, ==, "test.answer=(null);");
+  g_assert_cmpstr (answer_changes->str, ==, "test.answer=(null);");
+  g_assert_cmpuint (n_notify, ==, 3);
+  g_assert_null (wp_pipewire_object_get_property (
+          WP_PIPEWIRE_OBJECT (node), "test.answer"));
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -304,6 +427,8 @@ main (gint argc, gchar *argv[])
       test_proxy_setup, test_link_error, test_proxy_teardown);
   g_test_add ("/wp/proxy/enum_params_error", TestFixture, NULL,
       test_proxy_setup, test_enum_params_error, test_proxy_teardown);
+  g_test_add ("/wp/proxy/properties_changed", TestFixture, NULL,
+      test_proxy_setup, test_properties_changed, test_proxy_teardown);
 
   return g_test_run ();
 }
@@ -202,6 +202,88 @@ test_state_escaped (void)
   wp_state_clear (state);
 }
 
+static void
+test_state_records (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (WpState) state = wp_state_new ("records");
+  g_assert_nonnull (state);
+
+  /* Load empty */
+  {
+    g_autoptr (GVariant) records = wp_state_load_records (state);
+    g_assert_nonnull (records);
+    g_assert_true (g_variant_is_of_type (records, G_VARIANT_TYPE_VARDICT));
+    g_assert_cmpuint (g_variant_n_children (records), ==, 0);
+  }
+
+  /* Save, together with properties */
+  {
+    g_autoptr (WpProperties) props = wp_properties_new ("key", "value", NULL);
+    const gdouble volumes[] = { 0.5, 0.25 };
+    g_auto (GVariantBuilder) b = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+    g_auto (GVariantBuilder) group =
+        G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE_VARDICT);
+
+    g_variant_builder_add (&group, "{sv}", "volume", g_variant_new_double (1.0));
+    g_variant_builder_add (&group, "{sv}", "mute", g_variant_new_boolean (TRUE));
+    g_variant_builder_add (&group, "{sv}", "channelVolumes",
+        g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE, volumes,
+            G_N_ELEMENTS (volumes), sizeof (gdouble)));
+    g_variant_builder_add (&b, "{sv}", "Output/Audio:media.role:Music",
+        g_variant_builder_end (&group));
+    g_variant_builder_add (&b, "{sv}", "single", g_variant_new_double (0.75));
+
+    g_assert_true (wp_state_save (state, props, &error));
+    g_assert_no_error (error);
+    g_assert_true (wp_state_save_records (state, g_variant_builder_end (&b),
+            &error));
+    g_assert_no_error (error);
+  }
+
+  /* Load */
+  {
+    g_autoptr (WpProperties) props = wp_state_load (state);
+    g_autoptr (GVariant) records = wp_state_load_records (state);
+    g_autoptr (GVariant) group = NULL;
+    g_autoptr (GVariant) arr = NULL;
+    const gdouble *volumes;
+    gsize n_volumes = 0;
+    gdouble d = 0.0;
+    gboolean mute = FALSE;
+
+    g_assert_cmpstr (wp_properties_get (props, "key"), ==, "value");
+    g_assert_cmpuint (g_variant_n_children (records), ==, 2);
+
+    g_assert_true (g_variant_lookup (records, "single", "d", &d));
+    g_assert_cmpfloat_with_epsilon (d, 0.75, 0.001);
+
+    group = g_variant_lookup_value (records, "Output/Audio:media.role:Music",
+        G_VARIANT_TYPE_VARDICT);
+    g_assert_nonnull (group);
+    g_assert_true (g_variant_lookup (group, "volume", "d", &d));
+    g_assert_cmpfloat_with_epsilon (d, 1.0, 0.001);
+    g_assert_true (g_variant_lookup (group, "mute", "b", &mute));
+    g_assert_true (mute);
+
+    arr = g_variant_lookup_value (group, "channelVolumes",
+        G_VARIANT_TYPE ("ad"));
+    g_assert_nonnull (arr);
+    volumes = g_variant_get_fixed_array (arr, &n_volumes, sizeof (gdouble));
+    g_assert_cmpuint (n_volumes, ==, 2);
+    g_assert_cmpfloat_with_epsilon (volumes[0], 0.5, 0.001);
+    g_assert_cmpfloat_with_epsilon (volumes[1], 0.25, 0.001);
+  }
+
+  wp_state_clear (state);
+
+  /* Load empty after clear */
+  {
+    g_autoptr (GVariant) records = wp_state_load_records (state);
+    g_assert_cmpuint (g_variant_n_children (records), ==, 0);
+  }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -212,6 +294,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/state/empty", test_state_empty);
   g_test_add_func ("/wp/state/spaces", test_state_spaces);
   g_test_add_func ("/wp/state/escaped", test_state_escaped);
+  g_test_add_func ("/wp/state/records", test_state_records);
 
   return g_test_run ();
 }
@@ -0,0 +1,156 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+
+typedef struct {
+  WpBaseTestFixture base;
+  GString *fired;
+  guint n_pending;
+} TestFixture;
+
+static void
+test_timer_setup (TestFixture *self, gconstpointer user_data)
+{
+  wp_base_test_fixture_setup (&self->base, WP_BASE_TEST_FLAG_DONT_CONNECT);
+  self->fired = g_string_new (NULL);
+}
+
+static void
+test_timer_teardown (TestFixture *self, gconstpointer user_data)
+{
+  g_string_free (self->fired, TRUE);
+  wp_base_test_fixture_teardown (&self->base);
+}
+
+static void
+on_timer_fired (WpTimer * timer, gpointer data)
+{
+  TestFixture *self = g_object_get_data (G_OBJECT (data), "fixture");
+  const gchar *name = g_object_get_data (G_OBJECT (data), "name");
+
+  g_assert_false (wp_timer_is_pending (timer));
+  g_string_append (self->fired, name);
+  if (--self->n_pending == 0)
+    g_main_loop_quit (self->base.loop);
+}
+
+static WpTimer *
+new_timer (TestFixture *self, const gchar * name, GPtrArray * data)
+{
+  GObject *obj = g_object_new (G_TYPE_OBJECT, NULL);
+
+  g_object_set_data (obj, "fixture", self);
+  g_object_set_data_full (obj, "name", g_strdup (name), g_free);
+  g_ptr_array_add (data, obj);
+  return wp_timer_new (self->base.core, on_timer_fired, obj, NULL);
+}
+
+static void
+test_timer_order (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (GPtrArray) data = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr (WpTimer) a = new_timer (self, "a", data);
+  g_autoptr (WpTimer) b = new_timer (self, "b", data);
+  g_autoptr (WpTimer) c = new_timer (self, "c", data);
+  g_autoptr (WpTimer) d = new_timer (self, "d", data);
+  g_autoptr (WpTimer) e = new_timer (self, "e", data);
+
+  /* spread over the first two levels of the wheel */
+  wp_timer_start (a, 300);
+  wp_timer_start (b, 5);
+  wp_timer_start (c, 70);
+  wp_timer_start (d, 20);
+  wp_timer_start (e, 10);
+  g_assert_true (wp_timer_is_pending (a));
+
+  /* re-arm and cancel */
+  wp_timer_start (b, 100);
+  wp_timer_stop (e);
+  wp_timer_stop (e);
+  g_assert_false (wp_timer_is_pending (e));
+
+  self->n_pending = 4;
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpstr (self->fired->str, ==, "dcba");
+  g_assert_false (wp_timer_is_pending (a));
+
+  /* timers can be restarted after they fired */
+  g_string_truncate (self->fired, 0);
+  wp_timer_start (a, 0);
+  wp_timer_start (e, 1);
+  self->n_pending = 2;
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpstr (self->fired->str, ==, "ae");
+}
+
+static void
+test_timer_cascade (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (GPtrArray) data = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr (WpTimer) a = new_timer (self, "a", data);
+  g_autoptr (WpTimer) b = new_timer (self, "b", data);
+  g_autoptr (WpTimer) c = new_timer (self, "c", data);
+  g_autoptr (WpTimer) d = new_timer (self, "d", data);
+  gint64 start = g_get_monotonic_time ();
+
+  /* 64 * 64 ms and later is on the third level of the wheel; when the wheel
+     reaches their slot, these are moved down level by level and must still
+     fire in order and not earlier than requested */
+  wp_timer_start (c, 4300);
+  wp_timer_start (b, 4250);
+  wp_timer_start (a, 4200);
+  wp_timer_start (d, 10);
+
+  self->n_pending = 4;
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpstr (self->fired->str, ==, "dabc");
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 4300 * 1000);
+}
+
+static void
+on_timer_restart (WpTimer * timer, gpointer data)
+{
+  TestFixture *self = data;
+
+  g_string_append_c (self->fired, 'x');
+  if (--self->n_pending == 0)
+    g_main_loop_quit (self->base.loop);
+  else
+    wp_timer_start (timer, 2);
+}
+
+static void
+test_timer_restart_from_callback (TestFixture *self, gconstpointer user_data)
+{
+  WpTimer *timer = wp_timer_new (self->base.core, on_timer_restart, self,
+      NULL);
+
+  /* the pending timer keeps itself alive */
+  wp_timer_start (timer, 2);
+  wp_timer_unref (timer);
+
+  self->n_pending = 3;
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpstr (self->fired->str, ==, "xxx");
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/wp/timer/order", TestFixture, NULL,
+      test_timer_setup, test_timer_order, test_timer_teardown);
+  g_test_add ("/wp/timer/cascade", TestFixture, NULL,
+      test_timer_setup, test_timer_cascade, test_timer_teardown);
+  g_test_add ("/wp/timer/restart-from-callback", TestFixture, NULL,
+      test_timer_setup, test_timer_restart_from_callback, test_timer_teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,245 @@
+/* WirePlumber
+ *
+ * Copyright © 2022 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+
+#include <string.h>
+
+typedef struct {
+  WpBaseTestFixture base;
+} TestFixture;
+
+/* the last stall report that was logged */
+static gchar *last_report = NULL;
+
+static GLogWriterOutput
+capture_log_writer (GLogLevelFlags log_level, const GLogField * fields,
+    gsize n_fields, gpointer user_data)
+{
+  for (gsize i = 0; i < n_fields; i++) {
+    if (g_strcmp0 (fields[i].key, "MESSAGE") == 0) {
+      g_autofree gchar *msg = (fields[i].length < 0) ?
+          g_strdup (fields[i].value) :
+          g_strndup (fields[i].value, fields[i].length);
+      if (strstr (msg, "main loop stalled")) {
+        g_free (last_report);
+        last_report = g_steal_pointer (&msg);
+      }
+      break;
+    }
+  }
+  return wp_log_writer_default (log_level, fields, n_fields, user_data);
+}
+
+static void
+test_watchdog_setup (TestFixture *self, gconstpointer user_data)
+{
+  wp_base_test_fixture_setup (&self->base, WP_BASE_TEST_FLAG_DONT_CONNECT);
+}
+
+static void
+test_watchdog_teardown (TestFixture *self, gconstpointer user_data)
+{
+  wp_watchdog_stop ();
+  g_clear_pointer (&last_report, g_free);
+  wp_base_test_fixture_teardown (&self->base);
+}
+
+static gboolean
+stall (gpointer data)
+{
+  TestFixture *self = data;
+  gboolean watched = wp_watchdog_push ("test", G_TYPE_NONE, NULL, NULL);
+
+  g_assert_true (watched);
+  g_usleep (20000);
+  wp_watchdog_pop ();
+
+  g_main_loop_quit (self->base.loop);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+sleep_and_quit (gpointer data)
+{
+  TestFixture *self = data;
+
+  g_usleep (20000);
+  g_main_loop_quit (self->base.loop);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+sleep_a_bit (gpointer data)
+{
+  g_usleep (6000);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+quit (gpointer data)
+{
+  TestFixture *self = data;
+
+  g_main_loop_quit (self->base.loop);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_timer_fired (WpTimer * timer, gpointer data)
+{
+  TestFixture *self = data;
+
+  g_usleep (20000);
+  g_main_loop_quit (self->base.loop);
+}
+
+/* counts the iterations in the buckets above @limit_us */
+static guint64
+count_slower_than (const WpWatchdogStats * stats, guint64 limit_us)
+{
+  guint64 count = 0;
+
+  for (guint i = 1; i < WP_WATCHDOG_N_BUCKETS; i++) {
+    if (wp_watchdog_get_bucket_limit (i - 1) >= limit_us)
+      count += stats->histogram[i];
+  }
+  return count;
+}
+
+static void
+test_watchdog_disabled (TestFixture *self, gconstpointer user_data)
+{
+  WpWatchdogStats stats;
+
+  g_assert_false (wp_watchdog_push ("test", G_TYPE_NONE, NULL, NULL));
+  wp_watchdog_pop ();
+
+  wp_watchdog_get_stats (&stats);
+  g_assert_cmpuint (stats.n_iterations, ==, 0);
+  g_assert_cmpuint (stats.n_stalls, ==, 0);
+
+  g_assert_cmpuint (wp_watchdog_get_bucket_limit (WP_WATCHDOG_N_BUCKETS - 1),
+      ==, G_MAXUINT64);
+  for (guint i = 1; i < WP_WATCHDOG_N_BUCKETS; i++)
+    g_assert_cmpuint (wp_watchdog_get_bucket_limit (i - 1), <,
+        wp_watchdog_get_bucket_limit (i));
+}
+
+static void
+test_watchdog_stall (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (GSource) source = g_idle_source_new ();
+  WpWatchdogStats stats;
+
+  wp_watchdog_start (self->base.context, 5, 0);
+
+  g_source_set_name (source, "stall-source");
+  g_source_set_callback (source, stall, self, NULL);
+  g_source_attach (source, self->base.context);
+  g_main_loop_run (self->base.loop);
+
+  /* the iteration is accounted when the loop goes back to poll() */
+  g_main_context_iteration (self->base.context, FALSE);
+
+  wp_watchdog_get_stats (&stats);
+  g_assert_cmpuint (stats.n_iterations, >=, 1);
+  g_assert_cmpuint (stats.n_stalls, >=, 1);
+  g_assert_cmpuint (stats.max_busy_us, >=, 20000);
+  g_assert_cmpuint (count_slower_than (&stats, 10000), >=, 1);
+
+  g_assert_nonnull (last_report);
+  g_assert_nonnull (strstr (last_report, "running: test ("));
+  g_assert_nonnull (strstr (last_report, "from source 'stall-source'"));
+
+  wp_watchdog_stop ();
+  wp_watchdog_get_stats (&stats);
+  g_assert_cmpuint (stats.n_iterations, ==, 0);
+}
+
+static void
+test_watchdog_timer (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (WpTimer) timer =
+      wp_timer_new (self->base.core, on_timer_fired, self, NULL);
+  WpWatchdogStats stats;
+
+  wp_watchdog_start (self->base.context, 5, 0);
+
+  wp_timer_start (timer, 1);
+  g_main_loop_run (self->base.loop);
+  g_main_context_iteration (self->base.context, FALSE);
+
+  wp_watchdog_get_stats (&stats);
+  g_assert_cmpuint (stats.n_stalls, >=, 1);
+  g_assert_cmpuint (stats.max_busy_us, >=, 20000);
+}
+
+static void
+test_watchdog_core_sources (TestFixture *self, gconstpointer user_data)
+{
+  wp_watchdog_start (self->base.context, 5, 0);
+
+  /* C callback */
+  wp_core_idle_add (self->base.core, NULL, sleep_and_quit, self, NULL);
+  g_main_loop_run (self->base.loop);
+  g_main_context_iteration (self->base.context, FALSE);
+
+  g_assert_nonnull (last_report);
+  g_assert_nonnull (strstr (last_report, "running: idle callback function"));
+  g_assert_nonnull (strstr (last_report, "from source"));
+  g_clear_pointer (&last_report, g_free);
+
+  /* closure */
+  wp_core_timeout_add_closure (self->base.core, NULL, 1,
+      g_cclosure_new (G_CALLBACK (sleep_and_quit), self, NULL));
+  g_main_loop_run (self->base.loop);
+  g_main_context_iteration (self->base.context, FALSE);
+
+  g_assert_nonnull (last_report);
+  g_assert_nonnull (strstr (last_report, "running: timeout callback GClosure:"));
+}
+
+static void
+test_watchdog_slowest (TestFixture *self, gconstpointer user_data)
+{
+  wp_watchdog_start (self->base.context, 15, 0);
+
+  /* none of these stalls by itself, but they all run in the same
+     iteration, which does */
+  wp_core_idle_add (self->base.core, NULL, sleep_a_bit, NULL, NULL);
+  wp_core_idle_add (self->base.core, NULL, sleep_a_bit, NULL, NULL);
+  wp_core_idle_add (self->base.core, NULL, sleep_a_bit, NULL, NULL);
+  wp_core_idle_add (self->base.core, NULL, quit, self, NULL);
+  g_main_loop_run (self->base.loop);
+  g_main_context_iteration (self->base.context, FALSE);
+
+  g_assert_nonnull (last_report);
+  g_assert_nonnull (strstr (last_report,
+      "slowest instrumented handler: idle callback from source"));
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_log_set_writer_func (capture_log_writer, NULL, NULL);
+  wp_init (WP_INIT_ALL & ~WP_INIT_SET_GLIB_LOG);
+
+  g_test_add ("/wp/watchdog/disabled", TestFixture, NULL,
+      test_watchdog_setup, test_watchdog_disabled, test_watchdog_teardown);
+  g_test_add ("/wp/watchdog/stall", TestFixture, NULL,
+      test_watchdog_setup, test_watchdog_stall, test_watchdog_teardown);
+  g_test_add ("/wp/watchdog/timer", TestFixture, NULL,
+      test_watchdog_setup, test_watchdog_timer, test_watchdog_teardown);
+  g_test_add ("/wp/watchdog/core-sources", TestFixture, NULL,
+      test_watchdog_setup, test_watchdog_core_sources, test_watchdog_teardown);
+  g_test_add ("/wp/watchdog/slowest", TestFixture, NULL,
+      test_watchdog_setup, test_watchdog_slowest, test_watchdog_teardown);
+
+  return g_test_run ();
+}
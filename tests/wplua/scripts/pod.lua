@@ -249,3 +249,33 @@ assert (val.properties["id-02000000"].properties.device == "my-sub-device")
 assert (val.properties["id-02000000"].properties["id-03000000"] == true)
 assert (val.properties["id-02000000"].properties["id-04000000"] == "string")
 assert (pod:get_type_name() == "Spa:Pod:Object:Param:Props")
+
+-- Lazy access
+pod = Pod.Object {
+  "Spa:Pod:Object:Param:PortConfig", "PortConfig",
+  direction = "Input",
+  mode = "dsp",
+  format = Pod.Object {
+    "Spa:Pod:Object:Param:Format", "Format",
+    mediaType = "audio",
+    rate = 48000,
+    position = Pod.Array { "Spa:Enum:AudioChannel", "FL", "FR" },
+  },
+  ["id-01000000"] = Pod.Struct { true, 1, "string" },
+}
+assert (pod:get_object_id() == "PortConfig")
+assert (pod:get("direction") == "Input")
+assert (pod:get("format", "rate") == 48000)
+assert (pod:get("format", "position")[2] == "FR")
+assert (pod:get("format", "channels") == nil)
+assert (pod:get("id-01000000", 3) == "string")
+assert (pod:get("id-01000000", 4) == nil)
+assert (pod:get("format").properties.mediaType == "audio")
+assert (pod:get().object_id == "PortConfig")
+val = pod:pick("mode", "monitor", "direction")
+assert (val.mode == "dsp")
+assert (val.direction == "Input")
+assert (val.monitor == nil)
+assert (val.format == nil)
+assert (Pod.Int (4):get_object_id() == nil)
+assert (Pod.Int (4):pick("mode") == nil)
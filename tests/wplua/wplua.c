@@ -9,6 +9,7 @@
 #include "lua.h"
 #include <wplua/wplua.h>
 #include <wp/wp.h>
+#include <glib/gstdio.h>
 
 enum {
   PROP_0,
@@ -46,6 +47,8 @@ struct _TestObjectClass
 
 G_DEFINE_TYPE (TestObject, test_object, G_TYPE_OBJECT)
 
+static guint test_object_keyed_signal = 0;
+
 #define TEST_TYPE_OBJECT (test_object_get_type ())
 _GLIB_DEFINE_AUTOPTR_CHAINUP (TestObject, GObject)
 
@@ -211,6 +214,10 @@ test_object_class_init (TestObjectClass * klass)
 
   g_signal_new ("acquire", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
       0, NULL, NULL, NULL, G_TYPE_INT, 0);
+
+  test_object_keyed_signal = g_signal_new ("keyed", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED, 0, NULL, NULL, NULL,
+      G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 static void
@@ -228,8 +235,19 @@ l_test_object_toggle (lua_State * L)
   return 0;
 }
 
+static int
+l_test_object_emit_keyed (lua_State * L)
+{
+  TestObject * self = wplua_checkobject (L, 1, TEST_TYPE_OBJECT);
+  const gchar *key = luaL_checkstring (L, 2);
+  g_signal_emit (self, test_object_keyed_signal, g_quark_from_string (key),
+      key);
+  return 0;
+}
+
 static const luaL_Reg l_test_object_methods[] = {
   { "toggle", l_test_object_toggle },
+  { "emit_keyed", l_test_object_emit_keyed },
   { NULL, NULL }
 };
 
@@ -274,6 +292,37 @@ test_wplua_construct ()
   g_assert_cmpint (obj->ref_count, ==, 1);
 }
 
+static void
+test_wplua_interning ()
+{
+  g_autoptr (GObject) obj = g_object_new (TEST_TYPE_OBJECT, NULL);
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  lua_State *L = wplua_new ();
+
+  /* pushing the same object twice yields the same userdata
+     and only one reference is kept */
+  wplua_pushobject (L, g_object_ref (obj));
+  wplua_pushobject (L, g_object_ref (obj));
+  g_assert_true (lua_rawequal (L, -1, -2));
+  g_assert_cmpint (obj->ref_count, ==, 2);
+
+  wplua_pushboxed (L, WP_TYPE_PROPERTIES, wp_properties_ref (props));
+  wplua_pushboxed (L, WP_TYPE_PROPERTIES, wp_properties_ref (props));
+  g_assert_true (lua_rawequal (L, -1, -2));
+  g_assert_false (lua_rawequal (L, -1, -3));
+  lua_pop (L, 4);
+
+  /* once collected, a new userdata is created */
+  lua_gc (L, LUA_GCCOLLECT, 0);
+  g_assert_cmpint (obj->ref_count, ==, 1);
+  wplua_pushobject (L, g_object_ref (obj));
+  g_assert_cmpint (obj->ref_count, ==, 2);
+  lua_pop (L, 1);
+
+  wplua_free (L);
+  g_assert_cmpint (obj->ref_count, ==, 1);
+}
+
 static void
 test_wplua_properties ()
 {
@@ -369,6 +418,192 @@ test_wplua_closure ()
   g_closure_unref (closure);
 }
 
+static void
+test_wplua_alloc ()
+{
+  g_autoptr (GError) error = NULL;
+  WpLuaAllocStats stats, after;
+  WpLuaAllocClassStats classes[8];
+  guint n_classes, n_used = 0;
+  lua_State *L = wplua_new_full (128, 4096);
+
+  const gchar code[] =
+    "objects = {}\n"
+    "for i = 1, 1000 do\n"
+    "  objects[i] = { i, tostring(i) }\n"
+    "end\n";
+  wplua_load_buffer (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  wplua_get_alloc_stats (L, &stats);
+  g_assert_cmpuint (stats.live_bytes, >, 0);
+  g_assert_cmpuint (stats.peak_live_bytes, >=, stats.live_bytes);
+  g_assert_cmpuint (stats.pool_bytes, >=, 4096);
+  g_assert_cmpuint (stats.n_allocs, >, stats.n_frees);
+
+  n_classes = wplua_get_alloc_class_stats (L, classes, G_N_ELEMENTS (classes));
+  g_assert_cmpuint (n_classes, ==, 8);
+  for (guint i = 0; i < n_classes; i++) {
+    g_assert_cmpuint (classes[i].block_size, ==, (i + 1) * 16);
+    n_used += classes[i].n_used;
+  }
+  g_assert_cmpuint (n_used, >, 1000);
+
+  /* freed blocks go back to the pools, which release the slabs that
+     become empty */
+  lua_pushnil (L);
+  lua_setglobal (L, "objects");
+  lua_gc (L, LUA_GCCOLLECT, 0);
+
+  wplua_get_alloc_stats (L, &after);
+  g_assert_cmpuint (after.live_bytes, <, stats.live_bytes);
+  g_assert_cmpuint (after.peak_live_bytes, ==, stats.peak_live_bytes);
+  g_assert_cmpuint (after.pool_bytes, <, stats.pool_bytes);
+  g_assert_cmpuint (after.n_frees, >, stats.n_frees);
+
+  wplua_free (L);
+
+  /* without pools, everything goes to malloc */
+  L = wplua_new_full (0, 0);
+  wplua_load_buffer (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+  wplua_get_alloc_stats (L, &stats);
+  g_assert_cmpuint (stats.live_bytes, >, 0);
+  g_assert_cmpuint (stats.pool_bytes, ==, 0);
+  g_assert_cmpuint (wplua_get_alloc_class_stats (L, classes, 8), ==, 0);
+  wplua_free (L);
+}
+
+static void
+test_wplua_gc ()
+{
+  static const WpLuaGcMode modes[] = {
+    WP_LUA_GC_MODE_FULL,
+    WP_LUA_GC_MODE_INCREMENTAL,
+    WP_LUA_GC_MODE_GENERATIONAL,
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (modes); i++) {
+    g_autoptr (GError) error = NULL;
+    GClosure *closure;
+    WpLuaGcStats stats;
+    lua_State *L = wplua_new ();
+
+    wplua_set_gc_policy (L, modes[i], 0, 100);
+
+    const gchar code[] =
+      "function make_garbage()\n"
+      "  for i = 1, 1000 do\n"
+      "    local t = { i, tostring(i) }\n"
+      "  end\n"
+      "end\n";
+    wplua_load_buffer (L, code, sizeof (code) - 1, 0, 0, &error);
+    g_assert_no_error (error);
+
+    lua_getglobal (L, "make_garbage");
+    closure = wplua_function_to_closure (L, -1);
+    g_closure_ref (closure);
+    g_closure_sink (closure);
+    lua_pop (L, 1);
+
+    g_closure_invoke (closure, NULL, 0, NULL, NULL);
+
+    /* the full mode collects synchronously; the others on idle */
+    wplua_get_gc_stats (L, &stats);
+    if (modes[i] == WP_LUA_GC_MODE_FULL)
+      g_assert_cmpuint (stats.n_cycles, ==, 1);
+    else
+      g_assert_cmpuint (stats.n_cycles, ==, 0);
+
+    while (g_main_context_iteration (NULL, FALSE));
+
+    wplua_get_gc_stats (L, &stats);
+    g_assert_cmpuint (stats.n_cycles, ==, 1);
+    g_assert_cmpuint (stats.heap_size, >, 0);
+    g_assert_cmpuint (stats.peak_heap_size, >=, stats.heap_size);
+    if (modes[i] != WP_LUA_GC_MODE_FULL)
+      g_assert_cmpuint (stats.n_steps, >, 0);
+
+    wplua_free (L);
+    g_closure_unref (closure);
+  }
+}
+
+static void
+test_wplua_profiler ()
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GVariant) report = NULL;
+  g_autoptr (GVariantIter) handlers = NULL;
+  g_autoptr (GVariantIter) samples = NULL;
+  GClosure *closure;
+  const gchar *location;
+  guint64 calls, total_us, max_us, allocs, n_samples, time_us;
+  gboolean found_handler = FALSE, found_chunk = FALSE;
+  gboolean running = FALSE;
+  lua_State *L = wplua_new ();
+
+  wplua_profiler_start (L, 1);
+
+  const gchar code[] =
+    "\n"
+    "function handler()\n"
+    "  local t = {}\n"
+    "  for i = 1, 100 do t[i] = { i } end\n"
+    "end\n";
+  wplua_load_buffer (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  lua_getglobal (L, "handler");
+  closure = wplua_function_to_closure (L, -1);
+  g_closure_ref (closure);
+  g_closure_sink (closure);
+  lua_pop (L, 1);
+
+  g_closure_invoke (closure, NULL, 0, NULL, NULL);
+  g_closure_invoke (closure, NULL, 0, NULL, NULL);
+
+  /* calls after stopping are not accounted */
+  wplua_profiler_stop (L);
+  g_closure_invoke (closure, NULL, 0, NULL, NULL);
+
+  report = g_variant_ref_sink (wplua_profiler_get_report (L));
+  g_assert_true (g_variant_lookup (report, "running", "b", &running));
+  g_assert_false (running);
+  g_assert_true (g_variant_lookup (report, "handlers", "a(stttt)", &handlers));
+  g_assert_true (g_variant_lookup (report, "samples", "a(stt)", &samples));
+
+  while (g_variant_iter_next (handlers, "(&stttt)", &location, &calls,
+              &total_us, &max_us, &allocs)) {
+    g_assert_cmpuint (max_us, <=, total_us);
+    if (g_str_has_suffix (location, ":2")) {
+      g_assert_cmpuint (calls, ==, 2);
+      g_assert_cmpuint (allocs, >=, 2 * 101);
+      found_handler = TRUE;
+    } else if (g_str_has_suffix (location, ":0")) {
+      g_assert_cmpuint (calls, ==, 1);
+      found_chunk = TRUE;
+    }
+  }
+  g_assert_true (found_handler);
+  g_assert_true (found_chunk);
+
+  g_assert_true (g_variant_iter_next (samples, "(&stt)", &location,
+          &n_samples, &time_us));
+  g_assert_cmpuint (n_samples, >, 0);
+
+  /* reset discards everything */
+  wplua_profiler_reset (L);
+  g_clear_pointer (&report, g_variant_unref);
+  g_clear_pointer (&handlers, g_variant_iter_free);
+  report = g_variant_ref_sink (wplua_profiler_get_report (L));
+  g_assert_true (g_variant_lookup (report, "handlers", "a(stttt)", &handlers));
+  g_assert_cmpuint (g_variant_iter_n_children (handlers), ==, 0);
+
+  wplua_free (L);
+  g_closure_unref (closure);
+}
+
 static void
 test_wplua_signals ()
 {
@@ -405,6 +640,97 @@ test_wplua_signals ()
   wplua_free (L);
 }
 
+static void
+test_wplua_signals_detailed ()
+{
+  g_autoptr (GError) error = NULL;
+  lua_State *L = wplua_new ();
+
+  wplua_register_type_methods(L, TEST_TYPE_OBJECT,
+      l_test_object_new, l_test_object_methods);
+
+  /* the details are not known to GLib before the script connects */
+  const gchar code[] =
+    "o = TestObject_new()\n"
+    "keys = {}\n"
+    "deferred_keys = {}\n"
+    "\n"
+    "o:connect('keyed::wplua-detailed-a', function (obj, key)\n"
+    "    table.insert(keys, key)\n"
+    "  end)\n"
+    "o:connect_deferred('keyed::wplua-detailed-b', function (obj, key)\n"
+    "    table.insert(deferred_keys, key)\n"
+    "  end)\n"
+    "\n"
+    "o:emit_keyed('wplua-detailed-b')\n"
+    "o:emit_keyed('wplua-detailed-c')\n"
+    "o:emit_keyed('wplua-detailed-a')\n"
+    "\n"
+    "assert(#keys == 1)\n"
+    "assert(keys[1] == 'wplua-detailed-a')\n";
+  wplua_load_buffer (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  while (g_main_context_iteration (NULL, FALSE));
+
+  const gchar code2[] =
+    "assert(#deferred_keys == 1)\n"
+    "assert(deferred_keys[1] == 'wplua-detailed-b')\n";
+  wplua_load_buffer (L, code2, sizeof (code2) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+  wplua_free (L);
+}
+
+static void
+test_wplua_signals_deferred ()
+{
+  g_autoptr (GError) error = NULL;
+  lua_State *L = wplua_new ();
+
+  wplua_register_type_methods(L, TEST_TYPE_OBJECT,
+      l_test_object_new, l_test_object_methods);
+
+  const gchar code[] =
+    "o = TestObject_new()\n"
+    "notify_count = 0\n"
+    "changes = {}\n"
+    "\n"
+    "o:connect_deferred('notify::test-int', function (obj, pspec)\n"
+    "    assert(obj == o)\n"
+    "    assert(pspec == 'test-int')\n"
+    "    notify_count = notify_count + 1\n"
+    "  end)\n"
+    "\n"
+    "o:connect_deferred('change', function (obj, str, integer)\n"
+    "    table.insert(changes, str .. integer)\n"
+    "  end)\n"
+    "\n"
+    "o['test-int'] = 1\n"
+    "o['test-int'] = 2\n"
+    "o['test-int'] = 3\n"
+    "o:call('change', 'a', 1)\n"
+    "o:call('change', 'b', 2)\n"
+    "o:call('change', 'a', 1)\n"
+    "\n"
+    "assert(notify_count == 0)\n"
+    "assert(#changes == 0)\n"
+    "\n"
+    "assert(not pcall(o.connect_deferred, o, 'acquire', function () end))\n";
+  wplua_load_buffer (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  while (g_main_context_iteration (NULL, FALSE));
+
+  const gchar code2[] =
+    "assert(notify_count == 1)\n"
+    "assert(#changes == 2)\n"
+    "assert(changes[1] == 'a1')\n"
+    "assert(changes[2] == 'b2')\n";
+  wplua_load_buffer (L, code2, sizeof (code2) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+  wplua_free (L);
+}
+
 static void
 test_wplua_sandbox_script ()
 {
@@ -684,6 +1010,120 @@ test_wplua_script_arguments ()
   wplua_free (L);
 }
 
+static GPtrArray *
+list_bytecode_cache (void)
+{
+  g_autofree gchar *dir_path = g_build_filename (g_get_user_cache_dir (),
+      "wireplumber", "lua", NULL);
+  g_autoptr (GDir) dir = g_dir_open (dir_path, 0, NULL);
+  GPtrArray *files = g_ptr_array_new_with_free_func (g_free);
+  const gchar *name;
+
+  while (dir && (name = g_dir_read_name (dir)))
+    g_ptr_array_add (files, g_build_filename (dir_path, name, NULL));
+  return files;
+}
+
+static void
+load_cached_script (const gchar * path, gint64 expected)
+{
+  g_autoptr (GError) error = NULL;
+  lua_State *L = wplua_new ();
+
+  wplua_load_path (L, path, 0, 0, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (lua_getglobal (L, "cached_result"), ==, LUA_TNUMBER);
+  g_assert_cmpint (lua_tointeger (L, -1), ==, expected);
+  lua_pop (L, 1);
+
+  wplua_free (L);
+}
+
+static void
+test_wplua_bytecode_cache ()
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GPtrArray) before = NULL;
+  g_autoptr (GPtrArray) after = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *code = NULL;
+  g_autofree gchar *entry = NULL;
+  g_autofree gchar *dir = NULL;
+  g_autofree gchar *contents = NULL;
+  gint64 value = g_get_real_time ();
+  GStatBuf st;
+
+  tmpdir = g_dir_make_tmp ("wplua-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (tmpdir, "cached.lua", NULL);
+
+  /* make the content unique, so that it is never in the cache already */
+  code = g_strdup_printf ("cached_result = %" G_GINT64_FORMAT "\n", value);
+  g_file_set_contents (path, code, -1, &error);
+  g_assert_no_error (error);
+
+  before = list_bytecode_cache ();
+  load_cached_script (path, value);
+  after = list_bytecode_cache ();
+  g_assert_cmpuint (after->len, ==, before->len + 1);
+
+  for (guint i = 0; i < after->len && !entry; i++) {
+    if (!g_ptr_array_find_with_equal_func (before, after->pdata[i],
+            g_str_equal, NULL))
+      entry = g_strdup (after->pdata[i]);
+  }
+  g_assert_nonnull (entry);
+  g_assert_true (g_str_has_suffix (entry, ".luac"));
+
+  /* the second load is served from the cache */
+  load_cached_script (path, value);
+  g_clear_pointer (&after, g_ptr_array_unref);
+  after = list_bytecode_cache ();
+  g_assert_cmpuint (after->len, ==, before->len + 1);
+
+  /* editing the script replaces its entry */
+  value++;
+  g_free (code);
+  code = g_strdup_printf ("cached_result = %" G_GINT64_FORMAT "\n", value);
+  g_file_set_contents (path, code, -1, &error);
+  g_assert_no_error (error);
+  load_cached_script (path, value);
+  g_clear_pointer (&after, g_ptr_array_unref);
+  after = list_bytecode_cache ();
+  g_assert_cmpuint (after->len, ==, before->len + 1);
+  g_assert_true (g_ptr_array_find_with_equal_func (after, entry,
+          g_str_equal, NULL));
+
+  /* a damaged entry is discarded and the script is recompiled */
+  g_file_set_contents (entry, "WPLUAC\x02garbage", -1, &error);
+  g_assert_no_error (error);
+  load_cached_script (path, value);
+  g_assert_true (g_file_test (entry, G_FILE_TEST_IS_REGULAR));
+  load_cached_script (path, value);
+
+  /* an entry that others can write to is not loaded, but replaced */
+  g_assert_cmpint (g_chmod (entry, 0666), ==, 0);
+  load_cached_script (path, value);
+  g_assert_cmpint (g_stat (entry, &st), ==, 0);
+  g_assert_cmpint (st.st_mode & 0777, ==, 0600);
+
+  /* the cache is not used at all in a directory that others can write to */
+  dir = g_path_get_dirname (entry);
+  g_assert_cmpint (g_chmod (dir, 0777), ==, 0);
+  g_file_set_contents (entry, "garbage", -1, &error);
+  g_assert_no_error (error);
+  load_cached_script (path, value);
+  g_file_get_contents (entry, &contents, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (contents, ==, "garbage");
+  g_assert_cmpint (g_chmod (dir, 0700), ==, 0);
+
+  g_unlink (entry);
+  g_unlink (path);
+  g_rmdir (tmpdir);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -692,9 +1132,15 @@ main (gint argc, gchar *argv[])
 
   g_test_add_func ("/wplua/basic", test_wplua_basic);
   g_test_add_func ("/wplua/construct", test_wplua_construct);
+  g_test_add_func ("/wplua/interning", test_wplua_interning);
   g_test_add_func ("/wplua/properties", test_wplua_properties);
   g_test_add_func ("/wplua/closure", test_wplua_closure);
+  g_test_add_func ("/wplua/gc", test_wplua_gc);
+  g_test_add_func ("/wplua/alloc", test_wplua_alloc);
+  g_test_add_func ("/wplua/profiler", test_wplua_profiler);
   g_test_add_func ("/wplua/signals", test_wplua_signals);
+  g_test_add_func ("/wplua/signals/deferred", test_wplua_signals_deferred);
+  g_test_add_func ("/wplua/signals/detailed", test_wplua_signals_detailed);
   g_test_add_func ("/wplua/sandbox/script", test_wplua_sandbox_script);
   g_test_add_func ("/wplua/sandbox/config", test_wplua_sandbox_config);
   g_test_add_func ("/wplua/convert/asv", test_wplua_convert_asv);
@@ -703,6 +1149,7 @@ main (gint argc, gchar *argv[])
   g_test_add_func ("/wplua/convert/wp_properties",
       test_wplua_convert_wp_properties);
   g_test_add_func ("/wplua/script_arguments", test_wplua_script_arguments);
+  g_test_add_func ("/wplua/bytecode_cache", test_wplua_bytecode_cache);
 
   return g_test_run ();
 }